@@ -80,7 +80,7 @@ Java_com_google_android_filament_LightManager_nBuilderShadowOptions(JNIEnv* env,
         jfloat polygonOffsetConstant, jfloat polygonOffsetSlope,
         jboolean screenSpaceContactShadows, jint stepCount,
         jfloat maxShadowDistance, jboolean elvsm, jfloat blurWidth, jfloat shadowBulbRadius,
-        jfloatArray transform) {
+        jfloatArray transform, jboolean cacheShadowMap, jint cascadeUpdateInterval) {
     LightManager::Builder *builder = (LightManager::Builder *) nativeBuilder;
     LightManager::ShadowOptions shadowOptions {
             .mapSize = (uint32_t)mapSize,
@@ -101,7 +101,9 @@ Java_com_google_android_filament_LightManager_nBuilderShadowOptions(JNIEnv* env,
                     .elvsm = (bool)elvsm,
                     .blurWidth = blurWidth
             },
-            .shadowBulbRadius = shadowBulbRadius
+            .shadowBulbRadius = shadowBulbRadius,
+            .cacheShadowMap = (bool)cacheShadowMap,
+            .cascadeUpdateInterval = (uint8_t)cascadeUpdateInterval
     };
 
     jfloat *nativeSplits = env->GetFloatArrayElements(splitPositions, NULL);
@@ -171,6 +171,19 @@ Java_com_google_android_filament_View_nSetSoftShadowOptions(JNIEnv*, jclass, jlo
     view->setSoftShadowOptions(options);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetShadowTexelBudget(JNIEnv*, jclass, jlong nativeView,
+        jint texels) {
+    View* view = (View*) nativeView;
+    view->setShadowTexelBudget((uint32_t) texels);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_View_nGetShadowTexelBudget(JNIEnv*, jclass, jlong nativeView) {
+    View* view = (View*) nativeView;
+    return (jint) view->getShadowTexelBudget();
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_google_android_filament_View_nSetRenderQuality(JNIEnv*, jclass,
@@ -380,6 +380,31 @@ public class LightManager {
         @NonNull
         @Size(min = 4, max = 4)
         public float[] transform = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+        /**
+         * Whether the content of this light's shadow map can be reused across frames.
+         * When enabled, a shadow map (or cascade) is only rendered again when the light, its
+         * shadow camera or its options changed, or when a shadow caster that changed since the
+         * previous frame intersects the shadow map's frustum.
+         * Material parameter changes are not tracked and don't invalidate the shadow map.
+         * This is ignored when the View's ShadowType is set to VSM.
+         * (off by default)
+         */
+        public boolean cacheShadowMap = false;
+
+        /**
+         * Number of frames between two renderings of each shadow cascade, except the first one.
+         * With a value greater than 1, the distant cascades are rendered in turn, each one
+         * reusing its previous content, reprojected for the current camera, in the meantime.
+         * A cascade is still rendered immediately when the light or its options changed, when
+         * its previous content doesn't cover the region it must shadow anymore, or when a
+         * shadow caster that changed since intersects it.
+         * Only applicable to Type.SUN or Type.DIRECTIONAL lights with more than one cascade.
+         * This is ignored when the View's ShadowType is set to VSM.
+         * The default is 1, i.e. all cascades are rendered every frame.
+         */
+        @IntRange(from = 1, to = 255)
+        public int cascadeUpdateInterval = 1;
     }
 
     public static class ShadowCascades {
@@ -518,7 +543,8 @@ public class LightManager {
                     options.polygonOffsetConstant, options.polygonOffsetSlope,
                     options.screenSpaceContactShadows,
                     options.stepCount, options.maxShadowDistance,
-                    options.elvsm, options.blurWidth, options.shadowBulbRadius, options.transform);
+                    options.elvsm, options.blurWidth, options.shadowBulbRadius, options.transform,
+                    options.cacheShadowMap, options.cascadeUpdateInterval);
             return this;
         }
 
@@ -1181,7 +1207,8 @@ public class LightManager {
              boolean stable, boolean lispsm,
              float polygonOffsetConstant, float polygonOffsetSlope,
              boolean screenSpaceContactShadows, int stepCount, float maxShadowDistance,
-             boolean elvsm, float blurWidth, float shadowBulbRadius, float[] transform);
+             boolean elvsm, float blurWidth, float shadowBulbRadius, float[] transform,
+             boolean cacheShadowMap, int cascadeUpdateInterval);
     private static native void nBuilderCastLight(long nativeBuilder, boolean enabled);
     private static native void nBuilderPosition(long nativeBuilder, float x, float y, float z);
     private static native void nBuilderDirection(long nativeBuilder, float x, float y, float z);
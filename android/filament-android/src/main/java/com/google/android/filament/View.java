@@ -843,6 +843,30 @@ public class View {
         return mSoftShadowOptions;
     }
 
+    /**
+     * Sets the budget, in texels, of the spot and point light shadow maps of this View.
+     *
+     * When a budget is set, each spot and point light shadow map is sized according to the
+     * screen coverage of its light, and the shadow maps of the lights covering the least of the
+     * screen are downsized until the budget is met.
+     *
+     * Ignored when shadow type is set to ShadowType.VSM.
+     *
+     * @param texels budget in texels, or 0 to always use the shadow map size of each light.
+     */
+    public void setShadowTexelBudget(@IntRange(from = 0) int texels) {
+        nSetShadowTexelBudget(getNativeObject(), texels);
+    }
+
+    /**
+     * @return the spot and point light shadow maps texel budget of this View.
+     * @see #setShadowTexelBudget
+     */
+    @IntRange(from = 0)
+    public int getShadowTexelBudget() {
+        return nGetShadowTexelBudget(getNativeObject());
+    }
+
     /**
      * Activates or deactivates ambient occlusion.
      * @see #setAmbientOcclusionOptions
@@ -1254,6 +1278,8 @@ public class View {
     private static native void nSetShadowType(long nativeView, int type);
     private static native void nSetVsmShadowOptions(long nativeView, int anisotropy, boolean mipmapping, boolean highPrecision, float minVarianceScale, float lightBleedReduction);
     private static native void nSetSoftShadowOptions(long nativeView, float penumbraScale, float penumbraRatioScale);
+    private static native void nSetShadowTexelBudget(long nativeView, int texels);
+    private static native int nGetShadowTexelBudget(long nativeView);
     private static native void nSetColorGrading(long nativeView, long nativeColorGrading);
     private static native void nSetPostProcessingEnabled(long nativeView, boolean enabled);
     private static native boolean nIsPostProcessingEnabled(long nativeView);
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_BACKEND_FILEBLOBCACHE_H
+#define TNT_FILAMENT_BACKEND_FILEBLOBCACHE_H
+
+#include <utils/compiler.h>
+#include <utils/Mutex.h>
+
+#include <string>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament::backend {
+
+class Platform;
+
+/**
+ * FileBlobCache is a reference implementation of the blob cache a Platform gives to the backend
+ * (see Platform::setBlobFunc()), which stores the blobs in a file so that they persist from one
+ * run of the application to the next. With it, the backends that support it (e.g. OpenGL) skip
+ * compiling and linking the programs that are in the cache.
+ *
+ * The cache file holds one record per blob. New blobs are appended to the file, and when the file
+ * grows past its maximum size, it is compacted: the most recently used blobs are written to a
+ * new file, from the least to the most recently used, which then replaces the old one. A record
+ * that was only partially written, e.g. because the application crashed, is discarded the next
+ * time the cache is opened, and each blob is checked against its checksum when it's retrieved,
+ * so a damaged cache file only results in cache misses.
+ *
+ * A FileBlobCache is thread-safe. It must outlive the Platform it is attached to.
+ *
+ * Typical usage:
+ *
+ * ~~~~~~~~~~~{.cpp}
+ * FileBlobCache cache("/path/to/cache.bin", 32 * 1024 * 1024);
+ * cache.attach(*platform);
+ * Engine* engine = Engine::Builder().platform(platform).build();
+ * ~~~~~~~~~~~
+ */
+class UTILS_PUBLIC FileBlobCache {
+public:
+    /**
+     * Opens the cache file at the given path, or creates it if it doesn't exist.
+     *
+     * @param path              Path of the cache file.
+     * @param maxSize           Maximum size in bytes of the cache file, blobs larger than half
+     *                          of it are never cached.
+     * @param compatibilityId   An application-defined identifier of the content of the cache,
+     *                          e.g. a hash of the GPU driver's version. The content of the cache
+     *                          file is discarded if it was created with a different identifier.
+     */
+    FileBlobCache(const char* UTILS_NONNULL path, size_t maxSize,
+            uint64_t compatibilityId = 0) noexcept;
+
+    ~FileBlobCache() noexcept;
+
+    FileBlobCache(FileBlobCache const&) = delete;
+    FileBlobCache& operator=(FileBlobCache const&) = delete;
+
+    /**
+     * @return true if the cache file could be opened or created. Otherwise, the cache is always
+     *         empty.
+     */
+    bool isValid() const noexcept;
+
+    /**
+     * Sets this cache as the blob cache of the given Platform. This must be called before the
+     * Platform's Engine is created.
+     */
+    void attach(Platform& platform) noexcept;
+
+    /**
+     * Inserts a blob in the cache, replacing the blob associated with the same key, if any.
+     * See Platform::insertBlob().
+     */
+    void insert(const void* UTILS_NONNULL key, size_t keySize,
+            const void* UTILS_NONNULL value, size_t valueSize) noexcept;
+
+    /**
+     * Retrieves the blob associated with the given key, if it is in the cache. The blob is only
+     * copied to value if it fits, so value can be null to query the blob's size.
+     * See Platform::retrieveBlob().
+     *
+     * @return the size of the blob associated with the given key, or 0 if there is none.
+     */
+    size_t retrieve(const void* UTILS_NONNULL key, size_t keySize,
+            void* UTILS_NULLABLE value, size_t valueSize) noexcept;
+
+    //! Returns the number of blobs in the cache.
+    size_t getBlobCount() const noexcept;
+
+    //! Returns the size in bytes of the cache file.
+    size_t getFileSize() const noexcept;
+
+private:
+    struct Entry {
+        uint64_t offset;        // offset of the record in the file
+        uint64_t valueSize;
+        uint64_t lastUse;       // for the LRU eviction
+        uint32_t checksum;
+    };
+
+    void open() noexcept;
+    void close() noexcept;
+    bool compact(size_t targetSize) noexcept;
+    size_t getRecordSize(std::string const& key, Entry const& entry) const noexcept;
+
+    std::string const mPath;
+    size_t const mMaxSize;
+    uint64_t const mCompatibilityId;
+
+    mutable utils::Mutex mLock;
+    FILE* mFile = nullptr;
+    uint64_t mFileSize = 0;
+    uint64_t mUseCount = 0;
+    std::unordered_map<std::string, Entry> mEntries;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_FILEBLOBCACHE_H
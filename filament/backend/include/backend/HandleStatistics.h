@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_HANDLESTATISTICS_H
+#define TNT_FILAMENT_BACKEND_HANDLESTATISTICS_H
+
+#include <utils/CallStack.h>
+#include <utils/FixedCapacityVector.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+/**
+ * Usage statistics of the backend's handle allocator.
+ *
+ * These are only collected when filament is built with FILAMENT_ENABLE_HANDLE_STATISTICS,
+ * otherwise `enabled` is false and all other fields are zero or empty.
+ */
+struct HandleStatistics {
+    struct Pool {
+        uint32_t elementSize;       //!< size in bytes of an element of this pool
+        uint32_t capacity;          //!< number of elements this pool can hold
+        uint32_t liveCount;         //!< number of elements currently allocated
+        uint32_t highWatermark;     //!< maximum number of elements allocated at once
+    };
+
+    struct Type {
+        const char* name;           //!< name of the concrete handle type
+        uint32_t liveCount;         //!< number of handles of this type currently allocated
+        uint32_t highWatermark;     //!< maximum number of handles of this type allocated at once
+    };
+
+    struct AllocationSite {
+        const char* typeName;       //!< name of the concrete handle type allocated here
+        uint32_t liveSampleCount;   //!< number of sampled live allocations from this site
+        utils::CallStack callstack; //!< call stack of the allocation
+    };
+
+    bool enabled = false;
+
+    //! size in bytes of the handle arena
+    size_t arenaSize = 0;
+
+    //! usage of each of the handle arena's pools, from smallest to largest element size
+    Pool pools[3] = {};
+
+    //! handles allocated on the system heap because their pool was full
+    uint32_t heapLiveCount = 0;
+    uint32_t heapHighWatermark = 0;
+
+    //! one allocation in samplingInterval records its call stack
+    uint32_t samplingInterval = 0;
+
+    //! live counts per concrete handle type
+    utils::FixedCapacityVector<Type> types;
+
+    //! call stacks of the sampled allocations that are still live, most frequent first
+    utils::FixedCapacityVector<AllocationSite> allocationSites;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_HANDLESTATISTICS_H
@@ -18,6 +18,7 @@
 #define TNT_FILAMENT_BACKEND_PRIVATE_CIRCULARBUFFER_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 namespace filament::backend {
 
@@ -60,15 +61,35 @@ public:
 
     static size_t getBlockSize() noexcept { return sPageSize; }
 
+    // Backing storage of a circular buffer
+    struct Storage {
+        void* data = nullptr;
+        size_t size = 0;
+        int ashmem = -1;
+        // returns whether p points inside this storage (including its shadow copy)
+        bool contains(void const* p) const noexcept {
+            return uintptr_t(p) >= uintptr_t(data) && uintptr_t(p) < uintptr_t(data) + size * 2;
+        }
+    };
+
+    // Replaces the storage of this circular buffer with a new one of size newSize. Must be
+    // called while the buffer is empty (i.e. right after circularize()).
+    // The previous storage is returned and stays valid until it is freed with release(), which
+    // must happen only once all the commands recorded into it have been executed.
+    Storage grow(size_t newSize) noexcept;
+
+    // frees a storage returned by grow()
+    static void release(Storage const& storage) noexcept;
+
 private:
-    void* alloc(size_t size) noexcept;
-    void dealloc() noexcept;
+    static Storage alloc(size_t size) noexcept;
+    static void dealloc(Storage const& storage) noexcept;
 
-    // pointer to the beginning of the circular buffer (constant)
+    // pointer to the beginning of the circular buffer (constant unless grow() is called)
     void* mData = nullptr;
     int mUsesAshmem = -1;
 
-    // size of the circular buffer (constant)
+    // size of the circular buffer (constant unless grow() is called)
     size_t mSize = 0;
 
     // pointer to the beginning of recorded data
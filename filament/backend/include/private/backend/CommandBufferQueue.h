@@ -38,7 +38,14 @@ class CommandBufferQueue {
         void* end;
     };
 
+    // a storage replaced by a larger one, kept alive until the commands it holds are executed
+    struct RetiredStorage {
+        CircularBuffer::Storage storage;
+        size_t pending;
+    };
+
     const size_t mRequiredSize;
+    const size_t mMaxBufferSize;
 
     CircularBuffer mCircularBuffer;
 
@@ -47,21 +54,53 @@ class CommandBufferQueue {
     mutable utils::Mutex mLock;
     mutable utils::Condition mCondition;
     mutable std::vector<Slice> mCommandBuffersToExecute;
+    std::vector<RetiredStorage> mRetiredStorages;
     size_t mFreeSpace = 0;
     size_t mHighWatermark = 0;
     uint32_t mExitRequested = 0;
 
+    // telemetry
+    size_t mCurrentFrameSize = 0;
+    size_t mLastFrameSize = 0;
+    size_t mMaxFrameSize = 0;
+    uint64_t mFlushWaitTime = 0;
+    mutable uint64_t mDriverWaitTime = 0;
+    uint32_t mFlushWaitCount = 0;
+    uint32_t mGrowCount = 0;
+
     static constexpr uint32_t EXIT_REQUESTED = 0x31415926;
 
 public:
+    struct Statistics {
+        size_t capacity;            // current size of the circular buffer in bytes
+        size_t highWatermark;       // maximum number of bytes in flight
+        size_t lastFrameSize;       // bytes of commands recorded during the last frame
+        size_t maxFrameSize;        // maximum bytes of commands recorded during a frame
+        uint64_t flushWaitTime;     // total time in ns flush() blocked waiting for space
+        uint64_t driverWaitTime;    // total time in ns waitForCommands() blocked waiting
+        uint32_t flushWaitCount;    // number of times flush() blocked
+        uint32_t growCount;         // number of times the circular buffer was grown
+    };
+
     // requiredSize: guaranteed available space after flush()
-    CommandBufferQueue(size_t requiredSize, size_t bufferSize);
+    // maxBufferSize: if larger than bufferSize, the circular buffer is grown up to this size
+    //                instead of blocking flush() when it runs out of space.
+    CommandBufferQueue(size_t requiredSize, size_t bufferSize, size_t maxBufferSize = 0);
     ~CommandBufferQueue();
 
     CircularBuffer& getCircularBuffer() { return mCircularBuffer; }
 
     size_t getHighWatermark() const noexcept { return mHighWatermark; }
 
+    Statistics getStatistics() const noexcept;
+
+    // number of storages replaced by a larger one that are still waiting for their commands to
+    // be executed
+    size_t getRetiredStorageCount() const noexcept;
+
+    // marks the end of a frame for statistics purposes, must be called after flush()
+    void endFrame() noexcept;
+
     // wait for commands to be available and returns an array containing these commands
     std::vector<Slice> waitForCommands() const;
 
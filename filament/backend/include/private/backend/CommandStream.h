@@ -48,6 +48,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 // Set to true to print every command out on log.d. This requires RTTI and DEBUG
 #define DEBUG_COMMAND_STREAM false
@@ -189,6 +190,46 @@ public:
 
 // ------------------------------------------------------------------------------------------------
 
+/*
+ * Compact encoding of Driver::draw()
+ *
+ * Most draw() calls use the same PipelineState as the previous one. PipelineDrawCommand records
+ * the PipelineState, which the driver thread keeps after decoding it, so that subsequent draw()
+ * calls with an identical PipelineState can be recorded as a CompactDrawCommand, which only holds
+ * the primitive and instance count (16 bytes instead of 64).
+ * This relies on commands being executed in the order they're recorded, and on a Driver being
+ * used by a single CommandStream.
+ */
+class PipelineDrawCommand : public CommandBase {
+public:
+    PipelineState state;
+    Handle<HwRenderPrimitive> rph;
+    uint32_t instanceCount;
+
+    inline PipelineDrawCommand(Execute execute, PipelineState const& state,
+            Handle<HwRenderPrimitive> rph, uint32_t instanceCount) noexcept
+            : CommandBase(execute), state(state), rph(rph), instanceCount(instanceCount) { }
+};
+
+class CompactDrawCommand : public CommandBase {
+public:
+    Handle<HwRenderPrimitive> rph;
+    uint32_t instanceCount;
+
+    inline CompactDrawCommand(Execute execute,
+            Handle<HwRenderPrimitive> rph, uint32_t instanceCount) noexcept
+            : CommandBase(execute), rph(rph), instanceCount(instanceCount) { }
+};
+
+static_assert(std::is_trivially_destructible_v<PipelineDrawCommand>);
+static_assert(std::is_trivially_destructible_v<CompactDrawCommand>);
+
+// PipelineState is compared bitwise, make sure it doesn't have padding
+static_assert(sizeof(PipelineState) == sizeof(Handle<HwProgram>) + sizeof(RasterState) +
+        sizeof(StencilState) + sizeof(PolygonOffset) + sizeof(Viewport));
+
+// ------------------------------------------------------------------------------------------------
+
 #if !defined(NDEBUG) || (FILAMENT_DEBUG_COMMANDS >= FILAMENT_DEBUG_COMMANDS_ENABLE)
     // For now, simply pass the method name down as a string and throw away the parameters.
     // This is good enough for certain debugging needs and we can improve this later.
@@ -218,8 +259,7 @@ public:
     inline void methodName(paramsDecl) {                                                        \
         DEBUG_COMMAND_BEGIN(methodName, false, params);                                         \
         using Cmd = COMMAND_TYPE(methodName);                                                   \
-        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
-        new(p) Cmd(mDispatcher.methodName##_, APPLY(std::move, params));                        \
+        encodeCommand<Cmd>(mDispatcher.methodName##_, APPLY(std::move, params));                \
         DEBUG_COMMAND_END(methodName, false);                                                   \
     }
 
@@ -284,6 +324,30 @@ private:
         return mCurrentBuffer.allocate(size);
     }
 
+    template<typename Cmd, typename... ARGS>
+    inline void encodeCommand(Dispatcher::Execute execute, ARGS&& ... args) {
+        if constexpr (std::is_same_v<Cmd, COMMAND_TYPE(draw)>) {
+            encodeDraw(std::forward<ARGS>(args)...);
+        } else {
+            void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));
+            new(p) Cmd(execute, std::forward<ARGS>(args)...);
+        }
+    }
+
+    inline void encodeDraw(PipelineState const& state,
+            Handle<HwRenderPrimitive> rph, uint32_t instanceCount) {
+        if (UTILS_LIKELY(mHasEncodedPipelineState &&
+                !memcmp(&mEncodedPipelineState, &state, sizeof(PipelineState)))) {
+            void* const p = allocateCommand(CommandBase::align(sizeof(CompactDrawCommand)));
+            new(p) CompactDrawCommand(mDispatcher.compactDraw_, rph, instanceCount);
+        } else {
+            void* const p = allocateCommand(CommandBase::align(sizeof(PipelineDrawCommand)));
+            new(p) PipelineDrawCommand(mDispatcher.pipelineDraw_, state, rph, instanceCount);
+            mEncodedPipelineState = state;
+            mHasEncodedPipelineState = true;
+        }
+    }
+
     // We use a copy of Dispatcher (instead of a pointer) because this removes one dereference
     // when executing driver commands.
     Driver& UTILS_RESTRICT mDriver;
@@ -295,6 +359,10 @@ private:
     std::thread::id mThreadId{};
 #endif
 
+    // PipelineState of the last recorded draw(), see PipelineDrawCommand
+    PipelineState mEncodedPipelineState;
+    bool mHasEncodedPipelineState = false;
+
     bool mUsePerformanceCounter = false;
 };
 
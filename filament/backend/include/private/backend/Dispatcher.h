@@ -43,6 +43,10 @@ public:
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     Execute methodName##_;
 
 #include "DriverAPI.inc"
+
+    // compact encodings of draw(), see PipelineDrawCommand
+    Execute pipelineDraw_;
+    Execute compactDraw_;
 };
 
 } // namespace filament::backend
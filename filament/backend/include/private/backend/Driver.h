@@ -21,6 +21,7 @@
 #include <backend/DriverApiForward.h>
 #include <backend/DriverEnums.h>
 #include <backend/Handle.h>
+#include <backend/HandleStatistics.h>
 #include <backend/PipelineState.h>
 #include <backend/TargetBufferInfo.h>
 
@@ -78,6 +79,10 @@ public:
     // the default implementation simply calls fn
     virtual void execute(std::function<void(void)> const& fn) noexcept;
 
+    // Returns the usage statistics of the driver's handle allocator, this can be called from
+    // any thread. The default implementation returns empty statistics.
+    virtual HandleStatistics getHandleStatistics() const noexcept;
+
     // This is called on debug build, or when enabled manually on the backend thread side.
     virtual void debugCommandBegin(CommandStream* cmds,
             bool synchronous, const char* methodName) noexcept = 0;
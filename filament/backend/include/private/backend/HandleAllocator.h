@@ -18,15 +18,19 @@
 #define TNT_FILAMENT_BACKEND_PRIVATE_HANDLEALLOCATOR_H
 
 #include <backend/Handle.h>
+#include <backend/HandleStatistics.h>
 
 #include <utils/Allocator.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/architecture.h>
 #include <utils/compiler.h>
 #include <utils/debug.h>
 #include <utils/ostream.h>
 
 #include <tsl/robin_map.h>
 
+#include <atomic>
 #include <exception>
 #include <type_traits>
 #include <unordered_map>
@@ -40,6 +44,13 @@
 #   define HANDLE_TYPE_SAFETY 0
 #endif
 
+// Per-type live counts, high-watermarks and allocation-site sampling (see HandleStatistics)
+#if defined(FILAMENT_ENABLE_HANDLE_STATISTICS)
+#   define HANDLE_STATISTICS 1
+#else
+#   define HANDLE_STATISTICS 0
+#endif
+
 #define HandleAllocatorGL  HandleAllocator<16, 64, 208>
 #define HandleAllocatorVK  HandleAllocator<16, 64, 880>
 #define HandleAllocatorMTL HandleAllocator<16, 64, 584>
@@ -78,6 +89,9 @@ public:
         Handle<D> h{ allocateHandle<sizeof(D)>() };
         D* addr = handle_cast<D*>(h);
         new(addr) D(std::forward<ARGS>(args)...);
+#if HANDLE_STATISTICS
+        trackAllocation<D>(h.getId());
+#endif
 #if HANDLE_TYPE_SAFETY
         mLock.lock();
         mHandleTypeId[addr] = typeid(D).name();
@@ -99,6 +113,9 @@ public:
     template<typename D>
     Handle<D> allocate() noexcept {
         Handle<D> h{ allocateHandle<sizeof(D)>() };
+#if HANDLE_STATISTICS
+        trackAllocation<D>(h.getId());
+#endif
 #if HANDLE_TYPE_SAFETY
         D* addr = handle_cast<D*>(h);
         mLock.lock();
@@ -179,6 +196,9 @@ public:
                        << ", but handle's actual type is " << typeId << utils::io::endl;
                 std::terminate();
             }
+#endif
+#if HANDLE_STATISTICS
+            trackDeallocation<D>(handle.getId());
 #endif
             p->~D();
             deallocateHandle<sizeof(D)>(handle.getId());
@@ -221,16 +241,29 @@ public:
         return handle_cast<Dp>(const_cast<Handle<B>&>(handle));
     }
 
+    /*
+     * Returns the current usage of the handle arena, per pool and per concrete type, as well
+     * as the allocation sites of a sample of the live handles.
+     * This is only populated when FILAMENT_ENABLE_HANDLE_STATISTICS is defined.
+     * This can be called from any thread.
+     */
+    HandleStatistics getStatistics() const noexcept;
 
 private:
 
     // template <int P0, int P1, int P2>
     class Allocator {
         friend class HandleAllocator;
-        utils::PoolAllocator<P0, 16>   mPool0;
-        utils::PoolAllocator<P1, 16>   mPool1;
-        utils::PoolAllocator<P2, 16>   mPool2;
+        // The pools use a lock-free free list, so that handles can be allocated and freed
+        // concurrently from any thread without taking a lock.
+        template<size_t SIZE>
+        using Pool = utils::PoolAllocator<SIZE, 16, 0, utils::AtomicFreeList>;
+        Pool<P0>   mPool0;
+        Pool<P1>   mPool1;
+        Pool<P2>   mPool2;
         UTILS_UNUSED_IN_RELEASE const utils::AreaPolicy::HeapArea& mArea;
+        static char* getPoolBoundary(const utils::AreaPolicy::HeapArea& area,
+                const PoolRatios& poolRatios, size_t pool) noexcept;
     public:
         static constexpr size_t MIN_ALIGNMENT_SHIFT = 4;
         Allocator(const utils::AreaPolicy::HeapArea& area, const PoolRatios& poolRatios);
@@ -253,16 +286,15 @@ private:
         }
     };
 
-// FIXME: We should be using a Spinlock here, at least on platforms where mutexes are not
-//        efficient (i.e. non-Linux). However, we've seen some hangs on that spinlock, which
-//        we don't understand well (b/308029108).
+    // The pools are lock-free, however the debug tracking policy isn't thread-safe, so we still
+    // need a lock on debug builds.
 #ifndef NDEBUG
     using HandleArena = utils::Arena<Allocator,
             utils::LockingPolicy::Mutex,
             utils::TrackingPolicy::DebugAndHighWatermark>;
 #else
     using HandleArena = utils::Arena<Allocator,
-            utils::LockingPolicy::Mutex>;
+            utils::LockingPolicy::NoLock>;
 #endif
 
     // allocateHandle()/deallocateHandle() selects the pool to use at compile-time based on the
@@ -289,7 +321,7 @@ private:
     }
 
     // allocateHandleInPool()/deallocateHandleFromPool() is NOT inlined, which will cause three
-    // versions to be generated, one for each pool. Because the arena is synchronized,
+    // versions to be generated, one for each pool. Because the free lists are atomic,
     // the code generated is not trivial (even if it's not insane either).
     template<size_t SIZE>
     UTILS_NOINLINE
@@ -347,11 +379,117 @@ private:
 
     HandleArena mHandleArena;
 
-    // Below is only used when running out of space in the HandleArena
-    mutable utils::Mutex mLock;
-    tsl::robin_map<HandleBase::HandleId, void*> mOverflowMap;
-    HandleBase::HandleId mId = 0;
+    // Below is only used when running out of space in the HandleArena.
+    // The overflow map is sharded by handle id to reduce contention between threads.
+    static constexpr size_t OVERFLOW_SHARD_COUNT = 8;
+    static_assert(!(OVERFLOW_SHARD_COUNT & (OVERFLOW_SHARD_COUNT - 1)),
+            "OVERFLOW_SHARD_COUNT must be a power of two");
+
+    struct alignas(utils::CACHELINE_SIZE) OverflowShard {
+        mutable utils::Mutex lock;
+        tsl::robin_map<HandleBase::HandleId, void*> map;
+    };
+
+    OverflowShard& getOverflowShard(HandleBase::HandleId id) noexcept {
+        return mOverflowShards[id & (OVERFLOW_SHARD_COUNT - 1)];
+    }
+
+    OverflowShard const& getOverflowShard(HandleBase::HandleId id) const noexcept {
+        return mOverflowShards[id & (OVERFLOW_SHARD_COUNT - 1)];
+    }
+
+    OverflowShard mOverflowShards[OVERFLOW_SHARD_COUNT];
+    std::atomic<HandleBase::HandleId> mId = 0;
+
+#if HANDLE_STATISTICS
+    // Maximum number of concrete handle types tracked, types beyond this are ignored.
+    static constexpr size_t MAX_TRACKED_TYPE_COUNT = 64;
+    // One allocation out of SAMPLING_INTERVAL records its call stack.
+    static constexpr uint32_t SAMPLING_INTERVAL = 64;
+    // Maximum number of live sampled allocations.
+    static constexpr size_t MAX_SAMPLE_COUNT = 4096;
+
+    // Allocations and deallocations can happen on different threads, so counters are atomic.
+    struct Counter {
+        std::atomic<uint32_t> live = 0;
+        std::atomic<uint32_t> highWatermark = 0;
+        void increment() noexcept {
+            uint32_t const count = live.fetch_add(1, std::memory_order_relaxed) + 1;
+            uint32_t hw = highWatermark.load(std::memory_order_relaxed);
+            while (count > hw && !highWatermark.compare_exchange_weak(hw, count,
+                    std::memory_order_relaxed)) {
+            }
+        }
+        void decrement() noexcept {
+            live.fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    struct Sample {
+        size_t typeIndex;
+        utils::CallStack callstack;
+    };
+
+    // Returns a unique index for the concrete type D, shared by all HandleAllocators.
+    template<typename D>
+    static size_t getTypeIndex() noexcept {
+        static const size_t index = registerType(__PRETTY_FUNCTION__);
+        return index;
+    }
+
+    template<size_t SIZE>
+    static constexpr size_t getPoolIndex() noexcept {
+        return SIZE <= P0 ? 0 : (SIZE <= P1 ? 1 : 2);
+    }
+
+    template<typename D>
+    void trackAllocation(HandleBase::HandleId id) noexcept {
+        size_t const typeIndex = getTypeIndex<D>();
+        if (UTILS_LIKELY(typeIndex < MAX_TRACKED_TYPE_COUNT)) {
+            mTypeCounters[typeIndex].increment();
+        }
+        if (UTILS_LIKELY(isPoolHandle(id))) {
+            mPoolCounters[getPoolIndex<sizeof(D)>()].increment();
+        } else {
+            mHeapCounter.increment();
+        }
+        if (UTILS_UNLIKELY(
+                mAllocationCount.fetch_add(1, std::memory_order_relaxed) % SAMPLING_INTERVAL == 0)) {
+            recordSample(id, typeIndex);
+        }
+    }
+
+    template<typename D>
+    void trackDeallocation(HandleBase::HandleId id) noexcept {
+        size_t const typeIndex = getTypeIndex<D>();
+        if (UTILS_LIKELY(typeIndex < MAX_TRACKED_TYPE_COUNT)) {
+            mTypeCounters[typeIndex].decrement();
+        }
+        if (UTILS_LIKELY(isPoolHandle(id))) {
+            mPoolCounters[getPoolIndex<sizeof(D)>()].decrement();
+        } else {
+            mHeapCounter.decrement();
+        }
+        if (mSampleCount.load(std::memory_order_relaxed)) {
+            eraseSample(id);
+        }
+    }
+
+    static size_t registerType(const char* prettyFunction) noexcept;
+    void recordSample(HandleBase::HandleId id, size_t typeIndex) noexcept;
+    void eraseSample(HandleBase::HandleId id) noexcept;
+
+    Counter mTypeCounters[MAX_TRACKED_TYPE_COUNT];
+    Counter mPoolCounters[3];
+    Counter mHeapCounter;
+    uint32_t mPoolCapacity[3] = {};
+    std::atomic<uint32_t> mAllocationCount = 0;
+    std::atomic<uint32_t> mSampleCount = 0;
+    mutable utils::Mutex mSampleLock;
+    tsl::robin_map<HandleBase::HandleId, Sample> mSamples;
+#endif
 #if HANDLE_TYPE_SAFETY
+    mutable utils::Mutex mLock;
     mutable std::unordered_map<const void*, const char*> mHandleTypeId;
 #endif
 };
@@ -40,14 +40,34 @@ namespace filament::backend {
 size_t CircularBuffer::sPageSize = arch::getPageSize();
 
 CircularBuffer::CircularBuffer(size_t size) {
-    mData = alloc(size);
+    Storage const storage = alloc(size);
+    mData = storage.data;
+    mUsesAshmem = storage.ashmem;
     mSize = size;
     mTail = mData;
     mHead = mData;
 }
 
 CircularBuffer::~CircularBuffer() noexcept {
-    dealloc();
+    dealloc({ mData, mSize, mUsesAshmem });
+    mData = nullptr;
+    mUsesAshmem = -1;
+}
+
+CircularBuffer::Storage CircularBuffer::grow(size_t newSize) noexcept {
+    assert_invariant(empty());
+    Storage const previous{ mData, mSize, mUsesAshmem };
+    Storage const storage = alloc(newSize);
+    mData = storage.data;
+    mUsesAshmem = storage.ashmem;
+    mSize = newSize;
+    mTail = mData;
+    mHead = mData;
+    return previous;
+}
+
+void CircularBuffer::release(Storage const& storage) noexcept {
+    dealloc(storage);
 }
 
 // If the system support mmap(), use it for creating a "hard circular buffer" where two virtual
@@ -60,9 +80,10 @@ CircularBuffer::~CircularBuffer() noexcept {
 // to each others and a special case in circularize()
 
 UTILS_NOINLINE
-void* CircularBuffer::alloc(size_t size) noexcept {
+CircularBuffer::Storage CircularBuffer::alloc(size_t size) noexcept {
 #if HAS_MMAP
     void* data = nullptr;
+    int usesAshmem = -1;
     void* vaddr = MAP_FAILED;
     void* vaddr_shadow = MAP_FAILED;
     void* vaddr_guard = MAP_FAILED;
@@ -86,7 +107,7 @@ void* CircularBuffer::alloc(size_t size) noexcept {
                             MAP_PRIVATE, fd, (off_t)size);
                     if (vaddr_guard != MAP_FAILED && (vaddr_guard == (char*)vaddr_shadow + size)) {
                         // woo-hoo success!
-                        mUsesAshmem = fd;
+                        usesAshmem = fd;
                         data = vaddr;
                     }
                 }
@@ -94,7 +115,7 @@ void* CircularBuffer::alloc(size_t size) noexcept {
         }
     }
 
-    if (UTILS_UNLIKELY(mUsesAshmem < 0)) {
+    if (UTILS_UNLIKELY(usesAshmem < 0)) {
         // ashmem failed
         if (vaddr_guard != MAP_FAILED) {
             munmap(vaddr_guard, size);
@@ -126,28 +147,26 @@ void* CircularBuffer::alloc(size_t size) noexcept {
         void* guard = (void*)(uintptr_t(data) + size * 2);
         mprotect(guard, BLOCK_SIZE, PROT_NONE);
     }
-    return data;
+    return { data, size, usesAshmem };
 #else
     // Use 20% or 3 MiB overflow guard, whichever is bigger
-    return ::malloc(std::max(6 * size / 5, size + 3 * 1024 * 1024));
+    return { ::malloc(std::max(6 * size / 5, size + 3 * 1024 * 1024)), size, -1 };
 #endif
 }
 
 UTILS_NOINLINE
-void CircularBuffer::dealloc() noexcept {
+void CircularBuffer::dealloc(Storage const& storage) noexcept {
 #if HAS_MMAP
-    if (mData) {
+    if (storage.data) {
         size_t const BLOCK_SIZE = getBlockSize();
-        munmap(mData, mSize * 2 + BLOCK_SIZE);
-        if (mUsesAshmem >= 0) {
-            close(mUsesAshmem);
-            mUsesAshmem = -1;
+        munmap(storage.data, storage.size * 2 + BLOCK_SIZE);
+        if (storage.ashmem >= 0) {
+            close(storage.ashmem);
         }
     }
 #else
-    ::free(mData);
+    ::free(storage.data);
 #endif
-    mData = nullptr;
 }
 
 
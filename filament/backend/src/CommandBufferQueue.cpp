@@ -24,12 +24,22 @@
 #include "private/backend/BackendUtils.h"
 #include "private/backend/CommandStream.h"
 
+#include <algorithm>
+#include <chrono>
+
 using namespace utils;
 
 namespace filament::backend {
 
-CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize)
+static inline uint64_t elapsedSince(std::chrono::steady_clock::time_point start) noexcept {
+    using namespace std::chrono;
+    return uint64_t(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+}
+
+CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize,
+        size_t maxBufferSize)
         : mRequiredSize((requiredSize + (CircularBuffer::getBlockSize() - 1u)) & ~(CircularBuffer::getBlockSize() -1u)),
+          mMaxBufferSize((maxBufferSize + (CircularBuffer::getBlockSize() - 1u)) & ~(CircularBuffer::getBlockSize() -1u)),
           mCircularBuffer(bufferSize),
           mFreeSpace(mCircularBuffer.size()) {
     assert_invariant(mCircularBuffer.size() > requiredSize);
@@ -37,6 +47,35 @@ CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize)
 
 CommandBufferQueue::~CommandBufferQueue() {
     assert_invariant(mCommandBuffersToExecute.empty());
+    for (auto const& retired : mRetiredStorages) {
+        CircularBuffer::release(retired.storage);
+    }
+}
+
+CommandBufferQueue::Statistics CommandBufferQueue::getStatistics() const noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    return {
+            .capacity = mCircularBuffer.size(),
+            .highWatermark = mHighWatermark,
+            .lastFrameSize = mLastFrameSize,
+            .maxFrameSize = mMaxFrameSize,
+            .flushWaitTime = mFlushWaitTime,
+            .driverWaitTime = mDriverWaitTime,
+            .flushWaitCount = mFlushWaitCount,
+            .growCount = mGrowCount,
+    };
+}
+
+size_t CommandBufferQueue::getRetiredStorageCount() const noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    return mRetiredStorages.size();
+}
+
+void CommandBufferQueue::endFrame() noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    mLastFrameSize = mCurrentFrameSize;
+    mMaxFrameSize = std::max(mMaxFrameSize, mCurrentFrameSize);
+    mCurrentFrameSize = 0;
 }
 
 void CommandBufferQueue::requestExit() {
@@ -88,23 +127,56 @@ void CommandBufferQueue::flush() noexcept {
 
     // wait until there is enough space in the buffer
     mFreeSpace -= used;
+    mCurrentFrameSize += used;
     const size_t requiredSize = mRequiredSize;
 
-#ifndef NDEBUG
-    size_t totalUsed = circularBuffer.size() - mFreeSpace;
+    size_t const totalUsed = circularBuffer.size() - mFreeSpace;
     mHighWatermark = std::max(mHighWatermark, totalUsed);
+
+#ifndef NDEBUG
     if (UTILS_UNLIKELY(totalUsed > requiredSize)) {
         slog.d << "CommandStream used too much space: " << totalUsed
             << ", out of " << requiredSize << " (will block)" << io::endl;
     }
 #endif
 
+    // free the storages whose commands have all been executed
+    auto const retired = std::remove_if(mRetiredStorages.begin(), mRetiredStorages.end(),
+            [](RetiredStorage const& r) { return r.pending == 0; });
+    std::for_each(retired, mRetiredStorages.end(),
+            [](RetiredStorage const& r) { CircularBuffer::release(r.storage); });
+    mRetiredStorages.erase(retired, mRetiredStorages.end());
+
     mCondition.notify_one();
+
+    if (UTILS_UNLIKELY(mFreeSpace < requiredSize && circularBuffer.size() < mMaxBufferSize)) {
+        // Rather than blocking, switch to a larger storage. The current storage is kept alive
+        // until all the commands it holds are executed; they're still accounted for in
+        // mFreeSpace, so the invariant (free space == size - bytes in flight) is preserved.
+        SYSTRACE_NAME("CircularBuffer::grow()");
+        size_t const currentSize = circularBuffer.size();
+        size_t const newSize = std::min(mMaxBufferSize, currentSize * 2);
+        // only the bytes in flight that aren't in previously retired storages are in this one
+        size_t pending = totalUsed;
+        for (RetiredStorage const& retired : mRetiredStorages) {
+            assert_invariant(pending >= retired.pending);
+            pending -= retired.pending;
+        }
+        mRetiredStorages.push_back({ circularBuffer.grow(newSize), pending });
+        mFreeSpace += newSize - currentSize;
+        mGrowCount++;
+        slog.w << "CommandStream grown from " << currentSize / 1024 << " KiB to "
+               << newSize / 1024 << " KiB" << io::endl;
+    }
+
     if (UTILS_LIKELY(mFreeSpace < requiredSize)) {
         SYSTRACE_NAME("waiting: CircularBuffer::flush()");
+        auto const start = std::chrono::steady_clock::now();
         mCondition.wait(lock, [this, requiredSize]() -> bool {
             return mFreeSpace >= requiredSize;
         });
+        mFlushWaitTime += elapsedSince(start);
+        mFlushWaitCount++;
     }
 }
 
@@ -117,8 +189,12 @@ std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() con
         // The circular buffer should only be written and read from the driver thread, but just to be sure we lock the mutex here
         return std::move(mCommandBuffersToExecute);
     }
-    while (mCommandBuffersToExecute.empty() && !mExitRequested) {
-        mCondition.wait(lock);
+    if (mCommandBuffersToExecute.empty() && !mExitRequested) {
+        auto const start = std::chrono::steady_clock::now();
+        while (mCommandBuffersToExecute.empty() && !mExitRequested) {
+            mCondition.wait(lock);
+        }
+        mDriverWaitTime += elapsedSince(start);
     }
 
     ASSERT_PRECONDITION( mExitRequested == 0 || mExitRequested == EXIT_REQUESTED,
@@ -129,7 +205,19 @@ std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() con
 
 void CommandBufferQueue::releaseBuffer(CommandBufferQueue::Slice const& buffer) {
     std::lock_guard<utils::Mutex> const lock(mLock);
-    mFreeSpace += uintptr_t(buffer.end) - uintptr_t(buffer.begin);
+    size_t const size = uintptr_t(buffer.end) - uintptr_t(buffer.begin);
+    mFreeSpace += size;
+    // slices are released in order, so only the oldest retired storage that still has
+    // pending commands can hold this one
+    for (RetiredStorage& retired : mRetiredStorages) {
+        if (retired.pending) {
+            if (retired.storage.contains(buffer.begin)) {
+                assert_invariant(retired.pending >= size);
+                retired.pending -= size;
+            }
+            break;
+        }
+    }
     mCondition.notify_one();
 }
 
@@ -68,6 +68,23 @@ private:
         Cmd::execute(&ConcreteDriver::methodName##R, concreteDriver, base, next);               \
      }
 #include "private/backend/DriverAPI.inc"
+
+    static void pipelineDraw(Driver& driver, CommandBase* base, intptr_t* next) {
+        SYSTRACE()
+        ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);
+        PipelineDrawCommand const* const self = static_cast<PipelineDrawCommand const*>(base);
+        *next = CommandBase::align(sizeof(PipelineDrawCommand));
+        concreteDriver.mDecodedPipelineState = self->state;
+        concreteDriver.draw(self->state, self->rph, self->instanceCount);
+    }
+
+    static void compactDraw(Driver& driver, CommandBase* base, intptr_t* next) {
+        SYSTRACE()
+        ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);
+        CompactDrawCommand const* const self = static_cast<CompactDrawCommand const*>(base);
+        *next = CommandBase::align(sizeof(CompactDrawCommand));
+        concreteDriver.draw(concreteDriver.mDecodedPipelineState, self->rph, self->instanceCount);
+    }
 };
 
 template<typename ConcreteDriver>
@@ -83,6 +100,9 @@ Dispatcher ConcreteDispatcher<ConcreteDriver>::make() noexcept {
 
 #include "private/backend/DriverAPI.inc"
 
+    dispatcher.pipelineDraw_ = &ConcreteDispatcher::pipelineDraw;
+    dispatcher.compactDraw_ = &ConcreteDispatcher::compactDraw;
+
     return dispatcher;
 }
 
@@ -218,4 +218,8 @@ void Driver::execute(std::function<void(void)> const& fn) noexcept {
     fn();
 }
 
+HandleStatistics Driver::getHandleStatistics() const noexcept {
+    return {};
+}
+
 } // namespace filament::backend
@@ -25,6 +25,7 @@
 #include <backend/BufferDescriptor.h>
 #include <backend/DriverEnums.h>
 #include <backend/CallbackHandler.h>
+#include <backend/PipelineState.h>
 
 #include "private/backend/Dispatcher.h"
 #include "private/backend/Driver.h"
@@ -216,6 +217,9 @@ protected:
     void debugCommandBegin(CommandStream* cmds, bool synchronous, const char* methodName) noexcept override;
     void debugCommandEnd(CommandStream* cmds, bool synchronous, const char* methodName) noexcept override;
 
+    // PipelineState of the last PipelineDrawCommand, used to decode CompactDrawCommand
+    PipelineState mDecodedPipelineState;
+
 private:
     std::mutex mPurgeLock;
     std::vector<std::pair<void*, CallbackHandler::Callback>> mCallbacks;
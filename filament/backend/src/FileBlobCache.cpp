@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <backend/FileBlobCache.h>
+
+#include <backend/Platform.h>
+
+#include <utils/debug.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace filament::backend {
+
+namespace {
+
+// The cache file starts with a FileHeader, followed by the records. Each record is a
+// RecordHeader followed by the key and the value. Later records replace earlier ones with the
+// same key.
+
+constexpr char FILE_MAGIC[8] = { 'F', 'B', 'L', 'O', 'B', '0', '0', '1' };
+constexpr uint32_t RECORD_MAGIC = 0xB10BCAC4u;
+
+// keys are small (see BlobCacheKey), this only protects us from reading a garbage size
+constexpr uint32_t MAX_KEY_SIZE = 64 * 1024;
+
+struct FileHeader {
+    char magic[8];
+    uint64_t compatibilityId;
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t keySize;
+    uint64_t valueSize;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 16);
+static_assert(sizeof(RecordHeader) == 24);
+
+bool seek(FILE* file, uint64_t offset) noexcept {
+#if defined(WIN32)
+    return _fseeki64(file, int64_t(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+}
+
+uint64_t getSize(FILE* file) noexcept {
+#if defined(WIN32)
+    return _fseeki64(file, 0, SEEK_END) == 0 ? uint64_t(_ftelli64(file)) : 0;
+#else
+    return fseeko(file, 0, SEEK_END) == 0 ? uint64_t(ftello(file)) : 0;
+#endif
+}
+
+uint32_t computeChecksum(void const* data, size_t size) noexcept {
+    assert_invariant(size);
+    return hash::murmurSlow(static_cast<uint8_t const*>(data), size, 0);
+}
+
+} // anonymous namespace
+
+FileBlobCache::FileBlobCache(const char* path, size_t maxSize, uint64_t compatibilityId) noexcept
+        : mPath(path), mMaxSize(maxSize), mCompatibilityId(compatibilityId) {
+    std::lock_guard<Mutex> const lock(mLock);
+    open();
+}
+
+FileBlobCache::~FileBlobCache() noexcept {
+    std::lock_guard<Mutex> const lock(mLock);
+    close();
+}
+
+bool FileBlobCache::isValid() const noexcept {
+    std::lock_guard<Mutex> const lock(mLock);
+    return mFile != nullptr;
+}
+
+size_t FileBlobCache::getBlobCount() const noexcept {
+    std::lock_guard<Mutex> const lock(mLock);
+    return mEntries.size();
+}
+
+size_t FileBlobCache::getFileSize() const noexcept {
+    std::lock_guard<Mutex> const lock(mLock);
+    return size_t(mFileSize);
+}
+
+void FileBlobCache::attach(Platform& platform) noexcept {
+    platform.setBlobFunc(
+            [this](void const* key, size_t keySize, void const* value, size_t valueSize) {
+                insert(key, keySize, value, valueSize);
+            },
+            [this](void const* key, size_t keySize, void* value, size_t valueSize) {
+                return retrieve(key, keySize, value, valueSize);
+            });
+}
+
+void FileBlobCache::open() noexcept {
+    SYSTRACE_CALL();
+
+    mEntries.clear();
+    mFileSize = 0;
+
+    FileHeader header{};
+    mFile = fopen(mPath.c_str(), "r+b");
+    if (mFile) {
+        bool const compatible = fread(&header, sizeof(header), 1, mFile) == 1 &&
+                !memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) &&
+                header.compatibilityId == mCompatibilityId;
+        if (!compatible) {
+            fclose(mFile);
+            mFile = nullptr;
+        }
+    }
+
+    if (!mFile) {
+        // the file doesn't exist or its content can't be used, start with an empty cache
+        mFile = fopen(mPath.c_str(), "w+b");
+        if (!mFile) {
+            slog.w << "FileBlobCache: can't create " << mPath.c_str() << io::endl;
+            return;
+        }
+        memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.compatibilityId = mCompatibilityId;
+        if (fwrite(&header, sizeof(header), 1, mFile) != 1 || fflush(mFile) != 0) {
+            slog.w << "FileBlobCache: can't write " << mPath.c_str() << io::endl;
+            close();
+            return;
+        }
+        mFileSize = sizeof(header);
+        return;
+    }
+
+    // Build the index from the records' headers. The first record that isn't valid, typically
+    // one that was being written when the application was killed, ends the file.
+    uint64_t const fileSize = getSize(mFile);
+    uint64_t offset = sizeof(FileHeader);
+    std::string key;
+    while (offset < fileSize) {
+        RecordHeader record{};
+        if (!seek(mFile, offset) || fread(&record, sizeof(record), 1, mFile) != 1) {
+            break;
+        }
+        uint64_t const end = offset + sizeof(record) + record.keySize + record.valueSize;
+        if (record.magic != RECORD_MAGIC ||
+                !record.keySize || record.keySize > MAX_KEY_SIZE || !record.valueSize ||
+                record.valueSize > mMaxSize || end > fileSize) {
+            break;
+        }
+        key.resize(record.keySize);
+        if (fread(key.data(), record.keySize, 1, mFile) != 1) {
+            break;
+        }
+        mEntries[key] = { offset, record.valueSize, ++mUseCount, record.checksum };
+        offset = end;
+    }
+    mFileSize = offset;
+
+    if (offset != fileSize || mFileSize > mMaxSize) {
+        // drop the damaged tail of the file or the blobs that don't fit anymore
+        compact(offset != fileSize ? mMaxSize : mMaxSize / 2);
+    }
+}
+
+void FileBlobCache::close() noexcept {
+    if (mFile) {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+    mEntries.clear();
+    mFileSize = 0;
+}
+
+size_t FileBlobCache::getRecordSize(std::string const& key, Entry const& entry) const noexcept {
+    return sizeof(RecordHeader) + key.size() + size_t(entry.valueSize);
+}
+
+bool FileBlobCache::compact(size_t targetSize) noexcept {
+    SYSTRACE_CALL();
+    assert_invariant(mFile);
+
+    // the most recently used blobs are kept first
+    std::vector<std::pair<std::string const*, Entry const*>> entries;
+    entries.reserve(mEntries.size());
+    for (auto const& [key, entry] : mEntries) {
+        entries.emplace_back(&key, &entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.second->lastUse > rhs.second->lastUse;
+    });
+    size_t keptCount = 0;
+    uint64_t keptSize = sizeof(FileHeader);
+    for (auto const& entry : entries) {
+        size_t const recordSize = getRecordSize(*entry.first, *entry.second);
+        if (keptSize + recordSize <= targetSize) {
+            // otherwise this blob is evicted, but smaller ones might still fit
+            entries[keptCount++] = entry;
+            keptSize += recordSize;
+        }
+    }
+    entries.resize(keptCount);
+
+    // open() orders the blobs by their position in the file, so the least recently used blobs
+    // are written first.
+    std::reverse(entries.begin(), entries.end());
+
+    // The compacted cache is written to a temporary file, which then replaces the cache file,
+    // so that the cache file is valid at all times.
+    std::string const path = mPath + ".tmp";
+    FILE* const out = fopen(path.c_str(), "wb");
+    if (!out) {
+        slog.w << "FileBlobCache: can't create " << path.c_str() << io::endl;
+        return false;
+    }
+
+    FileHeader header{};
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.compatibilityId = mCompatibilityId;
+    bool success = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    std::unordered_map<std::string, Entry> compacted;
+    uint64_t size = sizeof(header);
+    std::vector<char> buffer(65536);
+    for (auto const& [key, entry] : entries) {
+        if (!success) {
+            break;
+        }
+        RecordHeader const record{ RECORD_MAGIC, uint32_t(key->size()), entry->valueSize,
+                entry->checksum, 0 };
+        success = fwrite(&record, sizeof(record), 1, out) == 1 &&
+                fwrite(key->data(), key->size(), 1, out) == 1 &&
+                seek(mFile, entry->offset + sizeof(RecordHeader) + key->size());
+        for (uint64_t remaining = entry->valueSize; success && remaining;) {
+            size_t const count = size_t(std::min(remaining, uint64_t(buffer.size())));
+            success = fread(buffer.data(), count, 1, mFile) == 1 &&
+                    fwrite(buffer.data(), count, 1, out) == 1;
+            remaining -= count;
+        }
+        compacted[*key] = { size, entry->valueSize, entry->lastUse, entry->checksum };
+        size += getRecordSize(*key, *entry);
+    }
+    success = fflush(out) == 0 && success;
+    fclose(out);
+
+    if (!success) {
+        remove(path.c_str());
+        slog.w << "FileBlobCache: can't write " << path.c_str() << io::endl;
+        return false;
+    }
+
+    fclose(mFile);
+    mFile = nullptr;
+    // rename() doesn't replace an existing file on all platforms
+    if (rename(path.c_str(), mPath.c_str()) != 0) {
+        remove(mPath.c_str());
+        rename(path.c_str(), mPath.c_str());
+    }
+
+    mFile = fopen(mPath.c_str(), "r+b");
+    if (!mFile) {
+        slog.w << "FileBlobCache: can't open " << mPath.c_str() << io::endl;
+        close();
+        return false;
+    }
+    mEntries = std::move(compacted);
+    mFileSize = size;
+    return true;
+}
+
+void FileBlobCache::insert(const void* key, size_t keySize,
+        const void* value, size_t valueSize) noexcept {
+    SYSTRACE_CALL();
+    std::lock_guard<Mutex> const lock(mLock);
+
+    size_t const recordSize = sizeof(RecordHeader) + keySize + valueSize;
+    if (!mFile || !keySize || keySize > MAX_KEY_SIZE || !valueSize ||
+            recordSize > mMaxSize / 2) {
+        return;
+    }
+
+    if (mFileSize + recordSize > mMaxSize) {
+        // evict the least recently used blobs, and leave some room so that we don't compact the
+        // file again on the next insertion.
+        if (!compact(mMaxSize / 2)) {
+            return;
+        }
+    }
+
+    std::string const k(static_cast<char const*>(key), keySize);
+    RecordHeader const record{ RECORD_MAGIC, uint32_t(keySize), valueSize,
+            computeChecksum(value, valueSize), 0 };
+
+    // The record is written past the end of the valid records. If this fails, the file is
+    // left as it was, as far as the index is concerned.
+    bool const success = seek(mFile, mFileSize) &&
+            fwrite(&record, sizeof(record), 1, mFile) == 1 &&
+            fwrite(key, keySize, 1, mFile) == 1 &&
+            fwrite(value, valueSize, 1, mFile) == 1 &&
+            fflush(mFile) == 0;
+    if (!success) {
+        slog.w << "FileBlobCache: can't write " << mPath.c_str() << io::endl;
+        return;
+    }
+
+    mEntries[k] = { mFileSize, valueSize, ++mUseCount, record.checksum };
+    mFileSize += recordSize;
+}
+
+size_t FileBlobCache::retrieve(const void* key, size_t keySize,
+        void* value, size_t valueSize) noexcept {
+    SYSTRACE_CALL();
+    std::lock_guard<Mutex> const lock(mLock);
+
+    if (!mFile) {
+        return 0;
+    }
+
+    auto const pos = mEntries.find(std::string(static_cast<char const*>(key), keySize));
+    if (pos == mEntries.end()) {
+        return 0;
+    }
+
+    Entry& entry = pos->second;
+    entry.lastUse = ++mUseCount;
+    if (entry.valueSize > valueSize) {
+        // the caller's buffer is too small, it will call us again with a large enough one
+        return size_t(entry.valueSize);
+    }
+
+    bool const success = seek(mFile, entry.offset + sizeof(RecordHeader) + keySize) &&
+            fread(value, size_t(entry.valueSize), 1, mFile) == 1 &&
+            computeChecksum(value, size_t(entry.valueSize)) == entry.checksum;
+    if (!success) {
+        // the file is damaged, forget about this blob
+        mEntries.erase(pos);
+        return 0;
+    }
+    return size_t(entry.valueSize);
+}
+
+} // namespace filament::backend
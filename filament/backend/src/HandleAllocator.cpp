@@ -18,23 +18,33 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string_view>
+
 #include <stdlib.h>
 
 namespace filament::backend {
 
 using namespace utils;
 
+template <size_t P0, size_t P1, size_t P2>
+char* HandleAllocator<P0, P1, P2>::Allocator::getPoolBoundary(AreaPolicy::HeapArea const& area,
+        const PoolRatios& poolRatios, size_t pool) noexcept {
+    const size_t unit = area.size() / (poolRatios.pool0 + poolRatios.pool1 + poolRatios.pool2);
+    const size_t offset = (pool == 1) ? poolRatios.pool0 * unit :
+            (poolRatios.pool0 + poolRatios.pool1) * unit;
+    return (char*)area.begin() + offset;
+}
+
 template <size_t P0, size_t P1, size_t P2>
 UTILS_NOINLINE
 HandleAllocator<P0, P1, P2>::Allocator::Allocator(AreaPolicy::HeapArea const& area, const PoolRatios& poolRatios)
-        : mArea(area) {
-    const size_t unit = area.size() / (poolRatios.pool0 + poolRatios.pool1 + poolRatios.pool2);
-    const size_t offsetPool1 = poolRatios.pool0 * unit;
-    const size_t offsetPool2 = (poolRatios.pool0 + poolRatios.pool1) * unit;
-    char* const p = (char*)area.begin();
-    mPool0 = PoolAllocator< P0, 16>(p, p + offsetPool1);
-    mPool1 = PoolAllocator< P1, 16>(p + offsetPool1, p + offsetPool2);
-    mPool2 = PoolAllocator< P2, 16>(p + offsetPool2, area.end());
+        : mPool0(area.begin(), getPoolBoundary(area, poolRatios, 1)),
+          mPool1(getPoolBoundary(area, poolRatios, 1), getPoolBoundary(area, poolRatios, 2)),
+          mPool2(getPoolBoundary(area, poolRatios, 2), area.end()),
+          mArea(area) {
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -42,27 +52,41 @@ HandleAllocator<P0, P1, P2>::Allocator::Allocator(AreaPolicy::HeapArea const& ar
 template <size_t P0, size_t P1, size_t P2>
 HandleAllocator<P0, P1, P2>::HandleAllocator(const char* name, size_t size, const PoolRatios& poolRatios) noexcept
     : mHandleArena(name, size, poolRatios) {
+#if HANDLE_STATISTICS
+    auto const& area = mHandleArena.getArea();
+    char* const boundaries[4] = {
+            (char*)area.begin(),
+            Allocator::getPoolBoundary(area, poolRatios, 1),
+            Allocator::getPoolBoundary(area, poolRatios, 2),
+            (char*)area.end() };
+    mPoolCapacity[0] = uint32_t((boundaries[1] - boundaries[0]) / P0);
+    mPoolCapacity[1] = uint32_t((boundaries[2] - boundaries[1]) / P1);
+    mPoolCapacity[2] = uint32_t((boundaries[3] - boundaries[2]) / P2);
+#endif
 }
 
 template <size_t P0, size_t P1, size_t P2>
 HandleAllocator<P0, P1, P2>::~HandleAllocator() {
-    auto& overflowMap = mOverflowMap;
-    if (!overflowMap.empty()) {
-        PANIC_LOG("Not all handles have been freed. Probably leaking memory.");
+    bool leaking = false;
+    for (auto& shard : mOverflowShards) {
         // Free remaining handle memory
-        for (auto& entry : overflowMap) {
+        for (auto& entry : shard.map) {
             ::free(entry.second);
+            leaking = true;
         }
     }
+    if (leaking) {
+        PANIC_LOG("Not all handles have been freed. Probably leaking memory.");
+    }
 }
 
 template <size_t P0, size_t P1, size_t P2>
 UTILS_NOINLINE
 void* HandleAllocator<P0, P1, P2>::handleToPointerSlow(HandleBase::HandleId id) const noexcept {
-    auto& overflowMap = mOverflowMap;
-    std::lock_guard lock(mLock);
-    auto pos = overflowMap.find(id);
-    if (pos != overflowMap.end()) {
+    auto const& shard = getOverflowShard(id);
+    std::lock_guard lock(shard.lock);
+    auto pos = shard.map.find(id);
+    if (pos != shard.map.end()) {
         return pos.value();
     }
     return nullptr;
@@ -71,9 +95,11 @@ void* HandleAllocator<P0, P1, P2>::handleToPointerSlow(HandleBase::HandleId id)
 template <size_t P0, size_t P1, size_t P2>
 HandleBase::HandleId HandleAllocator<P0, P1, P2>::allocateHandleSlow(size_t size) noexcept {
     void* p = ::malloc(size);
-    std::unique_lock lock(mLock);
-    HandleBase::HandleId id = (++mId) | HEAP_HANDLE_FLAG;
-    mOverflowMap.emplace(id, p);
+    HandleBase::HandleId const id =
+            (mId.fetch_add(1, std::memory_order_relaxed) + 1) | HEAP_HANDLE_FLAG;
+    auto& shard = getOverflowShard(id);
+    std::unique_lock lock(shard.lock);
+    shard.map.emplace(id, p);
     lock.unlock();
 
     if (UTILS_UNLIKELY(id == (HEAP_HANDLE_FLAG|1u))) { // meaning id was zero
@@ -87,19 +113,169 @@ template <size_t P0, size_t P1, size_t P2>
 void HandleAllocator<P0, P1, P2>::deallocateHandleSlow(HandleBase::HandleId id, size_t) noexcept {
     assert_invariant(id & HEAP_HANDLE_FLAG);
     void* p = nullptr;
-    auto& overflowMap = mOverflowMap;
+    auto& shard = getOverflowShard(id);
 
-    std::unique_lock lock(mLock);
-    auto pos = overflowMap.find(id);
-    if (pos != overflowMap.end()) {
+    std::unique_lock lock(shard.lock);
+    auto pos = shard.map.find(id);
+    if (pos != shard.map.end()) {
         p = pos.value();
-        overflowMap.erase(pos);
+        shard.map.erase(pos);
     }
     lock.unlock();
 
     ::free(p);
 }
 
+// ------------------------------------------------------------------------------------------------
+
+#if HANDLE_STATISTICS
+
+namespace {
+
+// Registry of the concrete handle types, shared by all HandleAllocators. The names are never
+// freed so that they can be safely returned in HandleStatistics.
+struct HandleTypeRegistry {
+    static constexpr size_t CAPACITY = 64;
+    Mutex lock;
+    CString names[CAPACITY];
+    size_t count = 0;
+};
+
+HandleTypeRegistry& getHandleTypeRegistry() noexcept {
+    static HandleTypeRegistry registry;
+    return registry;
+}
+
+// Extracts "T" from the __PRETTY_FUNCTION__ (or __FUNCSIG__) of getTypeIndex<T>()
+std::string_view extractTypeName(std::string_view const prettyFunction) noexcept {
+    // gcc: "... getTypeIndex() [with D = T; ...]", clang: "... getTypeIndex() [..., D = T]"
+    size_t begin = prettyFunction.find("D = ");
+    if (begin != std::string_view::npos) {
+        begin += 4;
+        size_t const end = prettyFunction.find_first_of(";]", begin);
+        return prettyFunction.substr(begin, end - begin);
+    }
+    // msvc: "... getTypeIndex<struct T>(void) noexcept"
+    begin = prettyFunction.find("getTypeIndex<");
+    if (begin != std::string_view::npos) {
+        begin += 13;
+        size_t const end = prettyFunction.rfind(">(");
+        return prettyFunction.substr(begin, end - begin);
+    }
+    return prettyFunction;
+}
+
+} // anonymous namespace
+
+template <size_t P0, size_t P1, size_t P2>
+size_t HandleAllocator<P0, P1, P2>::registerType(const char* prettyFunction) noexcept {
+    std::string_view const name = extractTypeName(prettyFunction);
+    HandleTypeRegistry& registry = getHandleTypeRegistry();
+    std::lock_guard lock(registry.lock);
+    // the same type can be registered by different HandleAllocator instantiations
+    for (size_t i = 0; i < registry.count; i++) {
+        if (std::string_view{ registry.names[i].c_str(), registry.names[i].size() } == name) {
+            return i;
+        }
+    }
+    if (UTILS_UNLIKELY(registry.count == HandleTypeRegistry::CAPACITY)) {
+        return MAX_TRACKED_TYPE_COUNT;
+    }
+    registry.names[registry.count] = CString{ name.data(), name.size() };
+    return registry.count++;
+}
+
+template <size_t P0, size_t P1, size_t P2>
+UTILS_NOINLINE
+void HandleAllocator<P0, P1, P2>::recordSample(HandleBase::HandleId id, size_t typeIndex) noexcept {
+    // skip this function and trackAllocation()
+    CallStack const callstack = CallStack::unwind(2);
+    std::lock_guard lock(mSampleLock);
+    if (mSamples.size() < MAX_SAMPLE_COUNT) {
+        mSamples[id] = { typeIndex, callstack };
+        mSampleCount.store(uint32_t(mSamples.size()), std::memory_order_relaxed);
+    }
+}
+
+template <size_t P0, size_t P1, size_t P2>
+UTILS_NOINLINE
+void HandleAllocator<P0, P1, P2>::eraseSample(HandleBase::HandleId id) noexcept {
+    std::lock_guard lock(mSampleLock);
+    if (mSamples.erase(id)) {
+        mSampleCount.store(uint32_t(mSamples.size()), std::memory_order_relaxed);
+    }
+}
+
+template <size_t P0, size_t P1, size_t P2>
+HandleStatistics HandleAllocator<P0, P1, P2>::getStatistics() const noexcept {
+    HandleStatistics stats;
+    stats.enabled = true;
+    stats.arenaSize = mHandleArena.getArea().size();
+    stats.samplingInterval = SAMPLING_INTERVAL;
+
+    constexpr size_t const elementSizes[3] = { P0, P1, P2 };
+    for (size_t i = 0; i < 3; i++) {
+        stats.pools[i] = {
+                .elementSize = uint32_t(elementSizes[i]),
+                .capacity = mPoolCapacity[i],
+                .liveCount = mPoolCounters[i].live.load(std::memory_order_relaxed),
+                .highWatermark = mPoolCounters[i].highWatermark.load(std::memory_order_relaxed) };
+    }
+    stats.heapLiveCount = mHeapCounter.live.load(std::memory_order_relaxed);
+    stats.heapHighWatermark = mHeapCounter.highWatermark.load(std::memory_order_relaxed);
+
+    HandleTypeRegistry& registry = getHandleTypeRegistry();
+    std::unique_lock registryLock(registry.lock);
+    size_t const typeCount = std::min(registry.count, MAX_TRACKED_TYPE_COUNT);
+    registryLock.unlock();
+
+    auto getTypeName = [&registry, typeCount](size_t index) -> const char* {
+        return index < typeCount ? registry.names[index].c_str() : "<untracked>";
+    };
+
+    stats.types.reserve(typeCount);
+    for (size_t i = 0; i < typeCount; i++) {
+        uint32_t const highWatermark = mTypeCounters[i].highWatermark.load(std::memory_order_relaxed);
+        if (highWatermark) {
+            // skip types that were never allocated by this HandleAllocator
+            stats.types.push_back({
+                    .name = getTypeName(i),
+                    .liveCount = mTypeCounters[i].live.load(std::memory_order_relaxed),
+                    .highWatermark = highWatermark });
+        }
+    }
+
+    // aggregate the live samples by allocation site
+    std::map<std::pair<CallStack, size_t>, uint32_t> sites;
+    std::unique_lock sampleLock(mSampleLock);
+    for (auto const& [id, sample] : mSamples) {
+        sites[{ sample.callstack, sample.typeIndex }]++;
+    }
+    sampleLock.unlock();
+
+    stats.allocationSites.reserve(sites.size());
+    for (auto const& [site, count] : sites) {
+        stats.allocationSites.push_back({
+                .typeName = getTypeName(site.second),
+                .liveSampleCount = count,
+                .callstack = site.first });
+    }
+    std::sort(stats.allocationSites.begin(), stats.allocationSites.end(),
+            [](auto const& lhs, auto const& rhs) {
+                return lhs.liveSampleCount > rhs.liveSampleCount;
+            });
+    return stats;
+}
+
+#else
+
+template <size_t P0, size_t P1, size_t P2>
+HandleStatistics HandleAllocator<P0, P1, P2>::getStatistics() const noexcept {
+    return {};
+}
+
+#endif
+
 // Explicit template instantiations.
 #if defined (FILAMENT_SUPPORTS_OPENGL)
 template class HandleAllocatorGL;
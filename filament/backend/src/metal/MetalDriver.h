@@ -67,6 +67,8 @@ private:
 
     ShaderModel getShaderModel() const noexcept final;
 
+    HandleStatistics getHandleStatistics() const noexcept final;
+
     // Overrides the default implementation by wrapping the call to fn in an @autoreleasepool block.
     void execute(std::function<void(void)> const& fn) noexcept final;
 
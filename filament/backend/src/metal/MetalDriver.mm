@@ -620,6 +620,10 @@ ShaderModel MetalDriver::getShaderModel() const noexcept {
 #endif
 }
 
+HandleStatistics MetalDriver::getHandleStatistics() const noexcept {
+    return mHandleAllocator.getStatistics();
+}
+
 Handle<HwStream> MetalDriver::createStreamNative(void* stream) {
     return {};
 }
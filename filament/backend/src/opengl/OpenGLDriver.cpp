@@ -247,6 +247,10 @@ ShaderModel OpenGLDriver::getShaderModel() const noexcept {
     return mContext.getShaderModel();
 }
 
+HandleStatistics OpenGLDriver::getHandleStatistics() const noexcept {
+    return mHandleAllocator.getStatistics();
+}
+
 // ------------------------------------------------------------------------------------------------
 // Change and track GL state
 // ------------------------------------------------------------------------------------------------
@@ -218,6 +218,8 @@ private:
 
     ShaderModel getShaderModel() const noexcept final;
 
+    HandleStatistics getHandleStatistics() const noexcept final;
+
     /*
      * Driver interface
      */
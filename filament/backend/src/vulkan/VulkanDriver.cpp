@@ -228,6 +228,10 @@ ShaderModel VulkanDriver::getShaderModel() const noexcept {
 #endif
 }
 
+HandleStatistics VulkanDriver::getHandleStatistics() const noexcept {
+    return mResourceAllocator.getStatistics();
+}
+
 void VulkanDriver::terminate() {
     // Command buffers should come first since it might have commands depending on resources that
     // are about to be destroyed.
@@ -58,6 +58,8 @@ private:
 
     ShaderModel getShaderModel() const noexcept final;
 
+    HandleStatistics getHandleStatistics() const noexcept final;
+
     template<typename T>
     friend class ConcreteDispatcher;
 
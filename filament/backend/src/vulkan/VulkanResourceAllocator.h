@@ -105,6 +105,10 @@ public:
         mHandleAllocatorImpl.deallocate(handle, obj);
     }
 
+    HandleStatistics getStatistics() const noexcept {
+        return mHandleAllocatorImpl.getStatistics();
+    }
+
 private:
     HandleAllocatorVK mHandleAllocatorImpl;
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandBufferQueue.h"
+
+#include <stddef.h>
+
+using namespace filament::backend;
+
+TEST(CommandBufferQueue, RetiredStoragesAreReleased) {
+    size_t const page = CircularBuffer::getBlockSize();
+    CommandBufferQueue queue(page, 4 * page, 64 * page);
+    CircularBuffer& circularBuffer = queue.getCircularBuffer();
+
+    // fill 3/4 of the buffer, which leaves less than requiredSize and grows it
+    circularBuffer.allocate(3 * page);
+    queue.flush();
+    EXPECT_EQ(circularBuffer.size(), 8 * page);
+    EXPECT_EQ(queue.getRetiredStorageCount(), 1u);
+
+    // grow a second time, while the commands of the first storage are still in flight
+    circularBuffer.allocate(4 * page + page / 2);
+    queue.flush();
+    EXPECT_EQ(circularBuffer.size(), 16 * page);
+    EXPECT_EQ(queue.getRetiredStorageCount(), 2u);
+
+    // execute all the commands
+    for (auto const& slice : queue.waitForCommands()) {
+        queue.releaseBuffer(slice);
+    }
+
+    // the retired storages are freed by the next flush
+    circularBuffer.allocate(page / 2);
+    queue.flush();
+    EXPECT_EQ(queue.getRetiredStorageCount(), 0u);
+
+    for (auto const& slice : queue.waitForCommands()) {
+        queue.releaseBuffer(slice);
+    }
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <backend/FileBlobCache.h>
+
+#include <utils/Path.h>
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+using namespace filament::backend;
+
+namespace {
+
+std::string getCachePath() {
+    return utils::Path::concat(utils::Path::getTemporaryDirectory(),
+            "filament_test_blob_cache.bin").getPath();
+}
+
+std::vector<uint8_t> makeBlob(size_t size, uint8_t seed) {
+    std::vector<uint8_t> blob(size);
+    for (size_t i = 0; i < size; i++) {
+        blob[i] = uint8_t(seed + i * 7);
+    }
+    return blob;
+}
+
+std::vector<uint8_t> retrieve(FileBlobCache& cache, uint64_t key) {
+    std::vector<uint8_t> blob(16);
+    size_t size = cache.retrieve(&key, sizeof(key), blob.data(), blob.size());
+    if (size > blob.size()) {
+        blob.resize(size);
+        size = cache.retrieve(&key, sizeof(key), blob.data(), blob.size());
+    }
+    blob.resize(size);
+    return blob;
+}
+
+} // anonymous namespace
+
+TEST(FileBlobCache, InsertRetrieve) {
+    std::string const path = getCachePath();
+    remove(path.c_str());
+
+    auto const a = makeBlob(10, 1);
+    auto const b = makeBlob(1000, 2);
+    {
+        FileBlobCache cache(path.c_str(), 64 * 1024);
+        ASSERT_TRUE(cache.isValid());
+        uint64_t const keyA = 1, keyB = 2, keyC = 3;
+        cache.insert(&keyA, sizeof(keyA), a.data(), a.size());
+        cache.insert(&keyB, sizeof(keyB), b.data(), b.size());
+        EXPECT_EQ(cache.getBlobCount(), 2u);
+        EXPECT_EQ(retrieve(cache, keyA), a);
+        EXPECT_EQ(retrieve(cache, keyB), b);
+        EXPECT_TRUE(retrieve(cache, keyC).empty());
+    }
+
+    // the blobs persist
+    {
+        FileBlobCache cache(path.c_str(), 64 * 1024);
+        EXPECT_EQ(cache.getBlobCount(), 2u);
+        EXPECT_EQ(retrieve(cache, 1), a);
+        EXPECT_EQ(retrieve(cache, 2), b);
+    }
+
+    // unless the cache was created with a different compatibility id
+    {
+        FileBlobCache cache(path.c_str(), 64 * 1024, 42);
+        EXPECT_EQ(cache.getBlobCount(), 0u);
+    }
+
+    remove(path.c_str());
+}
+
+TEST(FileBlobCache, Replace) {
+    std::string const path = getCachePath();
+    remove(path.c_str());
+
+    FileBlobCache cache(path.c_str(), 64 * 1024);
+    uint64_t const key = 1;
+    auto const a = makeBlob(100, 1);
+    auto const b = makeBlob(200, 2);
+    cache.insert(&key, sizeof(key), a.data(), a.size());
+    cache.insert(&key, sizeof(key), b.data(), b.size());
+    EXPECT_EQ(cache.getBlobCount(), 1u);
+    EXPECT_EQ(retrieve(cache, key), b);
+
+    remove(path.c_str());
+}
+
+TEST(FileBlobCache, Eviction) {
+    std::string const path = getCachePath();
+    remove(path.c_str());
+
+    constexpr size_t MAX_SIZE = 16 * 1024;
+    FileBlobCache cache(path.c_str(), MAX_SIZE);
+    auto const blob = makeBlob(1000, 3);
+    for (uint64_t key = 0; key < 64; key++) {
+        cache.insert(&key, sizeof(key), blob.data(), blob.size());
+        // keep the first blob in use, so it's never evicted
+        EXPECT_EQ(retrieve(cache, 0), blob);
+        EXPECT_LE(cache.getFileSize(), MAX_SIZE);
+    }
+    EXPECT_LT(cache.getBlobCount(), 16u);
+    EXPECT_EQ(retrieve(cache, 63), blob);
+
+    // blobs too large for the cache are ignored
+    auto const large = makeBlob(MAX_SIZE, 4);
+    uint64_t const key = 100;
+    cache.insert(&key, sizeof(key), large.data(), large.size());
+    EXPECT_TRUE(retrieve(cache, key).empty());
+
+    remove(path.c_str());
+}
+
+TEST(FileBlobCache, EvictionAfterReopen) {
+    std::string const path = getCachePath();
+    remove(path.c_str());
+
+    constexpr size_t MAX_SIZE = 16 * 1024;
+    auto const blob = makeBlob(1000, 3);
+    {
+        FileBlobCache cache(path.c_str(), MAX_SIZE);
+        for (uint64_t key = 0; key < 16; key++) {
+            cache.insert(&key, sizeof(key), blob.data(), blob.size());
+            if (key < 15) {
+                // keep the first blob in use, so it's the most recently used when the last
+                // insertion compacts the file
+                EXPECT_EQ(retrieve(cache, 0), blob);
+            }
+        }
+        EXPECT_LT(cache.getBlobCount(), 16u);
+    }
+
+    // the cache is compacted to half its size when it's opened with a smaller maximum size,
+    // which only keeps the three most recently used blobs
+    {
+        FileBlobCache cache(path.c_str(), MAX_SIZE / 2);
+        EXPECT_EQ(cache.getBlobCount(), 3u);
+        EXPECT_EQ(retrieve(cache, 0), blob);
+        EXPECT_EQ(retrieve(cache, 14), blob);
+        EXPECT_EQ(retrieve(cache, 15), blob);
+    }
+
+    remove(path.c_str());
+}
+
+TEST(FileBlobCache, DamagedFile) {
+    std::string const path = getCachePath();
+    remove(path.c_str());
+
+    auto const a = makeBlob(100, 1);
+    auto const b = makeBlob(100, 2);
+    {
+        FileBlobCache cache(path.c_str(), 64 * 1024);
+        uint64_t const keyA = 1, keyB = 2;
+        cache.insert(&keyA, sizeof(keyA), a.data(), a.size());
+        cache.insert(&keyB, sizeof(keyB), b.data(), b.size());
+    }
+
+    // simulate a crash in the middle of writing the last record
+    {
+        FILE* file = fopen(path.c_str(), "ab");
+        ASSERT_NE(file, nullptr);
+        uint32_t const garbage[] = { 0xB10BCAC4u, 8, 1000, 0 };
+        fwrite(garbage, sizeof(garbage), 1, file);
+        fclose(file);
+    }
+
+    {
+        FileBlobCache cache(path.c_str(), 64 * 1024);
+        EXPECT_EQ(cache.getBlobCount(), 2u);
+        EXPECT_EQ(retrieve(cache, 1), a);
+        EXPECT_EQ(retrieve(cache, 2), b);
+    }
+
+    remove(path.c_str());
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "private/backend/HandleAllocator.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace filament::backend;
+
+// HandleAllocatorGL is always instantiated in HandleAllocator.cpp when OpenGL is supported,
+// the other allocators depend on the backends being compiled in.
+#if defined(FILAMENT_SUPPORTS_OPENGL)
+
+namespace {
+
+using TestHandleAllocator = HandleAllocatorGL;
+
+template<size_t SIZE>
+struct TestObject {
+    TestObject(uint32_t thread, uint32_t index) noexcept : thread(thread), index(index) {}
+    uint32_t thread;
+    uint32_t index;
+    uint8_t padding[SIZE - 2 * sizeof(uint32_t)];
+};
+
+using SmallObject = TestObject<16>;
+using MediumObject = TestObject<64>;
+using LargeObject = TestObject<208>;
+
+constexpr size_t THREAD_COUNT = 8;
+constexpr size_t HANDLE_COUNT_PER_THREAD = 1024;
+constexpr size_t ITERATION_COUNT = 64;
+
+// Each thread allocates, validates and frees handles of all three size classes, concurrently
+// with the other threads.
+void runContention(TestHandleAllocator& allocator) {
+    std::atomic_bool start = false;
+    std::atomic_uint32_t failures = 0;
+
+    auto work = [&](uint32_t thread) {
+        std::vector<Handle<SmallObject>> small(HANDLE_COUNT_PER_THREAD);
+        std::vector<Handle<MediumObject>> medium(HANDLE_COUNT_PER_THREAD);
+        std::vector<Handle<LargeObject>> large(HANDLE_COUNT_PER_THREAD);
+
+        while (!start.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (size_t iteration = 0; iteration < ITERATION_COUNT; iteration++) {
+            for (uint32_t i = 0; i < HANDLE_COUNT_PER_THREAD; i++) {
+                small[i] = allocator.allocateAndConstruct<SmallObject>(thread, i);
+                medium[i] = allocator.allocateAndConstruct<MediumObject>(thread, i);
+                large[i] = allocator.allocateAndConstruct<LargeObject>(thread, i);
+            }
+            for (uint32_t i = 0; i < HANDLE_COUNT_PER_THREAD; i++) {
+                auto const* s = allocator.handle_cast<SmallObject*>(small[i]);
+                auto const* m = allocator.handle_cast<MediumObject*>(medium[i]);
+                auto const* l = allocator.handle_cast<LargeObject*>(large[i]);
+                if (s->thread != thread || s->index != i ||
+                    m->thread != thread || m->index != i ||
+                    l->thread != thread || l->index != i) {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                }
+                allocator.deallocate(small[i], s);
+                allocator.deallocate(medium[i], m);
+                allocator.deallocate(large[i], l);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(work, i);
+    }
+
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0u);
+}
+
+} // anonymous namespace
+
+TEST(HandleAllocator, Contention) {
+    // The arena is large enough to never overflow, so this only exercises the lock-free pools.
+    TestHandleAllocator allocator("Handles", 8u * 1024u * 1024u, { 32, 96, 136 });
+    runContention(allocator);
+}
+
+TEST(HandleAllocator, OverflowContention) {
+    // The arena is much too small, so most allocations go through the sharded heap path.
+    TestHandleAllocator allocator("Handles", 64u * 1024u, { 32, 96, 136 });
+    runContention(allocator);
+}
+
+#if defined(FILAMENT_ENABLE_HANDLE_STATISTICS)
+
+namespace {
+
+HandleStatistics::Type const* findType(HandleStatistics const& stats, const char* name) {
+    for (auto const& type : stats.types) {
+        if (strstr(type.name, name)) {
+            return &type;
+        }
+    }
+    return nullptr;
+}
+
+} // anonymous namespace
+
+TEST(HandleAllocator, Statistics) {
+    // The arena is small, so that the smallest pool can be filled and overflow to the heap.
+    TestHandleAllocator allocator("Handles", 64u * 1024u, { 32, 96, 136 });
+
+    HandleStatistics stats = allocator.getStatistics();
+    ASSERT_TRUE(stats.enabled);
+    uint32_t const capacity = stats.pools[0].capacity;
+    ASSERT_GT(capacity, 0u);
+    EXPECT_EQ(stats.pools[0].liveCount, 0u);
+    EXPECT_EQ(stats.heapLiveCount, 0u);
+
+    constexpr uint32_t HEAP_COUNT = 16;
+    std::vector<Handle<SmallObject>> handles(capacity + HEAP_COUNT);
+    for (uint32_t i = 0; i < handles.size(); i++) {
+        handles[i] = allocator.allocateAndConstruct<SmallObject>(0, i);
+    }
+
+    stats = allocator.getStatistics();
+    EXPECT_EQ(stats.pools[0].liveCount, capacity);
+    EXPECT_EQ(stats.pools[0].highWatermark, capacity);
+    EXPECT_EQ(stats.pools[1].liveCount, 0u);
+    EXPECT_EQ(stats.pools[2].liveCount, 0u);
+    EXPECT_EQ(stats.heapLiveCount, HEAP_COUNT);
+    EXPECT_EQ(stats.heapHighWatermark, HEAP_COUNT);
+    HandleStatistics::Type const* type = findType(stats, "TestObject<16");
+    ASSERT_NE(type, nullptr);
+    EXPECT_EQ(type->liveCount, capacity + HEAP_COUNT);
+    EXPECT_EQ(type->highWatermark, capacity + HEAP_COUNT);
+    EXPECT_EQ(findType(stats, "TestObject<64"), nullptr);
+    EXPECT_FALSE(stats.allocationSites.empty());
+
+    for (auto& handle : handles) {
+        allocator.deallocate(handle);
+    }
+
+    // the live counts go back to zero, the high-watermarks are kept
+    stats = allocator.getStatistics();
+    EXPECT_EQ(stats.pools[0].liveCount, 0u);
+    EXPECT_EQ(stats.pools[0].highWatermark, capacity);
+    EXPECT_EQ(stats.heapLiveCount, 0u);
+    EXPECT_EQ(stats.heapHighWatermark, HEAP_COUNT);
+    type = findType(stats, "TestObject<16");
+    ASSERT_NE(type, nullptr);
+    EXPECT_EQ(type->liveCount, 0u);
+    EXPECT_EQ(type->highWatermark, capacity + HEAP_COUNT);
+    EXPECT_TRUE(stats.allocationSites.empty());
+}
+
+#endif // FILAMENT_ENABLE_HANDLE_STATISTICS
+
+#endif // FILAMENT_SUPPORTS_OPENGL
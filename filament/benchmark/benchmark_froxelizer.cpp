@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Engine.h>
+#include <filament/LightManager.h>
+#include <filament/Viewport.h>
+
+#include "Froxelizer.h"
+
+#include "details/Engine.h"
+#include "details/Scene.h"
+
+#include <utils/EntityManager.h>
+
+#include <math/mat4.h>
+
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+class FilamentFroxelizerFixture : public benchmark::Fixture {
+protected:
+    FEngine* engine = nullptr;
+    Froxelizer* froxelizer = nullptr;
+    LinearAllocatorArena arena{ "froxelizer benchmark", 3 * 1024 * 1024 };
+    std::optional<filament::ArenaScope> scope;
+    std::vector<Entity> entities;
+    FScene::LightSoa lights;
+    Viewport viewport;
+
+    static mat4f getProjection(double fov) noexcept {
+        return mat4f::perspective(fov, 16.0 / 9.0, 0.1, 100);
+    }
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        engine = downcast(Engine::create(Engine::Backend::NOOP));
+        froxelizer = new Froxelizer(*engine);
+
+        // the viewport height selects the froxel grid size
+        uint32_t const height = uint32_t(state.range(1));
+        viewport = { 0, 0, height * 16 / 9, height };
+        scope.emplace(arena);
+        froxelizer->setOptions(5, 100);
+        froxelizer->prepare(engine->getDriverApi(), engine->getJobSystem(), *scope,
+                viewport, getProjection(60), 0.1, 100);
+
+        std::default_random_engine gen; // NOLINT
+        std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> randDistance(1.0f, 100.0f);
+        std::uniform_real_distribution<float> randRadius(0.5f, 10.0f);
+
+        // first light is always the directional light
+        lights.push_back({}, {}, {}, {}, {}, {}, {}, {}, {}, {});
+
+        // lights are distributed in the view frustum, half of them are spotlights
+        size_t const count = size_t(state.range(0));
+        for (size_t i = 0; i < count; i++) {
+            Entity const e = EntityManager::get().create();
+            bool const spot = i & 1;
+            LightManager::Builder(spot ? LightManager::Type::SPOT : LightManager::Type::POINT)
+                    .spotLightCone(0.2f, 0.6f)
+                    .direction(normalize(float3{ rand(gen), rand(gen), -1.0f }))
+                    .build(*engine, e);
+            auto const instance = engine->getLightManager().getInstance(e);
+            float const z = -randDistance(gen);
+            float3 const position{ rand(gen) * z, rand(gen) * z * 0.5f, z };
+            lights.push_back(float4{ position, randRadius(gen) },
+                    engine->getLightManager().getDirection(instance), {}, {},
+                    instance, 1, {}, {}, {}, {});
+            entities.push_back(e);
+        }
+        Froxelizer::computeLightBounds(engine->getLightManager(), mat4f{}, getProjection(60),
+                0.1f, lights);
+    }
+
+    void TearDown(const benchmark::State&) override {
+        lights.clear();
+        for (Entity const e : entities) {
+            engine->getLightManager().destroy(e);
+            EntityManager::get().destroy(e);
+        }
+        entities.clear();
+        froxelizer->terminate(engine->getDriverApi());
+        delete froxelizer;
+        scope.reset();
+        Engine::destroy((Engine**)&engine);
+    }
+};
+
+// light count x viewport height (i.e. froxel grid size)
+static void froxelizerArguments(benchmark::internal::Benchmark* b) {
+    for (int const lightCount : { 16, 64, 256, 1024, 4096, int(CONFIG_MAX_LIGHT_COUNT) }) {
+        for (int const height : { 720, 1080, 2160 }) {
+            b->Args({ lightCount, height });
+        }
+    }
+}
+
+BENCHMARK_DEFINE_F(FilamentFroxelizerFixture, froxelizeLights)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            froxelizer->froxelizeLights(*engine, mat4f{}, lights);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        state.counters["froxels"] = double(froxelizer->getFroxelCount());
+    }
+}
+
+BENCHMARK_DEFINE_F(FilamentFroxelizerFixture, updateBoundingSpheres)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        JobSystem& js = engine->getJobSystem();
+        size_t i = 0;
+        for (auto _ : state) {
+            // changing the projection recomputes the froxels planes and bounding spheres
+            filament::ArenaScope frame(arena);
+            froxelizer->prepare(engine->getDriverApi(), js, frame,
+                    viewport, getProjection((i++ & 1) ? 60 : 61), 0.1, 100);
+            state.PauseTiming();
+            engine->flushAndWait();
+            state.ResumeTiming();
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * froxelizer->getFroxelCount());
+    }
+}
+
+BENCHMARK_REGISTER_F(FilamentFroxelizerFixture, froxelizeLights)
+        ->Apply(froxelizerArguments);
+
+BENCHMARK_REGISTER_F(FilamentFroxelizerFixture, updateBoundingSpheres)
+        ->Args({ 0, 720 })->Args({ 0, 1080 })->Args({ 0, 2160 });
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "private/backend/HandleAllocator.h"
+
+#include <array>
+#include <memory>
+
+#include <stdint.h>
+
+using namespace filament::backend;
+
+// HandleAllocatorGL is only instantiated when the OpenGL backend is compiled in
+#if defined(FILAMENT_SUPPORTS_OPENGL)
+
+namespace {
+
+constexpr size_t BATCH_SIZE = 256;
+
+struct SmallObject {
+    uint32_t data[4];
+};
+
+// shared by all the threads of a benchmark, created and destroyed by the first thread
+std::unique_ptr<HandleAllocatorGL> gAllocator;
+
+} // anonymous namespace
+
+// Each thread allocates and frees batches of handles from the same allocator. The first argument
+// is the arena size in KiB: a large arena only uses the lock-free pools, a small one makes most
+// allocations overflow to the sharded heap.
+static void handleAllocatorContention(benchmark::State& state) {
+    if (state.thread_index == 0) {
+        gAllocator = std::make_unique<HandleAllocatorGL>("Handles",
+                size_t(state.range(0)) * 1024u, HandleAllocatorGL::PoolRatios{ 32, 96, 136 });
+    }
+
+    std::array<Handle<SmallObject>, BATCH_SIZE> handles;
+    for (auto _ : state) {
+        for (auto& handle : handles) {
+            handle = gAllocator->allocateAndConstruct<SmallObject>();
+        }
+        for (auto& handle : handles) {
+            gAllocator->deallocate(handle);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * BATCH_SIZE));
+
+    if (state.thread_index == 0) {
+        gAllocator.reset();
+    }
+}
+
+BENCHMARK(handleAllocatorContention)
+        ->Arg(8 * 1024)->Arg(16)
+        ->ThreadRange(1, 8)->UseRealTime();
+
+#endif // FILAMENT_SUPPORTS_OPENGL
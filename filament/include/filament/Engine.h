@@ -19,7 +19,9 @@
 
 #include <filament/FilamentAPI.h>
 
+#include <backend/CallbackHandler.h>
 #include <backend/DriverEnums.h>
+#include <backend/HandleStatistics.h>
 #include <backend/Platform.h>
 
 #include <utils/compiler.h>
@@ -261,6 +263,21 @@ public:
         uint32_t minCommandBufferSizeMB = FILAMENT_MIN_COMMAND_BUFFERS_SIZE_IN_MB;
 
 
+        /**
+         * Maximum size in MiB the low-level command buffer arena is allowed to grow to.
+         *
+         * When this is larger than commandBufferSizeMB, the engine allocates a larger command
+         * buffer arena (doubling its size, up to this value) instead of stalling when running
+         * out of space. The previous arena is freed once all the commands it holds have
+         * been executed. Growth events are logged and reported by getCommandBufferStatistics().
+         *
+         * The default value of 0 disables growing the command buffer arena.
+         *
+         * This value affects the application's memory usage.
+         */
+        uint32_t maxCommandBufferSizeMB = 0;
+
+
         /**
          * Size in MiB of the per-frame high level command buffer.
          *
@@ -317,6 +334,26 @@ public:
          * The default value of 30 corresponds to about half a second at 60 fps.
          */
         uint32_t resourceAllocatorCacheMaxAge = 30;
+
+        /*
+         * Size in KiB of the uniform buffers shared by the material instances that have few
+         * parameters (up to 1 KiB). Sharing these buffers reduces the number of buffer objects,
+         * and the parameters modified between frames are uploaded with a single update per
+         * shared buffer.
+         *
+         * The default value of 0 gives each material instance its own uniform buffer. The buffers
+         * are never shared at feature level 0.
+         */
+        uint32_t materialUniformBufferPoolSizeKB = 0;
+
+        /*
+         * Maximum number of destroyed instances kept per material, along with their GPU
+         * resources, to be reused by the next instances of the same material. The recycled
+         * instances are freed when their material is destroyed.
+         *
+         * The default value of 0 frees the material instances when they are destroyed.
+         */
+        uint32_t materialInstanceRecycleCount = 0;
     };
 
 
@@ -518,6 +555,45 @@ public:
      */
     static void destroy(Engine* UTILS_NULLABLE engine);
 
+    /**
+     * Runtime statistics of the low-level command buffer, which can be used to size
+     * Config::commandBufferSizeMB and Config::minCommandBufferSizeMB for a given application.
+     */
+    struct CommandBufferStatistics {
+        size_t capacity;            //!< current size of the command buffer arena in bytes
+        size_t highWatermark;       //!< maximum number of bytes in flight in the arena
+        size_t lastFrameSize;       //!< size in bytes of the commands issued during last frame
+        size_t maxFrameSize;        //!< maximum size in bytes of the commands issued in a frame
+        uint64_t flushWaitTime;     //!< total time in ns the main thread waited for space
+        uint64_t driverWaitTime;    //!< total time in ns the driver thread waited for commands
+        uint32_t flushWaitCount;    //!< number of times the main thread waited for space
+        uint32_t growCount;         //!< number of times the arena was grown
+    };
+
+    /**
+     * Returns the statistics of the low-level command buffer since this Engine was created.
+     *
+     * @return a CommandBufferStatistics structure
+     * @see Config::maxCommandBufferSizeMB
+     */
+    CommandBufferStatistics getCommandBufferStatistics() const noexcept;
+
+    using HandleStatistics = backend::HandleStatistics;
+
+    /**
+     * Returns the usage statistics of the backend's handle arena: the live count and
+     * high-watermark of each pool and of each handle type, and the call stacks of a sample
+     * of the live handles. This can be used to track handle leaks in long-running processes
+     * and to size Config::driverHandleArenaSizeMB.
+     *
+     * Statistics are only collected when filament is built with
+     * FILAMENT_ENABLE_HANDLE_STATISTICS, otherwise HandleStatistics::enabled is false.
+     *
+     * @return a HandleStatistics structure
+     * @see Config::driverHandleArenaSizeMB
+     */
+    HandleStatistics getHandleStatistics() const noexcept;
+
     /**
      * Query the feature level supported by the selected backend.
      *
@@ -886,6 +962,45 @@ public:
       */
     utils::JobSystem& getJobSystem() noexcept;
 
+    /**
+     * Retrieves the list of the material variants that were used for rendering since the Engine
+     * was created, including the ones of materials that were destroyed since.
+     *
+     * The list can be saved by the application, typically at the end of a session, and passed
+     * to warmUpVariants() in the next session, so that these variants are compiled in the
+     * background before they're needed. The list is only valid for the same version of Filament.
+     *
+     * @param data  Where to write the list, or nullptr to query its size.
+     * @param size  Size of the data buffer in bytes.
+     * @return      The size of the list in bytes. Nothing is written if size is too small.
+     */
+    size_t getVariantUsage(void* UTILS_NULLABLE data, size_t size) const noexcept;
+
+    /**
+     * Compiles the material variants of a list retrieved with getVariantUsage(), on the low
+     * priority compiler queue. This is only effective on backends that support parallel shader
+     * compilation (see Material::compile()).
+     *
+     * The variants of the materials that are alive are scheduled immediately, the ones of the
+     * other materials are scheduled as these materials get created. Materials are identified by
+     * their name and the content of their package.
+     *
+     * Calling warmUpVariants() again replaces the list of the materials not created yet.
+     *
+     * @param data      The list of variants, it can be freed after this call.
+     * @param size      Size of the list in bytes.
+     * @param handler   Handler to dispatch the progress callback or nullptr for the default
+     *                  handler.
+     * @param progress  Callback called on the main thread each time the variants of a material
+     *                  of the list are compiled, with the number of materials compiled so far and
+     *                  the number of materials in the list.
+     * @return          false if the list is invalid or was produced by a different version of
+     *                  Filament, in which case it is ignored.
+     */
+    bool warmUpVariants(const void* UTILS_NONNULL data, size_t size,
+            backend::CallbackHandler* UTILS_NULLABLE handler = nullptr,
+            utils::Invocable<void(size_t compiled, size_t total)>&& progress = {}) noexcept;
+
 #if defined(__EMSCRIPTEN__)
     /**
       * WebGL only: Tells the driver to reset any internal state tracking if necessary.
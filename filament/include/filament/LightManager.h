@@ -174,7 +174,14 @@ public:
 
     /**
      * Retrieve the Entities of all the components of this manager.
-     * @return A list, in no particular order, of all the entities managed by this manager.
+     *
+     * The entities are listed in the order of their Instance, and Instances are contiguous:
+     * the Instance of `getEntities()[k]` is the Instance of `getEntities()[0]` plus `k`.
+     * Instances are stable until a light component is destroyed, at which point the last
+     * component takes the Instance of the destroyed one. This allows ranges of lights to be
+     * updated with the bulk setters, e.g. setPositions(Instance, math::float3 const*, size_t).
+     *
+     * @return A list of all the entities managed by this manager.
      */
     utils::Entity const* UTILS_NONNULL getEntities() const noexcept;
 
@@ -383,6 +390,33 @@ public:
          * Ignored if the light type isn't directional. For artistic use. Use with caution.
          */
         math::quatf transform{ 1.0f };
+
+        /**
+         * Whether the content of this light's shadow map can be reused across frames.
+         * When enabled, a shadow map (or cascade) is only rendered again when the light, its
+         * shadow camera or its options changed, or when a shadow caster that changed since the
+         * previous frame (i.e. was added, removed, moved, or is skinned, morphed or instanced)
+         * intersects the shadow map's frustum. This is most useful for static geometry lit by a
+         * fixed light.
+         * Material parameter changes are not tracked and don't invalidate the shadow map.
+         * This is ignored when the View's ShadowType is set to VSM.
+         * (off by default)
+         */
+        bool cacheShadowMap = false;
+
+        /**
+         * Number of frames between two renderings of each shadow cascade, except the first one.
+         * With a value greater than 1, the distant cascades are rendered in turn, each one
+         * reusing the content it was last rendered with in the meantime, reprojected for the
+         * current camera. A cascade is still rendered immediately when the light or its options
+         * changed, when its previous content doesn't cover the region it must shadow anymore, or
+         * when a shadow caster that changed since intersects it.
+         * The first cascade is always rendered every frame.
+         * Only applicable to Type.SUN or Type.DIRECTIONAL lights with more than one cascade.
+         * This is ignored when the View's ShadowType is set to VSM.
+         * The default is 1, i.e. all cascades are rendered every frame.
+         */
+        uint8_t cascadeUpdateInterval = 1;
     };
 
     struct ShadowCascades {
@@ -840,6 +874,113 @@ public:
      */
     float getIntensity(Instance i) const noexcept;
 
+    /**
+     * Dynamically updates the position of several lights at once. This is equivalent to
+     * calling setPosition() for each light, without the per-call overhead.
+     * Sorting the instances makes the updates more cache-friendly.
+     *
+     * @param instances Array of \p count Instances obtained from getInstance().
+     * @param positions Array of \p count positions in world space.
+     * @param count     Number of lights to update.
+     *
+     * @see setPosition()
+     */
+    void setPositions(Instance const* UTILS_NONNULL instances,
+            math::float3 const* UTILS_NONNULL positions, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the position of a range of lights.
+     *
+     * @param first     Instance of the first light of the range. The range must only contain
+     *                  valid Instances, see getEntities().
+     * @param positions Array of \p count positions in world space.
+     * @param count     Number of lights to update.
+     *
+     * @see setPosition()
+     */
+    void setPositions(Instance first,
+            math::float3 const* UTILS_NONNULL positions, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the direction of several lights at once. This is equivalent to
+     * calling setDirection() for each light, without the per-call overhead.
+     *
+     * @param instances  Array of \p count Instances obtained from getInstance().
+     * @param directions Array of \p count directions in world space. Should be unit vectors.
+     * @param count      Number of lights to update.
+     *
+     * @see setDirection()
+     */
+    void setDirections(Instance const* UTILS_NONNULL instances,
+            math::float3 const* UTILS_NONNULL directions, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the direction of a range of lights.
+     *
+     * @param first      Instance of the first light of the range. The range must only contain
+     *                   valid Instances, see getEntities().
+     * @param directions Array of \p count directions in world space. Should be unit vectors.
+     * @param count      Number of lights to update.
+     *
+     * @see setDirection()
+     */
+    void setDirections(Instance first,
+            math::float3 const* UTILS_NONNULL directions, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the color of several lights at once. This is equivalent to
+     * calling setColor() for each light, without the per-call overhead.
+     *
+     * @param instances Array of \p count Instances obtained from getInstance().
+     * @param colors    Array of \p count colors specified in the linear sRGB color-space.
+     * @param count     Number of lights to update.
+     *
+     * @see setColor()
+     */
+    void setColors(Instance const* UTILS_NONNULL instances,
+            LinearColor const* UTILS_NONNULL colors, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the color of a range of lights.
+     *
+     * @param first     Instance of the first light of the range. The range must only contain
+     *                  valid Instances, see getEntities().
+     * @param colors    Array of \p count colors specified in the linear sRGB color-space.
+     * @param count     Number of lights to update.
+     *
+     * @see setColor()
+     */
+    void setColors(Instance first,
+            LinearColor const* UTILS_NONNULL colors, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the intensity of several lights at once. This is equivalent to
+     * calling setIntensity(Instance, float) for each light, without the per-call overhead.
+     *
+     * @param instances   Array of \p count Instances obtained from getInstance().
+     * @param intensities Array of \p count intensities, in *lux* for directional lights and
+     *                    in *lumen* for point and spot lights.
+     * @param count       Number of lights to update.
+     *
+     * @see setIntensity()
+     */
+    void setIntensities(Instance const* UTILS_NONNULL instances,
+            float const* UTILS_NONNULL intensities, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the intensity of a range of lights.
+     *
+     * @param first       Instance of the first light of the range. The range must only contain
+     *                    valid Instances, see getEntities().
+     * @param intensities Array of \p count intensities, in *lux* for directional lights and
+     *                    in *lumen* for point and spot lights.
+     * @param count       Number of lights to update.
+     *
+     * @see setIntensity()
+     */
+    void setIntensities(Instance first,
+            float const* UTILS_NONNULL intensities, size_t count) noexcept;
+
     /**
      * Set the falloff distance for point lights and spot lights.
      *
@@ -112,6 +112,31 @@ public:
          */
         Builder& package(const void* UTILS_NONNULL payload, size_t size);
 
+        using ReleaseCallback = void(*)(const void* UTILS_NONNULL payload, size_t size,
+                void* UTILS_NULLABLE user);
+
+        /**
+         * Specifies the material data without copying it. The material data must stay valid and
+         * unchanged until the callback is called, which happens once the Material built from it
+         * is destroyed, or if build() fails. This is useful to read the material data directly
+         * from a memory-mapped file.
+         *
+         * Whether or not the material data is copied, the shaders are only decoded when the
+         * variants that need them are used. Not copying the material data further reduces the
+         * memory used by materials of which only a few variants are used.
+         *
+         * The material data must be aligned on 8 bytes to be used in place, otherwise it is
+         * copied.
+         *
+         * @param payload Pointer to the material data.
+         * @param size Size of the material data pointed to by "payload" in bytes.
+         * @param callback Called with payload, size and user when the material data is no longer
+         *                 needed, once for each Material built. Must not be null.
+         * @param user User data passed to the callback.
+         */
+        Builder& package(const void* UTILS_NONNULL payload, size_t size,
+                ReleaseCallback UTILS_NONNULL callback, void* UTILS_NULLABLE user = nullptr);
+
         template<typename T>
         using is_supported_constant_parameter_t = typename std::enable_if<
                 std::is_same<int32_t, T>::value ||
@@ -227,6 +252,23 @@ public:
      */
     MaterialInstance* UTILS_NONNULL createInstance(const char* UTILS_NULLABLE name = nullptr) const noexcept;
 
+    /**
+     * Creates several instances of this material at once, which is faster than calling
+     * createInstance() repeatedly. Material instances should be freed using
+     * Engine::destroy(const MaterialInstance*).
+     *
+     * If Engine::Config::materialInstanceRecycleCount is set, the Engine recycles the instances
+     * of a material that are destroyed, along with their GPU resources, so creating instances
+     * after destroying others is cheaper.
+     *
+     * @param instances Array of at least count pointers, which receive the new instances.
+     * @param count     Number of instances to create.
+     * @param name      Optional name to associate with the instances. If this is null,
+     *                  then the instances inherit the material's name.
+     */
+    void createInstances(MaterialInstance* UTILS_NONNULL* UTILS_NONNULL instances, size_t count,
+            const char* UTILS_NULLABLE name = nullptr) const noexcept;
+
     //! Returns the name of this material as a null-terminated string.
     const char* UTILS_NONNULL getName() const noexcept;
 
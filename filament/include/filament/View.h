@@ -605,6 +605,28 @@ public:
      */
     SoftShadowOptions getSoftShadowOptions() const noexcept;
 
+    /**
+     * Sets the budget, in texels, of the spot and point light shadow maps of this View.
+     *
+     * Spot and point light shadow maps are packed in the layers of the shadow map atlas.
+     * When a budget is set, each of them is sized according to the screen coverage of its light,
+     * up to the light's ShadowOptions::mapSize and down to 1/8th of the largest shadow map of
+     * the View. Then, while the total texel count of these shadow maps exceeds the budget, the
+     * shadow maps of the lights covering the least of the screen are halved.
+     *
+     * This is ignored when the shadow type is set to ShadowType::VSM.
+     *
+     * @param texels Budget in texels, or 0 to always use ShadowOptions::mapSize (the default).
+     */
+    void setShadowTexelBudget(uint32_t texels) noexcept;
+
+    /**
+     * Returns the spot and point light shadow maps texel budget of this View.
+     *
+     * @return value set by setShadowTexelBudget().
+     */
+    uint32_t getShadowTexelBudget() const noexcept;
+
     /**
      * Enables or disables post processing. Enabled by default.
      *
@@ -327,6 +327,14 @@ size_t Engine::getMaxAutomaticInstances() const noexcept {
     return downcast(this)->getMaxAutomaticInstances();
 }
 
+Engine::CommandBufferStatistics Engine::getCommandBufferStatistics() const noexcept {
+    return downcast(this)->getCommandBufferStatistics();
+}
+
+Engine::HandleStatistics Engine::getHandleStatistics() const noexcept {
+    return downcast(this)->getHandleStatistics();
+}
+
 const Engine::Config& Engine::getConfig() const noexcept {
     return downcast(this)->getConfig();
 }
@@ -339,6 +347,15 @@ size_t Engine::getMaxStereoscopicEyes() noexcept {
     return FEngine::getMaxStereoscopicEyes();
 }
 
+size_t Engine::getVariantUsage(void* data, size_t size) const noexcept {
+    return downcast(this)->getVariantUsage(data, size);
+}
+
+bool Engine::warmUpVariants(const void* data, size_t size, backend::CallbackHandler* handler,
+        utils::Invocable<void(size_t compiled, size_t total)>&& progress) noexcept {
+    return downcast(this)->warmUpVariants(data, size, handler, std::move(progress));
+}
+
 #if defined(__EMSCRIPTEN__)
 void Engine::resetBackendState() noexcept {
     downcast(this)->resetBackendState();
@@ -25,7 +25,9 @@
 
 #include <filament/Viewport.h>
 
+#include <utils/algorithm.h>
 #include <utils/BinaryTreeArray.h>
+#include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 #include <utils/debug.h>
 
@@ -34,8 +36,12 @@
 #include <math/scalar.h>
 
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
 
 #include <stddef.h>
+#include <string.h>
 
 using namespace filament::math;
 using namespace utils;
@@ -49,8 +55,23 @@ static constexpr size_t FROXEL_SLICE_COUNT = 16;
 static constexpr float FROXEL_FIRST_SLICE_DEPTH = 5;
 static constexpr float FROXEL_LAST_SLICE_DISTANCE = 100;
 
-// The record buffer is limited by both the UBO size and our use of 16-bits indices.
-constexpr size_t RECORD_BUFFER_ENTRY_COUNT  = CONFIG_MINSPEC_UBO_SIZE;    // 16 KiB UBO minspec
+// Size in froxels of the side of a coarse tile, used when running out of record buffer space
+static constexpr size_t COARSE_TILE_SIZE = 4;
+
+// Number of froxel slices processed by each job when updating the bounding spheres
+static constexpr size_t JOBS_PARALLEL_FOR_SLICES_COUNT = 2;
+
+// Alignment of the SoA arrays, so that they can be loaded a full AVX2 register at a time
+static constexpr size_t SOA_ALIGNMENT = 32;
+
+// Number of light lists remembered for sharing between non-adjacent froxels (power of two)
+static constexpr size_t RECORD_CACHE_SIZE = 512;
+static_assert(!(RECORD_CACHE_SIZE & (RECORD_CACHE_SIZE - 1)),
+        "RECORD_CACHE_SIZE must be a power of two");
+
+// The record buffer is limited by both the UBO size and our use of 16-bits indices. It holds
+// 8-bit records, or 16-bit records (half as many) when there are more than 256 lights.
+constexpr size_t RECORD_BUFFER_SIZE = CONFIG_MINSPEC_UBO_SIZE;    // 16 KiB UBO minspec
 
 // Buffer needed for Froxelizer internal data structures (~256 KiB)
 constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
@@ -58,29 +79,27 @@ constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
                                                   FROXEL_BUFFER_MAX_ENTRY_COUNT + 3 +
                                                   FROXEL_SLICE_COUNT / 4 + 1);
 
-// number of lights processed by one group (e.g. 32)
+// number of lights of a coarse tile tested together (e.g. 32)
 static constexpr size_t LIGHT_PER_GROUP = sizeof(Froxelizer::LightGroupType) * 8;
 
-// number of groups (i.e. jobs) to use for froxelization (e.g. 8)
-static constexpr size_t GROUP_COUNT =
-        (CONFIG_MAX_LIGHT_COUNT + LIGHT_PER_GROUP - 1) / LIGHT_PER_GROUP;
+// maximum number of lights per froxel, limited by FroxelEntry::count()
+static constexpr size_t MAX_FROXEL_LIGHT_COUNT = 255;
+
+// number of lights that can be indexed by 8-bit records
+static constexpr size_t MAX_RECORD8_LIGHT_COUNT = 256;
 
-// This depends on the maximum number of lights (currently 256)
+// This depends on the maximum number of lights (currently 16384)
 static_assert(CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<Froxelizer::RecordBufferType>::max(),
-        "can't have more than 256 lights");
+        "can't have more than 65536 lights");
 
 // Record buffer cannot be larger than 65K entries because froxels use uint16_t to store indices
 // to it.
-static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536,
+static_assert(RECORD_BUFFER_SIZE <= 65536,
         "RecordBuffer cannot be larger than 65536 entries");
 
-static_assert(RECORD_BUFFER_ENTRY_COUNT <= CONFIG_MINSPEC_UBO_SIZE,
+static_assert(RECORD_BUFFER_SIZE <= CONFIG_MINSPEC_UBO_SIZE,
         "RecordBuffer cannot be larger than the UBO minspec (16KiB)");
 
-struct Froxelizer::FroxelThreadData :
-        public std::array<LightGroupType, FROXEL_BUFFER_MAX_ENTRY_COUNT> {
-};
-
 
 // Returns false if the two matrices are different. May return false if they're the
 // same, with some elements only differing by +0 or -0. Behaviour is undefined with NaNs.
@@ -101,9 +120,6 @@ Froxelizer::Froxelizer(FEngine& engine)
           mZLightNear(FROXEL_FIRST_SLICE_DEPTH),
           mZLightFar(FROXEL_LAST_SLICE_DISTANCE)
 {
-    static_assert(std::is_same_v<RecordBufferType, uint8_t>,
-            "Record Buffer must use bytes");
-
     DriverApi& driverApi = engine.getDriverApi();
 
     if (UTILS_UNLIKELY(driverApi.getFeatureLevel() == FeatureLevel::FEATURE_LEVEL_0)) {
@@ -114,7 +130,7 @@ Froxelizer::Froxelizer(FEngine& engine)
             FROXEL_BUFFER_MAX_ENTRY_COUNT,
             engine.getDriverApi().getMaxUniformBufferSize() / 16u);
 
-    mRecordsBuffer = driverApi.createBufferObject(RECORD_BUFFER_ENTRY_COUNT,
+    mRecordsBuffer = driverApi.createBufferObject(RECORD_BUFFER_SIZE,
             BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
 
     mFroxelsBuffer = driverApi.createBufferObject(getFroxelBufferEntryCount() * 16u,
@@ -129,7 +145,8 @@ void Froxelizer::terminate(DriverApi& driverApi) noexcept {
     // call reset() on our LinearAllocator arenas
     mArena.reset();
 
-    mBoundingSpheres = nullptr;
+    mBoundingSpheres = {};
+    mPlaneNormalsX = {};
     mPlanesY = nullptr;
     mPlanesX = nullptr;
     mDistancesZ = nullptr;
@@ -168,14 +185,15 @@ void Froxelizer::setProjection(const mat4f& projection,
 }
 
 bool Froxelizer::prepare(
-        FEngine::DriverApi& driverApi, ArenaScope& arena, filament::Viewport const& viewport,
+        FEngine::DriverApi& driverApi, JobSystem& js, ArenaScope& arena,
+        filament::Viewport const& viewport,
         const mat4f& projection, float projectionNear, float projectionFar) noexcept {
     setViewport(viewport);
     setProjection(projection, projectionNear, projectionFar);
 
     bool uniformsNeedUpdating = false;
     if (UTILS_UNLIKELY(mDirtyFlags)) {
-        uniformsNeedUpdating = update();
+        uniformsNeedUpdating = update(js);
     }
 
     /*
@@ -190,31 +208,38 @@ bool Froxelizer::prepare(
 
     // record buffer (~16 KiB)
     mRecordBufferUser = {
-            driverApi.allocatePod<RecordBufferType>(RECORD_BUFFER_ENTRY_COUNT),
-            RECORD_BUFFER_ENTRY_COUNT };
+            driverApi.allocatePod<uint8_t>(RECORD_BUFFER_SIZE, alignof(RecordBufferType)),
+            RECORD_BUFFER_SIZE };
 
     /*
      * Temporary allocations for processing all froxel data
      */
 
-    // light records per froxel (~256 KiB)
-    mLightRecords = {
-            arena.allocate<LightRecord>(getFroxelBufferEntryCount(), CACHELINE_SIZE),
+    // light bits and light lists per froxel (~160 KiB)
+    mFroxelLightBits = {
+            arena.allocate<LightGroupType>(getFroxelBufferEntryCount(), CACHELINE_SIZE),
             getFroxelBufferEntryCount() };
 
-    // froxel thread data (~256 KiB)
-    mFroxelShardedData = {
-            arena.allocate<FroxelThreadData>(GROUP_COUNT, CACHELINE_SIZE),
-            uint32_t(GROUP_COUNT)
-    };
+    mFroxelLightLists = {
+            arena.allocate<LightList>(getFroxelBufferEntryCount(), CACHELINE_SIZE),
+            getFroxelBufferEntryCount() };
+
+    // coarse tiles entries (~3 KiB)
+    mCoarseTileEntries = {
+            arena.allocate<uint32_t>(mCoarseTileCount),
+            mCoarseTileCount };
+
+    // light lists cache (8 KiB)
+    mRecordCache = {
+            arena.allocate<RecordCacheEntry>(RECORD_CACHE_SIZE, CACHELINE_SIZE),
+            RECORD_CACHE_SIZE };
 
     assert_invariant(mFroxelBufferUser.begin());
     assert_invariant(mRecordBufferUser.begin());
-    assert_invariant(mLightRecords.begin());
-    assert_invariant(mFroxelShardedData.begin());
-
-    // initialize buffers that need to be
-    memset(mLightRecords.data(), 0, mLightRecords.sizeInBytes());
+    assert_invariant(mFroxelLightBits.begin());
+    assert_invariant(mFroxelLightLists.begin());
+    assert_invariant(mCoarseTileEntries.begin());
+    assert_invariant(mRecordCache.begin());
 
     return uniformsNeedUpdating;
 }
@@ -261,8 +286,8 @@ void Froxelizer::computeFroxelLayout(
 }
 
 UTILS_NOINLINE
-void Froxelizer::updateBoundingSpheres(
-        math::float4* const UTILS_RESTRICT boundingSpheres,
+void Froxelizer::updateBoundingSpheres(JobSystem& js,
+        BoundingSpheres const& boundingSpheres,
         size_t froxelCountX, size_t froxelCountY, size_t froxelCountZ,
         math::float4 const* UTILS_RESTRICT planesX,
         math::float4 const* UTILS_RESTRICT planesY,
@@ -270,17 +295,43 @@ void Froxelizer::updateBoundingSpheres(
 
     SYSTRACE_CALL();
 
-    // TODO: this could potentially be parallel_for'ized
-
     /*
      * Now compute the bounding sphere of each froxel, which is needed for spotlights
      * We intersect 3 planes of the frustum to find each 8 corners.
+     * Each z-slice is independent, so they're processed in parallel.
      */
 
     UTILS_ASSUME(froxelCountX > 0);
     UTILS_ASSUME(froxelCountY > 0);
 
-    for (size_t iz = 0, fi = 0, nz = froxelCountZ; iz < nz; ++iz) {
+    auto work = [=](uint32_t startZ, uint32_t countZ) {
+        updateBoundingSpheresSlices(boundingSpheres, froxelCountX, froxelCountY,
+                startZ, startZ + countZ, planesX, planesY, planesZ);
+    };
+
+    if (froxelCountZ <= JOBS_PARALLEL_FOR_SLICES_COUNT) {
+        work(0, uint32_t(froxelCountZ));
+    } else {
+        auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(froxelCountZ), std::cref(work),
+                jobs::CountSplitter<JOBS_PARALLEL_FOR_SLICES_COUNT>());
+        js.runAndWait(job);
+    }
+}
+
+void Froxelizer::updateBoundingSpheresSlices(
+        BoundingSpheres const& boundingSpheres,
+        size_t froxelCountX, size_t froxelCountY, size_t z0, size_t z1,
+        math::float4 const* UTILS_RESTRICT planesX,
+        math::float4 const* UTILS_RESTRICT planesY,
+        float const* UTILS_RESTRICT planesZ) noexcept {
+
+    float* const UTILS_RESTRICT sx = boundingSpheres.x;
+    float* const UTILS_RESTRICT sy = boundingSpheres.y;
+    float* const UTILS_RESTRICT sz = boundingSpheres.z;
+    float* const UTILS_RESTRICT sr = boundingSpheres.r;
+
+    for (size_t iz = z0, fi = getFroxelIndex(0, 0, z0, froxelCountX, froxelCountY);
+            iz < z1; ++iz) {
         float4 planes[6];
         planes[4] =  float4{ 0, 0, 1, planesZ[iz + 0] };
         planes[5] = -float4{ 0, 0, 1, planesZ[iz + 1] };
@@ -314,14 +365,18 @@ void Froxelizer::updateBoundingSpheres(
                 float const r = std::sqrt(std::max({ d0, d1, d2, d3, d4, d5, d6, d7 }));
 
                 assert_invariant(getFroxelIndex(ix, iy, iz, froxelCountX, froxelCountY) == fi);
-                boundingSpheres[fi++] = { c, r };
+                sx[fi] = c.x;
+                sy[fi] = c.y;
+                sz[fi] = c.z;
+                sr[fi] = r;
+                fi++;
             }
         }
     }
 }
 
 UTILS_NOINLINE
-bool Froxelizer::update() noexcept {
+bool Froxelizer::update(JobSystem& js) noexcept {
     bool uniformsNeedUpdating = false;
     if (UTILS_UNLIKELY(mDirtyFlags & VIEWPORT_CHANGED)) {
         filament::Viewport const& viewport = mViewport;
@@ -352,6 +407,10 @@ bool Froxelizer::update() noexcept {
         const uint32_t froxelCount = uint32_t(froxelCountX * froxelCountY * froxelCountZ);
         mFroxelCount = froxelCount;
 
+        mCoarseTileCountX = uint16_t((froxelCountX + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE);
+        mCoarseTileCountY = uint16_t((froxelCountY + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE);
+        mCoarseTileCount = uint32_t(mCoarseTileCountX * mCoarseTileCountY * froxelCountZ);
+
         if (mDistancesZ) {
             // this is a LinearAllocator arena, use rewind() instead of free (which is a no op).
             mArena.rewind(mDistancesZ);
@@ -360,12 +419,22 @@ bool Froxelizer::update() noexcept {
         mDistancesZ      = mArena.alloc<float>(froxelCountZ + 1);
         mPlanesX         = mArena.alloc<float4>(froxelCountX + 1);
         mPlanesY         = mArena.alloc<float4>(froxelCountY + 1);
-        mBoundingSpheres = mArena.alloc<float4>(froxelCount);
+        mPlaneNormalsX = {
+                mArena.alloc<float>(froxelCountX + 1, SOA_ALIGNMENT),
+                mArena.alloc<float>(froxelCountX + 1, SOA_ALIGNMENT),
+                mArena.alloc<float>(froxelCountX + 1, SOA_ALIGNMENT) };
+        mBoundingSpheres = {
+                mArena.alloc<float>(froxelCount, SOA_ALIGNMENT),
+                mArena.alloc<float>(froxelCount, SOA_ALIGNMENT),
+                mArena.alloc<float>(froxelCount, SOA_ALIGNMENT),
+                mArena.alloc<float>(froxelCount, SOA_ALIGNMENT) };
 
         assert_invariant(mDistancesZ);
         assert_invariant(mPlanesX);
         assert_invariant(mPlanesY);
-        assert_invariant(mBoundingSpheres);
+        assert_invariant(mPlaneNormalsX.x && mPlaneNormalsX.y && mPlaneNormalsX.z);
+        assert_invariant(mBoundingSpheres.x && mBoundingSpheres.y &&
+                         mBoundingSpheres.z && mBoundingSpheres.r);
 
         mDistancesZ[0] = 0.0f;
         const float zLightNear = mZLightNear;
@@ -395,7 +464,6 @@ bool Froxelizer::update() noexcept {
         assert_invariant(mDistancesZ);
         assert_invariant(mPlanesX);
         assert_invariant(mPlanesY);
-        assert_invariant(mBoundingSpheres);
 
         // clip-space dimensions
         const float froxelWidthInClipSpace  = float(2 * mFroxelDimension.x) / float(mViewport.width);
@@ -413,6 +481,9 @@ bool Froxelizer::update() noexcept {
             float const x = (float(i) * froxelWidthInClipSpace) - 1.0f;
             float4 const p = trProjection * float4{ -1, 0, 0, x };
             planesX[i] = float4{ normalize(p.xyz), 0 };  // p.w is guaranteed to be 0
+            mPlaneNormalsX.x[i] = planesX[i].x;
+            mPlaneNormalsX.y[i] = planesX[i].y;
+            mPlaneNormalsX.z[i] = planesX[i].z;
         }
 
         // generate the vertical planes from their clip-space equation
@@ -422,7 +493,7 @@ bool Froxelizer::update() noexcept {
             planesY[i] = float4{ normalize(p.xyz), 0 };  // p.w is guaranteed to be 0
         }
 
-        updateBoundingSpheres(mBoundingSpheres,
+        updateBoundingSpheres(js, mBoundingSpheres,
                 mFroxelCountX, mFroxelCountY, mFroxelCountZ,
                 planesX, planesY, mDistancesZ);
 
@@ -453,6 +524,10 @@ bool Froxelizer::update() noexcept {
     }
     assert_invariant(mZLightNear >= mNear);
     mDirtyFlags = 0;
+
+    // the froxels changed, whatever is on the GPU is stale
+    mCommittedDataValid = false;
+
     return uniformsNeedUpdating;
 }
 
@@ -490,6 +565,37 @@ size_t Froxelizer::findSliceZ(float z) const noexcept {
     return size_t(clamp(s, 0, mFroxelCountZ - 1));
 }
 
+size_t Froxelizer::getCoarseTileIndex(size_t froxelIndex) const noexcept {
+    size_t const ix = froxelIndex % mFroxelCountX;
+    size_t const iy = (froxelIndex / mFroxelCountX) % mFroxelCountY;
+    size_t const iz = froxelIndex / (mFroxelCountX * mFroxelCountY);
+    return (ix / COARSE_TILE_SIZE) +
+           (iy / COARSE_TILE_SIZE) * mCoarseTileCountX +
+           iz * mCoarseTileCountX * mCoarseTileCountY;
+}
+
+Froxelizer::FroxelRange Froxelizer::getCoarseTileRange(size_t tileIndex) const noexcept {
+    size_t const tx = tileIndex % mCoarseTileCountX;
+    size_t const ty = (tileIndex / mCoarseTileCountX) % mCoarseTileCountY;
+    size_t const tz = tileIndex / (mCoarseTileCountX * mCoarseTileCountY);
+    size_t const x0 = tx * COARSE_TILE_SIZE;
+    size_t const y0 = ty * COARSE_TILE_SIZE;
+    size_t const x1 = std::min(x0 + COARSE_TILE_SIZE, size_t(mFroxelCountX)) - 1;
+    size_t const y1 = std::min(y0 + COARSE_TILE_SIZE, size_t(mFroxelCountY)) - 1;
+    return { uint16_t(x0), uint16_t(y0), uint16_t(tz), uint16_t(x1), uint16_t(y1), uint16_t(tz) };
+}
+
+size_t Froxelizer::getLightIndex(FroxelEntry entry, size_t i) const noexcept {
+    size_t const index = entry.offset() + i;
+    if (entry.hasRecords16()) {
+        RecordBufferType lightIndex;
+        memcpy(&lightIndex, mRecordBufferUser.data() + index * sizeof(lightIndex),
+                sizeof(lightIndex));
+        return lightIndex;
+    }
+    return mRecordBufferUser[index];
+}
+
 std::pair<size_t, size_t> Froxelizer::clipToIndices(float2 const& clip) const noexcept {
     // clip coordinates between [-1, 1], conversion to index between [0, count[
     // (clip + 1) * 0.5 * dimension / froxelsize
@@ -501,31 +607,157 @@ std::pair<size_t, size_t> Froxelizer::clipToIndices(float2 const& clip) const no
 
 
 void Froxelizer::commit(backend::DriverApi& driverApi) {
+    if (mFroxelDataUnchanged) {
+        // the GPU buffers already have this data
+        mFroxelDataUnchanged = false;
+        return;
+    }
+
     // send data to GPU
     driverApi.updateBufferObject(mFroxelsBuffer,
             { mFroxelBufferUser.data(), getFroxelBufferEntryCount() * 16u }, 0);
 
     driverApi.updateBufferObject(mRecordsBuffer,
-            { mRecordBufferUser.data(), RECORD_BUFFER_ENTRY_COUNT }, 0);
+            { mRecordBufferUser.data(), RECORD_BUFFER_SIZE }, 0);
+
+    mCommittedViewMatrix = mPendingViewMatrix;
+    std::swap(mCommittedLightKey, mPendingLightKey);
+    mCommittedDataValid = true;
 
 #ifndef NDEBUG
     mFroxelBufferUser.clear();
     mRecordBufferUser.clear();
-    mFroxelShardedData.clear();
+    mFroxelLightBits.clear();
+    mFroxelLightLists.clear();
 #endif
 }
 
+// Returns the clip-space range, along one axis, of the perspective projection of a sphere clipped
+// by the near plane. See "2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere",
+// Mara & McGuire, JCGT 2013.
+// c is the center of the sphere in the (axis, z) plane, r its radius, nearZ the near plane's z,
+// and scale, offset the projection's terms for this axis. This is branch-less so that the loop
+// in computeLightBounds() vectorizes.
+UTILS_ALWAYS_INLINE
+static inline float2 projectSphereAxis(float2 const c, float const r, float const nearZ,
+        float const scale, float const offset) noexcept {
+    float const d2 = dot(c, c);
+    float const t2 = d2 - r * r;
+    bool const cameraInsideSphere = t2 <= 0.0f;
+    // (cos, sin) of the angle between the direction to the center and the tangents
+    float2 v = float2{ std::sqrt(std::max(0.0f, t2)), r } / std::sqrt(std::max(d2, 1e-12f));
+    v = cameraInsideSphere ? float2{ 0.0f } : v;
+    // whether the near plane intersects the sphere
+    bool const clipSphere = c.y + r >= nearZ;
+    // The first tangent (v.y > 0) is the lower bound, so it's paired with the lower end of the
+    // sphere's intersection with the near plane, at c.x - k.
+    float k = -std::sqrt(std::max(0.0f, r * r - (nearZ - c.y) * (nearZ - c.y)));
+    float ndc[2];
+    for (size_t i = 0; i < 2; i++) {
+        // the tangent point, unless the near plane clips it
+        float2 b = float2{ v.x * c.x + v.y * c.y, v.x * c.y - v.y * c.x } * v.x;
+        bool const clipBound = cameraInsideSphere || b.y > nearZ;
+        b = (clipSphere && clipBound) ? float2{ c.x + k, nearZ } : b;
+        ndc[i] = -scale * b.x / b.y - offset;
+        v.y = -v.y;
+        k = -k;
+    }
+    float2 const range{ std::min(ndc[0], ndc[1]), std::max(ndc[0], ndc[1]) };
+    return clamp(range, -1.0f, 1.0f);
+}
+
+void Froxelizer::computeLightBounds(FLightManager const& lcm,
+        mat4f const& UTILS_RESTRICT viewMatrix, mat4f const& UTILS_RESTRICT projection,
+        float near, FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
+    SYSTRACE_CALL();
+
+    if (lightData.size() <= FScene::DIRECTIONAL_LIGHTS_COUNT) {
+        return;
+    }
+
+    // the directional light doesn't participate in froxelization
+    size_t const count = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+    size_t const first = FScene::DIRECTIONAL_LIGHTS_COUNT;
+    auto const* UTILS_RESTRICT spheres    = lightData.data<FScene::POSITION_RADIUS>() + first;
+    auto const* UTILS_RESTRICT directions = lightData.data<FScene::DIRECTION>() + first;
+    auto const* UTILS_RESTRICT instances  = lightData.data<FScene::LIGHT_INSTANCE>() + first;
+    auto* UTILS_RESTRICT bounds  = lightData.data<FScene::CLIP_SPACE_BOUNDS>() + first;
+    auto* UTILS_RESTRICT zRanges = lightData.data<FScene::VIEW_SPACE_Z_RANGE>() + first;
+
+    // First, the world-space bounding sphere of each light, stored in place of its bounds.
+    // For a spotlight, it's the bounding sphere of its cone capped by its sphere of influence.
+    for (size_t i = 0; i < count; i++) {
+        float4 sphere = spheres[i];
+        FLightManager::Instance const li = instances[i];
+        if (lcm.isSpotLight(li)) {
+            float const cosOuter = std::sqrt(lcm.getCosOuterSquared(li));
+            float const sinOuter = 1.0f / lcm.getSinInverse(li);
+            float const r = sphere.w;
+            if (cosOuter < f::SQRT1_2) {
+                // outer angle larger than 45 degrees, the sphere goes through the cone's cap
+                sphere = { sphere.xyz + directions[i] * (cosOuter * r), sinOuter * r };
+            } else {
+                // the sphere goes through the cone's apex and the tip of its cap
+                float const d = r / (2.0f * cosOuter);
+                sphere = { sphere.xyz + directions[i] * d, d };
+            }
+        }
+        bounds[i] = sphere;
+    }
+
+    // Then, the bounds of the bounding spheres. This loop doesn't have any control flow so that
+    // it's vectorized by the compiler.
+    float const nearZ = -near;
+    if (projection[2][3] != 0.0f) {
+        // perspective projection
+        for (size_t i = 0; i < count; i++) {
+            float4 const sphere = bounds[i];
+            float3 const c = (viewMatrix * float4{ sphere.xyz, 1.0f }).xyz;
+            float2 const x = projectSphereAxis({ c.x, c.z }, sphere.w, nearZ,
+                    projection[0][0], projection[2][0]);
+            float2 const y = projectSphereAxis({ c.y, c.z }, sphere.w, nearZ,
+                    projection[1][1], projection[2][1]);
+            bounds[i] = { x[0], y[0], x[1], y[1] };
+            zRanges[i] = { c.z - sphere.w, c.z + sphere.w };
+        }
+    } else {
+        // orthographic projection
+        float2 const scale = { std::abs(projection[0][0]), std::abs(projection[1][1]) };
+        float2 const offset = { projection[3][0], projection[3][1] };
+        for (size_t i = 0; i < count; i++) {
+            float4 const sphere = bounds[i];
+            float3 const c = (viewMatrix * float4{ sphere.xyz, 1.0f }).xyz;
+            float2 const center = float2{ projection[0][0], projection[1][1] } * c.xy + offset;
+            float2 const lo = clamp(center - scale * sphere.w, -1.0f, 1.0f);
+            float2 const hi = clamp(center + scale * sphere.w, -1.0f, 1.0f);
+            bounds[i] = { lo, hi };
+            zRanges[i] = { c.z - sphere.w, c.z + sphere.w };
+        }
+    }
+}
+
 void Froxelizer::froxelizeLights(FEngine& engine,
         mat4f const& UTILS_RESTRICT viewMatrix,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     // note: this is called asynchronously
+
+    // With a static camera and static lights, the froxel data is the same as last frame's.
+    // The comparisons are exact, any change, however small, must update the froxels.
+    getLightKey(engine.getLightManager(), lightData, mPendingLightKey);
+    mFroxelDataUnchanged = mCommittedDataValid &&
+            mPendingLightKey == mCommittedLightKey &&
+            !memcmp(&viewMatrix, &mCommittedViewMatrix, sizeof(viewMatrix));
+    if (mFroxelDataUnchanged) {
+        return;
+    }
+    mPendingViewMatrix = viewMatrix;
+
     froxelizeLoop(engine, viewMatrix, lightData);
-    froxelizeAssignRecordsCompress();
+    froxelizeAssignRecordsCompress(lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
 
 #ifndef NDEBUG
     if (lightData.size()) {
         // go through every froxel
-        auto const& recordBufferUser(mRecordBufferUser);
         auto gpuFroxelEntries(mFroxelBufferUser);
         gpuFroxelEntries.set(gpuFroxelEntries.begin(),
                 mFroxelCountX * mFroxelCountY * mFroxelCountZ);
@@ -533,9 +765,10 @@ void Froxelizer::froxelizeLights(FEngine& engine,
             // go through every light for that froxel
             for (size_t i = 0; i < entry.count(); i++) {
                 // get the light index
-                assert_invariant(entry.offset() + i < RECORD_BUFFER_ENTRY_COUNT);
+                assert_invariant(entry.offset() + i <
+                        RECORD_BUFFER_SIZE / (entry.hasRecords16() ? 2 : 1));
 
-                size_t const lightIndex = recordBufferUser[entry.offset() + i];
+                size_t const lightIndex = getLightIndex(entry, i);
                 assert_invariant(lightIndex <= CONFIG_MAX_LIGHT_INDEX);
 
                 // make sure it corresponds to an existing light
@@ -546,193 +779,371 @@ void Froxelizer::froxelizeLights(FEngine& engine,
 #endif
 }
 
+void Froxelizer::getLightKey(FLightManager const& lcm,
+        const FScene::LightSoa& UTILS_RESTRICT lightData, std::vector<float>& key) noexcept {
+    SYSTRACE_CALL();
+
+    key.clear();
+    if (lightData.size() <= FScene::DIRECTIONAL_LIGHTS_COUNT) {
+        return;
+    }
+
+    // the directional light doesn't participate in froxelization
+    size_t const count = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+    auto const* UTILS_RESTRICT spheres    = lightData.data<FScene::POSITION_RADIUS>();
+    auto const* UTILS_RESTRICT directions = lightData.data<FScene::DIRECTION>();
+    auto const* UTILS_RESTRICT instances  = lightData.data<FScene::LIGHT_INSTANCE>();
+
+    key.reserve(count * 9);
+    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT; i < lightData.size(); i++) {
+        float4 const& sphere = spheres[i];
+        float3 const& direction = directions[i];
+        // the spotlight cone isn't in the light SoA
+        FLightManager::Instance const li = instances[i];
+        key.insert(key.end(), {
+                sphere.x, sphere.y, sphere.z, sphere.w,
+                direction.x, direction.y, direction.z,
+                lcm.getCosOuterSquared(li), lcm.getSinInverse(li) });
+    }
+}
+
 void Froxelizer::froxelizeLoop(FEngine& engine,
         const mat4f& UTILS_RESTRICT viewMatrix,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     SYSTRACE_CALL();
 
-    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-    memset(froxelThreadData.data(), 0, froxelThreadData.sizeInBytes());
-
     auto& lcm = engine.getLightManager();
     auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
+    auto const* UTILS_RESTRICT bounds       = lightData.data<FScene::CLIP_SPACE_BOUNDS>();
+    auto const* UTILS_RESTRICT zRanges      = lightData.data<FScene::VIEW_SPACE_Z_RANGE>();
+
+    const mat3f& vn = viewMatrix.upperLeft();
+
+    // We use minimum cone angle of 0.5 degrees because too small angles cause issues in the
+    // sphere/cone intersection test, due to floating-point precision.
+    constexpr float maxInvSin = 114.59301f;         // 1 / sin(0.5 degrees)
+    constexpr float maxCosSquared = 0.99992385f;    // cos(0.5 degrees)^2
+
+    size_t const lightCount = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+    mLightParams.resize(lightCount);
+    for (size_t i = 0; i < lightCount; i++) {
+        const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
+        FLightManager::Instance const li = instances[j];
+        LightParams& light = mLightParams[i];
+        light = {
+                .position = (viewMatrix * float4{ spheres[j].xyz, 1 }).xyz,     // to view-space
+                .cosSqr = std::min(maxCosSquared, lcm.getCosOuterSquared(li)),  // spot only
+                .axis = vn * directions[j],                                     // spot only
+                .invSin = lcm.getSinInverse(li),                                // spot only
+                .radius = spheres[j].w,
+        };
+        // infinity means "point-light"
+        if (light.invSin != std::numeric_limits<float>::infinity()) {
+            light.invSin = std::min(maxInvSin, light.invSin);
+        }
 
-    auto process = [ this, &froxelThreadData,
-                     spheres, directions, instances, &viewMatrix, &lcm ]
-            (size_t count, size_t offset, size_t stride) {
-
-        SYSTRACE_NAME("FroxelizeLoop Job");
-
-        const mat4f& projection = mProjection;
-        const mat3f& vn = viewMatrix.upperLeft();
-
-        // We use minimum cone angle of 0.5 degrees because too small angles cause issues in the
-        // sphere/cone intersection test, due to floating-point precision.
-        constexpr float maxInvSin = 114.59301f;         // 1 / sin(0.5 degrees)
-        constexpr float maxCosSquared = 0.99992385f;    // cos(0.5 degrees)^2
-
-        for (size_t i = offset; i < count; i += stride) {
-            const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
-            FLightManager::Instance const li = instances[j];
-            LightParams light = {
-                    .position = (viewMatrix * float4{ spheres[j].xyz, 1 }).xyz,     // to view-space
-                    .cosSqr = std::min(maxCosSquared, lcm.getCosOuterSquared(li)),  // spot only
-                    .axis = vn * directions[j],                                     // spot only
-                    .invSin = lcm.getSinInverse(li),                                // spot only
-                    .radius = spheres[j].w,
-            };
-            // infinity means "point-light"
-            if (light.invSin != std::numeric_limits<float>::infinity()) {
-                light.invSin = std::min(maxInvSin, light.invSin);
-            }
+        // A light fully behind LightFar doesn't light anything (we could avoid this check if
+        // we culled lights using LightFar instead of the culling camera's far plane)
+        light.visible = zRanges[j][1] >= -mZLightFar; // z values are negative
+
+#ifdef DEBUG_FROXEL
+        light.froxels = { 0, 0, 0,
+                uint16_t(mFroxelCountX - 1), uint16_t(mFroxelCountY - 1),
+                uint16_t(mFroxelCountZ - 1) };
+#else
+        // the light's bounds were computed by computeLightBounds(), convert them to froxel indices
+        const float znear = std::min(-mNear, zRanges[j][1]); // z values are negative
+        const float zfar  = zRanges[j][0];
+        const auto [x0, y0] = clipToIndices(bounds[j].xy);
+        const auto [x1, y1] = clipToIndices(bounds[j].zw);
+        const size_t z0 = findSliceZ(znear);
+        const size_t z1 = findSliceZ(zfar);
+
+        assert_invariant(x0 <= x1);
+        assert_invariant(y0 <= y1);
+        assert_invariant(z0 <= z1);
+
+        light.froxels = { uint16_t(x0), uint16_t(y0), uint16_t(z0),
+                          uint16_t(x1), uint16_t(y1), uint16_t(z1) };
+#endif
+    }
 
-            const size_t group = i % GROUP_COUNT;
-            const size_t bit   = i / GROUP_COUNT;
-            assert_invariant(bit < LIGHT_PER_GROUP);
+    binLights();
 
-            FroxelThreadData& threadData = froxelThreadData[group];
-            froxelizePointAndSpotLight(threadData, bit, projection, light);
-        }
+    // The froxels of a z-slice are contiguous, so the jobs don't share any froxel data.
+    auto work = [this](uint32_t startZ, uint32_t countZ) {
+        froxelizeSlices(startZ, startZ + countZ);
     };
 
-    // we do 64 lights per job
     JobSystem& js = engine.getJobSystem();
-
     constexpr bool SINGLE_THREADED = false;
     if (!SINGLE_THREADED) {
-        auto *parent = js.createJob();
-        for (size_t i = 0; i < GROUP_COUNT; i++) {
-            js.run(jobs::createJob(js, parent, std::cref(process),
-                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, GROUP_COUNT));
-        }
-        js.runAndWait(parent);
+        auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(mFroxelCountZ), std::cref(work),
+                jobs::CountSplitter<1>());
+        js.runAndWait(job);
     } else {
-        js.runAndWait(jobs::createJob(js, nullptr, std::cref(process),
-                lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, 0, 1)
-        );
+        work(0, uint32_t(mFroxelCountZ));
     }
 }
 
-void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
-
+void Froxelizer::binLights() noexcept {
     SYSTRACE_CALL();
 
-    Slice<FroxelThreadData> const froxelThreadData = mFroxelShardedData;
+    auto const& lights = mLightParams;
+    size_t const tileCount = mCoarseTileCount;
+    size_t const tileCountX = mCoarseTileCountX;
+    size_t const tileCountXY = size_t(mCoarseTileCountX) * mCoarseTileCountY;
+
+    // calls f() with the index of each coarse tile overlapping the froxels of a light
+    auto forEachTile = [=](FroxelRange const& r, auto&& f) {
+        for (size_t tz = r.z0; tz <= r.z1; tz++) {
+            for (size_t ty = r.y0 / COARSE_TILE_SIZE; ty <= r.y1 / COARSE_TILE_SIZE; ty++) {
+                for (size_t tx = r.x0 / COARSE_TILE_SIZE; tx <= r.x1 / COARSE_TILE_SIZE; tx++) {
+                    f(tx + ty * tileCountX + tz * tileCountXY);
+                }
+            }
+        }
+    };
+
+    // count the lights of each tile, and turn the counts into offsets
+    std::vector<uint32_t>& offsets = mTileLightOffsets;
+    offsets.assign(tileCount + 1, 0);
+    mAllLights.clear();
+    for (size_t i = 0, c = lights.size(); i < c; i++) {
+        if (lights[i].visible) {
+            forEachTile(lights[i].froxels, [&offsets](size_t t) { offsets[t + 1]++; });
+            if (mAllLights.size() < MAX_FROXEL_LIGHT_COUNT) {
+                mAllLights.push_back(RecordBufferType(i));
+            }
+        }
+    }
+    for (size_t t = 0; t < tileCount; t++) {
+        offsets[t + 1] += offsets[t];
+    }
+
+    // write the lights of each tile in order, so they stay sorted by distance
+    std::vector<uint32_t>& cursors = mTileListOffsets;
+    cursors.assign(offsets.begin(), offsets.end() - 1);
+    mTileLights.resize(offsets[tileCount]);
+    RecordBufferType* const UTILS_RESTRICT tileLights = mTileLights.data();
+    for (size_t i = 0, c = lights.size(); i < c; i++) {
+        if (lights[i].visible) {
+            forEachTile(lights[i].froxels, [&cursors, tileLights, i](size_t t) {
+                tileLights[cursors[t]++] = RecordBufferType(i);
+            });
+        }
+    }
+
+    // finally, make room for the light list of each froxel, which has at most as many lights
+    // as its tile
+    uint32_t size = 0;
+    for (size_t t = 0; t < tileCount; t++) {
+        FroxelRange const r = getCoarseTileRange(t);
+        size_t const froxelCount = (r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+        mTileListOffsets[t] = size;
+        size += uint32_t(froxelCount *
+                std::min(MAX_FROXEL_LIGHT_COUNT, size_t(offsets[t + 1] - offsets[t])));
+    }
+    mFroxelLights.resize(size);
+}
 
-    // convert froxel data from N groups of M bits to LightRecord::bitset, so we can
-    // easily compare adjacent froxels, for compaction. The conversion loops below get
-    // inlined and vectorized in release builds.
+void Froxelizer::froxelizeSlices(size_t z0, size_t z1) noexcept {
+    SYSTRACE_NAME("FroxelizeLoop Job");
+
+    mat4f const& projection = mProjection;
+    LightParams const* const UTILS_RESTRICT lights = mLightParams.data();
+    LightGroupType* const UTILS_RESTRICT bits = mFroxelLightBits.data();
+    LightList* const UTILS_RESTRICT lists = mFroxelLightLists.data();
+    size_t const tileCountXY = size_t(mCoarseTileCountX) * mCoarseTileCountY;
+
+    for (size_t t = z0 * tileCountXY, c = z1 * tileCountXY; t < c; t++) {
+        FroxelRange const range = getCoarseTileRange(t);
+        RecordBufferType const* const tileLights = mTileLights.data() + mTileLightOffsets[t];
+        size_t const tileLightCount = mTileLightOffsets[t + 1] - mTileLightOffsets[t];
+        size_t const capacity = std::min(MAX_FROXEL_LIGHT_COUNT, tileLightCount);
+
+        // the light lists of the tile's froxels, in the tile's row-major order
+        RecordBufferType* const UTILS_RESTRICT froxelLights =
+                mFroxelLights.data() + mTileListOffsets[t];
+        uint8_t counts[COARSE_TILE_SIZE * COARSE_TILE_SIZE] = {};
+
+        // The tile's lights are tested LIGHT_PER_GROUP at a time, each one sets its bit in the
+        // froxels it intersects, which are then appended to the froxels' lists. The lights are
+        // sorted, so once a froxel has MAX_FROXEL_LIGHT_COUNT lights, the others are farther.
+        for (size_t g = 0; g < tileLightCount; g += LIGHT_PER_GROUP) {
+            for (size_t iy = range.y0; iy <= range.y1; iy++) {
+                size_t const fi = getFroxelIndex(range.x0, iy, range.z0);
+                std::fill_n(bits + fi, range.x1 - range.x0 + 1, 0);
+            }
 
-    // this gets very well vectorized...
+            for (size_t b = 0, n = std::min(LIGHT_PER_GROUP, tileLightCount - g); b < n; b++) {
+                froxelizePointAndSpotLight(bits, b, projection, lights[tileLights[g + b]], range);
+            }
+
+            bool full = true;
+            for (size_t iy = range.y0, k = 0; iy <= range.y1; iy++) {
+                for (size_t ix = range.x0; ix <= range.x1; ix++, k++) {
+                    RecordBufferType* const UTILS_RESTRICT list = froxelLights + k * capacity;
+                    size_t count = counts[k];
+                    LightGroupType m = bits[getFroxelIndex(ix, iy, range.z0)];
+                    for (; m && count < capacity; m &= m - 1) {
+                        list[count++] = tileLights[g + utils::ctz(m)];
+                    }
+                    counts[k] = uint8_t(count);
+                    full = full && count == MAX_FROXEL_LIGHT_COUNT;
+                }
+            }
+            if (full) {
+                break;
+            }
+        }
 
-    utils::Slice<LightRecord> records(mLightRecords);
-    for (size_t j = 0, jc = getFroxelBufferEntryCount(); j < jc; j++) {
-        for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
-            using container_type = LightRecord::bitset::container_type;
-            constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
-            container_type b = froxelThreadData[i * r][j];
-            for (size_t k = 0; k < r; k++) {
-                b |= (container_type(froxelThreadData[i * r + k][j]) << (LIGHT_PER_GROUP * k));
+        for (size_t iy = range.y0, k = 0; iy <= range.y1; iy++) {
+            for (size_t ix = range.x0; ix <= range.x1; ix++, k++) {
+                lists[getFroxelIndex(ix, iy, range.z0)] = { froxelLights + k * capacity, counts[k] };
             }
-            records[j].lights.getBitsAt(i) = b;
         }
     }
+}
+
+// Writes a light list at offset in the record buffer, as 8-bit or 16-bit records.
+static void writeLightList(uint8_t* const UTILS_RESTRICT records, size_t offset,
+        Froxelizer::RecordBufferType const* UTILS_RESTRICT lights, size_t count,
+        bool records16) noexcept {
+    if (records16) {
+        // note: this assumes a little-endian system, like the rest of the record buffer
+        memcpy(records + offset * sizeof(Froxelizer::RecordBufferType), lights,
+                count * sizeof(Froxelizer::RecordBufferType));
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            records[offset + i] = uint8_t(lights[i]);
+        }
+    }
+}
 
-    LightRecord::bitset allLights{};
-    for (size_t j = 0, jc = getFroxelBufferEntryCount(); j < jc; j++) {
-        allLights |= records[j].lights;
+static size_t hashLights(Froxelizer::RecordBufferType const* lights, size_t count) noexcept {
+    uint64_t h = count;
+    for (size_t i = 0; i < count; i++) {
+        h = (h ^ lights[i]) * 0x9E3779B97F4A7C15llu;
     }
+    return size_t(h ^ (h >> 32u));
+}
+
+void Froxelizer::froxelizeAssignRecordsCompress(size_t lightCount) noexcept {
+
+    SYSTRACE_CALL();
+
+    // The records are bytes, unless some light indices don't fit in a byte.
+    bool const records16 = lightCount > MAX_RECORD8_LIGHT_COUNT;
+    size_t const recordCount = RECORD_BUFFER_SIZE / (records16 ? 2 : 1);
+
+    Slice<LightList> const lists(mFroxelLightLists);
+
+    auto sameLights = [](LightList const& lhs, LightList const& rhs) {
+        return lhs.count == rhs.count && (lhs.lights == rhs.lights ||
+                std::equal(lhs.lights, lhs.lights + lhs.count, rhs.lights));
+    };
 
     uint16_t offset = 0;
     FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
 
     const size_t froxelCountX = mFroxelCountX;
-    RecordBufferType* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
+    uint8_t* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
 
     // initialize the first record with all lights in the scene -- this will be used only if
     // we run out of record space.
-    const uint8_t allLightsCount = (uint8_t)std::min(size_t(255), allLights.count());
+    LightList const allLights{ mAllLights.data(), uint32_t(mAllLights.size()) };
+    const uint8_t allLightsCount = uint8_t(allLights.count);
     offset += allLightsCount;
-    allLights.forEachSetBit([point = froxelRecords, froxelRecords](size_t l) mutable {
-        // make sure to keep this code branch-less
-        const size_t word = l / LIGHT_PER_GROUP;
-        const size_t bit  = l % LIGHT_PER_GROUP;
-        l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-        *point = (RecordBufferType)l;
-        // we need to "cancel" the write operation if we have more than 255 spot or point lights
-        // (this is a limitation of the data type used to store the light counts per froxel)
-        point += (point - froxelRecords < 255) ? 1 : 0;
-    });
-
-    // how many froxel record entries were reused (for debugging)
-    UTILS_UNUSED size_t reused = 0;
-
-    for (size_t i = 0, c = mFroxelCount; i < c;) {
-        LightRecord b = records[i];
-        if (b.lights.none()) {
+    writeLightList(froxelRecords, 0, allLights.lights, allLights.count, records16);
+
+    // Light lists already written to the record buffer, indexed by their hash, so that
+    // froxels with the same lights share their records even when they're not adjacent.
+    Slice<RecordCacheEntry> cache(mRecordCache);
+    memset(cache.data(), 0, cache.sizeInBytes());
+
+    // Finds or writes a light list in the record buffer.
+    // Returns false if we're out of space.
+    auto assignRecord = [&cache, &offset, &sameLights, froxelRecords, recordCount, records16]
+            (LightList const& list, FroxelEntry* entry) -> bool {
+        RecordCacheEntry& cached =
+                cache[hashLights(list.lights, list.count) & (RECORD_CACHE_SIZE - 1)];
+        if (cached.list.lights && sameLights(cached.list, list)) {
+            entry->u32 = cached.entry;
+            return true;
+        }
+        if (UTILS_UNLIKELY(offset + list.count >= recordCount)) {
+            return false;
+        }
+        *entry = { offset, uint8_t(list.count), records16 };
+        writeLightList(froxelRecords, offset, list.lights, list.count, records16);
+        offset += list.count;
+        cached = { list, entry->u32 };
+        return true;
+    };
+
+    size_t i = 0;
+    for (size_t c = mFroxelCount; i < c;) {
+        LightList b = lists[i];
+        if (!b.count) {
             froxels[i++].u32 = 0;
             continue;
         }
 
-        // We have a limitation of 255 spot + 255 point lights per froxel.
         // note: initializer list for union cannot have more than one element
-        FroxelEntry entry{ offset, uint8_t(std::min(size_t(255), b.lights.count())) };
-        const size_t lightCount = entry.count();
-
-        if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
+        FroxelEntry entry{ 0, 0 };
+        if (UTILS_UNLIKELY(!assignRecord(b, &entry))) {
 #ifndef NDEBUG
             slog.d << "out of space: " << i << ", at " << offset << io::endl;
 #endif
-            // note: instead of dropping froxels we could look for similar records we've already
-            // filed up.
-            do {
-                froxels[i] = { 0u, allLightsCount };
-                if (records[i].lights.none()) {
-                    froxels[i].u32 = 0;
-                }
-            } while(++i < c);
-            goto out_of_memory;
+            break;
         }
 
-        // iterate the bitfield
-        auto * const beginPoint = froxelRecords + offset;
-        b.lights.forEachSetBit([point = beginPoint, beginPoint](size_t l) mutable {
-            // make sure to keep this code branch-less
-            const size_t word = l / LIGHT_PER_GROUP;
-            const size_t bit  = l % LIGHT_PER_GROUP;
-            l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-            *point = (RecordBufferType)l;
-            // we need to "cancel" the write operation if we have more than 255 spot or point lights
-            // (this is a limitation of the data type used to store the light counts per froxel)
-            point += (point - beginPoint < 255) ? 1 : 0;
-        });
-
-        offset += lightCount;
-
-#ifndef NDEBUG
-        if (lightCount) { reused--; }
-#endif
         do {
-#ifndef NDEBUG
-            if (lightCount) { reused++; }
-#endif
             froxels[i++].u32 = entry.u32;
             if (i >= c) break;
 
-            if (records[i].lights != b.lights && i >= froxelCountX) {
+            if (!sameLights(lists[i], b) && i >= froxelCountX) {
                 // if this froxel record doesn't match the previous one on its left,
                 // we re-try with the record above it, which saves many froxel records
                 // (north of 10% in practice).
-                b = records[i - froxelCountX];
+                b = lists[i - froxelCountX];
                 entry.u32 = froxels[i - froxelCountX].u32;
             }
-        } while(records[i].lights == b.lights);
+        } while (sameLights(lists[i], b));
+    }
+
+    if (UTILS_UNLIKELY(i < mFroxelCount)) {
+        // We ran out of space, the remaining froxels use the light list of their coarse tile,
+        // which contains all their lights (unless it has more than 255), at the cost of shading
+        // some lights needlessly.
+        Slice<uint32_t> tileEntries(mCoarseTileEntries);
+        constexpr uint32_t UNASSIGNED = std::numeric_limits<uint32_t>::max();
+        std::fill(tileEntries.begin(), tileEntries.end(), UNASSIGNED);
+
+        for (size_t c = mFroxelCount; i < c; i++) {
+            if (!lists[i].count) {
+                froxels[i].u32 = 0;
+                continue;
+            }
+            size_t const tile = getCoarseTileIndex(i);
+            if (tileEntries[tile] == UNASSIGNED) {
+                uint32_t const first = mTileLightOffsets[tile];
+                uint32_t const count = mTileLightOffsets[tile + 1] - first;
+                LightList const tileLights{ mTileLights.data() + first,
+                        uint32_t(std::min(MAX_FROXEL_LIGHT_COUNT, size_t(count))) };
+                FroxelEntry entry{ 0, allLightsCount, records16 };
+                // if even the coarse light list doesn't fit, we use the list of all lights.
+                assignRecord(tileLights, &entry);
+                tileEntries[tile] = entry.u32;
+            }
+            froxels[i].u32 = tileEntries[tile];
+        }
     }
-out_of_memory:
+
     // FIXME: on big-endian systems we need to change the endianness of the record buffer
-    ;
 }
 
 static inline float2 project(mat4f const& p, float3 const& v) noexcept {
@@ -745,72 +1156,82 @@ static inline float2 project(mat4f const& p, float3 const& v) noexcept {
     return float2{ x, y } * (1.0f / w);
 }
 
+/*
+ * The two kernels below don't have any control flow and work on SoA data, so that they're
+ * vectorized by the compiler, testing 4 (SSE, NEON) or 8 (AVX2) planes or froxels at once.
+ * Indices are 32 bits so they fit as many lanes as the floats.
+ */
+
+// Tests sphere s (radius squared) against the planes [begin + offset, end + offset), which go
+// through the origin, and grows the range [*bx, *ex] with the indices of those intersected.
+UTILS_ALWAYS_INLINE
+inline void Froxelizer::spherePlanesIntersectionRange(
+        uint32_t* UTILS_RESTRICT bx, uint32_t* UTILS_RESTRICT ex,
+        float4 const& s, PlaneNormals const& planes,
+        uint32_t begin, uint32_t end, uint32_t offset) noexcept {
+    float const* const UTILS_RESTRICT nx = planes.x + offset;
+    float const* const UTILS_RESTRICT ny = planes.y + offset;
+    float const* const UTILS_RESTRICT nz = planes.z + offset;
+    uint32_t b = *bx;
+    uint32_t e = *ex;
+    for (uint32_t i = begin; i < end; i++) {
+        // this is spherePlaneIntersection(s, plane).w > 0, with plane.w == 0
+        float const d = s.x * nx[i] + s.y * ny[i] + s.z * nz[i];
+        // all ones if the plane is intersected, 0 otherwise
+        uint32_t const mask = -uint32_t(d * d < s.w);
+        b = std::min(b, i | ~mask);
+        e = std::max(e, i & mask);
+    }
+    *bx = b;
+    *ex = e;
+}
+
+// Tests the spotlight against the bounding spheres of the froxels [first, first + count)
+// and sets the light's bit in each froxel intersecting it.
+UTILS_ALWAYS_INLINE
+inline void Froxelizer::spheresConeIntersection(
+        LightGroupType* UTILS_RESTRICT froxels, BoundingSpheres const& spheres,
+        size_t first, size_t count, size_t bit, LightParams const& light) noexcept {
+    float const* const UTILS_RESTRICT sx = spheres.x + first;
+    float const* const UTILS_RESTRICT sy = spheres.y + first;
+    float const* const UTILS_RESTRICT sz = spheres.z + first;
+    float const* const UTILS_RESTRICT sr = spheres.r + first;
+    float3 const position = light.position;
+    float3 const axis = light.axis;
+    float const invSin = light.invSin;
+    float const cosSqr = light.cosSqr;
+    for (size_t i = 0; i < count; i++) {
+        bool const intersect = sphereConeIntersectionFast(
+                float4{ sx[i], sy[i], sz[i], sr[i] }, position, axis, invSin, cosSqr);
+        froxels[i] |= LightGroupType(intersect) << bit;
+    }
+}
+
 void Froxelizer::froxelizePointAndSpotLight(
-        FroxelThreadData& froxelThread, size_t bit,
+        LightGroupType* UTILS_RESTRICT froxels, size_t bit,
         mat4f const& UTILS_RESTRICT p,
-        const Froxelizer::LightParams& UTILS_RESTRICT light) const noexcept {
-
-    if (UTILS_UNLIKELY(light.position.z + light.radius < -mZLightFar)) { // z values are negative
-        // This light is fully behind LightFar, it doesn't light anything
-        // (we could avoid this check if we culled lights using LightFar instead of the
-        // culling camera's far plane)
+        const Froxelizer::LightParams& UTILS_RESTRICT light,
+        FroxelRange const& range) const noexcept {
+
+    // only the froxels in both the light's range and the requested range are processed
+    const size_t x0 = std::max(light.froxels.x0, range.x0);
+    const size_t x1 = std::min(light.froxels.x1, range.x1);
+    const size_t y0 = std::max(light.froxels.y0, range.y0);
+    const size_t y1 = std::min(light.froxels.y1, range.y1);
+    const size_t z0 = std::max(light.froxels.z0, range.z0);
+    const size_t z1 = std::min(light.froxels.z1, range.z1);
+    if (x0 > x1 || y0 > y1 || z0 > z1) {
         return;
     }
 
     // the code below works with radius^2
     const float4 s = { light.position, light.radius * light.radius };
 
-#ifdef DEBUG_FROXEL
-    const size_t x0 = 0;
-    const size_t x1 = mFroxelCountX - 1;
-    const size_t y0 = 0;
-    const size_t y1 = mFroxelCountY - 1;
-    const size_t z0 = 0;
-    const size_t z1 = mFroxelCountZ - 1;
-#else
-    // find a reasonable bounding-box in froxel space for the sphere by projecting
-    // its (clipped) bounding-box to clip-space and converting to froxel indices.
-    Box const aabb = { light.position, light.radius };
-    const float znear = std::min(-mNear, aabb.center.z + aabb.halfExtent.z); // z values are negative
-    const float zfar  =                  aabb.center.z - aabb.halfExtent.z;
-
-    // TODO: we need to investigate if doing all this actually saves time
-    //       e.g.: we could only do the z-min/max which is much easier to compute.
-
-    const float2 pts[8] = {
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{ 1, 1 }, znear }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{ 1,-1 }, znear }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{-1, 1 }, znear }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{-1,-1 }, znear }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{ 1, 1 }, zfar  }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{ 1,-1 }, zfar  }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{-1, 1 }, zfar  }),
-        project(p, { aabb.center.xy + aabb.halfExtent.xy * float2{-1,-1 }, zfar  }),
-    };
-
-    float2 pmin = std::numeric_limits<float>::max();
-    float2 pmax = 0;
-    for (auto pt: pts) {
-        pmin = min(pmin, pt);
-        pmax = max(pmax, pt);
-    }
-
-    const auto [x0, y0] = clipToIndices(pmin);
-    const size_t z0 = findSliceZ(znear);
-
-    const auto [x1, y1] = clipToIndices(pmax);
-    const size_t z1 = findSliceZ(zfar);
-
-    assert_invariant(x0 <= x1);
-    assert_invariant(y0 <= y1);
-    assert_invariant(z0 <= z1);
-#endif
-
     const size_t zcenter = findSliceZ(s.z);
-    float4 const * const UTILS_RESTRICT planesX = mPlanesX;
     float4 const * const UTILS_RESTRICT planesY = mPlanesY;
     float const * const UTILS_RESTRICT planesZ = mDistancesZ;
-    float4 const * const UTILS_RESTRICT boundingSpheres = mBoundingSpheres;
+    PlaneNormals const planeNormalsX = mPlaneNormalsX;
+    BoundingSpheres const boundingSpheres = mBoundingSpheres;
     for (size_t iz = z0 ; iz <= z1; ++iz) {
         float4 cz(s);
         // froxel that contain the center of the sphere is special, we don't even need to do the
@@ -838,27 +1259,23 @@ void Froxelizer::froxelizePointAndSpotLight(
                 if (cy.w > 0) {
                     // The reduced sphere from the previous stage intersects this horizontal plane,
                     // and we now have new smaller sphere centered on these two previous planes
-                    size_t bx = std::numeric_limits<size_t>::max(); // horizontal begin index
-                    size_t ex = 0; // horizontal end index
-
-                    // find the "begin" index (left side)
-                    for (size_t ix = x0; ix < x1 + 1; ++ix) {
-                        // The froxel that contains the center of the sphere is special,
-                        // we don't even need to do the intersection check, it's always true.
-                        if (UTILS_LIKELY(ix != xcenter)) {
-                            float4 const& plane = ix < xcenter ? planesX[ix + 1] : planesX[ix];
-                            if (spherePlaneIntersection(cy, plane).w > 0) {
-                                // The reduced sphere from the previous stage intersects this
-                                // vertical plane, we record the min/max froxel indices
-                                bx = std::min(bx, ix);
-                                ex = std::max(ex, ix);
-                            }
-                        } else {
-                            // this is the froxel containing the center of the sphere, it is
-                            // definitely participating
-                            bx = std::min(bx, ix);
-                            ex = std::max(ex, ix);
-                        }
+                    uint32_t bx = std::numeric_limits<uint32_t>::max(); // horizontal begin index
+                    uint32_t ex = 0; // horizontal end index
+
+                    // Froxels left of the center are tested against their right plane, froxels
+                    // right of the center against their left plane.
+                    uint32_t const xl = uint32_t(std::min(xcenter, x1 + 1));
+                    uint32_t const xr = uint32_t(std::max(xcenter + 1, x0));
+                    spherePlanesIntersectionRange(&bx, &ex, cy, planeNormalsX,
+                            uint32_t(x0), xl, 1);
+                    spherePlanesIntersectionRange(&bx, &ex, cy, planeNormalsX,
+                            xr, uint32_t(x1 + 1), 0);
+
+                    // The froxel that contains the center of the sphere is special,
+                    // we don't even need to do the intersection check, it's always true.
+                    if (UTILS_LIKELY(xcenter >= x0 && xcenter <= x1)) {
+                        bx = std::min(bx, uint32_t(xcenter));
+                        ex = std::max(ex, uint32_t(xcenter));
                     }
 
                     if (UTILS_UNLIKELY(bx > ex)) {
@@ -872,17 +1289,12 @@ void Froxelizer::froxelizePointAndSpotLight(
                     size_t fi = getFroxelIndex(bx, iy, iz);
                     if (light.invSin != std::numeric_limits<float>::infinity()) {
                         // This is a spotlight (common case)
-                        // this loops gets vectorized (on arm64) w/ clang
-                        while (bx++ != ex) {
-                            // see if this froxel intersects the cone
-                            bool const intersect = sphereConeIntersectionFast(boundingSpheres[fi],
-                                    light.position, light.axis, light.invSin, light.cosSqr);
-                            froxelThread[fi++] |= LightGroupType(intersect) << bit;
-                        }
+                        spheresConeIntersection(froxels + fi, boundingSpheres,
+                                fi, ex - bx, bit, light);
                     } else {
                         // this loops gets vectorized (on arm64) w/ clang
                         while (bx++ != ex) {
-                            froxelThread[fi++] |= LightGroupType(1) << bit;
+                            froxels[fi++] |= LightGroupType(1) << bit;
                         }
                     }
                 }
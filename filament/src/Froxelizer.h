@@ -27,12 +27,16 @@
 #include <backend/Handle.h>
 
 #include <utils/compiler.h>
-#include <utils/bitset.h>
 #include <utils/Slice.h>
 
 #include <math/mat4.h>
 #include <math/vec4.h>
 
+#include <vector>
+
+// for gtest
+class FilamentTest_FroxelDataSkip_Test;
+
 namespace filament {
 
 // Max number of froxels limited by:
@@ -57,10 +61,10 @@ public:
 };
 
 //
-// Light UBO           Froxel Record UBO      per-froxel light list texture
-// {4 x float4}            {index into        RG_U16 {offset, point-count, spot-count}
-// (spot/point            light texture}
-//                     {uint4 -> 16 indices}
+// Light UBO           Froxel Record UBO      per-froxel light list UBO
+// {4 x float4}            {index into        U32 {offset, flags, count}
+// (spot/point             lights}
+//                     {uint4 -> 16 or 8 indices}
 //
 //  +----+                     +-+                     +----+
 // 0|....| <------------+     0| |         +-----------|0230| (e.g. offset=02, 3-lights)
@@ -76,7 +80,22 @@ public:
 //  |....|                                          h = num froxels
 //  |....|
 //  +----+
-// 256 lights max
+// 256 lights, the others are in the lights texture
+//
+// The first CONFIG_MAX_LIGHT_UNIFORM_COUNT lights are in the light UBO, the others in the per-view
+// lights texture, up to CONFIG_MAX_LIGHT_COUNT lights. FView::prepareVisibleLights() keeps the
+// nearest lights and drops the others. The records are 8-bit light indices, or 16-bit ones when
+// there are more than 256 lights, which the froxels indicate with FroxelEntry::RECORDS_16_BITS.
+//
+// The lights are first binned into coarse tiles (a block of froxels in a z-slice) using their
+// bounds, then each froxel is only tested against the lights of its tile, so that the cost scales
+// with the number of lights each froxel sees rather than with the total number of lights.
+// A froxel's light list has the (at most 255) nearest lights that intersect it.
+//
+// Froxels with identical light lists share the same records, even when they're not adjacent.
+// When the record buffer runs out of space, the remaining froxels use the light list of their
+// coarse tile, which is a superset of their own. Only when that doesn't fit either do they fall
+// back to the list of all lights.
 //
 
 class Froxelizer {
@@ -102,6 +121,7 @@ public:
      * Allocate per-frame data structures for froxelization.
      *
      * driverApi         used to allocate memory in the stream
+     * js                used to update the froxels bounding spheres in parallel
      * arena             used to allocate per-frame memory
      * viewport          used to calculate froxel dimensions
      * projection        camera projection matrix
@@ -110,7 +130,8 @@ public:
      *
      * return true if updateUniforms() needs to be called
      */
-    bool prepare(backend::DriverApi& driverApi, ArenaScope& arena, Viewport const& viewport,
+    bool prepare(backend::DriverApi& driverApi, utils::JobSystem& js, ArenaScope& arena,
+            Viewport const& viewport,
             const math::mat4f& projection, float projectionNear, float projectionFar) noexcept;
 
     Froxel getFroxelAt(size_t x, size_t y, size_t z) const noexcept;
@@ -121,7 +142,17 @@ public:
 
     float getLightFar() const noexcept { return mZLightFar; }
 
+    // Computes the bounds of the froxels each point and spot light can affect: the clip-space
+    // rectangle and view-space z range of its bounding sphere (which, for spotlights, only
+    // encloses the cone). This must be called on the lights given to froxelizeLights(), once
+    // they're culled and sorted.
+    static void computeLightBounds(FLightManager const& lcm,
+            math::mat4f const& viewMatrix, math::mat4f const& projection, float near,
+            FScene::LightSoa& lightData) noexcept;
+
     // update Records and Froxels texture with lights data. this is thread-safe.
+    // When the froxels, the view matrix and the lights are unchanged since the last commit(),
+    // the assignment is skipped and the next commit() won't upload anything.
     void froxelizeLights(FEngine& engine, math::mat4f const& viewMatrix,
             const FScene::LightSoa& lightData) noexcept;
 
@@ -131,7 +162,7 @@ public:
         s.froxelCountXY = math::float2{ mViewport.width, mViewport.height } / mFroxelDimension;
     }
 
-    // send froxel data to GPU
+    // send froxel data to GPU, if it changed
     void commit(backend::DriverApi& driverApi);
 
 
@@ -140,31 +171,69 @@ public:
      */
 
     struct FroxelEntry {
-        inline FroxelEntry(uint16_t offset, uint8_t count) noexcept
-            : u32((offset << 16) | count) { }
+        // the records of this froxel are 16-bit light indices, instead of 8-bit
+        static constexpr uint32_t RECORDS_16_BITS = 0x100u;
+        inline FroxelEntry(uint16_t offset, uint8_t count, bool records16 = false) noexcept
+            : u32((offset << 16) | (records16 ? RECORDS_16_BITS : 0u) | count) { }
         inline uint8_t count() const noexcept { return u32 & 0xFFu; }
         inline uint16_t offset() const noexcept { return u32 >> 16u; }
+        inline bool hasRecords16() const noexcept { return u32 & RECORDS_16_BITS; }
         uint32_t u32 = 0;
     };
 
-    // we can't change this easily because the shader expects 16 indices per uint4
-    using RecordBufferType = uint8_t;
+    // light indices in the light lists, they're written as 8-bit records when they all fit
+    using RecordBufferType = uint16_t;
 
     const utils::Slice<FroxelEntry>& getFroxelBufferUser() const { return mFroxelBufferUser; }
-    const utils::Slice<RecordBufferType>& getRecordBufferUser() const { return mRecordBufferUser; }
+    const utils::Slice<uint8_t>& getRecordBufferUser() const { return mRecordBufferUser; }
+
+    // returns the i-th light index of the froxel entry
+    size_t getLightIndex(FroxelEntry entry, size_t i) const noexcept;
 
     // this is chosen so froxelizePointAndSpotLight() vectorizes 4 froxel tests / spotlight
-    // with 256 lights this implies 8 jobs (256 / 32) for froxelization.
+    // a coarse tile's lights are tested 32 at a time.
     using LightGroupType = uint32_t;
 
 private:
+    friend class ::FilamentTest_FroxelDataSkip_Test;
+
     size_t getFroxelBufferEntryCount() const noexcept {
         return mFroxelBufferEntryCount;
     }
 
-    struct LightRecord {
-        using bitset = utils::bitset<uint64_t, (CONFIG_MAX_LIGHT_COUNT + 63) / 64>;
-        bitset lights;
+    // a light list, sorted by light index, i.e. from the nearest light to the farthest
+    struct LightList {
+        RecordBufferType const* lights = nullptr;
+        uint32_t count = 0;
+    };
+
+    // froxel indices along each axis, inclusive
+    struct FroxelRange {
+        uint16_t x0, y0, z0;
+        uint16_t x1, y1, z1;
+    };
+
+    // Froxels bounding spheres and vertical planes are stored as SoA, so that the intersection
+    // tests in froxelizePointAndSpotLight() process 4 (SSE, NEON) or 8 (AVX2) froxels or planes
+    // per iteration.
+    struct BoundingSpheres {
+        float* x = nullptr;
+        float* y = nullptr;
+        float* z = nullptr;
+        float* r = nullptr;
+    };
+
+    // normals of planes going through the origin (i.e. w == 0)
+    struct PlaneNormals {
+        float* x = nullptr;
+        float* y = nullptr;
+        float* z = nullptr;
+    };
+
+    // a light list already written in the record buffer
+    struct RecordCacheEntry {
+        LightList list;             // light list, list.lights is nullptr if this entry is unused
+        uint32_t entry;             // FroxelEntry pointing to the light list
     };
 
     struct LightParams {
@@ -173,8 +242,10 @@ private:
         math::float3 axis;
         // this must be initialized to indicate this is a point light
         float invSin = std::numeric_limits<float>::infinity();
-        // radius is not used in the hot loop, so leave it at the end
+        // radius and bounds are not used in the hot loop, so leave them at the end
         float radius;
+        FroxelRange froxels;        // froxels in the light's bounds, see computeLightBounds()
+        bool visible;               // false if the light doesn't light any froxel
     };
 
     struct LightTreeNode {
@@ -189,31 +260,62 @@ private:
         uint16_t reserved;
     };
 
-    struct FroxelThreadData;
-
     inline void setViewport(Viewport const& viewport) noexcept;
     inline void setProjection(const math::mat4f& projection, float near, float far) noexcept;
-    bool update() noexcept;
+    bool update(utils::JobSystem& js) noexcept;
 
     void froxelizeLoop(FEngine& engine,
             math::mat4f const& viewMatrix, const FScene::LightSoa& lightData) noexcept;
 
-    void froxelizeAssignRecordsCompress() noexcept;
+    // bins the lights into the coarse tiles they may intersect
+    void binLights() noexcept;
+
+    // computes the light list of each froxel of the z-slices [z0, z1)
+    void froxelizeSlices(size_t z0, size_t z1) noexcept;
+
+    void froxelizeAssignRecordsCompress(size_t lightCount) noexcept;
+
+    // writes the light data the froxels depend on into key
+    static void getLightKey(FLightManager const& lcm,
+            const FScene::LightSoa& lightData, std::vector<float>& key) noexcept;
+
+    size_t getCoarseTileIndex(size_t froxelIndex) const noexcept;
+
+    // returns the froxels of a coarse tile, which is a single z-slice
+    FroxelRange getCoarseTileRange(size_t tileIndex) const noexcept;
+
+    void froxelizePointAndSpotLight(LightGroupType* froxels, size_t bit,
+            math::mat4f const& projection, const LightParams& light,
+            FroxelRange const& range) const noexcept;
 
-    void froxelizePointAndSpotLight(FroxelThreadData& froxelThread, size_t bit,
-            math::mat4f const& projection, const LightParams& light) const noexcept;
+    static void spherePlanesIntersectionRange(
+            uint32_t* UTILS_RESTRICT bx, uint32_t* UTILS_RESTRICT ex,
+            math::float4 const& s, PlaneNormals const& planes,
+            uint32_t begin, uint32_t end, uint32_t offset) noexcept;
+
+    static void spheresConeIntersection(
+            LightGroupType* UTILS_RESTRICT froxels, BoundingSpheres const& spheres,
+            size_t first, size_t count, size_t bit, LightParams const& light) noexcept;
 
     static void computeLightTree(LightTreeNode* lightTree,
             utils::Slice<RecordBufferType> const& lightList,
             const FScene::LightSoa& lightData, size_t lightRecordsOffset) noexcept;
 
-    static void updateBoundingSpheres(
-            math::float4* UTILS_RESTRICT boundingSpheres,
+    static void updateBoundingSpheres(utils::JobSystem& js,
+            BoundingSpheres const& boundingSpheres,
             size_t froxelCountX, size_t froxelCountY, size_t froxelCountZ,
             math::float4 const* UTILS_RESTRICT planesX,
             math::float4 const* UTILS_RESTRICT planesY,
             float const* UTILS_RESTRICT planesZ) noexcept;
 
+    // updates the bounding spheres of the z-slices [z0, z1)
+    static void updateBoundingSpheresSlices(
+            BoundingSpheres const& boundingSpheres,
+            size_t froxelCountX, size_t froxelCountY, size_t z0, size_t z1,
+            math::float4 const* UTILS_RESTRICT planesX,
+            math::float4 const* UTILS_RESTRICT planesY,
+            float const* UTILS_RESTRICT planesZ) noexcept;
+
     static size_t getFroxelIndex(size_t ix, size_t iy, size_t iz,
             size_t froxelCountX, size_t froxelCountY) noexcept {
         return ix + (iy * froxelCountX) + (iz * froxelCountX * froxelCountY);
@@ -241,20 +343,34 @@ private:
     float* mDistancesZ = nullptr;
     math::float4* mPlanesX = nullptr;
     math::float4* mPlanesY = nullptr;
-    math::float4* mBoundingSpheres = nullptr;           // 128 KiB w/ 8192 froxels
+    PlaneNormals mPlaneNormalsX;
+    BoundingSpheres mBoundingSpheres;                   // 128 KiB w/ 8192 froxels
 
     // allocations in the per frame arena
-    utils::Slice<FroxelThreadData> mFroxelShardedData;  // 256 KiB w/  256 lights and 8192 froxels
     utils::Slice<FroxelEntry> mFroxelBufferUser;        //  32 KiB w/ 8192 froxels
-    utils::Slice<LightRecord> mLightRecords;            // 256 KiB w/  256 lights
+    utils::Slice<LightGroupType> mFroxelLightBits;      //  32 KiB w/ 8192 froxels
+    utils::Slice<LightList> mFroxelLightLists;          // 128 KiB w/ 8192 froxels
+    utils::Slice<uint32_t> mCoarseTileEntries;          //  ~3 KiB w/ 8192 froxels
+    utils::Slice<RecordCacheEntry> mRecordCache;        //   8 KiB
 
     // allocations in the command stream
-    utils::Slice<RecordBufferType> mRecordBufferUser;   //  16 KiB
+    utils::Slice<uint8_t> mRecordBufferUser;            //  16 KiB
+
+    // per-frame data whose size depends on the lights, the storage is kept across frames
+    std::vector<LightParams> mLightParams;              // light parameters in view space
+    std::vector<uint32_t> mTileLightOffsets;            // offset of each tile's lights
+    std::vector<RecordBufferType> mTileLights;          // lights of each coarse tile
+    std::vector<uint32_t> mTileListOffsets;             // offset of each tile's froxel lists
+    std::vector<RecordBufferType> mFroxelLights;        // light lists of each froxel
+    std::vector<RecordBufferType> mAllLights;           // the (at most 255) nearest lights
 
     uint16_t mFroxelCountX = 0;
     uint16_t mFroxelCountY = 0;
     uint16_t mFroxelCountZ = 0;
     uint32_t mFroxelCount = 0;
+    uint16_t mCoarseTileCountX = 0;
+    uint16_t mCoarseTileCountY = 0;
+    uint32_t mCoarseTileCount = 0;
     math::uint2 mFroxelDimension = {};
 
     math::mat4f mProjection;
@@ -272,6 +388,15 @@ private:
     float mZLightNear;
     float mZLightFar;
 
+    // state of the froxel data last uploaded to the GPU, used to skip the froxelization
+    // and the uploads when nothing changed.
+    math::mat4f mCommittedViewMatrix;
+    math::mat4f mPendingViewMatrix;
+    std::vector<float> mCommittedLightKey;
+    std::vector<float> mPendingLightKey;
+    bool mCommittedDataValid = false;
+    bool mFroxelDataUnchanged = false;
+
     // track if we need to update our internal state before froxelizing
     uint8_t mDirtyFlags = 0;
     enum {
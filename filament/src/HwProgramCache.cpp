@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwProgramCache.h"
+
+#include <utils/CString.h>
+#include <utils/debug.h>
+
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+namespace {
+
+template<typename T>
+void append(std::vector<char>& data, T const& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto const* const p = reinterpret_cast<char const*>(&value);
+    data.insert(data.end(), p, p + sizeof(value));
+}
+
+void append(std::vector<char>& data, void const* bytes, size_t size) {
+    // the size comes first, so that consecutive fields can't be confused
+    append(data, uint64_t(size));
+    auto const* const p = static_cast<char const*>(bytes);
+    data.insert(data.end(), p, p + size);
+}
+
+void append(std::vector<char>& data, CString const& s) {
+    append(data, s.c_str_safe(), s.size());
+}
+
+} // anonymous namespace
+
+HwProgramCache::HwProgramCache() {
+    mPrograms.reserve(256);
+    mKeys.reserve(256);
+}
+
+HwProgramCache::~HwProgramCache() noexcept = default;
+
+void HwProgramCache::terminate(DriverApi&) noexcept {
+    assert_invariant(mPrograms.empty());
+    assert_invariant(mKeys.empty());
+}
+
+std::vector<char> HwProgramCache::getKeyData(Program const& program) {
+    // Everything that Program gives to the backend, except the name and cache id which are
+    // only used for diagnostics and the blob cache.
+    std::vector<char> data;
+
+    auto const& shaders = program.getShadersSource();
+    size_t shadersSize = 0;
+    for (auto const& shader : shaders) {
+        shadersSize += shader.size();
+    }
+    data.reserve(shadersSize + 1024);
+    for (auto const& shader : shaders) {
+        append(data, shader.data(), shader.size());
+    }
+
+    for (auto const& name : program.getUniformBlockBindings()) {
+        append(data, name);
+    }
+
+    for (auto const& group : program.getSamplerGroupInfo()) {
+        append(data, group.stageFlags);
+        append(data, uint64_t(group.samplers.size()));
+        for (auto const& sampler : group.samplers) {
+            append(data, sampler.name);
+            append(data, sampler.binding);
+        }
+    }
+
+    append(data, uint64_t(program.getSpecializationConstants().size()));
+    for (auto const& constant : program.getSpecializationConstants()) {
+        append(data, constant.id);
+        append(data, uint64_t(constant.value.index()));
+        std::visit([&data](auto value) { append(data, value); }, constant.value);
+    }
+
+    // only used with ESSL 1.0
+    for (auto const& uniforms : program.getBindingUniformInfo()) {
+        append(data, uint64_t(uniforms.size()));
+        for (auto const& uniform : uniforms) {
+            append(data, uniform.name);
+            append(data, uniform.offset);
+            append(data, uniform.size);
+            append(data, uniform.type);
+        }
+    }
+    append(data, uint64_t(program.getAttributes().size()));
+    for (auto const& [name, location] : program.getAttributes()) {
+        append(data, name);
+        append(data, location);
+    }
+
+    return data;
+}
+
+ProgramHandle HwProgramCache::create(DriverApi& driver, Program&& program) noexcept {
+    std::vector<char> data = getKeyData(program);
+    std::string_view const view{ data.data(), data.size() };
+    Key const key{ std::hash<std::string_view>{}(view), view };
+
+    // see if we already have an identical program
+    auto pos = mPrograms.find(key);
+
+    // the common case is that we've never seen it
+    if (UTILS_LIKELY(pos == mPrograms.end())) {
+        ProgramHandle const handle = driver.createProgram(std::move(program));
+        // the key's view stays valid, because moving data keeps its buffer
+        mPrograms.insert({ key, { handle, 1, std::move(data) }});
+        mKeys.insert({ handle.getId(), key });
+        return handle;
+    }
+    pos.value().refs++;
+    return pos->second.handle;
+}
+
+void HwProgramCache::destroy(DriverApi& driver, ProgramHandle ph) noexcept {
+    if (!ph) {
+        return;
+    }
+
+    // look for this handle in our map, it must be there
+    auto pos = mKeys.find(ph.getId());
+    assert_invariant(pos != mKeys.end());
+
+    // check the refcount and destroy if needed
+    auto ipos = mPrograms.find(pos->second);
+    assert_invariant(ipos != mPrograms.end());
+    if (--ipos.value().refs == 0) {
+        mPrograms.erase(ipos);
+        mKeys.erase(pos);
+        driver.destroyProgram(ph);
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_HWPROGRAMCACHE_H
+#define TNT_FILAMENT_HWPROGRAMCACHE_H
+
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <private/backend/DriverApi.h>
+
+#include <tsl/robin_map.h>
+
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// for gtest
+class FilamentTest_HwProgramCache_Test;
+
+namespace filament {
+
+/*
+ * HwProgramCache shares the backend programs between the materials that produce identical
+ * programs, i.e. the same shaders, specialization constants and bindings. This is typically the
+ * case of materials built from the same template, that only differ by their parameters.
+ *
+ * The programs are reference counted, create() and destroy() must be balanced.
+ */
+class HwProgramCache {
+public:
+
+    HwProgramCache();
+    ~HwProgramCache() noexcept;
+
+    HwProgramCache(HwProgramCache const& rhs) = delete;
+    HwProgramCache(HwProgramCache&& rhs) noexcept = delete;
+    HwProgramCache& operator=(HwProgramCache const& rhs) = delete;
+    HwProgramCache& operator=(HwProgramCache&& rhs) noexcept = delete;
+
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // Returns the program identical to this one if there is one, or creates it.
+    backend::ProgramHandle create(backend::DriverApi& driver, backend::Program&& program) noexcept;
+
+    // Releases a program returned by create(), it is destroyed when it's no longer used.
+    // ph can be null.
+    void destroy(backend::DriverApi& driver, backend::ProgramHandle ph) noexcept;
+
+private:
+    friend class ::FilamentTest_HwProgramCache_Test;
+
+    // Programs are identified by all of their data, so that a hash collision can't make two
+    // different programs share a backend program.
+    struct Key {
+        size_t hash;
+        std::string_view data;  // see getKeyData(), owned by the program's Entry
+        bool operator==(Key const& rhs) const noexcept {
+            return hash == rhs.hash && data == rhs.data;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(Key const& key) const noexcept { return key.hash; }
+    };
+
+    struct Entry {
+        backend::ProgramHandle handle;
+        uint32_t refs;
+        std::vector<char> data;
+    };
+
+    // Serializes everything that identifies a program.
+    static std::vector<char> getKeyData(backend::Program const& program);
+
+    // programs by key
+    tsl::robin_map<Key, Entry, KeyHash> mPrograms;
+
+    // keys by program
+    tsl::robin_map<backend::ProgramHandle::HandleId, Key> mKeys;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_HWPROGRAMCACHE_H
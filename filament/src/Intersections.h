@@ -57,8 +57,8 @@ inline constexpr bool sphereConeIntersectionFast(
     math::float3 const d = sphere.xyz - u;
     float const e = dot(coneAxis, d);
     float const dd = dot(d, d);
-    // we do the e>0 last here to avoid a branch
-    return (e * e >= dd * coneCosSquared && e > 0);
+    // use & instead of && to avoid a branch, so loops calling this can be vectorized
+    return (e * e >= dd * coneCosSquared) & (e > 0);
 }
 
 inline constexpr bool sphereConeIntersection(
@@ -94,6 +94,45 @@ float LightManager::getIntensity(Instance i) const noexcept {
     return downcast(this)->getIntensity(i);
 }
 
+void LightManager::setPositions(Instance const* instances,
+        float3 const* positions, size_t count) noexcept {
+    downcast(this)->setLocalPositions(instances, positions, count);
+}
+
+void LightManager::setPositions(Instance first, float3 const* positions, size_t count) noexcept {
+    downcast(this)->setLocalPositions(first, positions, count);
+}
+
+void LightManager::setDirections(Instance const* instances,
+        float3 const* directions, size_t count) noexcept {
+    downcast(this)->setLocalDirections(instances, directions, count);
+}
+
+void LightManager::setDirections(Instance first, float3 const* directions, size_t count) noexcept {
+    downcast(this)->setLocalDirections(first, directions, count);
+}
+
+void LightManager::setColors(Instance const* instances,
+        LinearColor const* colors, size_t count) noexcept {
+    downcast(this)->setColors(instances, colors, count);
+}
+
+void LightManager::setColors(Instance first, LinearColor const* colors, size_t count) noexcept {
+    downcast(this)->setColors(first, colors, count);
+}
+
+void LightManager::setIntensities(Instance const* instances,
+        float const* intensities, size_t count) noexcept {
+    downcast(this)->setIntensities(instances, intensities, count,
+            FLightManager::IntensityUnit::LUMEN_LUX);
+}
+
+void LightManager::setIntensities(Instance first,
+        float const* intensities, size_t count) noexcept {
+    downcast(this)->setIntensities(first, intensities, count,
+            FLightManager::IntensityUnit::LUMEN_LUX);
+}
+
 void LightManager::setFalloff(Instance i, float radius) noexcept {
     downcast(this)->setFalloff(i, radius);
 }
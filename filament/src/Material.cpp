@@ -24,6 +24,11 @@ MaterialInstance* Material::createInstance(const char* name) const noexcept {
     return downcast(this)->createInstance(name);
 }
 
+void Material::createInstances(MaterialInstance** instances, size_t count,
+        const char* name) const noexcept {
+    downcast(this)->createInstances(instances, count, name);
+}
+
 const char* Material::getName() const noexcept {
     return downcast(this)->getName().c_str_safe();
 }
@@ -44,8 +44,31 @@ namespace filament {
 
 // ------------------------------------------------------------------------------------------------
 
-MaterialParser::MaterialParserDetails::MaterialParserDetails(ShaderLanguage language, const void* data, size_t size)
-        : mManagedBuffer(data, size),
+MaterialParser::MaterialParserDetails::ManagedBuffer::ManagedBuffer(const void* start, size_t size,
+        ReleaseCallback releaseCallback, void* user)
+        : mPackage(start), mSize(size), mReleaseCallback(releaseCallback), mUser(user) {
+    // The package is read in place when possible. Its dictionaries' entries need to be 8-byte
+    // aligned in memory, so a misaligned package is copied.
+    if (releaseCallback && (uintptr_t(start) % 8) == 0) {
+        mStart = const_cast<void*>(start);
+    } else {
+        mStart = malloc(size);
+        memcpy(mStart, start, size);
+    }
+}
+
+MaterialParser::MaterialParserDetails::ManagedBuffer::~ManagedBuffer() noexcept {
+    if (mStart != mPackage) {
+        free(mStart);
+    }
+    if (mReleaseCallback) {
+        mReleaseCallback(mPackage, mSize, mUser);
+    }
+}
+
+MaterialParser::MaterialParserDetails::MaterialParserDetails(ShaderLanguage language,
+        const void* data, size_t size, ReleaseCallback releaseCallback, void* user)
+        : mManagedBuffer(data, size, releaseCallback, user),
           mChunkContainer(mManagedBuffer.data(), mManagedBuffer.size()),
           mMaterialChunk(mChunkContainer) {
     switch (language) {
@@ -83,8 +106,9 @@ bool MaterialParser::MaterialParserDetails::getFromSimpleChunk(
 
 // ------------------------------------------------------------------------------------------------
 
-MaterialParser::MaterialParser(ShaderLanguage language, const void* data, size_t size)
-        : mImpl(language, data, size) {
+MaterialParser::MaterialParser(ShaderLanguage language, const void* data, size_t size,
+        ReleaseCallback releaseCallback, void* user)
+        : mImpl(language, data, size, releaseCallback, user) {
 }
 
 ChunkContainer& MaterialParser::getChunkContainer() noexcept {
@@ -101,13 +125,11 @@ MaterialParser::ParseResult MaterialParser::parse() noexcept {
         return ParseResult::ERROR_OTHER;
     }
     const ChunkType matTag = mImpl.mMaterialTag;
-    const ChunkType dictTag = mImpl.mDictionaryTag;
+    const ChunkType dictTag = DictionaryReader::getDictionaryTag(cc, mImpl.mDictionaryTag);
+    mImpl.mDictionaryTag = dictTag;
     if (UTILS_UNLIKELY(!cc.hasChunk(matTag) || !cc.hasChunk(dictTag))) {
         return ParseResult::ERROR_MISSING_BACKEND;
     }
-    if (UTILS_UNLIKELY(!DictionaryReader::unflatten(cc, dictTag, mImpl.mBlobDictionary))) {
-        return ParseResult::ERROR_OTHER;
-    }
     if (UTILS_UNLIKELY(!mImpl.mMaterialChunk.initialize(matTag))) {
         return ParseResult::ERROR_OTHER;
     }
@@ -345,8 +367,14 @@ bool MaterialParser::getReflectionMode(ReflectionMode* value) const noexcept {
 
 bool MaterialParser::getShader(ShaderContent& shader,
         ShaderModel shaderModel, Variant variant, ShaderStage stage) noexcept {
+    if (UTILS_UNLIKELY(!mImpl.mDictionaryInitialized)) {
+        if (!mImpl.mDictionary.initialize(mImpl.mChunkContainer, mImpl.mDictionaryTag)) {
+            return false;
+        }
+        mImpl.mDictionaryInitialized = true;
+    }
     return mImpl.mMaterialChunk.getShader(shader,
-            mImpl.mBlobDictionary, shaderModel, variant, stage);
+            mImpl.mDictionary, shaderModel, variant, stage);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 #define TNT_FILAMENT_MATERIALPARSER_H
 
 #include <filaflat/ChunkContainer.h>
+#include <filaflat/DictionaryReader.h>
 #include <filaflat/MaterialChunk.h>
 
 #include <filament/MaterialEnums.h>
@@ -34,6 +35,9 @@
 
 #include <inttypes.h>
 
+// for gtest
+class MaterialParser_ReleaseCallback_Test;
+
 namespace filaflat {
 class ChunkContainer;
 class Unflattener;
@@ -48,7 +52,12 @@ struct MaterialConstant;
 
 class MaterialParser {
 public:
-    MaterialParser(backend::ShaderLanguage language, const void* data, size_t size);
+    using ReleaseCallback = void(*)(const void* data, size_t size, void* user);
+
+    // The package is copied, unless a release callback is provided, in which case the package is
+    // referenced until the parser is destroyed, and then released with the callback.
+    MaterialParser(backend::ShaderLanguage language, const void* data, size_t size,
+            ReleaseCallback releaseCallback = nullptr, void* user = nullptr);
 
     MaterialParser(MaterialParser const& rhs) noexcept = delete;
     MaterialParser& operator=(MaterialParser const& rhs) noexcept = delete;
@@ -128,8 +137,11 @@ public:
     }
 
 private:
+    friend class ::MaterialParser_ReleaseCallback_Test;
+
     struct MaterialParserDetails {
-        MaterialParserDetails(backend::ShaderLanguage language, const void* data, size_t size);
+        MaterialParserDetails(backend::ShaderLanguage language, const void* data, size_t size,
+                ReleaseCallback releaseCallback, void* user);
 
         template<typename T>
         bool getFromSimpleChunk(filamat::ChunkType type, T* value) const noexcept;
@@ -139,13 +151,14 @@ private:
 
         class ManagedBuffer {
             void* mStart = nullptr;
+            const void* mPackage = nullptr;
             size_t mSize = 0;
+            ReleaseCallback mReleaseCallback = nullptr;
+            void* mUser = nullptr;
         public:
-            explicit ManagedBuffer(const void* start, size_t size)
-                    : mStart(malloc(size)), mSize(size) {
-                memcpy(mStart, start, size);
-            }
-            ~ManagedBuffer() noexcept { free(mStart); }
+            ManagedBuffer(const void* start, size_t size,
+                    ReleaseCallback releaseCallback, void* user);
+            ~ManagedBuffer() noexcept;
             ManagedBuffer(ManagedBuffer const& rhs) = delete;
             ManagedBuffer& operator=(ManagedBuffer const& rhs) = delete;
             void* data() const noexcept { return mStart; }
@@ -159,7 +172,10 @@ private:
 
         // Keep MaterialChunk alive between calls to getShader to avoid reload the shader index.
         filaflat::MaterialChunk mMaterialChunk;
-        filaflat::BlobDictionary mBlobDictionary;
+        // The dictionary is indexed when the first shader is requested, and its entries are
+        // decoded as needed.
+        filaflat::LazyDictionary mDictionary;
+        bool mDictionaryInitialized = false;
         filamat::ChunkType mMaterialTag = filamat::ChunkType::Unknown;
         filamat::ChunkType mDictionaryTag = filamat::ChunkType::Unknown;
     };
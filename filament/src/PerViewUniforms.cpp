@@ -369,6 +369,11 @@ void PerViewUniforms::prepareDynamicLights(Froxelizer& froxelizer) noexcept {
     s.lightFarAttenuationParams = 0.5f * float2{ 10.0f, 10.0f / (f * f) };
 }
 
+void PerViewUniforms::prepareLights(Handle<HwTexture> lights) noexcept {
+    // sampler must be NEAREST
+    mSamplers.setSampler(PerViewSib::LIGHTS, { lights, {}});
+}
+
 void PerViewUniforms::prepareShadowMapping(bool highPrecision) noexcept {
     auto& s = mUniforms.edit();
     constexpr float low  = 5.54f; // ~ std::log(std::numeric_limits<math::half>::max()) * 0.5f;
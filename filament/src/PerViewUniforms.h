@@ -116,6 +116,7 @@ public:
             FIndirectLight const& ibl, float intensity, float exposure) noexcept;
 
     void prepareDynamicLights(Froxelizer& froxelizer) noexcept;
+    void prepareLights(TextureHandle lights) noexcept;
 
     void prepareShadowVSM(TextureHandle texture,
             ShadowMappingUniforms const& shadowMappingUniforms,
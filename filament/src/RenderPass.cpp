@@ -28,6 +28,8 @@
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 using namespace utils;
@@ -121,11 +123,19 @@ void RenderPass::appendCommands(FEngine& engine, CommandTypeFlags const commandT
 
     const float3 cameraPosition(mCameraPosition);
     const float3 cameraForwardVector(mCameraForwardVector);
-    auto work = [commandTypeFlags, curr, &soa, variant, renderFlags, visibilityMask, cameraPosition,
+
+    // the visibility masks are either the SOA's or out-of-band ones starting at vr.first
+    FScene::VisibleMaskType const* const visibleMasks =
+            mVisibleMasks ? mVisibleMasks : soa.data<FScene::VISIBLE_MASK>();
+    uint32_t const visibleMasksFirst = mVisibleMasks ? vr.first : 0;
+
+    auto work = [commandTypeFlags, curr, &soa, visibleMasks, visibleMasksFirst,
+                 variant, renderFlags, visibilityMask, cameraPosition,
                  cameraForwardVector, stereoscopicEyeCount]
             (uint32_t startIndex, uint32_t indexCount) {
         RenderPass::generateCommands(commandTypeFlags, curr,
-                soa, { startIndex, startIndex + indexCount }, variant, renderFlags, visibilityMask,
+                soa, { startIndex, startIndex + indexCount },
+                visibleMasks, visibleMasksFirst, variant, renderFlags, visibilityMask,
                 cameraPosition, cameraForwardVector, stereoscopicEyeCount);
     };
 
@@ -376,6 +386,7 @@ void RenderPass::setupColorCommand(Command& cmdDraw, Variant variant,
 UTILS_NOINLINE
 void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
         FScene::RenderableSoa const& soa, Range<uint32_t> range,
+        FScene::VisibleMaskType const* visibleMasks, uint32_t visibleMasksFirst,
         Variant variant, RenderFlags renderFlags,
         FScene::VisibleMaskType visibilityMask, float3 cameraPosition, float3 cameraForward,
         uint8_t instancedStereoEyeCount) noexcept {
@@ -409,12 +420,14 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
     switch (commandTypeFlags & (CommandTypeFlags::COLOR | CommandTypeFlags::DEPTH)) {
         case CommandTypeFlags::COLOR:
             curr = generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, curr,
-                    soa, range, variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
+                    soa, range, visibleMasks, visibleMasksFirst,
+                    variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
                     instancedStereoEyeCount);
             break;
         case CommandTypeFlags::DEPTH:
             curr = generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, curr,
-                    soa, range, variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
+                    soa, range, visibleMasks, visibleMasksFirst,
+                    variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
                     instancedStereoEyeCount);
             break;
         default:
@@ -437,6 +450,8 @@ UTILS_NOINLINE
 RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
         Command* UTILS_RESTRICT curr,
         FScene::RenderableSoa const& UTILS_RESTRICT soa, Range<uint32_t> range,
+        FScene::VisibleMaskType const* const UTILS_RESTRICT visibleMasks,
+        uint32_t const visibleMasksFirst,
         Variant const variant, RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
         float3 cameraPosition, float3 cameraForward, uint8_t instancedStereoEyeCount) noexcept {
 
@@ -459,7 +474,6 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
     auto const* const UTILS_RESTRICT soaPrimitives          = soa.data<FScene::PRIMITIVES>();
     auto const* const UTILS_RESTRICT soaSkinning            = soa.data<FScene::SKINNING_BUFFER>();
     auto const* const UTILS_RESTRICT soaMorphing            = soa.data<FScene::MORPHING_BUFFER>();
-    auto const* const UTILS_RESTRICT soaVisibilityMask      = soa.data<FScene::VISIBLE_MASK>();
     auto const* const UTILS_RESTRICT soaInstanceInfo        = soa.data<FScene::INSTANCES>();
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
@@ -482,7 +496,7 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
     for (uint32_t i = range.first; i < range.last; ++i) {
         // Check if this renderable passes the visibilityMask.
-        if (UTILS_UNLIKELY(!(soaVisibilityMask[i] & visibilityMask))) {
+        if (UTILS_UNLIKELY(!(visibleMasks[i - visibleMasksFirst] & visibilityMask))) {
             continue;
         }
 
@@ -754,18 +768,84 @@ void RenderPass::Executor::overrideScissor(backend::Viewport const& scissor) noe
 }
 
 void RenderPass::Executor::execute(FEngine& engine, const char*) const noexcept {
-    execute(engine.getDriverApi(), mCommands.begin(), mCommands.end());
+    execute(engine.getDriverApi(), mCommands.begin(), mCommands.end(),
+            engine.getRenderPassStatistics());
 }
 
+/*
+ * Keeps track of the per-renderable buffers and samplers bound by the Executor, so that
+ * redundant bindings (e.g. between primitives of the same renderable) are not sent to the driver.
+ */
+class RenderPass::Executor::BindingTracker {
+    struct BufferRange {
+        Handle<HwBufferObject> handle;
+        uint32_t offset;
+        uint32_t size;
+    };
+    static constexpr uint32_t WHOLE_BUFFER = std::numeric_limits<uint32_t>::max();
+
+    BufferRange mBuffers[CONFIG_UNIFORM_BINDING_COUNT] = {};
+    Handle<HwSamplerGroup> mSamplers[CONFIG_SAMPLER_BINDING_COUNT] = {};
+    uint32_t mFilteredCount = 0;
+
+public:
+    uint32_t getFilteredCount() const noexcept { return mFilteredCount; }
+
+    // forget all bindings, e.g. when a custom command may have changed them
+    void invalidate() noexcept {
+        std::fill(std::begin(mBuffers), std::end(mBuffers), BufferRange{});
+        std::fill(std::begin(mSamplers), std::end(mSamplers), Handle<HwSamplerGroup>{});
+    }
+
+    void bindUniformBufferRange(DriverApi& driver, uint32_t index,
+            Handle<HwBufferObject> handle, uint32_t offset, uint32_t size) noexcept {
+        assert_invariant(index < CONFIG_UNIFORM_BINDING_COUNT);
+        BufferRange& current = mBuffers[index];
+        if (UTILS_UNLIKELY(current.handle == handle &&
+                current.offset == offset && current.size == size)) {
+            mFilteredCount++;
+            return;
+        }
+        current = { handle, offset, size };
+        if (size == WHOLE_BUFFER) {
+            driver.bindUniformBuffer(index, handle);
+        } else {
+            driver.bindBufferRange(BufferObjectBinding::UNIFORM, index, handle, offset, size);
+        }
+    }
+
+    void bindUniformBuffer(DriverApi& driver, uint32_t index,
+            Handle<HwBufferObject> handle) noexcept {
+        bindUniformBufferRange(driver, index, handle, 0, WHOLE_BUFFER);
+    }
+
+    void bindSamplers(DriverApi& driver, uint32_t index, Handle<HwSamplerGroup> handle) noexcept {
+        assert_invariant(index < CONFIG_SAMPLER_BINDING_COUNT);
+        if (UTILS_UNLIKELY(mSamplers[index] == handle)) {
+            mFilteredCount++;
+            return;
+        }
+        mSamplers[index] = handle;
+        driver.bindSamplers(index, handle);
+    }
+};
+
 UTILS_NOINLINE // no need to be inlined
 void RenderPass::Executor::execute(backend::DriverApi& driver,
-        const Command* first, const Command* last) const noexcept {
+        const Command* first, const Command* last,
+        RenderPassStatistics& statistics) const noexcept {
     SYSTRACE_CALL();
     SYSTRACE_CONTEXT();
 
     if (first != last) {
         SYSTRACE_VALUE32("commandCount", last - first);
 
+        BindingTracker bindings;
+        uint32_t drawCount = 0;
+        uint32_t unchangedPipelineCount = 0;
+        Handle<HwProgram> previousProgram;
+        RasterState previousRasterState;
+
         PipelineState pipeline{
                 .polygonOffset = mPolygonOffset,
                 .scissor = mScissor
@@ -791,6 +871,8 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
 
             if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
                 mi = nullptr; // custom command could change the currently bound MaterialInstance
+                bindings.invalidate();
+                previousProgram = {};
                 uint32_t const index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
                 assert_invariant(index < mCustomCommands.size());
                 pCustomCommands[index]();
@@ -806,6 +888,9 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
             const PrimitiveInfo info = first->primitive;
             pipeline.rasterState = info.rasterState;
 
+            // the material instance determines the scissor, polygon offset and stencil state
+            bool pipelineChanged = mi != info.mi;
+
             if (UTILS_UNLIKELY(mi != info.mi)) {
                 // this is always taken the first time
                 mi = info.mi;
@@ -845,6 +930,12 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
 
             pipeline.program = ma->getProgram(info.materialVariant);
 
+            pipelineChanged = pipelineChanged ||
+                    pipeline.program != previousProgram ||
+                    pipeline.rasterState != previousRasterState;
+            previousProgram = pipeline.program;
+            previousRasterState = pipeline.rasterState;
+
             uint16_t const instanceCount = info.instanceCount & PrimitiveInfo::INSTANCE_COUNT_MASK;
             auto getPerObjectUboHandle =
                     [this, &info, &instanceCount]() -> std::pair<Handle<backend::HwBufferObject>, uint32_t> {
@@ -863,11 +954,11 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
                 }
             };
 
-            // bind per-renderable uniform block. there is no need to attempt to skip this command
-            // because the backends already do this.
+            // bind per-renderable uniform block. consecutive primitives of the same renderable
+            // use the same range, in which case the binding is skipped.
             auto const [perObjectUboHandle, offset] = getPerObjectUboHandle();
             assert_invariant(perObjectUboHandle);
-            driver.bindBufferRange(BufferObjectBinding::UNIFORM,
+            bindings.bindUniformBufferRange(driver,
                     +UniformBindingPoints::PER_RENDERABLE,
                     perObjectUboHandle,
                     offset,
@@ -875,33 +966,41 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
 
             if (UTILS_UNLIKELY(info.skinningHandle)) {
                 // note: we can't bind less than sizeof(PerRenderableBoneUib) due to glsl limitations
-                driver.bindBufferRange(BufferObjectBinding::UNIFORM,
+                bindings.bindUniformBufferRange(driver,
                         +UniformBindingPoints::PER_RENDERABLE_BONES,
                         info.skinningHandle,
                         info.skinningOffset * sizeof(PerRenderableBoneUib::BoneData),
                         sizeof(PerRenderableBoneUib));
                 // note: always bind the skinningTexture because the shader needs it.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
+                bindings.bindSamplers(driver, +SamplerBindingPoints::PER_RENDERABLE_SKINNING,
                         info.skinningTexture);
                 // note: even if only skinning is enabled, binding morphTargetBuffer is needed.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
+                bindings.bindSamplers(driver, +SamplerBindingPoints::PER_RENDERABLE_MORPHING,
                         info.morphTargetBuffer);
            }
 
             if (UTILS_UNLIKELY(info.morphWeightBuffer)) {
                 // Instead of using a UBO per primitive, we could also have a single UBO for all
                 // primitives and use bindUniformBufferRange which might be more efficient.
-                driver.bindUniformBuffer(+UniformBindingPoints::PER_RENDERABLE_MORPHING,
+                bindings.bindUniformBuffer(driver, +UniformBindingPoints::PER_RENDERABLE_MORPHING,
                         info.morphWeightBuffer);
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
+                bindings.bindSamplers(driver, +SamplerBindingPoints::PER_RENDERABLE_MORPHING,
                         info.morphTargetBuffer);
                 // note: even if only morphing is enabled, binding skinningTexture is needed.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
+                bindings.bindSamplers(driver, +SamplerBindingPoints::PER_RENDERABLE_SKINNING,
                         info.skinningTexture);
             }
 
+            // draws using an unchanged pipeline are encoded compactly by the CommandStream
+            drawCount++;
+            unchangedPipelineCount += pipelineChanged ? 0 : 1;
             driver.draw(pipeline, info.primitiveHandle, instanceCount);
         }
+
+        SYSTRACE_VALUE32("filteredBindings", bindings.getFilteredCount());
+        statistics.drawCount += drawCount;
+        statistics.unchangedPipelineCount += unchangedPipelineCount;
+        statistics.filteredCommandCount += bindings.getFilteredCount();
     }
 
     if (mInstancedUboHandle) {
@@ -42,6 +42,7 @@
 namespace filament {
 
 class FMaterialInstance;
+struct RenderPassStatistics;
 
 class RenderPass {
 public:
@@ -309,6 +310,13 @@ public:
     // Defaults to all 1's, which means all renderables in this render pass will be rendered.
     void setVisibilityMask(FScene::VisibleMaskType mask) noexcept { mVisibilityMask = mask; }
 
+    // Overrides the renderables' VISIBLE_MASK with masks computed out-of-band, e.g. per shadow
+    // map. visibleMasks[i] is the mask of the i-th renderable of the geometry's range, and must
+    // stay valid until appendCommands() returns.
+    void setVisibleMasks(FScene::VisibleMaskType const* visibleMasks) noexcept {
+        mVisibleMasks = visibleMasks;
+    }
+
     Command const* begin() const noexcept { return mCommandBegin; }
     Command const* end() const noexcept { return mCommandEnd; }
     bool empty() const noexcept { return begin() == end(); }
@@ -344,10 +352,13 @@ public:
         bool mPolygonOffsetOverride : 1;         // whether to override the polygon offset setting
         bool mScissorOverride : 1;               // whether to override the polygon offset setting
 
+        class BindingTracker;
+
         Executor(RenderPass const* pass, Command const* b, Command const* e) noexcept;
 
         void execute(backend::DriverApi& driver,
-                const Command* first, const Command* last) const noexcept;
+                const Command* first, const Command* last,
+                RenderPassStatistics& statistics) const noexcept;
 
     public:
         Executor() = default;
@@ -406,6 +417,7 @@ private:
 
     static inline void generateCommands(uint32_t commandTypeFlags, Command* commands,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
+            FScene::VisibleMaskType const* visibleMasks, uint32_t visibleMasksFirst,
             Variant variant, RenderFlags renderFlags,
             FScene::VisibleMaskType visibilityMask,
             math::float3 cameraPosition, math::float3 cameraForward,
@@ -414,6 +426,7 @@ private:
     template<uint32_t commandTypeFlags>
     static inline Command* generateCommandsImpl(uint32_t extraFlags, Command* curr,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
+            FScene::VisibleMaskType const* visibleMasks, uint32_t visibleMasksFirst,
             Variant variant, RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
             math::float3 cameraPosition, math::float3 cameraForward,
             uint8_t instancedStereoEyeCount) noexcept;
@@ -458,6 +471,9 @@ private:
     // Additional visibility mask
     FScene::VisibleMaskType mVisibilityMask = std::numeric_limits<FScene::VisibleMaskType>::max();
 
+    // Out-of-band VISIBLE_MASK for mVisibleRenderables, or nullptr to use the SOA's
+    FScene::VisibleMaskType const* mVisibleMasks = nullptr;
+
     backend::Viewport mScissorViewport{ 0, 0,
             std::numeric_limits<int32_t>::max(),
             std::numeric_limits<int32_t>::max() };
@@ -41,6 +41,10 @@ void ResourceListBase::insert(void* item) {
     mList.insert(item);
 }
 
+void ResourceListBase::reserve(size_t count) {
+    mList.reserve(count);
+}
+
 bool ResourceListBase::remove(void const* item) {
     return mList.erase(const_cast<void*>(item)) > 0;
 }
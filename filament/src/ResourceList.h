@@ -36,6 +36,8 @@ public:
 
     void insert(void* item);
 
+    void reserve(size_t count);
+
     bool remove(void const* item);
 
     iterator find(void const* item);
@@ -77,6 +79,7 @@ public:
     using ResourceListBase::ResourceListBase;
     using ResourceListBase::forEach;
     using ResourceListBase::insert;
+    using ResourceListBase::reserve;
     using ResourceListBase::remove;
     using ResourceListBase::find;
     using ResourceListBase::empty;
@@ -241,7 +241,7 @@ ShadowMap::ShaderParameters ShadowMap::updatePunctual(
         const ShadowMapInfo& shadowMapInfo, const FLightManager::ShadowParams& params) noexcept {
     const mat4f Mp = mat4f::perspective(outerConeAngle * f::RAD_TO_DEG * 2.0f, 1.0f, nearPlane, farPlane);
 
-    assert_invariant(shadowMapInfo.textureDimension == mOptions->mapSize);
+    assert_invariant(shadowMapInfo.textureDimension == mSize);
 
     // Final shadow transform
     const mat4f S = math::highPrecisionMultiply(Mp, Mv);
@@ -334,14 +334,12 @@ ShadowMap::ShaderParameters ShadowMap::updateSpot(FEngine& engine,
 
 ShadowMap::ShaderParameters ShadowMap::updatePoint(FEngine& engine,
         const FScene::LightSoa& lightData, size_t index, filament::CameraInfo const&,
-        const ShadowMapInfo& shadowMapInfo, FScene const& scene, uint8_t face) noexcept {
+        const ShadowMapInfo& shadowMapInfo,
+        Culler::result_type const* visibleMasks, size_t count, uint8_t face) noexcept {
 
     // check if this shadow map has anything to render
     mHasVisibleShadows = false;
-    FScene::RenderableSoa const& UTILS_RESTRICT soa = scene.getRenderableData();
-    auto const* const UTILS_RESTRICT visibleMasks = soa.data<FScene::VISIBLE_MASK>();
-    size_t const c = soa.size();
-    for (size_t i = 0; i < c; i++) {
+    for (size_t i = 0; i < count; i++) {
         if (visibleMasks[i] & VISIBLE_DYN_SHADOW_RENDERABLE) {
             mHasVisibleShadows = true;
             break;
@@ -1264,9 +1262,9 @@ backend::Viewport ShadowMap::getViewport() const noexcept {
     // or when shadowFar is smaller than the camera far.
     // For spot- and point-lights we also use a 1-texel border, so that bilinear filtering
     // can work properly if the shadowmap is in an atlas (and we can't rely on h/w clamp).
-    const uint32_t dim = mOptions->mapSize;
+    const uint32_t dim = mSize;
     const uint16_t border = 1u;
-    return { border, border, dim - 2u * border, dim - 2u * border };
+    return { mOffset.x + border, mOffset.y + border, dim - 2u * border, dim - 2u * border };
 }
 
 backend::Viewport ShadowMap::getScissor() const noexcept {
@@ -1276,14 +1274,14 @@ backend::Viewport ShadowMap::getScissor() const noexcept {
     // For spot- and point-lights we also use a 1-texel border, so that bilinear filtering
     // can work properly if the shadowmap is in an atlas (and we can't rely on h/w clamp), so we
     // don't scissor the border, so it gets filled with correct neighboring texels.
-    const uint32_t dim = mOptions->mapSize;
+    const uint32_t dim = mSize;
     const uint16_t border = 1u;
     switch (mShadowType) {
         case ShadowType::DIRECTIONAL:
-            return { border, border, dim - 2u * border, dim - 2u * border };
+            return { mOffset.x + border, mOffset.y + border, dim - 2u * border, dim - 2u * border };
         case ShadowType::SPOT:
         case ShadowType::POINT:
-            return { 0, 0, dim, dim };
+            return { mOffset.x, mOffset.y, dim, dim };
     }
 }
 
@@ -1305,9 +1303,9 @@ math::float4 ShadowMap::getClampToEdgeCoords(ShadowMapInfo const& shadowMapInfo)
     }
 
     float const texel = 1.0f / float(shadowMapInfo.atlasDimension);
-    float const dim = float(mOptions->mapSize);
-    float const l = border;
-    float const b = border;
+    float const dim = float(mSize);
+    float const l = float(mOffset.x) + border;
+    float const b = float(mOffset.y) + border;
     float const w = dim - 2.0f * border;
     float const h = dim - 2.0f * border;
     float4 const v = float4{ l, b, l + w, b + h } * texel;
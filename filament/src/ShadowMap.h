@@ -32,6 +32,8 @@
 #include <math/mat4.h>
 #include <math/vec4.h>
 
+#include <utils/debug.h>
+
 namespace filament {
 
 class RenderPass;
@@ -152,9 +154,11 @@ public:
             const ShadowMapInfo& shadowMapInfo, FScene const& scene,
             SceneInfo sceneInfo) noexcept;
 
+    // visibleMasks are the VISIBLE_MASK of the count renderables that can cast shadows
     ShadowMap::ShaderParameters updatePoint(FEngine& engine,
             const FScene::LightSoa& lightData, size_t index, filament::CameraInfo const& camera,
-            const ShadowMapInfo& shadowMapInfo, FScene const& scene, uint8_t face) noexcept;
+            const ShadowMapInfo& shadowMapInfo,
+            Culler::result_type const* visibleMasks, size_t count, uint8_t face) noexcept;
 
     // Do we have visible shadows. Valid after calling update().
     bool hasVisibleShadows() const noexcept { return mHasVisibleShadows; }
@@ -175,8 +179,15 @@ public:
     LightManager::ShadowOptions const* getShadowOptions() const noexcept { return mOptions; }
     size_t getLightIndex() const { return mLightIndex; }
     uint16_t getShadowIndex() const { return mShadowIndex; }
-    void setLayer(uint8_t layer) noexcept { mLayer = layer; }
+    // sets the layer and the square area of that layer this shadow map is rendered into
+    void setAllocation(uint8_t layer, backend::Viewport const& area) noexcept {
+        assert_invariant(area.width == area.height);
+        mLayer = layer;
+        mOffset = { uint16_t(area.left), uint16_t(area.bottom) };
+        mSize = uint16_t(area.width);
+    }
     uint8_t getLayer() const noexcept { return mLayer; }
+    uint16_t getSize() const noexcept { return mSize; }
     backend::Viewport getViewport() const noexcept;
     backend::Viewport getScissor() const noexcept;
 
@@ -346,6 +357,8 @@ private:
     LightManager::ShadowOptions const* mOptions = nullptr;                  // 8
     uint32_t mLightIndex = 0;   // which light are we shadowing             // 4
     uint16_t mShadowIndex = 0;  // our index in the shadowMap vector        // 2
+    math::ushort2 mOffset{};    // our position in the layer                // 4
+    uint16_t mSize = 0;         // our dimension in the layer               // 2
     uint8_t mLayer = 0;         // our layer in the shadowMap texture       // 1
     ShadowType mShadowType  : 2;                                            // :2
     bool mHasVisibleShadows : 2;                                            // :2
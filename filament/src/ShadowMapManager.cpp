@@ -16,7 +16,9 @@
 
 #include "ShadowMapManager.h"
 
+#include "AtlasAllocator.h"
 #include "RenderPass.h"
+#include "ResourceAllocator.h"
 #include "ShadowMap.h"
 
 #include "details/Texture.h"
@@ -24,14 +26,52 @@
 
 #include <fg/FrameGraph.h>
 
+#include <filament/Frustum.h>
+
 #include <utils/debug.h>
 #include <utils/FixedCapacityVector.h>
+#include <utils/JobSystem.h>
+#include <utils/Range.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <numeric>
 
 namespace filament {
 
 using namespace backend;
 using namespace math;
 
+template<typename MATRIX>
+static bool isSameMatrix(MATRIX const& l, MATRIX const& r) noexcept {
+    for (size_t i = 0; i < MATRIX::NUM_COLS; i++) {
+        if (l[i] != r[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Values computed relative to different world origins only match up to rounding errors, which
+// are relative to the largest of the magnitudes involved, given by scale.
+template<typename VECTOR>
+static bool isSameVector(VECTOR const& l, VECTOR const& r, double scale = 1.0) noexcept {
+    using T = typename VECTOR::value_type;
+    constexpr T epsilon = T(1e-5);
+    T const magnitude = std::max({ T(scale), max(abs(l)), max(abs(r)) });
+    return max(abs(l - r)) <= epsilon * magnitude;
+}
+
+template<typename MATRIX>
+static bool isNearlySameMatrix(MATRIX const& l, MATRIX const& r, double scale = 1.0) noexcept {
+    for (size_t i = 0; i < MATRIX::NUM_COLS; i++) {
+        if (!isSameVector(l[i], r[i], scale)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 ShadowMapManager::ShadowMapManager(FEngine& engine)
         : mEngine(engine) {
     // initialize our ShadowMap array in-place
@@ -48,6 +88,8 @@ ShadowMapManager::ShadowMapManager(FEngine& engine)
             &engine.debug.shadowmap.visualize_cascades);
     debugRegistry.registerProperty("d.shadowmap.tightly_bound_scene",
             &engine.debug.shadowmap.tightly_bound_scene);
+    debugRegistry.registerProperty("d.shadowmap.receiver_aware_culling",
+            &engine.debug.shadowmap.receiver_aware_culling);
 }
 
 ShadowMapManager::~ShadowMapManager() {
@@ -61,6 +103,7 @@ ShadowMapManager::~ShadowMapManager() {
 void ShadowMapManager::terminate(FEngine& engine) {
     DriverApi& driver = engine.getDriverApi();
     driver.destroyBufferObject(mShadowUbh);
+    mCachedShadowMap.destroy(engine.getResourceAllocator());
     UTILS_NOUNROLL
     for (auto& entry : mShadowMapCache) {
         std::launder(reinterpret_cast<ShadowMap*>(&entry))->terminate(engine);
@@ -68,12 +111,205 @@ void ShadowMapManager::terminate(FEngine& engine) {
 }
 
 
+void ShadowMapManager::updateShadowCasters(FEngine& engine, FView const& view,
+        CameraInfo const& cameraInfo,
+        FScene::RenderableSoa const& renderableData,
+        FScene::LightSoa const& lightData) noexcept {
+    FLightManager const& lcm = engine.getLightManager();
+
+    // VSM shadow maps are never cached, because they'd need to be blurred and mipmapped again.
+    bool cacheShadowMaps = false;
+    if (view.isShadowingEnabled() && !view.hasVSM()) {
+        for (size_t i = 0, c = lightData.size(); i < c && !cacheShadowMaps; i++) {
+            FLightManager::Instance const li = lightData.elementAt<FScene::LIGHT_INSTANCE>(i);
+            if (li && lcm.isShadowCaster(li)) {
+                auto const& options = lcm.getShadowOptions(li);
+                cacheShadowMaps = options.cacheShadowMap ||
+                        (lcm.isDirectionalLight(li) && options.shadowCascades > 1 &&
+                         options.cascadeUpdateInterval > 1);
+            }
+        }
+    }
+
+    // The scene is translated by the world origin, which follows the camera (see
+    // FView::computeCameraInfo), so the shadow casters' state is kept relative to the actual
+    // world origin.
+    float3 const previousWorldOrigin = mWorldOrigin;
+    float3 const worldOrigin{ cameraInfo.worldTransform[3].xyz };
+    mWorldOrigin = worldOrigin;
+
+    mCacheShadowMaps = cacheShadowMaps;
+    mDirtyShadowCasters.clear();
+    if (!cacheShadowMaps) {
+        mShadowCasters.clear();
+        mAllShadowCastersDirty = true;
+        return;
+    }
+
+    // The scene's renderables keep their order from frame to frame, unless entities are added
+    // or removed, in which case we consider all shadow casters have changed.
+    size_t const count = renderableData.size();
+    mAllShadowCastersDirty = mShadowCasters.size() != count;
+    mShadowCasters.resize(count);
+
+    auto const* const instances = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const worldTransforms = renderableData.data<FScene::WORLD_TRANSFORM>();
+    auto const* const centers = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    auto const* const extents = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    auto const* const layers = renderableData.data<FScene::LAYERS>();
+    auto const* const visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto const* const skinning = renderableData.data<FScene::SKINNING_BUFFER>();
+    auto const* const morphing = renderableData.data<FScene::MORPHING_BUFFER>();
+    auto const* const instancing = renderableData.data<FScene::INSTANCES>();
+
+    // past this many dirty shadow casters we only keep their union
+    constexpr size_t MAX_DIRTY_SHADOW_CASTERS = 32;
+    Aabb dirtyBounds;
+    double const originScale = std::max(max(abs(worldOrigin)), max(abs(previousWorldOrigin)));
+    auto addDirtyShadowCaster = [&](ShadowCasterState const& state) {
+        if (state.castShadows) {
+            Box const box{ state.center, state.halfExtent };
+            dirtyBounds.min = min(dirtyBounds.min, box.getMin());
+            dirtyBounds.max = max(dirtyBounds.max, box.getMax());
+            if (mDirtyShadowCasters.size() < MAX_DIRTY_SHADOW_CASTERS) {
+                mDirtyShadowCasters.push_back(box);
+            }
+        }
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        mat4f worldTransform = worldTransforms[i];
+        worldTransform[3].xyz -= worldOrigin;
+        ShadowCasterState const current{
+                worldTransform, centers[i] - worldOrigin, extents[i], instances[i],
+                layers[i], bool(visibility[i].castShadows) };
+        ShadowCasterState& previous = mShadowCasters[i];
+
+        if (!mAllShadowCastersDirty && (current.castShadows || previous.castShadows)) {
+            // skinned, morphed and instanced renderables can change without their transform
+            // changing, so we always consider them dirty.
+            bool const dirty = skinning[i].handle || morphing[i].handle || instancing[i].buffer ||
+                    previous.instance != current.instance ||
+                    previous.layers != current.layers ||
+                    previous.castShadows != current.castShadows ||
+                    previous.halfExtent != current.halfExtent ||
+                    !isSameVector(previous.center, current.center, originScale) ||
+                    !isNearlySameMatrix(previous.worldTransform, current.worldTransform,
+                            originScale);
+            if (dirty) {
+                addDirtyShadowCaster(previous);
+                addDirtyShadowCaster(current);
+            }
+        }
+        previous = current;
+    }
+
+    if (mDirtyShadowCasters.size() >= MAX_DIRTY_SHADOW_CASTERS) {
+        mDirtyShadowCasters.clear();
+        mDirtyShadowCasters.push_back({ dirtyBounds.center(), dirtyBounds.extent() });
+    }
+}
+
+bool ShadowMapManager::hasDirtyShadowCasters(Frustum const& frustum,
+        float3 const& worldOrigin) const noexcept {
+    if (mAllShadowCastersDirty) {
+        return true;
+    }
+    return std::any_of(mDirtyShadowCasters.begin(), mDirtyShadowCasters.end(),
+            [&](Box const& box) {
+                return frustum.intersects(Box{ box.center + worldOrigin, box.halfExtent });
+            });
+}
+
+bool ShadowMapManager::isSameCachedState(CachedShadowMap const& cachedShadowMap,
+        CachedShadowMap const& state) noexcept {
+    return state.valid && cachedShadowMap.valid &&
+           cachedShadowMap.light == state.light &&
+           cachedShadowMap.type == state.type &&
+           cachedShadowMap.layer == state.layer &&
+           cachedShadowMap.face == state.face &&
+           cachedShadowMap.visibleLayers == state.visibleLayers &&
+           cachedShadowMap.polygonOffsetConstant == state.polygonOffsetConstant &&
+           cachedShadowMap.polygonOffsetSlope == state.polygonOffsetSlope &&
+           cachedShadowMap.viewport == state.viewport &&
+           cachedShadowMap.shadowCasters == state.shadowCasters;
+}
+
+uint64_t ShadowMapManager::hashShadowCasters(FScene::RenderableSoa const& renderableData,
+        utils::Range<uint32_t> range, Culler::result_type const* visibleMasks,
+        FScene::VisibleMaskType visibilityMask) noexcept {
+    // FView::prepare() can reorder the renderables from frame to frame, so the hashes of the
+    // shadow casters are summed.
+    auto const* const instances = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    uint64_t hash = 0;
+    for (uint32_t i = range.first; i < range.last; i++) {
+        if (visibleMasks[i - range.first] & visibilityMask) {
+            // splitmix64 finalizer
+            uint64_t h = instances[i].asValue() + 0x9E3779B97F4A7C15u;
+            h = (h ^ (h >> 30u)) * 0xBF58476D1CE4E5B9u;
+            h = (h ^ (h >> 27u)) * 0x94D049BB133111EBu;
+            hash += h ^ (h >> 31u);
+        }
+    }
+    return hash;
+}
+
+bool ShadowMapManager::canReuseCachedShadowMap(CachedShadowMap const& cachedShadowMap,
+        CachedShadowMap const& state, Frustum const& frustum) const noexcept {
+    double const scale = max(abs(mWorldOrigin));
+    return isSameCachedState(cachedShadowMap, state) &&
+           isNearlySameMatrix(cachedShadowMap.projection, state.projection) &&
+           isNearlySameMatrix(cachedShadowMap.view, state.view, scale) &&
+           !hasDirtyShadowCasters(frustum, mWorldOrigin);
+}
+
+ShadowUib::ShadowData ShadowMapManager::getReprojectedShadowData(
+        CachedShadowMap const& cachedShadowMap) const noexcept {
+    // the world origin moved by this much since the shadow map was rendered
+    float3 const offset = cachedShadowMap.worldOrigin - mWorldOrigin;
+    ShadowUib::ShadowData shadowData = cachedShadowMap.shadowData;
+    shadowData.lightFromWorldMatrix = highPrecisionMultiply(
+            shadowData.lightFromWorldMatrix, mat4f::translation(offset));
+    shadowData.lightFromWorldZ.w += dot(shadowData.lightFromWorldZ.xyz, offset);
+    return shadowData;
+}
+
+bool ShadowMapManager::isCoveredByCachedCascade(CachedShadowMap const& cachedShadowMap,
+        mat4f const& lightFromWorld, float4 const& scissor) const noexcept {
+    // The corners of the current cascade's light volume must be within the cached cascade's
+    // scissor and depth range, otherwise the cached cascade could miss shadow casters. Its
+    // shadow casters must also be the same, see isSameCachedState().
+    constexpr float epsilon = 1e-5f;
+    ShadowUib::ShadowData const cached = getReprojectedShadowData(cachedShadowMap);
+    mat4f const cachedFromCurrent = highPrecisionMultiply(
+            cached.lightFromWorldMatrix, inverse(lightFromWorld));
+    float4 const cachedScissor = cached.scissorNormalized;
+    for (float const x : { scissor.x, scissor.z }) {
+        for (float const y : { scissor.y, scissor.w }) {
+            for (float const z : { 0.0f, 1.0f }) {
+                float4 const p = cachedFromCurrent * float4{ x, y, z, 1.0f };
+                if (!(p.w > 0.0f)) {
+                    return false;
+                }
+                float3 const uvz = p.xyz / p.w;
+                if (any(lessThan(uvz, float3{ cachedScissor.xy, 0.0f } - epsilon)) ||
+                    any(greaterThan(uvz, float3{ cachedScissor.zw, 1.0f } + epsilon))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
 ShadowMapManager::ShadowTechnique ShadowMapManager::update(FEngine& engine, FView& view,
         CameraInfo const& cameraInfo,
         FScene::RenderableSoa& renderableData, FScene::LightSoa const& lightData) noexcept {
     ShadowTechnique shadowTechnique = {};
 
-    calculateTextureRequirements(engine, view, lightData);
+    mFrameCount++;
+
+    calculateTextureRequirements(engine, view, cameraInfo, lightData);
 
     // Compute scene-dependent values shared across all shadow maps
     ShadowMap::SceneInfo const info{ *view.getScene(), view.getVisibleLayers(), cameraInfo.view };
@@ -142,6 +378,36 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
     const TextureAtlasRequirements textureRequirements = mTextureAtlasRequirements;
     assert_invariant(textureRequirements.layers <= CONFIG_MAX_SHADOW_LAYERS);
 
+    FrameGraphTexture::Descriptor const shadowMapDesc{
+            .width = textureRequirements.size, .height = textureRequirements.size,
+            .depth = textureRequirements.layers,
+            .levels = textureRequirements.levels,
+            .type = SamplerType::SAMPLER_2D_ARRAY,
+            .format = textureRequirements.format
+    };
+
+    // When some shadow maps are cached, the shadow map atlas is kept from one frame to the next,
+    // as long as its layout doesn't change.
+    bool const cacheShadowMaps = mCacheShadowMaps;
+    bool const reuseCachedShadowMap = cacheShadowMaps && mCachedShadowMap.handle &&
+            mCachedShadowMapDesc.width == shadowMapDesc.width &&
+            mCachedShadowMapDesc.height == shadowMapDesc.height &&
+            mCachedShadowMapDesc.depth == shadowMapDesc.depth &&
+            mCachedShadowMapDesc.levels == shadowMapDesc.levels &&
+            mCachedShadowMapDesc.format == shadowMapDesc.format;
+
+    FrameGraphId<FrameGraphTexture> cachedShadowMap;
+    if (reuseCachedShadowMap) {
+        cachedShadowMap = fg.import("Cached Shadowmap", mCachedShadowMapDesc,
+                FrameGraphTexture::Usage::DEPTH_ATTACHMENT | FrameGraphTexture::Usage::SAMPLEABLE,
+                mCachedShadowMap);
+    } else {
+        mCachedShadowMap.destroy(engine.getResourceAllocator());
+        for (auto& cachedShadowMap : mCachedShadowMaps) {
+            cachedShadowMap.valid = false;
+        }
+    }
+
     // -------------------------------------------------------------------------------------------
     // Prepare Shadow Pass
     // -------------------------------------------------------------------------------------------
@@ -152,6 +418,10 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
             ShadowMap* shadowMap;
             utils::Range<uint32_t> range;
             FScene::VisibleMaskType visibilityMask;
+            // whether this shadow map is rendered by the "Shadow Pass" of its layer
+            mutable bool hasShadowPass = false;
+            // whether this shadow map is reused from the previous frame
+            mutable bool cached = false;
         };
         // the actual shadow map atlas (currently a 2D texture array)
         FrameGraphId<FrameGraphTexture> shadows;
@@ -164,13 +434,8 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
     auto& prepareShadowPass = fg.addPass<PrepareShadowPassData>("Prepare Shadow Pass",
             [&](FrameGraph::Builder& builder, auto& data) {
                 data.passList.reserve(CONFIG_MAX_SHADOWMAPS);
-                data.shadows = builder.createTexture("Shadowmap", {
-                        .width = textureRequirements.size, .height = textureRequirements.size,
-                        .depth = textureRequirements.layers,
-                        .levels = textureRequirements.levels,
-                        .type = SamplerType::SAMPLER_2D_ARRAY,
-                        .format = textureRequirements.format
-                });
+                data.shadows = cachedShadowMap ? cachedShadowMap :
+                        builder.createTexture("Shadowmap", shadowMapDesc);
 
                 // these loops create a list of the shadow maps that might need to be rendered
                 auto& passList = data.passList;
@@ -183,7 +448,7 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                         if (shadowMap.hasVisibleShadows()) {
                             passList.push_back({
                                     {}, &shadowMap, directionalShadowCastersRange,
-                                    VISIBLE_DIR_SHADOW_RENDERABLE });
+                                    VISIBLE_DIR_SHADOW_RENDERABLE, false, false });
                         }
                     }
                 }
@@ -195,47 +460,239 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                         assert_invariant(!shadowMap.isDirectionalShadow());
                         passList.push_back({
                                 {}, &shadowMap, spotShadowCastersRange,
-                                VISIBLE_DYN_SHADOW_RENDERABLE });
+                                VISIBLE_DYN_SHADOW_RENDERABLE, false, false });
                     }
                 }
 
-                assert_invariant(passList.size() <= textureRequirements.layers);
+                assert_invariant(std::all_of(passList.begin(), passList.end(),
+                        [&](auto const& entry) {
+                            return entry.shadowMap->getLayer() < textureRequirements.layers;
+                        }));
 
                 // This pass must be declared as having a side effect because it never gets a
                 // "read" from one of its resource (only writes), so the FrameGraph culls it.
                 builder.sideEffect();
             },
-            [this, &engine, &view, vsmShadowOptions,
+            [this, &engine, &view, vsmShadowOptions, cacheShadowMaps,
                 scene, mainCameraInfo, userTime, passTemplate = pass](
                     FrameGraphResources const&, auto const& data, DriverApi& driver) {
 
-                // Note: we could almost parallel_for the loop below, the problem currently is
-                // that updatePrimitivesLod() updates temporary global state.
-                // prepareSpotShadowMap() also update the visibility of renderable. These two
-                // pieces of state are needed only until shadowMap.render() returns.
-                // Conceptually, we could store this out-of-band.
+                auto& renderableData = scene->getRenderableData();
+                auto const& passList = data.passList;
+                bool const vsm = view.hasVSM();
+
+                // Spot and point shadow maps cull their shadow casters into their own copy of
+                // the VISIBLE_MASK, instead of the scene's, so that they can be prepared
+                // concurrently. They all share the same range of renderables.
+                utils::Range<uint32_t> spotRange{};
+                uint32_t spotShadowMapCount = 0;
+                for (auto const& entry : passList) {
+                    if (!entry.shadowMap->isDirectionalShadow()) {
+                        assert_invariant(spotShadowMapCount == 0 ||
+                                (spotRange.first == entry.range.first &&
+                                 spotRange.last == entry.range.last));
+                        spotRange = entry.range;
+                        spotShadowMapCount++;
+                    }
+                }
 
-                // Generate a RenderPass for each shadow map
-                for (auto const& entry : data.passList) {
-                    ShadowMap& shadowMap = *entry.shadowMap;
+                // With several cascades, each one only renders the directional shadow casters that
+                // intersect its own frustum. The cascades are at the beginning of the pass list.
+                utils::Range<uint32_t> cascadeRange{};
+                uint32_t cascadeCount = 0;
+                for (auto const& entry : passList) {
+                    if (entry.shadowMap->isDirectionalShadow()) {
+                        cascadeRange = entry.range;
+                        cascadeCount++;
+                    }
+                }
+                // Culler::intersects() processes Culler::MODULO renderables at a time, so the
+                // cascades' masks are padded to 16, like the spot shadow maps' below
+                size_t const cascadeMasksStride = (cascadeRange.size() + 0xFu) & ~size_t(0xFu);
+                utils::FixedCapacityVector<Culler::result_type> cascadeMasks(
+                        cascadeCount > 1 ? cascadeMasksStride * cascadeCount : 0);
+                if (cascadeCount > 1) {
+                    for (size_t i = 0; i < cascadeCount; i++) {
+                        ShadowMap const& shadowMap = *passList[i].shadowMap;
+                        if (shadowMap.hasVisibleShadows()) {
+                            cullCascadeShadowCasters(shadowMap.getCamera().getCullingFrustum(),
+                                    renderableData, cascadeRange,
+                                    cascadeMasks.data() + i * cascadeMasksStride);
+                        }
+                    }
+                }
 
-                    // for spot shadow map, we need to do the culling
-                    switch (shadowMap.getShadowType()) {
-                        case ShadowType::DIRECTIONAL:
-                            break;
-                        case ShadowType::SPOT:
-                            prepareSpotShadowMap(shadowMap, engine, view, mainCameraInfo,
-                                    scene->getRenderableData(), entry.range,
-                                    scene->getLightData(), mSceneInfo);
-                            break;
-                        case ShadowType::POINT:
-                            preparePointShadowMap(shadowMap, engine, view, mainCameraInfo,
-                                    scene->getRenderableData(), entry.range,
-                                    scene->getLightData(), mSceneInfo);
-                            break;
+                // updateSpotVisibilityMasks() processes 16 renderables at a time
+                size_t const visibleMasksStride = (spotRange.size() + 0xFu) & ~size_t(0xFu);
+                utils::FixedCapacityVector<Culler::result_type> visibleMasks(
+                        visibleMasksStride * spotShadowMapCount);
+                utils::FixedCapacityVector<ShadowMap::ShaderParameters> shaderParameters(
+                        passList.size());
+
+                if (spotShadowMapCount) {
+                    auto const* const sceneVisibleMasks =
+                            renderableData.data<FScene::VISIBLE_MASK>() + spotRange.first;
+                    for (size_t i = 0; i < spotShadowMapCount; i++) {
+                        std::copy_n(sceneVisibleMasks, spotRange.size(),
+                                visibleMasks.data() + i * visibleMasksStride);
                     }
 
-                    if (shadowMap.hasVisibleShadows()) {
+                    // the spot and point shadow maps are at the end of the pass list
+                    size_t const firstSpotShadowMap = passList.size() - spotShadowMapCount;
+                    auto work = [&](uint32_t startIndex, uint32_t count) {
+                        for (uint32_t i = startIndex, n = startIndex + count; i < n; i++) {
+                            auto const& entry = passList[firstSpotShadowMap + i];
+                            ShadowMap& shadowMap = *entry.shadowMap;
+                            Culler::result_type* const masks =
+                                    visibleMasks.data() + i * visibleMasksStride;
+                            shaderParameters[firstSpotShadowMap + i] =
+                                    shadowMap.getShadowType() == ShadowType::SPOT ?
+                                    prepareSpotShadowMap(shadowMap, engine, view,
+                                            mainCameraInfo, renderableData, entry.range, masks,
+                                            scene->getLightData(), mSceneInfo) :
+                                    preparePointShadowMap(shadowMap, engine, view,
+                                            mainCameraInfo, renderableData, entry.range, masks,
+                                            scene->getLightData());
+                        }
+                    };
+
+                    utils::JobSystem& js = engine.getJobSystem();
+                    auto* job = utils::jobs::parallel_for(js, nullptr, 0, spotShadowMapCount,
+                            std::cref(work), utils::jobs::CountSplitter<1, 6>());
+                    js.runAndWait(job);
+
+                    for (size_t i = firstSpotShadowMap, c = passList.size(); i < c; i++) {
+                        updateShadowUniforms(*passList[i].shadowMap, vsm, shaderParameters[i]);
+                    }
+                }
+
+                // The visible masks a shadow map's casters are culled in, nullptr for the scene's
+                auto getVisibleMasks = [&](size_t i) -> Culler::result_type const* {
+                    if (passList[i].shadowMap->isDirectionalShadow()) {
+                        return cascadeCount > 1 ?
+                                cascadeMasks.data() + i * cascadeMasksStride : nullptr;
+                    }
+                    // the spot and point shadow maps are at the end of the pass list
+                    size_t const spotIndex = i - (passList.size() - spotShadowMapCount);
+                    return visibleMasks.data() + spotIndex * visibleMasksStride;
+                };
+
+                // The LOD selection doesn't depend on the shadow map yet, so it's done once
+                // per range of renderables rather than once per shadow map.
+                // updatePrimitivesLod must be run before RenderPass::appendCommands.
+                utils::Range<uint32_t> lodRange{};
+                for (auto const& entry : passList) {
+                    if (entry.shadowMap->hasVisibleShadows() &&
+                            (lodRange.first != entry.range.first ||
+                             lodRange.last != entry.range.last)) {
+                        lodRange = entry.range;
+                        view.updatePrimitivesLod(engine, mainCameraInfo, renderableData, lodRange);
+                    }
+                }
+
+                // Find the shadow maps that can be reused from the previous frame, i.e. those
+                // that were rendered last frame in the same state, at the same place in the atlas
+                // and with the same shadow casters, and in which none of the shadow casters that
+                // changed since are visible.
+                // A layer is cleared when it's rendered, so a shadow map can only be reused if
+                // all the shadow maps sharing its layer can be.
+                // The cascades updated at a reduced rate (see cascadeUpdateInterval), are also
+                // reused in the frames they're not scheduled in, with their previous matrices
+                // reprojected for the current world origin, as long as they still cover their
+                // part of the view frustum and render the same shadow casters.
+                if (cacheShadowMaps) {
+                    utils::FixedCapacityVector<CachedShadowMap> states(passList.size());
+                    uint64_t dirtyLayers = 0;
+                    for (size_t i = 0, c = passList.size(); i < c; i++) {
+                        auto const& entry = passList[i];
+                        ShadowMap const& shadowMap = *entry.shadowMap;
+                        auto const* options = shadowMap.getShadowOptions();
+                        FCamera const& camera = shadowMap.getCamera();
+                        backend::Viewport const viewport = shadowMap.getViewport();
+                        size_t const shadowIndex = shadowMap.getShadowIndex();
+                        bool const isStaggeredCascade = shadowMap.isDirectionalShadow() &&
+                                shadowIndex > 0 && options->cascadeUpdateInterval > 1;
+                        bool const valid = (options->cacheShadowMap || isStaggeredCascade) &&
+                                entry.hasShadowPass && shadowMap.hasVisibleShadows();
+                        // The casters rendered can change while the shadow map's matrices don't,
+                        // e.g. when they're culled by the receivers visible from the camera.
+                        Culler::result_type const* const masks = getVisibleMasks(i);
+                        CachedShadowMap& state = states[i];
+                        state = {
+                                .shadowData = mShadowUb.edit().shadows[shadowIndex],
+                                .projection = camera.getProjectionMatrix(),
+                                .view = camera.getViewMatrix() * mat4::translation(mWorldOrigin),
+                                .worldOrigin = mWorldOrigin,
+                                .viewport = { viewport.left, viewport.bottom,
+                                        viewport.width, viewport.height },
+                                .light = scene->getLightData().elementAt<FScene::LIGHT_INSTANCE>(
+                                        shadowMap.getLightIndex()),
+                                .type = shadowMap.getShadowType(),
+                                .layer = shadowMap.getLayer(),
+                                .face = shadowMap.getFace(),
+                                .visibleLayers = view.getVisibleLayers(),
+                                .polygonOffsetConstant = options->polygonOffsetConstant,
+                                .polygonOffsetSlope = options->polygonOffsetSlope,
+                                .shadowCasters = valid ? hashShadowCasters(renderableData,
+                                        entry.range, masks ? masks :
+                                        renderableData.data<FScene::VISIBLE_MASK>() +
+                                                entry.range.first,
+                                        entry.visibilityMask) : 0,
+                                .valid = valid
+                        };
+                        CachedShadowMap const& cachedShadowMap = mCachedShadowMaps[shadowIndex];
+                        bool const sameState = isSameCachedState(cachedShadowMap, state);
+                        if (sameState && options->cacheShadowMap) {
+                            entry.cached = canReuseCachedShadowMap(cachedShadowMap, state,
+                                    camera.getCullingFrustum());
+                        }
+                        if (sameState && isStaggeredCascade && !entry.cached) {
+                            // cascade 1 is rendered in the first frame of the interval, etc.
+                            uint8_t const interval = options->cascadeUpdateInterval;
+                            bool const scheduled =
+                                    mFrameCount % interval == (shadowIndex - 1) % interval;
+                            entry.cached = !scheduled &&
+                                    isCoveredByCachedCascade(cachedShadowMap,
+                                            state.shadowData.lightFromWorldMatrix,
+                                            state.shadowData.scissorNormalized) &&
+                                    !hasDirtyShadowCasters(Frustum{ mat4f{
+                                            cachedShadowMap.projection * cachedShadowMap.view *
+                                            mat4::translation(-mWorldOrigin) }}, mWorldOrigin);
+                        }
+                        if (entry.hasShadowPass && !entry.cached) {
+                            dirtyLayers |= uint64_t(1) << state.layer;
+                        }
+                    }
+
+                    for (size_t i = 0, c = passList.size(); i < c; i++) {
+                        auto const& entry = passList[i];
+                        ShadowMap const& shadowMap = *entry.shadowMap;
+                        if (dirtyLayers & (uint64_t(1) << shadowMap.getLayer())) {
+                            entry.cached = false;
+                        }
+                        CachedShadowMap& cachedShadowMap =
+                                mCachedShadowMaps[shadowMap.getShadowIndex()];
+                        if (!entry.cached) {
+                            // the shadow map is rendered in this state
+                            cachedShadowMap = states[i];
+                        } else if (shadowMap.isDirectionalShadow()) {
+                            // the shaders must sample the cascade as it was rendered
+                            mShadowUb.edit().shadows[shadowMap.getShadowIndex()] =
+                                    getReprojectedShadowData(cachedShadowMap);
+                        }
+                    }
+                }
+
+                // Generate a RenderPass for each shadow map. This must be done from the main
+                // thread (see RenderPass::appendCommands), but each pass generates its commands
+                // in parallel.
+                for (size_t i = 0, c = passList.size(); i < c; i++) {
+                    auto const& entry = passList[i];
+                    ShadowMap& shadowMap = *entry.shadowMap;
+
+                    Culler::result_type const* const masks = getVisibleMasks(i);
+
+                    if (shadowMap.hasVisibleShadows() && !entry.cached) {
                         // Note: this loop can generate a lot of commands that come out of the
                         //       "per frame command arena". The allocation persists until the
                         //       end of the frame.
@@ -257,15 +714,12 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                                 vsmShadowOptions.highPrecision);
                         shadowMap.commit(transaction, driver);
 
-                        // updatePrimitivesLod must be run before RenderPass::appendCommands.
-                        view.updatePrimitivesLod(engine,
-                                cameraInfo, scene->getRenderableData(), entry.range);
-
                         // generate and sort the commands for rendering the shadow map
                         RenderPass pass(passTemplate);
                         pass.setCamera(cameraInfo);
                         pass.setVisibilityMask(entry.visibilityMask);
-                        pass.setGeometry(scene->getRenderableData(),
+                        pass.setVisibleMasks(masks);
+                        pass.setGeometry(renderableData,
                                 entry.range, scene->getRenderableUBO());
                         pass.appendCommands(engine, RenderPass::SHADOW);
                         pass.sortCommands(engine);
@@ -303,13 +757,21 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
     };
 
     auto const& passList = prepareShadowPass.getData().passList;
-    for (auto const& entry: passList) {
-        if (!entry.shadowMap->hasVisibleShadows()) {
+    for (uint8_t layer = 0; layer < textureRequirements.layers; layer++) {
+        // all the shadow maps packed in a layer are rendered by a single pass
+        ShadowMap const* firstShadowMap = nullptr;
+        for (auto const& entry : passList) {
+            if (entry.shadowMap->getLayer() == layer && entry.shadowMap->hasVisibleShadows()) {
+                entry.hasShadowPass = true;
+                firstShadowMap = firstShadowMap ? firstShadowMap : entry.shadowMap;
+            }
+        }
+        if (!firstShadowMap) {
             continue;
         }
-        
-        const uint8_t layer = entry.shadowMap->getLayer();
-        const auto* options = entry.shadowMap->getShadowOptions();
+
+        // VSM shadow maps are never packed, so there is only one in the layer when blurring
+        const auto* options = firstShadowMap->getShadowOptions();
         const auto msaaSamples = textureRequirements.msaaSamples;
 
         auto& shadowPass = fg.addPass<ShadowPassData>("Shadow Pass",
@@ -383,23 +845,36 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                     // blurring.
                     data.rt = blur ? data.rt : rt;
                 },
-                [=, &engine, &entry](FrameGraphResources const& resources,
+                [=, &engine, &passList = passList](FrameGraphResources const& resources,
                         auto const& data, DriverApi& driver) {
 
-                    // Note: we capture entry by reference here. That's actually okay because
-                    // `entry` lives in `PrepareShadowPassData` which is guaranteed to still
+                    // Note: we capture passList by reference here. That's actually okay because
+                    // it lives in `PrepareShadowPassData` which is guaranteed to still
                     // be alive when we execute here (all passes stay alive until the FrameGraph
                     // is destroyed).
-                    // It wouldn't work to capture by copy because entry.executor wouldn't be
-                    // initialized, as this happens in an `execute` block.
+                    // It wouldn't work to capture by copy because the entries' executors wouldn't
+                    // be initialized, as this happens in an `execute` block.
+                    auto const isInLayer = [layer](auto const& entry) {
+                        return entry.hasShadowPass && entry.shadowMap->getLayer() == layer;
+                    };
+
+                    // the layer still holds last frame's shadow maps, we must not clear it
+                    if (std::all_of(passList.begin(), passList.end(), [&](auto const& entry) {
+                            return !isInLayer(entry) || entry.cached; })) {
+                        return;
+                    }
 
                     auto rt = resources.getRenderPassInfo(data.rt);
 
                     engine.flush();
                     driver.beginRenderPass(rt.target, rt.params);
-                    entry.shadowMap->bind(driver);
-                    entry.executor.overrideScissor(entry.shadowMap->getScissor());
-                    entry.executor.execute(engine, "Shadow Pass");
+                    for (auto const& entry : passList) {
+                        if (isInLayer(entry)) {
+                            entry.shadowMap->bind(driver);
+                            entry.executor.overrideScissor(entry.shadowMap->getScissor());
+                            entry.executor.execute(engine, "Shadow Pass");
+                        }
+                    }
                     driver.endRenderPass();
                 });
 
@@ -432,6 +907,25 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
         }
     }
 
+    // Export the newly created shadow map atlas, so it can be reused next frame. It can only be
+    // imported as a depth attachment if it was used as one.
+    bool const hasShadowPass = std::any_of(passList.begin(), passList.end(),
+            [](auto const& entry) { return entry.hasShadowPass; });
+    if (cacheShadowMaps && !reuseCachedShadowMap && hasShadowPass) {
+        struct ExportShadowMapData {
+            FrameGraphId<FrameGraphTexture> shadows;
+        };
+        fg.addPass<ExportShadowMapData>("Export Shadowmap",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    // the "output" of this pass is imported next frame
+                    builder.sideEffect();
+                    data.shadows = builder.sample(prepareShadowPass->shadows);
+                },
+                [this](FrameGraphResources const& resources, auto const& data, DriverApi&) {
+                    resources.detach(data.shadows, &mCachedShadowMap, &mCachedShadowMapDesc);
+                });
+    }
+
     return prepareShadowPass->shadows;
 }
 
@@ -544,6 +1038,10 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(FEng
             Frustum const& frustum = shadowMap.getCamera().getCullingFrustum();
             FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
                     VISIBLE_DIR_SHADOW_RENDERABLE_BIT);
+            if (engine.debug.shadowmap.receiver_aware_culling) {
+                cullDirectionalShadowCastersByReceivers(MvAtOrigin, view.getVisibleLayers(),
+                        renderableData);
+            }
         }
     }
 
@@ -677,15 +1175,16 @@ void ShadowMapManager::updateSpotVisibilityMasks(
     }
 }
 
-void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
-        FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-        FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-        FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo) noexcept {
+ShadowMap::ShaderParameters ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
+        FEngine& engine, FView const& view, CameraInfo const& mainCameraInfo,
+        FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+        Culler::result_type* visibleMasks,
+        FScene::LightSoa const& lightData,
+        ShadowMap::SceneInfo const& sceneInfo) const noexcept {
     auto& lcm = engine.getLightManager();
 
     const size_t lightIndex = shadowMap.getLightIndex();
     const FLightManager::Instance li = lightData.elementAt<FScene::LIGHT_INSTANCE>(lightIndex);
-    FLightManager::ShadowOptions const* const options = shadowMap.getShadowOptions();
 
     // compute the frustum for this light
     // for spotlights, we cull shadow casters first because we already know the frustum,
@@ -704,9 +1203,8 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
     // Cull shadow casters
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
-    FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
     Culler::intersects(
-            visibleArray + range.first,
+            visibleMasks,
             frustum,
             worldAABBCenter + range.first,
             worldAABBExtent + range.first,
@@ -720,56 +1218,31 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
             view.getVisibleLayers(),
             layers + range.first,
             visibility + range.first,
-            visibleArray + range.first,
+            visibleMasks,
             range.size());
 
     // update the shadow map frustum/camera
     const ShadowMap::ShadowMapInfo shadowMapInfo{
             .atlasDimension      = mTextureAtlasRequirements.size,
-            .textureDimension    = uint16_t(options->mapSize),
-            .shadowDimension     = uint16_t(options->mapSize - 2u),
+            .textureDimension    = shadowMap.getSize(),
+            .shadowDimension     = uint16_t(shadowMap.getSize() - 2u),
             .textureSpaceFlipped = engine.getBackend() == Backend::METAL ||
                                    engine.getBackend() == Backend::VULKAN,
             .vsm                 = view.hasVSM()
     };
 
-    auto shaderParameters = shadowMap.updateSpot(mEngine,
+    return shadowMap.updateSpot(mEngine,
             lightData, lightIndex, mainCameraInfo, shadowMapInfo, *view.getScene(), sceneInfo);
-
-    // and if we need to generate it, update all the UBO data
-    if (shadowMap.hasVisibleShadows()) {
-        const size_t shadowIndex = shadowMap.getShadowIndex();
-        const float wsTexelSizeAtOneMeter = shaderParameters.texelSizeAtOneMeterWs;
-        // note: normalBias is set to zero for VSM
-        const float normalBias = shadowMapInfo.vsm ? 0.0f : options->normalBias;
-
-        auto& s = mShadowUb.edit();
-        const double n = shadowMap.getCamera().getNear();
-        const double f = shadowMap.getCamera().getCullingFar();
-        s.shadows[shadowIndex].layer = shadowMap.getLayer();
-        s.shadows[shadowIndex].lightFromWorldMatrix = shaderParameters.lightSpace;
-        s.shadows[shadowIndex].scissorNormalized = shaderParameters.scissorNormalized;
-        s.shadows[shadowIndex].normalBias = normalBias * wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].lightFromWorldZ = shaderParameters.lightFromWorldZ;
-        s.shadows[shadowIndex].texelSizeAtOneMeter = wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].nearOverFarMinusNear = float(n / (f - n));
-        s.shadows[shadowIndex].elvsm = options->vsm.elvsm;
-        s.shadows[shadowIndex].bulbRadiusLs =
-                mSoftShadowOptions.penumbraScale * options->shadowBulbRadius
-                        / wsTexelSizeAtOneMeter;
-
-    }
 }
 
-void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
-        FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-        FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-        FScene::LightSoa& lightData,
-        ShadowMap::SceneInfo const& sceneInfo) noexcept {
+ShadowMap::ShaderParameters ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
+        FEngine& engine, FView const& view, CameraInfo const& mainCameraInfo,
+        FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+        Culler::result_type* visibleMasks,
+        FScene::LightSoa const& lightData) const noexcept {
 
     const uint8_t face = shadowMap.getFace();
     const size_t lightIndex = shadowMap.getLightIndex();
-    FLightManager::ShadowOptions const* const options = shadowMap.getShadowOptions();
 
     // compute the frustum for this light
     // for spotlights, we cull shadow casters first because we already know the frustum,
@@ -785,9 +1258,8 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
     // Cull shadow casters
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
-    FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
     Culler::intersects(
-            visibleArray + range.first,
+            visibleMasks,
             frustum,
             worldAABBCenter + range.first,
             worldAABBExtent + range.first,
@@ -801,29 +1273,143 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
             view.getVisibleLayers(),
             layers + range.first,
             visibility + range.first,
-            visibleArray + range.first,
+            visibleMasks,
             range.size());
 
     // update the shadow map frustum/camera
     const ShadowMap::ShadowMapInfo shadowMapInfo{
             .atlasDimension      = mTextureAtlasRequirements.size,
-            .textureDimension    = uint16_t(options->mapSize),
-            .shadowDimension     = uint16_t(options->mapSize), // point-lights don't have a border
+            .textureDimension    = shadowMap.getSize(),
+            .shadowDimension     = shadowMap.getSize(), // point-lights don't have a border
             .textureSpaceFlipped = engine.getBackend() == Backend::METAL ||
                                    engine.getBackend() == Backend::VULKAN,
             .vsm                 = view.hasVSM()
     };
 
-    auto shaderParameters = shadowMap.updatePoint(mEngine, lightData, lightIndex,
-            mainCameraInfo, shadowMapInfo, *view.getScene(), face);
+    return shadowMap.updatePoint(mEngine, lightData, lightIndex,
+            mainCameraInfo, shadowMapInfo, visibleMasks, range.size(), face);
+}
+
+void ShadowMapManager::cullDirectionalShadowCastersByReceivers(mat4f const& Mv,
+        uint8_t visibleLayers, FScene::RenderableSoa& renderableData) noexcept {
+    SYSTRACE_CALL();
+
+    // The visible receivers are rasterized, in light-space, into a coarse grid that records the
+    // farthest receiver of each cell. A caster is kept if it covers a cell that has a receiver
+    // farther away from the light than the caster's nearest point.
+    constexpr size_t GRID_SIZE = 32;
+
+    float3 const* const worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* const worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    uint8_t const* const layers = renderableData.data<FScene::LAYERS>();
+    auto const* const visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    FScene::VisibleMaskType* const visibleMasks = renderableData.data<FScene::VISIBLE_MASK>();
+    size_t const count = renderableData.size();
+
+    auto getLightSpaceBounds = [&](size_t i) {
+        Aabb const aabb{ worldAABBCenter[i] - worldAABBExtent[i],
+                         worldAABBCenter[i] + worldAABBExtent[i] };
+        return Aabb::transform(Mv.upperLeft(), Mv[3].xyz, aabb);
+    };
+
+    // receivers visible by the camera, see FView::computeVisibilityMasks()
+    auto isVisibleReceiver = [&](size_t i) {
+        return visibility[i].receiveShadows && (layers[i] & visibleLayers) &&
+               (!visibility[i].culling || (visibleMasks[i] & VISIBLE_RENDERABLE));
+    };
+
+    Aabb receivers;
+    for (size_t i = 0; i < count; i++) {
+        if (isVisibleReceiver(i)) {
+            Aabb const r = getLightSpaceBounds(i);
+            receivers.min = min(receivers.min, r.min);
+            receivers.max = max(receivers.max, r.max);
+        }
+    }
+
+    if (!(receivers.min.x <= receivers.max.x && receivers.min.y <= receivers.max.y)) {
+        // no visible receivers, there are no shadows to render anyway
+        return;
+    }
+
+    float2 const origin = receivers.min.xy;
+    float2 const scale = float(GRID_SIZE) / max(receivers.max.xy - origin, float2(FLT_MIN));
+    auto getCells = [origin, scale](Aabb const& b) {
+        float2 const first = clamp((b.min.xy - origin) * scale, 0.0f, float(GRID_SIZE - 1));
+        float2 const last  = clamp((b.max.xy - origin) * scale, 0.0f, float(GRID_SIZE - 1));
+        return std::pair{ uint2(first), uint2(last) };
+    };
+
+    // the light looks down the -z axis, so the farthest receiver has the lowest z
+    std::array<float, GRID_SIZE * GRID_SIZE> farthestReceiver;
+    farthestReceiver.fill(std::numeric_limits<float>::max());
+    for (size_t i = 0; i < count; i++) {
+        if (isVisibleReceiver(i)) {
+            Aabb const r = getLightSpaceBounds(i);
+            auto const [first, last] = getCells(r);
+            for (size_t y = first.y; y <= last.y; y++) {
+                for (size_t x = first.x; x <= last.x; x++) {
+                    float& z = farthestReceiver[y * GRID_SIZE + x];
+                    z = std::min(z, r.min.z);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!(visibleMasks[i] & VISIBLE_DIR_SHADOW_RENDERABLE)) {
+            continue;
+        }
+        Aabb const c = getLightSpaceBounds(i);
+        bool castsOnReceiver = false;
+        if (c.max.x >= receivers.min.x && c.min.x <= receivers.max.x &&
+            c.max.y >= receivers.min.y && c.min.y <= receivers.max.y) {
+            auto const [first, last] = getCells(c);
+            for (size_t y = first.y; y <= last.y && !castsOnReceiver; y++) {
+                for (size_t x = first.x; x <= last.x && !castsOnReceiver; x++) {
+                    castsOnReceiver = farthestReceiver[y * GRID_SIZE + x] <= c.max.z;
+                }
+            }
+        }
+        if (!castsOnReceiver) {
+            visibleMasks[i] &= ~VISIBLE_DIR_SHADOW_RENDERABLE;
+        }
+    }
+}
 
+void ShadowMapManager::cullCascadeShadowCasters(Frustum const& frustum,
+        FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+        Culler::result_type* visibleMasks) noexcept {
+    float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    Culler::intersects(
+            visibleMasks,
+            frustum,
+            worldAABBCenter + range.first,
+            worldAABBExtent + range.first,
+            range.size(),
+            VISIBLE_DIR_SHADOW_RENDERABLE_BIT);
+
+    // The cascade can only render the casters selected for the whole directional shadow map, and
+    // those that aren't culled are always rendered (see FView::computeVisibilityMasks()).
+    auto const* const sceneMasks = renderableData.data<FScene::VISIBLE_MASK>() + range.first;
+    auto const* const visibility = renderableData.data<FScene::VISIBILITY_STATE>() + range.first;
+    for (size_t i = 0, c = range.size(); i < c; i++) {
+        Culler::result_type const culled = visibility[i].culling ?
+                visibleMasks[i] : Culler::result_type(VISIBLE_DIR_SHADOW_RENDERABLE);
+        visibleMasks[i] = sceneMasks[i] & culled;
+    }
+}
 
-    // and if we need to generate it, update all the UBO data
+void ShadowMapManager::updateShadowUniforms(ShadowMap const& shadowMap, bool vsm,
+        ShadowMap::ShaderParameters const& shaderParameters) noexcept {
+    // if we need to generate this shadow map, update all the UBO data
     if (shadowMap.hasVisibleShadows()) {
+        FLightManager::ShadowOptions const* const options = shadowMap.getShadowOptions();
         const size_t shadowIndex = shadowMap.getShadowIndex();
         const float wsTexelSizeAtOneMeter = shaderParameters.texelSizeAtOneMeterWs;
         // note: normalBias is set to zero for VSM
-        const float normalBias = shadowMapInfo.vsm ? 0.0f : options->normalBias;
+        const float normalBias = vsm ? 0.0f : options->normalBias;
 
         auto& s = mShadowUb.edit();
         const double n = shadowMap.getCamera().getNear();
@@ -883,13 +1469,30 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateSpotShadowMaps(FEngine
     return shadowTechnique;
 }
 
+// Returns the fraction of the viewport height covered by a light's sphere of influence.
+static float computeScreenCoverage(CameraInfo const& camera, float4 const& sphere) noexcept {
+    float3 const center = (camera.view * float4{ sphere.xyz, 1.0f }).xyz;
+    float const r = sphere.w;
+    float const d2 = dot(center, center);
+    if (d2 <= r * r) {
+        // the camera is inside the light's sphere of influence
+        return 1.0f;
+    }
+    if (center.z - r > 0.0f) {
+        // the light's sphere of influence is entirely behind the camera
+        return 0.0f;
+    }
+    // tangent of the sphere's half angle, scaled to NDC
+    return std::min(1.0f, r * camera.projection[1][1] / std::sqrt(d2 - r * r));
+}
+
 void ShadowMapManager::calculateTextureRequirements(FEngine& engine, FView& view,
-        FScene::LightSoa const&) noexcept {
+        CameraInfo const& cameraInfo, FScene::LightSoa const& lightData) noexcept {
 
-    // Lay out the shadow maps. For now, we take the largest requested dimension and allocate a
-    // texture of that size. Each cascade / shadow map gets its own layer in the array texture.
-    // The directional shadow cascades start on layer 0, followed by spotlights.
-    uint8_t layer = 0;
+    // Lay out the shadow maps. We take the largest requested dimension and allocate a texture
+    // of that size. Each cascade gets its own layer in the array texture, starting on layer 0.
+    // The spot and point shadow maps are packed in the remaining layers by an AtlasAllocator,
+    // possibly at a lower resolution than requested, to honor the View's texel budget.
     uint32_t maxDimension = 0;
     bool elvsm = false;
     for (ShadowMap& shadowMap : getCascadedShadowMap()) {
@@ -897,13 +1500,117 @@ void ShadowMapManager::calculateTextureRequirements(FEngine& engine, FView& view
         auto const& options = shadowMap.getShadowOptions();
         maxDimension = std::max(maxDimension, options->mapSize);
         elvsm = elvsm || options->vsm.elvsm;
-        shadowMap.setLayer(layer++);
     }
     for (ShadowMap& shadowMap : getSpotShadowMaps()) {
         auto const& options = shadowMap.getShadowOptions();
         maxDimension = std::max(maxDimension, options->mapSize);
         elvsm = elvsm || options->vsm.elvsm;
-        shadowMap.setLayer(layer++);
+    }
+
+    // VSM shadow maps are blurred and mipmapped a layer at a time, so they can't be packed.
+    // AtlasAllocator only handles power-of-two sizes.
+    bool const packShadowMaps = !view.hasVSM() &&
+            maxDimension && !(maxDimension & (maxDimension - 1u));
+
+    uint8_t layer = 0;
+    if (!packShadowMaps) {
+        for (ShadowMap& shadowMap : getCascadedShadowMap()) {
+            uint32_t const dim = shadowMap.getShadowOptions()->mapSize;
+            shadowMap.setAllocation(layer++, { 0, 0, dim, dim });
+        }
+        for (ShadowMap& shadowMap : getSpotShadowMaps()) {
+            uint32_t const dim = shadowMap.getShadowOptions()->mapSize;
+            shadowMap.setAllocation(layer++, { 0, 0, dim, dim });
+        }
+    } else {
+        // A shadow map that doesn't fit in the atlas gets a layer of its own, after the atlas's.
+        // This can't exceed the layer limit, because each layer holds at least one shadow map.
+        static_assert(CONFIG_MAX_SHADOW_LAYERS >= CONFIG_MAX_SHADOWMAPS);
+        std::array<std::pair<ShadowMap*, uint32_t>, CONFIG_MAX_SHADOWMAPS> overflow; // NOLINT
+        size_t overflowCount = 0;
+
+        AtlasAllocator allocator(maxDimension);
+        for (ShadowMap& shadowMap : getCascadedShadowMap()) {
+            uint32_t const dim = shadowMap.getShadowOptions()->mapSize;
+            AtlasAllocator::Allocation const allocation = allocator.allocate(maxDimension);
+            if (UTILS_UNLIKELY(allocation.layer < 0)) {
+                overflow[overflowCount++] = { &shadowMap, dim };
+                continue;
+            }
+            shadowMap.setAllocation(uint8_t(allocation.layer), { 0, 0, dim, dim });
+            layer = std::max(layer, uint8_t(allocation.layer + 1));
+        }
+
+        // the smallest size AtlasAllocator can allocate
+        uint32_t const minDimension = maxDimension >> 3u;
+        auto const nextPowerOfTwo = [](uint32_t x) -> uint32_t {
+            return x <= 1u ? 1u : 1u << (32u - utils::clz(x - 1u));
+        };
+
+        utils::Slice<ShadowMap> spotShadowMaps = getSpotShadowMaps();
+        std::array<uint32_t, CONFIG_MAX_SHADOWMAPS> sizes; // NOLINT
+        for (size_t i = 0, c = spotShadowMaps.size(); i < c; i++) {
+            uint32_t const mapSize = spotShadowMaps[i].getShadowOptions()->mapSize;
+            sizes[i] = std::clamp(nextPowerOfTwo(mapSize), minDimension, maxDimension);
+        }
+
+        uint32_t const texelBudget = view.getShadowTexelBudget();
+        if (texelBudget) {
+            // size each shadow map after the screen coverage of its light...
+            std::array<float, CONFIG_MAX_SHADOWMAPS> coverage; // NOLINT
+            uint64_t texelCount = 0;
+            for (size_t i = 0, c = spotShadowMaps.size(); i < c; i++) {
+                size_t const lightIndex = spotShadowMaps[i].getLightIndex();
+                coverage[i] = computeScreenCoverage(cameraInfo,
+                        lightData.elementAt<FScene::POSITION_RADIUS>(lightIndex));
+                uint32_t const size = uint32_t(std::ceil(float(sizes[i]) * coverage[i]));
+                sizes[i] = std::clamp(nextPowerOfTwo(size), minDimension, sizes[i]);
+                texelCount += uint64_t(sizes[i]) * sizes[i];
+            }
+
+            // ...then halve the shadow maps of the lights covering the least of the screen
+            // until we're within budget. All the faces of a point light keep the same size.
+            while (texelCount > texelBudget) {
+                size_t candidate = spotShadowMaps.size();
+                for (size_t i = 0, c = spotShadowMaps.size(); i < c; i++) {
+                    if (sizes[i] > minDimension &&
+                            (candidate == c || coverage[i] < coverage[candidate])) {
+                        candidate = i;
+                    }
+                }
+                if (candidate == spotShadowMaps.size()) {
+                    break;
+                }
+                size_t const lightIndex = spotShadowMaps[candidate].getLightIndex();
+                for (size_t i = 0, c = spotShadowMaps.size(); i < c; i++) {
+                    if (spotShadowMaps[i].getLightIndex() == lightIndex) {
+                        texelCount -= 3u * (uint64_t(sizes[i]) * sizes[i]) / 4u;
+                        sizes[i] /= 2u;
+                    }
+                }
+            }
+        }
+
+        // allocate the largest shadow maps first, so the smaller ones fill the gaps
+        std::array<uint8_t, CONFIG_MAX_SHADOWMAPS> order; // NOLINT
+        std::iota(order.begin(), order.begin() + spotShadowMaps.size(), 0);
+        std::stable_sort(order.begin(), order.begin() + spotShadowMaps.size(),
+                [&sizes](uint8_t lhs, uint8_t rhs) { return sizes[lhs] > sizes[rhs]; });
+        for (size_t i = 0, c = spotShadowMaps.size(); i < c; i++) {
+            AtlasAllocator::Allocation const allocation = allocator.allocate(sizes[order[i]]);
+            if (UTILS_UNLIKELY(allocation.layer < 0)) {
+                overflow[overflowCount++] = { &spotShadowMaps[order[i]], sizes[order[i]] };
+                continue;
+            }
+            spotShadowMaps[order[i]].setAllocation(uint8_t(allocation.layer), allocation.viewport);
+            layer = std::max(layer, uint8_t(allocation.layer + 1));
+        }
+
+        for (size_t i = 0; i < overflowCount; i++) {
+            auto const [shadowMap, dim] = overflow[i];
+            assert_invariant(layer < CONFIG_MAX_SHADOW_LAYERS);
+            shadowMap->setAllocation(layer++, { 0, 0, dim, dim });
+        }
     }
 
     const uint8_t layersNeeded = layer;
@@ -25,6 +25,10 @@
 #include "details/Engine.h"
 #include "details/Scene.h"
 
+#include "fg/FrameGraphTexture.h"
+
+#include <filament/Box.h>
+
 #include <private/filament/EngineEnums.h>
 
 #include <backend/DriverApiForward.h>
@@ -37,11 +41,16 @@
 
 #include <array>
 #include <memory>
+#include <vector>
+
+// for gtest
+class FilamentTest_ShadowMapCache_Test;
 
 namespace filament {
 
 class FView;
 class FrameGraph;
+class Frustum;
 class RenderPass;
 
 struct ShadowMappingUniforms {
@@ -79,6 +88,13 @@ public:
     void addShadowMap(size_t lightIndex, bool spotlight,
             LightManager::ShadowOptions const* options) noexcept;
 
+    // Finds the shadow casters that changed since the previous frame, when some shadow maps are
+    // cached (see ShadowOptions::cacheShadowMap and ShadowOptions::cascadeUpdateInterval).
+    // This must be called before FView::prepare() reorders the renderables.
+    void updateShadowCasters(FEngine& engine, FView const& view, CameraInfo const& cameraInfo,
+            FScene::RenderableSoa const& renderableData,
+            FScene::LightSoa const& lightData) noexcept;
+
     // Updates all the shadow maps and performs culling.
     // Returns true if any of the shadow maps have visible shadows.
     ShadowMapManager::ShadowTechnique update(FEngine& engine, FView& view,
@@ -104,6 +120,8 @@ public:
     }
 
 private:
+    friend class ::FilamentTest_ShadowMapCache_Test;
+
     ShadowMapManager::ShadowTechnique updateCascadeShadowMaps(FEngine& engine,
             FView& view, CameraInfo cameraInfo, FScene::RenderableSoa& renderableData,
             FScene::LightSoa const& lightData, ShadowMap::SceneInfo sceneInfo) noexcept;
@@ -111,19 +129,48 @@ private:
     ShadowMapManager::ShadowTechnique updateSpotShadowMaps(FEngine& engine,
             FScene::LightSoa const& lightData) noexcept;
 
-    void calculateTextureRequirements(FEngine&, FView& view,
-            FScene::LightSoa const&) noexcept;
-
-    void prepareSpotShadowMap(ShadowMap& shadowMap,
-            FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-            FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo) noexcept;
+    void calculateTextureRequirements(FEngine&, FView& view, CameraInfo const& cameraInfo,
+            FScene::LightSoa const& lightData) noexcept;
 
-    void preparePointShadowMap(ShadowMap& map,
-            FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-            FScene::LightSoa& lightData,
-            ShadowMap::SceneInfo const& sceneInfo) noexcept;
+    // Culls the shadow casters of a spot or point shadow map and updates its camera.
+    // The casters' visibility is written in visibleMasks, this shadow map's copy of the
+    // VISIBLE_MASK of the renderables in range (with a capacity rounded up to 16), instead of
+    // the scene's. This only modifies per-shadow-map state, so several shadow maps can be
+    // prepared concurrently.
+    ShadowMap::ShaderParameters prepareSpotShadowMap(ShadowMap& shadowMap,
+            FEngine& engine, FView const& view, CameraInfo const& mainCameraInfo,
+            FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+            Culler::result_type* visibleMasks,
+            FScene::LightSoa const& lightData,
+            ShadowMap::SceneInfo const& sceneInfo) const noexcept;
+
+    ShadowMap::ShaderParameters preparePointShadowMap(ShadowMap& map,
+            FEngine& engine, FView const& view, CameraInfo const& mainCameraInfo,
+            FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+            Culler::result_type* visibleMasks,
+            FScene::LightSoa const& lightData) const noexcept;
+
+    // updates the uniforms of a prepared spot or point shadow map, if it has visible shadows
+    void updateShadowUniforms(ShadowMap const& shadowMap, bool vsm,
+            ShadowMap::ShaderParameters const& shaderParameters) noexcept;
+
+    // Removes the directional shadow casters that can't cast a shadow on any visible receiver,
+    // i.e. whose light-space footprint doesn't overlap a visible receiver farther from the light.
+    // The result is shared by all cascades.
+    static void cullDirectionalShadowCastersByReceivers(math::mat4f const& Mv,
+            uint8_t visibleLayers, FScene::RenderableSoa& renderableData) noexcept;
+
+    // Culls the directional shadow casters against the frustum of a single cascade. The result is
+    // written in visibleMasks, this cascade's copy of the VISIBLE_MASK of the renderables in range
+    // (with a capacity rounded up to 16).
+    static void cullCascadeShadowCasters(Frustum const& frustum,
+            FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+            Culler::result_type* visibleMasks) noexcept;
+
+    // Whether a shadow caster that changed since the previous frame intersects the frustum.
+    // worldOrigin is the translation of the world origin the frustum is relative to.
+    bool hasDirtyShadowCasters(Frustum const& frustum,
+            math::float3 const& worldOrigin) const noexcept;
 
     static void updateSpotVisibilityMasks(
             uint8_t visibleLayers,
@@ -180,6 +227,75 @@ private:
 
     ShadowMap::SceneInfo mSceneInfo;
 
+    // State of a renderable in the previous frame, used to find the shadow casters that changed.
+    // The positions are independent of the world origin (i.e. of the camera position).
+    struct ShadowCasterState {
+        math::mat4f worldTransform;
+        math::float3 center;
+        math::float3 halfExtent;
+        FRenderableManager::Instance instance;
+        uint8_t layers = 0;
+        bool castShadows = false;
+    };
+
+    // The state a shadow map of the cached shadow map atlas was rendered with
+    struct CachedShadowMap {
+        ShadowUib::ShadowData shadowData;
+        math::mat4 projection;
+        math::mat4 view;        // independent of the world origin
+        math::float3 worldOrigin;
+        Viewport viewport;
+        FLightManager::Instance light;
+        ShadowType type = ShadowType::DIRECTIONAL;
+        uint8_t layer = 0;
+        uint8_t face = 0;
+        uint8_t visibleLayers = 0;
+        float polygonOffsetConstant = 0.0f;
+        float polygonOffsetSlope = 0.0f;
+        uint64_t shadowCasters = 0;     // see hashShadowCasters()
+        bool valid = false;
+    };
+
+    // Whether a shadow map was cached in the same state, i.e. with the same options, at the same
+    // place in the atlas and with the same shadow casters.
+    static bool isSameCachedState(CachedShadowMap const& cachedShadowMap,
+            CachedShadowMap const& state) noexcept;
+
+    // An order-independent hash of the shadow casters a shadow map renders, i.e. of the
+    // renderables in range whose visible mask has one of the bits of visibilityMask. visibleMasks
+    // is indexed from range.first.
+    static uint64_t hashShadowCasters(FScene::RenderableSoa const& renderableData,
+            utils::Range<uint32_t> range, Culler::result_type const* visibleMasks,
+            FScene::VisibleMaskType visibilityMask) noexcept;
+
+    // Whether a shadow map can be reused from the cached atlas: it was cached in the same state,
+    // with the same matrices, and no dirty shadow caster intersects its culling frustum.
+    bool canReuseCachedShadowMap(CachedShadowMap const& cachedShadowMap,
+            CachedShadowMap const& state, Frustum const& frustum) const noexcept;
+
+    // The shader parameters of a cached shadow map, for the current world origin
+    ShadowUib::ShadowData getReprojectedShadowData(
+            CachedShadowMap const& cachedShadowMap) const noexcept;
+
+    // Whether a cached cascade covers the light volume of the current frame's cascade, given by
+    // the latter's light space transform and scissor.
+    bool isCoveredByCachedCascade(CachedShadowMap const& cachedShadowMap,
+            math::mat4f const& lightFromWorld, math::float4 const& scissor) const noexcept;
+
+    // Shadow map caching: the atlas is kept across frames, and the layers holding the shadow maps
+    // that are cached are only rendered when the CachedShadowMap state of one of their shadow
+    // maps changed or when a dirty shadow caster intersects its frustum. The cascades updated
+    // at a reduced rate are kept in the same way, in the frames they're not scheduled.
+    bool mCacheShadowMaps = false;
+    bool mAllShadowCastersDirty = true;
+    uint32_t mFrameCount = 0;
+    math::float3 mWorldOrigin;
+    std::vector<ShadowCasterState> mShadowCasters;
+    std::vector<Box> mDirtyShadowCasters;
+    std::array<CachedShadowMap, CONFIG_MAX_SHADOWMAPS> mCachedShadowMaps;
+    FrameGraphTexture mCachedShadowMap;
+    FrameGraphTexture::Descriptor mCachedShadowMapDesc;
+
     // Inline storage for all our ShadowMap objects, we can't easily use a std::array<> directly.
     // Because ShadowMap doesn't have a default ctor, and we avoid out-of-line allocations.
     // Each ShadowMap is currently 40 bytes (total of 2.5KB for 64 shadow maps)
@@ -31,7 +31,10 @@
 #include <math/mat3.h>
 #include <math/mat4.h>
 
+#include <limits>
+
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 namespace filament {
@@ -69,7 +72,8 @@ public:
     // invalidate a range of uniforms and return a pointer to it. offset and size given in bytes
     void* invalidateUniforms(size_t offset, size_t size) {
         assert_invariant(offset + size <= mSize);
-        mSomethingDirty = true;
+        mDirtyBegin = std::min(mDirtyBegin, uint32_t(offset));
+        mDirtyEnd = std::max(mDirtyEnd, uint32_t(offset + size));
         return static_cast<char*>(mBuffer) + offset;
     }
 
@@ -84,10 +88,17 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // return if any uniform has been changed
-    bool isDirty() const noexcept { return mSomethingDirty; }
+    bool isDirty() const noexcept { return mDirtyBegin < mDirtyEnd; }
+
+    // the smallest range, in bytes, that contains all the modified uniforms
+    size_t getDirtyOffset() const noexcept { return isDirty() ? mDirtyBegin : 0; }
+    size_t getDirtySize() const noexcept { return isDirty() ? mDirtyEnd - mDirtyBegin : 0; }
 
     // mark the whole buffer as clean (no modified uniforms)
-    void clean() const noexcept { mSomethingDirty = false; }
+    void clean() const noexcept {
+        mDirtyBegin = std::numeric_limits<uint32_t>::max();
+        mDirtyEnd = 0;
+    }
 
     /*
      * -----------------------------------------------
@@ -166,6 +177,12 @@ public:
         return toBufferDescriptor(driver, 0, getSize());
     }
 
+    // copy the modified uniforms and cleans the dirty bits, the data must be uploaded at
+    // getDirtyOffset().
+    backend::BufferDescriptor toDirtyBufferDescriptor(backend::DriverApi& driver) const noexcept {
+        return toBufferDescriptor(driver, getDirtyOffset(), getDirtySize());
+    }
+
     // copy the UBO data and cleans the dirty bits
     backend::BufferDescriptor toBufferDescriptor(
             backend::DriverApi& driver, size_t offset, size_t size) const noexcept {
@@ -203,7 +220,9 @@ private:
     char mStorage[96];
     void *mBuffer = nullptr;
     uint32_t mSize = 0;
-    mutable bool mSomethingDirty = false;
+    // modified range, empty when mDirtyBegin >= mDirtyEnd
+    mutable uint32_t mDirtyBegin = std::numeric_limits<uint32_t>::max();
+    mutable uint32_t mDirtyEnd = 0;
 };
 
 // specialization for mat3f (which has a different alignment, see std140 layout rules)
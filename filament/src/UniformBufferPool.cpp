@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UniformBufferPool.h"
+
+#include "UniformBuffer.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/DriverEnums.h>
+
+#include <utils/debug.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <string.h>
+
+namespace filament {
+
+using namespace backend;
+
+UniformBufferPool::UniformBufferPool(size_t bufferSize) noexcept
+        : mBufferSize(uint32_t(bufferSize)) {
+    // a buffer holds at least one slot of each size class
+    if (mBufferSize) {
+        mBufferSize = std::max(mBufferSize, MAX_SLOT_SIZE);
+        mBufferSize = (mBufferSize + MAX_SLOT_SIZE - 1) & ~(MAX_SLOT_SIZE - 1);
+    }
+}
+
+UniformBufferPool::~UniformBufferPool() noexcept = default;
+
+void UniformBufferPool::terminate(DriverApi&) noexcept {
+    // all the slots must have been freed, which destroyed the buffer objects
+    assert_invariant(std::none_of(mBuffers.begin(), mBuffers.end(),
+            [](Buffer const& buffer) { return bool(buffer.handle); }));
+    mBuffers.clear();
+}
+
+UniformBufferPool::Slot UniformBufferPool::allocate(DriverApi& driver, size_t size) noexcept {
+    if (!isEnabled() || size > MAX_SLOT_SIZE) {
+        return {};
+    }
+
+    uint32_t slotSize = SLOT_ALIGNMENT;
+    while (slotSize < size) {
+        slotSize *= 2;
+    }
+
+    auto pos = std::find_if(mBuffers.begin(), mBuffers.end(), [slotSize](Buffer const& buffer) {
+        return buffer.handle && buffer.slotSize == slotSize && !buffer.freeSlots.empty();
+    });
+
+    if (pos == mBuffers.end()) {
+        // reuse the entry of a destroyed buffer object, so that the other slots keep their index
+        pos = std::find_if(mBuffers.begin(), mBuffers.end(),
+                [](Buffer const& buffer) { return !buffer.handle; });
+        if (pos == mBuffers.end()) {
+            if (mBuffers.size() > std::numeric_limits<uint16_t>::max()) {
+                return {};
+            }
+            pos = mBuffers.insert(mBuffers.end(), Buffer{});
+        }
+        Buffer buffer{
+                driver.createBufferObject(mBufferSize,
+                        BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC),
+                slotSize,
+                std::make_unique<char[]>(mBufferSize),
+                {},
+                std::numeric_limits<uint32_t>::max(), 0 };
+        // allocate the slots from the start of the buffer
+        for (uint32_t offset = mBufferSize; offset > 0; offset -= slotSize) {
+            buffer.freeSlots.push_back(offset - slotSize);
+        }
+        *pos = std::move(buffer);
+    }
+
+    uint32_t const offset = pos->freeSlots.back();
+    pos->freeSlots.pop_back();
+    return { pos->handle, offset, uint16_t(pos - mBuffers.begin()) };
+}
+
+void UniformBufferPool::free(DriverApi& driver, Slot const& slot) noexcept {
+    if (slot) {
+        assert_invariant(slot.buffer < mBuffers.size());
+        Buffer& buffer = mBuffers[slot.buffer];
+        assert_invariant(buffer.handle == slot.handle);
+        buffer.freeSlots.push_back(slot.offset);
+        if (buffer.freeSlots.size() == mBufferSize / buffer.slotSize) {
+            driver.destroyBufferObject(buffer.handle);
+            buffer = {};
+        }
+    }
+}
+
+void UniformBufferPool::commit(Slot const& slot, UniformBuffer const& ub) noexcept {
+    assert_invariant(slot.buffer < mBuffers.size());
+    if (!ub.isDirty()) {
+        return;
+    }
+
+    Buffer& buffer = mBuffers[slot.buffer];
+    uint32_t const offset = slot.offset + uint32_t(ub.getDirtyOffset());
+    uint32_t const size = uint32_t(ub.getDirtySize());
+    assert_invariant(ub.getSize() <= buffer.slotSize);
+
+    memcpy(buffer.data.get() + offset,
+            static_cast<char const*>(ub.getBuffer()) + ub.getDirtyOffset(), size);
+    ub.clean();
+
+    buffer.dirtyBegin = std::min(buffer.dirtyBegin, offset);
+    buffer.dirtyEnd = std::max(buffer.dirtyEnd, offset + size);
+}
+
+void UniformBufferPool::flush(DriverApi& driver) noexcept {
+    for (Buffer& buffer : mBuffers) {
+        if (buffer.dirtyBegin < buffer.dirtyEnd) {
+            upload(driver, buffer);
+        }
+    }
+}
+
+void UniformBufferPool::upload(DriverApi& driver, Buffer& buffer) noexcept {
+    // the CPU copy is always up-to-date, so the unmodified slots of the range are uploaded
+    // unchanged.
+    uint32_t const offset = buffer.dirtyBegin;
+    uint32_t const size = buffer.dirtyEnd - buffer.dirtyBegin;
+    BufferDescriptor bd;
+    bd.size = size;
+    bd.buffer = driver.allocate(size);
+    memcpy(bd.buffer, buffer.data.get() + offset, size);
+    driver.updateBufferObject(buffer.handle, std::move(bd), offset);
+    buffer.dirtyBegin = std::numeric_limits<uint32_t>::max();
+    buffer.dirtyEnd = 0;
+}
+
+} // namespace filament
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_UNIFORMBUFFERPOOL_H
+#define TNT_FILAMENT_UNIFORMBUFFERPOOL_H
+
+#include "private/backend/DriverApi.h"
+
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+
+#include <memory>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// for gtest
+class FilamentTest_UniformBufferPool_Test;
+
+namespace filament {
+
+class UniformBuffer;
+
+/*
+ * UniformBufferPool sub-allocates small uniform buffers (e.g. the ones of material instances)
+ * from a few large buffer objects, to reduce the number of buffer objects and of uploads.
+ *
+ * Slots are allocated in power-of-two size classes, aligned to the strictest uniform buffer
+ * offset alignment we support. The pool keeps a CPU copy of each buffer object, commits only
+ * update that copy, and flush() uploads all the modified slots of a buffer object with a single
+ * update, so that we never issue several partial updates of a buffer object per frame.
+ */
+class UniformBufferPool {
+public:
+    // offset alignment required by bindBufferRange() on all backends
+    static constexpr uint32_t SLOT_ALIGNMENT = 256;
+
+    // larger uniform buffers are not pooled
+    static constexpr uint32_t MAX_SLOT_SIZE = 1024;
+
+    struct Slot {
+        backend::BufferObjectHandle handle;
+        uint32_t offset = 0;
+        uint16_t buffer = 0;
+        explicit operator bool() const noexcept { return bool(handle); }
+    };
+
+    // bufferSize is the size of each buffer object in bytes, 0 disables the pool
+    explicit UniformBufferPool(size_t bufferSize) noexcept;
+    ~UniformBufferPool() noexcept;
+
+    UniformBufferPool(UniformBufferPool const& rhs) = delete;
+    UniformBufferPool& operator=(UniformBufferPool const& rhs) = delete;
+
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    bool isEnabled() const noexcept { return mBufferSize != 0; }
+
+    // Returns a slot of at least size bytes, or an empty slot if the pool is disabled or size is
+    // too large, in which case the caller should use its own buffer object.
+    Slot allocate(backend::DriverApi& driver, size_t size) noexcept;
+
+    // Frees a slot, the buffer object is destroyed once all its slots are free.
+    void free(backend::DriverApi& driver, Slot const& slot) noexcept;
+
+    // Copies the modified uniforms of ub to its slot and cleans ub. The upload is deferred until
+    // the next flush().
+    void commit(Slot const& slot, UniformBuffer const& ub) noexcept;
+
+    // Uploads the pending commits of the buffer object of slot, this must be called before the
+    // slot is used.
+    void flush(backend::DriverApi& driver, Slot const& slot) noexcept {
+        assert_invariant(slot.buffer < mBuffers.size());
+        Buffer& buffer = mBuffers[slot.buffer];
+        if (UTILS_UNLIKELY(buffer.dirtyBegin < buffer.dirtyEnd)) {
+            upload(driver, buffer);
+        }
+    }
+
+    // Uploads the pending commits of all buffer objects.
+    void flush(backend::DriverApi& driver) noexcept;
+
+private:
+    friend class ::FilamentTest_UniformBufferPool_Test;
+
+    // a Buffer with a null handle was destroyed, its entry is reused by the next buffer object
+    struct Buffer {
+        backend::BufferObjectHandle handle;
+        uint32_t slotSize;
+        std::unique_ptr<char[]> data;   // copy of the buffer object's content
+        std::vector<uint32_t> freeSlots;
+        uint32_t dirtyBegin;
+        uint32_t dirtyEnd;
+    };
+
+    void upload(backend::DriverApi& driver, Buffer& buffer) noexcept;
+
+    std::vector<Buffer> mBuffers;
+    uint32_t mBufferSize;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_UNIFORMBUFFERPOOL_H
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VariantUsage.h"
+
+#include "details/Material.h"
+
+#include <filament/MaterialEnums.h>
+
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Systrace.h>
+
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+
+namespace {
+
+// The list starts with a Header, followed by one Record per material.
+
+constexpr char LIST_MAGIC[4] = { 'F', 'V', 'A', 'R' };
+constexpr uint32_t LIST_VERSION = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t materialVersion;
+    uint32_t count;
+};
+
+struct Record {
+    uint64_t key;
+    uint64_t variants[VARIANT_COUNT / 64];
+};
+
+static_assert(sizeof(Header) == 16);
+static_assert(sizeof(Record) == 8 + VARIANT_COUNT / 8);
+
+} // anonymous namespace
+
+VariantUsage::VariantUsage() noexcept = default;
+
+VariantUsage::~VariantUsage() noexcept = default;
+
+uint64_t VariantUsage::getMaterialKey(FMaterial const& material) noexcept {
+    // the key must be the same from one run to the next, so we can't use std::hash
+    CString const& name = material.getName();
+    uint32_t const nameHash = name.empty() ? 0 :
+            hash::murmurSlow((uint8_t const*)name.c_str(), name.size(), 0);
+    return material.getCacheId() ^ (uint64_t(nameHash) * 0x9E3779B97F4A7C15u);
+}
+
+void VariantUsage::onMaterialDestroyed(FMaterial const& material) noexcept {
+    VariantList const& variants = material.getUsedVariants();
+    if (variants.any()) {
+        mRecorded[getMaterialKey(material)] |= variants;
+    }
+}
+
+void VariantUsage::onMaterialCreated(FMaterial& material) noexcept {
+    if (UTILS_LIKELY(mPending.empty())) {
+        return;
+    }
+    auto const pos = mPending.find(getMaterialKey(material));
+    if (pos == mPending.end()) {
+        return;
+    }
+    VariantList const variants = pos->second;
+    mPending.erase(pos);
+
+    material.compile(backend::CompilerPriorityQueue::LOW, variants, mHandler,
+            [progress = mProgress](Material*) {
+                progress->compiled++;
+                if (progress->callback) {
+                    progress->callback(progress->compiled, progress->total);
+                }
+            });
+}
+
+size_t VariantUsage::serialize(ResourceList<FMaterial> const& materials,
+        void* data, size_t size) const noexcept {
+    SYSTRACE_CALL();
+
+    std::unordered_map<uint64_t, VariantList> usage = mRecorded;
+    materials.forEach([&usage](FMaterial const* material) {
+        VariantList const& variants = material->getUsedVariants();
+        if (variants.any()) {
+            usage[getMaterialKey(*material)] |= variants;
+        }
+    });
+
+    size_t const listSize = sizeof(Header) + usage.size() * sizeof(Record);
+    if (!data || size < listSize) {
+        return listSize;
+    }
+
+    Header header{};
+    memcpy(header.magic, LIST_MAGIC, sizeof(LIST_MAGIC));
+    header.version = LIST_VERSION;
+    header.materialVersion = uint32_t(MATERIAL_VERSION);
+    header.count = uint32_t(usage.size());
+
+    char* p = static_cast<char*>(data);
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    for (auto const& [key, variants] : usage) {
+        Record record{ key, {} };
+        for (size_t i = 0; i < VARIANT_COUNT / 64; i++) {
+            record.variants[i] = variants.getBitsAt(i);
+        }
+        memcpy(p, &record, sizeof(record));
+        p += sizeof(record);
+    }
+    return listSize;
+}
+
+bool VariantUsage::warmUp(ResourceList<FMaterial> const& materials, void const* data, size_t size,
+        backend::CallbackHandler* handler, ProgressCallback&& progress) noexcept {
+    SYSTRACE_CALL();
+
+    Header header{};
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, LIST_MAGIC, sizeof(LIST_MAGIC)) != 0 ||
+            header.version != LIST_VERSION ||
+            size < sizeof(Header) + size_t(header.count) * sizeof(Record)) {
+        slog.w << "Invalid list of material variants" << io::endl;
+        return false;
+    }
+    if (header.materialVersion != MATERIAL_VERSION) {
+        // the variants might have changed meaning
+        slog.w << "Ignoring list of material variants from material version "
+               << header.materialVersion << io::endl;
+        return false;
+    }
+
+    mPending.clear();
+    char const* p = static_cast<char const*>(data) + sizeof(header);
+    for (uint32_t i = 0; i < header.count; i++, p += sizeof(Record)) {
+        Record record{};
+        memcpy(&record, p, sizeof(record));
+        VariantList& variants = mPending[record.key];
+        for (size_t j = 0; j < VARIANT_COUNT / 64; j++) {
+            variants.getBitsAt(j) |= record.variants[j];
+        }
+    }
+
+    mHandler = handler;
+    mProgress = std::make_shared<Progress>();
+    mProgress->callback = std::move(progress);
+    mProgress->total = mPending.size();
+
+    // the materials created later are handled by onMaterialCreated()
+    materials.forEach([this](FMaterial* material) {
+        onMaterialCreated(*material);
+    });
+    return true;
+}
+
+} // namespace filament
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_VARIANTUSAGE_H
+#define TNT_FILAMENT_VARIANTUSAGE_H
+
+#include "ResourceList.h"
+
+#include <private/filament/Variant.h>
+
+#include <backend/CallbackHandler.h>
+
+#include <utils/Invocable.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// for gtest
+class FilamentTest_VariantUsage_Test;
+
+namespace filament {
+
+class FMaterial;
+
+/*
+ * VariantUsage keeps track of the variants of each material that were used for rendering, so
+ * that they can be exported at the end of a session, and precompiled in the background at the
+ * beginning of the next one (see Engine::getVariantUsage() and Engine::warmUpVariants()).
+ *
+ * The materials record the variants they use themselves (see FMaterial::prepareProgram()), this
+ * only keeps the variants of the materials that were destroyed. Across sessions, materials are
+ * identified by their name and the cache id of their package.
+ *
+ * VariantUsage must only be used from the main thread.
+ */
+class VariantUsage {
+public:
+    using ProgressCallback = utils::Invocable<void(size_t compiled, size_t total)>;
+
+    VariantUsage() noexcept;
+    ~VariantUsage() noexcept;
+
+    VariantUsage(VariantUsage const&) = delete;
+    VariantUsage& operator=(VariantUsage const&) = delete;
+
+    // Keeps the variants used by a material that is being destroyed.
+    void onMaterialDestroyed(FMaterial const& material) noexcept;
+
+    // Starts compiling the variants of a new material, if it is in the warm-up list.
+    void onMaterialCreated(FMaterial& material) noexcept;
+
+    // Writes the variants used by all materials, including the given live materials, to data if
+    // size is large enough, and returns the size of the list in bytes.
+    size_t serialize(ResourceList<FMaterial> const& materials,
+            void* data, size_t size) const noexcept;
+
+    // Sets the warm-up list and starts compiling the variants of the given live materials.
+    // Returns false if the list is invalid, e.g. if it was produced by a different version of
+    // filament.
+    bool warmUp(ResourceList<FMaterial> const& materials, void const* data, size_t size,
+            backend::CallbackHandler* handler, ProgressCallback&& progress) noexcept;
+
+private:
+    friend class ::FilamentTest_VariantUsage_Test;
+
+    static uint64_t getMaterialKey(FMaterial const& material) noexcept;
+
+    struct Progress {
+        ProgressCallback callback;
+        size_t compiled = 0;
+        size_t total = 0;
+    };
+
+    // variants used by the materials that were destroyed
+    std::unordered_map<uint64_t, VariantList> mRecorded;
+
+    // variants to compile, for the materials of the warm-up list that weren't created yet
+    std::unordered_map<uint64_t, VariantList> mPending;
+    backend::CallbackHandler* mHandler = nullptr;
+    // shared with the compilation callbacks, which can outlive us
+    std::shared_ptr<Progress> mProgress;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_VARIANTUSAGE_H
@@ -203,6 +203,14 @@ SoftShadowOptions View::getSoftShadowOptions() const noexcept {
     return downcast(this)->getSoftShadowOptions();
 }
 
+void View::setShadowTexelBudget(uint32_t texels) noexcept {
+    downcast(this)->setShadowTexelBudget(texels);
+}
+
+uint32_t View::getShadowTexelBudget() const noexcept {
+    return downcast(this)->getShadowTexelBudget();
+}
+
 void View::setAmbientOcclusion(View::AmbientOcclusion ambientOcclusion) noexcept {
     downcast(this)->setAmbientOcclusion(ambientOcclusion);
 }
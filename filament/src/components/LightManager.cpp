@@ -26,6 +26,8 @@
 #include <utils/debug.h>
 #include <filament/LightManager.h>
 
+#include <algorithm>
+
 
 using namespace filament::math;
 using namespace utils;
@@ -343,6 +345,81 @@ void FLightManager::setIntensity(Instance i, float intensity, IntensityUnit unit
     }
 }
 
+void FLightManager::setLocalPositions(Instance const* instances,
+        float3 const* positions, size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance const i = instances[k];
+        if (i) {
+            manager.elementAt<POSITION>(i) = positions[k];
+        }
+    }
+}
+
+void FLightManager::setLocalPositions(Instance first,
+        float3 const* positions, size_t count) noexcept {
+    assert_invariant(!count || isValidRange(first, count));
+    if (count && isValidRange(first, count)) {
+        std::copy_n(positions, count, &mManager.elementAt<POSITION>(first));
+    }
+}
+
+void FLightManager::setLocalDirections(Instance const* instances,
+        float3 const* directions, size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance const i = instances[k];
+        if (i) {
+            manager.elementAt<DIRECTION>(i) = directions[k];
+        }
+    }
+}
+
+void FLightManager::setLocalDirections(Instance first,
+        float3 const* directions, size_t count) noexcept {
+    assert_invariant(!count || isValidRange(first, count));
+    if (count && isValidRange(first, count)) {
+        std::copy_n(directions, count, &mManager.elementAt<DIRECTION>(first));
+    }
+}
+
+void FLightManager::setColors(Instance const* instances,
+        LinearColor const* colors, size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance const i = instances[k];
+        if (i) {
+            manager.elementAt<COLOR>(i) = colors[k];
+        }
+    }
+}
+
+void FLightManager::setColors(Instance first,
+        LinearColor const* colors, size_t count) noexcept {
+    assert_invariant(!count || isValidRange(first, count));
+    if (count && isValidRange(first, count)) {
+        std::copy_n(colors, count, &mManager.elementAt<COLOR>(first));
+    }
+}
+
+void FLightManager::setIntensities(Instance const* instances,
+        float const* intensities, size_t count, IntensityUnit unit) noexcept {
+    // the conversion to luminous intensity depends on each light's type
+    for (size_t k = 0; k < count; k++) {
+        setIntensity(instances[k], intensities[k], unit);
+    }
+}
+
+void FLightManager::setIntensities(Instance first,
+        float const* intensities, size_t count, IntensityUnit unit) noexcept {
+    assert_invariant(!count || isValidRange(first, count));
+    if (count && isValidRange(first, count)) {
+        for (size_t k = 0; k < count; k++) {
+            setIntensity(Instance(first + k), intensities[k], unit);
+        }
+    }
+}
+
 void FLightManager::setFalloff(Instance i, float falloff) noexcept {
     auto& manager = mManager;
     if (i && !isDirectionalLight(i)) {
@@ -118,6 +118,21 @@ public:
 
     UTILS_NOINLINE bool getLightChannel(Instance i, unsigned int channel) const noexcept;
 
+    // Bulk versions of the setters above, for an array of instances or for a range of
+    // contiguous instances. The latter write each attribute's array sequentially.
+    void setLocalPositions(Instance const* instances,
+            math::float3 const* positions, size_t count) noexcept;
+    void setLocalPositions(Instance first, math::float3 const* positions, size_t count) noexcept;
+    void setLocalDirections(Instance const* instances,
+            math::float3 const* directions, size_t count) noexcept;
+    void setLocalDirections(Instance first, math::float3 const* directions, size_t count) noexcept;
+    void setColors(Instance const* instances, LinearColor const* colors, size_t count) noexcept;
+    void setColors(Instance first, LinearColor const* colors, size_t count) noexcept;
+    void setIntensities(Instance const* instances, float const* intensities, size_t count,
+            IntensityUnit unit) noexcept;
+    void setIntensities(Instance first, float const* intensities, size_t count,
+            IntensityUnit unit) noexcept;
+
     LightType const& getLightType(Instance i) const noexcept {
         return mManager[i].lightType;
     }
@@ -243,6 +258,10 @@ public:
 private:
     friend class FScene;
 
+    bool isValidRange(Instance first, size_t count) const noexcept {
+        return first && size_t(first) + count <= size_t(mManager.end());
+    }
+
     enum {
         LIGHT_TYPE,         // light type
         POSITION,           // position in local-space (i.e. pre-transform)
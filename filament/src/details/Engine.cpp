@@ -195,9 +195,11 @@ FEngine::FEngine(Engine::Builder const& builder) :
         mTransformManager(),
         mLightManager(*this),
         mCameraManager(*this),
+        mUniformBufferPool(builder->mConfig.materialUniformBufferPoolSizeKB * 1024),
         mCommandBufferQueue(
                 builder->mConfig.minCommandBufferSizeMB * MiB,
-                builder->mConfig.commandBufferSizeMB * MiB),
+                builder->mConfig.commandBufferSizeMB * MiB,
+                builder->mConfig.maxCommandBufferSizeMB * MiB),
         mPerRenderPassAllocator(
                 "FEngine::mPerRenderPassAllocator",
                 builder->mConfig.perRenderPassArenaSizeMB * MiB),
@@ -446,6 +448,10 @@ void FEngine::shutdown() {
     size_t const wmpct = wm / (getCommandBufferSize() / 100);
     slog.d << "CircularBuffer: High watermark "
            << wm / 1024 << " KiB (" << wmpct << "%)" << io::endl;
+    auto const stats = mCommandBufferQueue.getStatistics();
+    slog.d << "CircularBuffer: Max frame size " << stats.maxFrameSize / 1024 << " KiB, "
+           << stats.flushWaitCount << " stalls (" << stats.flushWaitTime / 1000000 << " ms), "
+           << stats.growCount << " growths" << io::endl;
 #endif
 
     DriverApi& driver = getDriverApi();
@@ -495,6 +501,9 @@ void FEngine::shutdown() {
     cleanupResourceList(std::move(mVertexBuffers));
     cleanupResourceList(std::move(mTextures));
     cleanupResourceList(std::move(mRenderTargets));
+    while (!mRecycledMaterialInstances.empty()) {
+        destroyRecycledMaterialInstances(mRecycledMaterialInstances.begin()->first);
+    }
     cleanupResourceList(std::move(mMaterials));
     cleanupResourceList(std::move(mInstanceBuffers));
     for (auto& item : mMaterialInstances) {
@@ -503,6 +512,9 @@ void FEngine::shutdown() {
 
     cleanupResourceListLocked(mFenceListLock, std::move(mFences));
 
+    mProgramCache.terminate(driver);
+    mUniformBufferPool.terminate(driver);
+
     driver.destroyTexture(mDummyOneTexture);
     driver.destroyTexture(mDummyOneDepthTexture);
     driver.destroyTexture(mDummyOneTextureArray);
@@ -566,6 +578,9 @@ void FEngine::prepare() {
 #endif
         material->getDefaultInstance()->commit(driver);
     });
+
+    // the instances that share uniform buffers are uploaded together
+    mUniformBufferPool.flush(driver);
 }
 
 void FEngine::gc() {
@@ -704,6 +719,20 @@ int FEngine::loop() {
     return 0;
 }
 
+Engine::CommandBufferStatistics FEngine::getCommandBufferStatistics() const noexcept {
+    auto const stats = mCommandBufferQueue.getStatistics();
+    return {
+            .capacity = stats.capacity,
+            .highWatermark = stats.highWatermark,
+            .lastFrameSize = stats.lastFrameSize,
+            .maxFrameSize = stats.maxFrameSize,
+            .flushWaitTime = stats.flushWaitTime,
+            .driverWaitTime = stats.driverWaitTime,
+            .flushWaitCount = stats.flushWaitCount,
+            .growCount = stats.growCount,
+    };
+}
+
 void FEngine::flushCommandBuffer(CommandBufferQueue& commandQueue) {
     getDriver().purge();
     commandQueue.flush();
@@ -768,7 +797,11 @@ FIndirectLight* FEngine::createIndirectLight(const IndirectLight::Builder& build
 }
 
 FMaterial* FEngine::createMaterial(const Material::Builder& builder) noexcept {
-    return create(mMaterials, builder);
+    FMaterial* const p = create(mMaterials, builder);
+    if (p) {
+        mVariantUsage.onMaterialCreated(*p);
+    }
+    return p;
 }
 
 FSkybox* FEngine::createSkybox(const Skybox::Builder& builder) noexcept {
@@ -801,12 +834,56 @@ FRenderer* FEngine::createRenderer() noexcept {
 
 FMaterialInstance* FEngine::createMaterialInstance(const FMaterial* material,
         const FMaterialInstance* other, const char* name) noexcept {
-    FMaterialInstance* p = mHeapAllocator.make<FMaterialInstance>(*this, other, name);
-    if (UTILS_UNLIKELY(p)) { // should never happen
-        auto pos = mMaterialInstances.emplace(material, "MaterialInstance");
-        pos.first->second.insert(p);
+    MaterialInstance* p = nullptr;
+    createMaterialInstances(material, other, name, &p, 1);
+    return downcast(p);
+}
+
+size_t FEngine::createMaterialInstances(const FMaterial* material,
+        const FMaterialInstance* other, const char* name,
+        MaterialInstance** instances, size_t count) noexcept {
+    auto& list = mMaterialInstances.emplace(material, "MaterialInstance").first->second;
+    list.reserve(list.size() + count);
+
+    size_t i = 0;
+
+    // reuse the instances destroyed earlier, along with their backend objects
+    auto pos = mRecycledMaterialInstances.find(material);
+    if (pos != mRecycledMaterialInstances.end()) {
+        auto& recycled = pos->second;
+        for (; i < count && !recycled.empty(); i++) {
+            FMaterialInstance* const p = recycled.back();
+            recycled.pop_back();
+            p->reset(other, name);
+            list.insert(p);
+            instances[i] = p;
+        }
+    }
+
+    for (; i < count; i++) {
+        FMaterialInstance* const p = mHeapAllocator.make<FMaterialInstance>(*this, other, name);
+        if (UTILS_UNLIKELY(!p)) { // should never happen
+            break;
+        }
+        list.insert(p);
+        instances[i] = p;
+    }
+
+    for (size_t j = i; j < count; j++) {
+        instances[j] = nullptr;
+    }
+    return i;
+}
+
+void FEngine::destroyRecycledMaterialInstances(const FMaterial* material) noexcept {
+    auto pos = mRecycledMaterialInstances.find(material);
+    if (pos != mRecycledMaterialInstances.end()) {
+        for (FMaterialInstance* const p : pos->second) {
+            p->terminate(*this);
+            mHeapAllocator.destroy(p);
+        }
+        mRecycledMaterialInstances.erase(pos);
     }
-    return p;
 }
 
 /*
@@ -1071,6 +1148,10 @@ bool FEngine::destroy(const FMaterial* ptr) {
             return false;
         }
     }
+    if (isValid(ptr, mMaterials)) {
+        mVariantUsage.onMaterialDestroyed(*ptr);
+        destroyRecycledMaterialInstances(ptr);
+    }
     return terminateAndDestroy(ptr, mMaterials);
 }
 
@@ -1080,6 +1161,18 @@ bool FEngine::destroy(const FMaterialInstance* ptr) {
     auto pos = mMaterialInstances.find(ptr->getMaterial());
     assert_invariant(pos != mMaterialInstances.cend());
     if (pos != mMaterialInstances.cend()) {
+        // keep the instance to be reused by the next instance of this material
+        if (mConfig.materialInstanceRecycleCount) {
+            auto& recycled = mRecycledMaterialInstances[ptr->getMaterial()];
+            if (recycled.size() < mConfig.materialInstanceRecycleCount) {
+                bool const success = pos->second.remove(ptr);
+                if (ASSERT_PRECONDITION_NON_FATAL(success,
+                        "MaterialInstance at %p doesn't exist (double free?)", ptr)) {
+                    recycled.push_back(const_cast<FMaterialInstance*>(ptr));
+                }
+                return success;
+            }
+        }
         return terminateAndDestroy(ptr, pos->second);
     }
     // if we don't find this instance's material it might be because it's the default instance
@@ -1297,6 +1390,13 @@ Engine::Config Engine::BuilderDetails::validateConfig(const Config* const pConfi
             config.commandBufferSizeMB,
             config.minCommandBufferSizeMB * CONCURRENT_FRAME_COUNT);
 
+    // A growable command buffer can't be smaller than its initial size
+    if (config.maxCommandBufferSizeMB) {
+        config.maxCommandBufferSizeMB = std::max(
+                config.maxCommandBufferSizeMB,
+                config.commandBufferSizeMB);
+    }
+
     // Enforce pre-render-pass arena rule-of-thumb
     config.perRenderPassArenaSizeMB = std::max(
             config.perRenderPassArenaSizeMB,
@@ -21,8 +21,11 @@
 
 #include "Allocators.h"
 #include "DFG.h"
+#include "HwProgramCache.h"
 #include "PostProcessManager.h"
 #include "ResourceList.h"
+#include "UniformBufferPool.h"
+#include "VariantUsage.h"
 
 #include "components/CameraManager.h"
 #include "components/LightManager.h"
@@ -79,6 +82,12 @@ using MaterialKey = uint32_t;
 #include <new>
 #include <random>
 #include <unordered_map>
+#include <vector>
+
+// for gtest
+class FilamentTest_MaterialInstanceRecycling_Test;
+class FilamentTest_MaterialInstanceRecyclingDestroyMaterial_Test;
+class FilamentTest_VariantUsage_Test;
 
 namespace filament {
 
@@ -99,6 +108,13 @@ class FView;
 
 class ResourceAllocator;
 
+// statistics of the commands issued by RenderPass::Executor, accumulated over a frame
+struct RenderPassStatistics {
+    uint32_t drawCount = 0;                 // number of draw commands
+    uint32_t unchangedPipelineCount = 0;    // draws using the previous draw's pipeline
+    uint32_t filteredCommandCount = 0;      // redundant bind commands that were dropped
+};
+
 /*
  * Concrete implementation of the Engine interface. This keeps track of all hardware resources
  * for a given context.
@@ -139,6 +155,12 @@ public:
 
     DFG const& getDFG() const noexcept { return mDFG; }
 
+    // programs shared between materials
+    HwProgramCache& getProgramCache() noexcept { return mProgramCache; }
+
+    // uniform buffers shared between material instances
+    UniformBufferPool& getUniformBufferPool() noexcept { return mUniformBufferPool; }
+
     // the per-frame Area is used by all Renderer, so they must run in sequence and
     // have freed all allocated memory when done. If this needs to change in the future,
     // we'll simply have to use separate Areas (for instance).
@@ -283,6 +305,9 @@ public:
     FRenderer* createRenderer() noexcept;
     FMaterialInstance* createMaterialInstance(const FMaterial* material,
             const FMaterialInstance* other, const char* name) noexcept;
+    size_t createMaterialInstances(const FMaterial* material,
+            const FMaterialInstance* other, const char* name,
+            MaterialInstance** instances, size_t count) noexcept;
 
     FScene* createScene() noexcept;
     FView* createView() noexcept;
@@ -295,6 +320,15 @@ public:
     void destroyCameraComponent(utils::Entity entity) noexcept;
 
 
+    size_t getVariantUsage(void* data, size_t size) const noexcept {
+        return mVariantUsage.serialize(mMaterials, data, size);
+    }
+
+    bool warmUpVariants(const void* data, size_t size, backend::CallbackHandler* handler,
+            utils::Invocable<void(size_t compiled, size_t total)>&& progress) noexcept {
+        return mVariantUsage.warmUp(mMaterials, data, size, handler, std::move(progress));
+    }
+
     bool destroy(const FBufferObject* p);
     bool destroy(const FVertexBuffer* p);
     bool destroy(const FFence* p);
@@ -418,6 +452,29 @@ public:
     size_t getRequestedDriverHandleArenaSize() const noexcept { return mConfig.driverHandleArenaSizeMB * MiB; }
     Config const& getConfig() const noexcept { return mConfig; }
 
+    CommandBufferStatistics getCommandBufferStatistics() const noexcept;
+
+    HandleStatistics getHandleStatistics() const noexcept {
+        return getDriver().getHandleStatistics();
+    }
+
+    // statistics of the current frame, accumulated by RenderPass::Executor
+    RenderPassStatistics& getRenderPassStatistics() noexcept { return mRenderPassStatistics; }
+
+    // statistics of the last completed frame
+    RenderPassStatistics const& getLastFrameRenderPassStatistics() const noexcept {
+        return mLastFrameRenderPassStatistics;
+    }
+
+    // makes the current frame's statistics the last frame's, and starts a new frame
+    void renderPassStatisticsEndFrame() noexcept {
+        mLastFrameRenderPassStatistics = mRenderPassStatistics;
+        mRenderPassStatistics = {};
+    }
+
+    // marks the end of a frame in the command buffer statistics
+    void commandBufferEndFrame() noexcept { mCommandBufferQueue.endFrame(); }
+
     bool hasFeatureLevel(backend::FeatureLevel neededFeatureLevel) const noexcept {
         return FEngine::getActiveFeatureLevel() >= neededFeatureLevel;
     }
@@ -427,6 +484,10 @@ public:
 #endif
 
 private:
+    friend class ::FilamentTest_MaterialInstanceRecycling_Test;
+    friend class ::FilamentTest_MaterialInstanceRecyclingDestroyMaterial_Test;
+    friend class ::FilamentTest_VariantUsage_Test;
+
     explicit FEngine(Engine::Builder const& builder);
     void init();
     void shutdown();
@@ -492,6 +553,12 @@ private:
     ResourceList<FColorGrading> mColorGradings{ "ColorGrading" };
     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
 
+    // variants used by the materials, and the ones to compile ahead of time
+    VariantUsage mVariantUsage;
+
+    HwProgramCache mProgramCache;
+    UniformBufferPool mUniformBufferPool;
+
     // the fence list is accessed from multiple threads
     utils::Mutex mFenceListLock;
     ResourceList<FFence> mFences{"Fence"};
@@ -501,6 +568,11 @@ private:
     // FMaterialInstance are handled directly by FMaterial
     std::unordered_map<const FMaterial*, ResourceList<FMaterialInstance>> mMaterialInstances;
 
+    // Destroyed material instances, kept with their backend objects to be reused by the next
+    // instances of the same material (up to Config::materialInstanceRecycleCount per material).
+    std::unordered_map<const FMaterial*, std::vector<FMaterialInstance*>> mRecycledMaterialInstances;
+    void destroyRecycledMaterialInstances(const FMaterial* material) noexcept;
+
     DFG mDFG;
 
     std::thread mDriverThread;
@@ -510,6 +582,9 @@ private:
 
     uint32_t mFlushCounter = 0;
 
+    RenderPassStatistics mRenderPassStatistics;
+    RenderPassStatistics mLastFrameRenderPassStatistics;
+
     LinearAllocatorArena mPerRenderPassAllocator;
     HeapAllocatorArena mHeapAllocator;
 
@@ -557,6 +632,7 @@ public:
             bool focus_shadowcasters = true;
             bool visualize_cascades = false;
             bool tightly_bound_scene = true;
+            bool receiver_aware_culling = true;
             float dzn = -1.0f;
             float dzf =  1.0f;
             float display_shadow_texture_scale = 0.25f;
@@ -46,9 +46,11 @@ using namespace filaflat;
 using namespace utils;
 
 static MaterialParser* createParser(Backend backend, ShaderLanguage language,
-                                    const void* data, size_t size) {
+        const void* data, size_t size,
+        MaterialParser::ReleaseCallback releaseCallback = nullptr, void* user = nullptr) {
     // unique_ptr so we don't leak MaterialParser on failures below
-    auto materialParser = std::make_unique<MaterialParser>(language, data, size);
+    auto materialParser = std::make_unique<MaterialParser>(language, data, size,
+            releaseCallback, user);
 
     MaterialParser::ParseResult const materialResult = materialParser->parse();
 
@@ -77,6 +79,8 @@ static MaterialParser* createParser(Backend backend, ShaderLanguage language,
 struct Material::BuilderDetails {
     const void* mPayload = nullptr;
     size_t mSize = 0;
+    Material::Builder::ReleaseCallback mReleaseCallback = nullptr;
+    void* mReleaseUser = nullptr;
     MaterialParser* mMaterialParser = nullptr;
     bool mDefaultMaterial = false;
     std::unordered_map<
@@ -100,6 +104,18 @@ BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs
 Material::Builder& Material::Builder::package(const void* payload, size_t size) {
     mImpl->mPayload = payload;
     mImpl->mSize = size;
+    mImpl->mReleaseCallback = nullptr;
+    mImpl->mReleaseUser = nullptr;
+    return *this;
+}
+
+Material::Builder& Material::Builder::package(const void* payload, size_t size,
+        ReleaseCallback callback, void* user) {
+    ASSERT_PRECONDITION(callback != nullptr, "callback cannot be null");
+    mImpl->mPayload = payload;
+    mImpl->mSize = size;
+    mImpl->mReleaseCallback = callback;
+    mImpl->mReleaseUser = user;
     return *this;
 }
 
@@ -117,7 +133,7 @@ template Material::Builder& Material::Builder::constant<bool>(const char*, size_
 Material* Material::Builder::build(Engine& engine) {
     std::unique_ptr<MaterialParser> materialParser{ createParser(
         downcast(engine).getBackend(), downcast(engine).getShaderLanguage(),
-        mImpl->mPayload, mImpl->mSize) };
+        mImpl->mPayload, mImpl->mSize, mImpl->mReleaseCallback, mImpl->mReleaseUser) };
 
     if (materialParser == nullptr) {
         return nullptr;
@@ -432,7 +448,7 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
             FMaterial const* const pDefaultMaterial = engine.getDefaultMaterial();
             auto& cachedPrograms = mCachedPrograms;
             for (Variant const variant: pDefaultMaterial->mDepthVariants) {
-                pDefaultMaterial->prepareProgram(variant);
+                pDefaultMaterial->cacheProgram(variant);
                 cachedPrograms[variant.key] = pDefaultMaterial->getProgram(variant);
             }
         }
@@ -470,6 +486,7 @@ FMaterial::~FMaterial() noexcept {
 void FMaterial::invalidate(Variant::type_t variantMask, Variant::type_t variantValue) noexcept {
     if (mMaterialDomain == MaterialDomain::SURFACE) {
         DriverApi& driverApi = mEngine.getDriverApi();
+        HwProgramCache& programCache = mEngine.getProgramCache();
         auto& cachedPrograms = mCachedPrograms;
         for (size_t k = 0, n = VARIANT_COUNT; k < n; ++k) {
             Variant const variant(k);
@@ -484,7 +501,7 @@ void FMaterial::invalidate(Variant::type_t variantMask, Variant::type_t variantV
                         continue;
                     }
                 }
-                driverApi.destroyProgram(cachedPrograms[k]);
+                programCache.destroy(driverApi, cachedPrograms[k]);
                 cachedPrograms[k].clear();
             }
         }
@@ -492,7 +509,7 @@ void FMaterial::invalidate(Variant::type_t variantMask, Variant::type_t variantV
          if (UTILS_UNLIKELY(!mIsDefaultMaterial && !mHasCustomDepthShader)) {
             FMaterial const* const pDefaultMaterial = mEngine.getDefaultMaterial();
             for (Variant const variant: pDefaultMaterial->mDepthVariants) {
-                pDefaultMaterial->prepareProgram(variant);
+                pDefaultMaterial->cacheProgram(variant);
                 if (!cachedPrograms[variant.key]) {
                     cachedPrograms[variant.key] = pDefaultMaterial->getProgram(variant);
                 }
@@ -500,10 +517,11 @@ void FMaterial::invalidate(Variant::type_t variantMask, Variant::type_t variantV
         }
     } else if (mMaterialDomain == MaterialDomain::POST_PROCESS) {
         DriverApi& driverApi = mEngine.getDriverApi();
+        HwProgramCache& programCache = mEngine.getProgramCache();
         auto& cachedPrograms = mCachedPrograms;
         for (size_t k = 0, n = POST_PROCESS_VARIANT_COUNT; k < n; ++k) {
             if ((k & variantMask) == variantValue) {
-                driverApi.destroyProgram(cachedPrograms[k]);
+                programCache.destroy(driverApi, cachedPrograms[k]);
                 cachedPrograms[k].clear();
             }
         }
@@ -545,12 +563,49 @@ void FMaterial::compile(CompilerPriorityQueue priority,
         for (auto const variant: variants) {
             if (!variantFilter || variant == Variant::filterUserVariant(variant, variantFilter)) {
                 if (hasVariant(variant)) {
-                    prepareProgram(variant, priority);
+                    cacheProgram(variant, priority);
                 }
             }
         }
     }
 
+    compilePrograms(priority, handler, std::move(callback));
+}
+
+void FMaterial::compile(CompilerPriorityQueue priority,
+        VariantList const& variants,
+        backend::CallbackHandler* handler,
+        utils::Invocable<void(Material*)>&& callback) noexcept {
+
+    if (UTILS_LIKELY(mEngine.getDriverApi().isParallelShaderCompileSupported())) {
+        bool const isStereoSupported = mEngine.getDriverApi().isStereoSupported();
+        variants.forEachSetBit([this, priority, isStereoSupported](size_t key) {
+            Variant const variant{ Variant::type_t(key) };
+            bool isValid = false;
+            switch (mMaterialDomain) {
+                case MaterialDomain::SURFACE:
+                    isValid = !Variant::isReserved(variant) &&
+                            variant == Variant::filterVariant(variant, isVariantLit()) &&
+                            (isStereoSupported || !Variant::isStereoVariant(variant));
+                    break;
+                case MaterialDomain::POST_PROCESS:
+                    isValid = key < POST_PROCESS_VARIANT_COUNT;
+                    break;
+                case MaterialDomain::COMPUTE:
+                    break;
+            }
+            if (isValid && hasVariant(variant)) {
+                cacheProgram(variant, priority);
+            }
+        });
+    }
+
+    compilePrograms(priority, handler, std::move(callback));
+}
+
+void FMaterial::compilePrograms(CompilerPriorityQueue priority,
+        backend::CallbackHandler* handler,
+        utils::Invocable<void(Material*)>&& callback) noexcept {
     if (callback) {
         struct Callback {
             Invocable<void(Material*)> f;
@@ -572,6 +627,11 @@ FMaterialInstance* FMaterial::createInstance(const char* name) const noexcept {
     return FMaterialInstance::duplicate(&mDefaultInstance, name);
 }
 
+void FMaterial::createInstances(MaterialInstance** instances, size_t count,
+        const char* name) const noexcept {
+    mEngine.createMaterialInstances(this, &mDefaultInstance, name, instances, count);
+}
+
 bool FMaterial::hasParameter(const char* name) const noexcept {
     return mUniformInterfaceBlock.hasField(name) ||
            mSamplerInterfaceBlock.hasSampler(name) ||
@@ -690,8 +750,9 @@ Program FMaterial::getProgramWithVariants(
            .shader(ShaderStage::FRAGMENT, fsBuilder.data(), fsBuilder.size())
            .uniformBlockBindings(mUniformBlockBindings)
            .diagnostics(mName,
-                    [this, variant](io::ostream& out) -> io::ostream& {
-                        return out << mName.c_str_safe()
+                    // the program can outlive this material if it's shared
+                    [name = mName, variant](io::ostream& out) -> io::ostream& {
+                        return out << name.c_str_safe()
                                    << ", variant=(" << io::hex << variant.key << io::dec << ")";
                     });
 
@@ -726,7 +787,9 @@ Program FMaterial::getProgramWithVariants(
 }
 
 void FMaterial::createAndCacheProgram(Program&& p, Variant variant) const noexcept {
-    auto program = mEngine.getDriverApi().createProgram(std::move(p));
+    // materials that only differ by their parameters, or by specialization constants with the
+    // same values, get the same program.
+    auto program = mEngine.getProgramCache().create(mEngine.getDriverApi(), std::move(p));
     assert_invariant(program);
     mCachedPrograms[variant.key] = program;
 }
@@ -820,6 +883,7 @@ void FMaterial::onQueryCallback(void* userdata, VariantList* pVariants) {
 
 void FMaterial::destroyPrograms(FEngine& engine) {
     DriverApi& driverApi = engine.getDriverApi();
+    HwProgramCache& programCache = engine.getProgramCache();
     auto& cachedPrograms = mCachedPrograms;
     for (size_t k = 0, n = VARIANT_COUNT; k < n; ++k) {
         const Variant variant(k);
@@ -832,7 +896,7 @@ void FMaterial::destroyPrograms(FEngine& engine) {
                 continue;
             }
         }
-        driverApi.destroyProgram(cachedPrograms[k]);
+        programCache.destroy(driverApi, cachedPrograms[k]);
         cachedPrograms[k].clear();
     }
 }
@@ -69,9 +69,19 @@ public:
             backend::CallbackHandler* handler,
             utils::Invocable<void(Material*)>&& callback) noexcept;
 
+    // Same as above, but for an exact list of variants, e.g. the ones recorded by VariantUsage.
+    // The variants that this material doesn't have are ignored.
+    void compile(CompilerPriorityQueue priority,
+            VariantList const& variants,
+            backend::CallbackHandler* handler,
+            utils::Invocable<void(Material*)>&& callback) noexcept;
+
     // Create an instance of this material
     FMaterialInstance* createInstance(const char* name) const noexcept;
 
+    void createInstances(MaterialInstance** instances, size_t count,
+            const char* name) const noexcept;
+
     bool hasParameter(const char* name) const noexcept;
 
     bool isSampler(const char* name) const noexcept;
@@ -89,17 +99,29 @@ public:
 
     void invalidate(Variant::type_t variantMask = 0, Variant::type_t variantValue = 0) noexcept;
 
-    // prepareProgram creates the program for the material's given variant at the backend level.
+    // prepareProgram creates the program for the material's given variant at the backend level,
+    // and records that this variant is used for rendering (see VariantUsage).
     // Must be called outside of backend render pass.
     // Must be called before getProgram() below.
     void prepareProgram(Variant variant,
             backend::CompilerPriorityQueue priorityQueue = CompilerPriorityQueue::HIGH) const noexcept {
         // prepareProgram() is called for each RenderPrimitive in the scene, so it must be efficient.
+        mUsedVariants.set(variant.key);
+        cacheProgram(variant, priorityQueue);
+    }
+
+    // cacheProgram creates the program for the material's given variant at the backend level,
+    // without recording it as used, e.g. when compiling variants ahead of time.
+    void cacheProgram(Variant variant,
+            backend::CompilerPriorityQueue priorityQueue = CompilerPriorityQueue::HIGH) const noexcept {
         if (UTILS_UNLIKELY(!isCached(variant))) {
             prepareProgramSlow(variant, priorityQueue);
         }
     }
 
+    // the variants that were used for rendering since this material was created
+    VariantList const& getUsedVariants() const noexcept { return mUsedVariants; }
+
     // getProgram returns the backend program for the material's given variant.
     // Must be called after prepareProgram().
     [[nodiscard]] backend::Handle<backend::HwProgram> getProgram(Variant variant) const noexcept {
@@ -119,6 +141,7 @@ public:
     backend::FeatureLevel getFeatureLevel() const noexcept { return mFeatureLevel; }
     backend::RasterState getRasterState() const noexcept  { return mRasterState; }
     uint32_t getId() const noexcept { return mMaterialId; }
+    uint64_t getCacheId() const noexcept { return mCacheId; }
 
     UserVariantFilterMask getSupportedVariants() const noexcept {
         return UserVariantFilterMask(UserVariantFilterBit::ALL) & ~mVariantFilterMask;
@@ -219,8 +242,12 @@ private:
 
     void createAndCacheProgram(backend::Program&& p, Variant variant) const noexcept;
 
+    void compilePrograms(CompilerPriorityQueue priority, backend::CallbackHandler* handler,
+            utils::Invocable<void(Material*)>&& callback) noexcept;
+
     // try to order by frequency of use
     mutable std::array<backend::Handle<backend::HwProgram>, VARIANT_COUNT> mCachedPrograms;
+    mutable VariantList mUsedVariants;
 
     backend::RasterState mRasterState;
     BlendingMode mRenderBlendingMode = BlendingMode::OPAQUE;
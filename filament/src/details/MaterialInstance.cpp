@@ -67,8 +67,7 @@ FMaterialInstance::FMaterialInstance(FEngine& engine,
 
     if (!material->getUniformInterfaceBlock().isEmpty()) {
         mUniforms.setUniforms(other->getUniformBuffer());
-        mUbHandle = driver.createBufferObject(mUniforms.getSize(),
-                BufferObjectBinding::UNIFORM, backend::BufferUsage::DYNAMIC);
+        createUniformBuffer(engine, backend::BufferUsage::DYNAMIC);
     }
 
     if (!material->getSamplerInterfaceBlock().isEmpty()) {
@@ -77,6 +76,40 @@ FMaterialInstance::FMaterialInstance(FEngine& engine,
                 mSamplers.getSize(), utils::FixedSizeString<32>(mMaterial->getName().c_str_safe()));
     }
 
+    initDuplicate(material);
+}
+
+void FMaterialInstance::reset(FMaterialInstance const* other, const char* name) {
+    // this is the same as the constructor above, but we keep our storage and backend objects
+    FMaterial const* const material = other->getMaterial();
+    assert_invariant(material == mMaterial);
+
+    mPolygonOffset = other->mPolygonOffset;
+    mStencilState = other->mStencilState;
+    mMaskThreshold = other->mMaskThreshold;
+    mSpecularAntiAliasingVariance = other->mSpecularAntiAliasingVariance;
+    mSpecularAntiAliasingThreshold = other->mSpecularAntiAliasingThreshold;
+    mCulling = other->mCulling;
+    mDepthFunc = other->mDepthFunc;
+    mColorWrite = other->mColorWrite;
+    mDepthWrite = other->mDepthWrite;
+    mHasScissor = false;
+    mIsDoubleSided = other->mIsDoubleSided;
+    mScissorRect = other->mScissorRect;
+    mName = name ? CString(name) : other->mName;
+
+    if (!material->getUniformInterfaceBlock().isEmpty()) {
+        mUniforms.setUniforms(other->getUniformBuffer());
+    }
+
+    if (!material->getSamplerInterfaceBlock().isEmpty()) {
+        mSamplers = other->getSamplerGroup();
+    }
+
+    initDuplicate(material);
+}
+
+void FMaterialInstance::initDuplicate(FMaterial const* material) {
     if (material->hasDoubleSidedCapability()) {
         setDoubleSided(mIsDoubleSided);
     }
@@ -110,8 +143,7 @@ void FMaterialInstance::initDefaultInstance(FEngine& engine, FMaterial const* ma
 
     if (!material->getUniformInterfaceBlock().isEmpty()) {
         mUniforms = UniformBuffer(material->getUniformInterfaceBlock().getSize());
-        mUbHandle = driver.createBufferObject(mUniforms.getSize(),
-                BufferObjectBinding::UNIFORM, backend::BufferUsage::STATIC);
+        createUniformBuffer(engine, backend::BufferUsage::STATIC);
     }
 
     if (!material->getSamplerInterfaceBlock().isEmpty()) {
@@ -155,22 +187,57 @@ void FMaterialInstance::initDefaultInstance(FEngine& engine, FMaterial const* ma
 
 FMaterialInstance::~FMaterialInstance() noexcept = default;
 
+void FMaterialInstance::createUniformBuffer(FEngine& engine, backend::BufferUsage usage) {
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    // Small uniform buffers can be sub-allocated from a shared buffer object, except at feature
+    // level 0 where uniform buffers are emulated: the emulation ignores the offset of the bound
+    // range, and only updates a program's uniforms when another buffer object is bound.
+    if (engine.getActiveFeatureLevel() > FeatureLevel::FEATURE_LEVEL_0) {
+        mUbSlot = engine.getUniformBufferPool().allocate(driver, mUniforms.getSize());
+    }
+    if (mUbSlot) {
+        mUbHandle = mUbSlot.handle;
+    } else {
+        mUbHandle = driver.createBufferObject(mUniforms.getSize(),
+                BufferObjectBinding::UNIFORM, usage);
+    }
+}
+
 void FMaterialInstance::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
-    driver.destroyBufferObject(mUbHandle);
+    if (mUbSlot) {
+        engine.getUniformBufferPool().free(driver, mUbSlot);
+    } else {
+        driver.destroyBufferObject(mUbHandle);
+    }
     driver.destroySamplerGroup(mSbHandle);
 }
 
 void FMaterialInstance::commitSlow(DriverApi& driver) const {
     // update uniforms if needed
     if (mUniforms.isDirty()) {
-        driver.updateBufferObject(mUbHandle, mUniforms.toBufferDescriptor(driver), 0);
+        FEngine& engine = mMaterial->getEngine();
+        if (mUbSlot) {
+            // uploaded with the other slots of the buffer object by the next flush
+            engine.getUniformBufferPool().commit(mUbSlot, mUniforms);
+        } else if (engine.getBackend() == Backend::OPENGL) {
+            // a partial update uses glBufferSubData(), which can stall when issued for many
+            // buffers in the same frame, glBufferData() is preferred for the whole buffer.
+            driver.updateBufferObject(mUbHandle, mUniforms.toBufferDescriptor(driver), 0);
+        } else {
+            uint32_t const offset = uint32_t(mUniforms.getDirtyOffset());
+            driver.updateBufferObject(mUbHandle, mUniforms.toDirtyBufferDescriptor(driver), offset);
+        }
     }
     if (mSamplers.isDirty()) {
         driver.updateSamplerGroup(mSbHandle, mSamplers.toBufferDescriptor(driver));
     }
 }
 
+void FMaterialInstance::flushUniformBufferSlot(DriverApi& driver) const {
+    mMaterial->getEngine().getUniformBufferPool().flush(driver, mUbSlot);
+}
+
 // ------------------------------------------------------------------------------------------------
 
 void FMaterialInstance::setParameter(std::string_view name,
@@ -19,6 +19,7 @@
 
 #include "downcast.h"
 #include "UniformBuffer.h"
+#include "UniformBufferPool.h"
 #include "details/Engine.h"
 
 #include "private/backend/DriverApi.h"
@@ -44,6 +45,10 @@ public:
 
     static FMaterialInstance* duplicate(FMaterialInstance const* other, const char* name) noexcept;
 
+    // reinitializes a recycled instance as a copy of other, which must be an instance of the
+    // same material, keeping its backend objects.
+    void reset(FMaterialInstance const* other, const char* name);
+
     ~FMaterialInstance() noexcept;
 
     void terminate(FEngine& engine);
@@ -55,7 +60,13 @@ public:
     }
 
     void use(FEngine::DriverApi& driver) const {
-        if (mUbHandle) {
+        if (mUbSlot) {
+            // commits made after FEngine::prepare() are uploaded when the slot is first used
+            flushUniformBufferSlot(driver);
+            driver.bindBufferRange(backend::BufferObjectBinding::UNIFORM,
+                    +UniformBindingPoints::PER_MATERIAL_INSTANCE,
+                    mUbHandle, mUbSlot.offset, uint32_t(mUniforms.getSize()));
+        } else if (mUbHandle) {
             driver.bindUniformBuffer(+UniformBindingPoints::PER_MATERIAL_INSTANCE, mUbHandle);
         }
         if (mSbHandle) {
@@ -238,11 +249,18 @@ private:
 
     void commitSlow(FEngine::DriverApi& driver) const;
 
+    void flushUniformBufferSlot(FEngine::DriverApi& driver) const;
+
+    void createUniformBuffer(FEngine& engine, backend::BufferUsage usage);
+
+    void initDuplicate(FMaterial const* material);
+
     // keep these grouped, they're accessed together in the render-loop
     FMaterial const* mMaterial = nullptr;
 
     backend::Handle<backend::HwBufferObject> mUbHandle;
     backend::Handle<backend::HwSamplerGroup> mSbHandle;
+    UniformBufferPool::Slot mUbSlot;    // set if mUbHandle is shared with other instances
     UniformBuffer mUniforms;
     backend::SamplerGroup mSamplers;
 
@@ -70,6 +70,8 @@ FRenderer::FRenderer(FEngine& engine) :
             &engine.debug.renderer.doFrameCapture);
     debugRegistry.registerProperty("d.renderer.disable_buffer_padding",
             &engine.debug.renderer.disable_buffer_padding);
+    debugRegistry.registerDataSource("d.renderer.render_pass_statistics",
+            &engine.getLastFrameRenderPassStatistics(), 1);
     debugRegistry.registerProperty("d.shadowmap.display_shadow_texture",
             &engine.debug.shadowmap.display_shadow_texture);
     debugRegistry.registerProperty("d.shadowmap.display_shadow_texture_scale",
@@ -288,6 +290,7 @@ bool FRenderer::beginFrame(FSwapChain* swapChain, uint64_t vsyncSteadyClockTimeN
 
 void FRenderer::endFrame() {
     SYSTRACE_CALL();
+    SYSTRACE_CONTEXT();
 
     if (UTILS_UNLIKELY(mBeginFrameInternal)) {
         mBeginFrameInternal();
@@ -323,6 +326,15 @@ void FRenderer::endFrame() {
     }
 
     engineGC();
+
+    // the commands issued since the last flush are accounted to the next frame
+    engine.commandBufferEndFrame();
+
+    // publish this frame's RenderPass statistics
+    auto const& stats = engine.getRenderPassStatistics();
+    SYSTRACE_VALUE32("drawCount", stats.drawCount);
+    SYSTRACE_VALUE32("filteredCommandCount", stats.filteredCommandCount);
+    engine.renderPassStatisticsEndFrame();
 }
 
 void FRenderer::readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
@@ -464,7 +464,7 @@ void FScene::terminate(FEngine&) {
 }
 
 void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope&,
-        Handle<HwBufferObject> lightUbh) noexcept {
+        Handle<HwBufferObject> lightUbh, Handle<HwTexture> lightTexture) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
     FLightManager const& lcm = mEngine.getLightManager();
     FScene::LightSoa& lightData = getLightData();
@@ -484,7 +484,14 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope&,
     float2* const zrange = lightData.data<FScene::SCREEN_SPACE_Z_RANGE>();
     computeLightRanges(zrange, camera, spheres + DIRECTIONAL_LIGHTS_COUNT, positionalLightCount);
 
-    LightsUib* const lp = driver.allocatePod<LightsUib>(positionalLightCount);
+    // the lights that don't fit in the UBO go in the lights texture, which is updated by rows
+    size_t const uniformLightCount =
+            std::min(positionalLightCount, CONFIG_MAX_LIGHT_UNIFORM_COUNT);
+    size_t const textureRowCount = (positionalLightCount - uniformLightCount +
+            CONFIG_LIGHT_TEXTURE_WIDTH - 1) / CONFIG_LIGHT_TEXTURE_WIDTH;
+
+    LightsUib* const lp = driver.allocatePod<LightsUib>(
+            uniformLightCount + textureRowCount * CONFIG_LIGHT_TEXTURE_WIDTH);
 
     auto const* UTILS_RESTRICT directions       = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances        = lightData.data<FScene::LIGHT_INSTANCE>();
@@ -508,7 +515,18 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope&,
                 shadowInfo[i].castsShadows);
     }
 
-    driver.updateBufferObject(lightUbh, { lp, positionalLightCount * sizeof(LightsUib) }, 0);
+    driver.updateBufferObject(lightUbh, { lp, uniformLightCount * sizeof(LightsUib) }, 0);
+
+    if (textureRowCount) {
+        // each light is 4 RGBA32F texels, the end of the last row is left uninitialized
+        assert_invariant(lightTexture);
+        constexpr size_t texelsPerLight = sizeof(LightsUib) / sizeof(float4);
+        driver.update3DImage(lightTexture, 0, 0, 0, 0,
+                CONFIG_LIGHT_TEXTURE_WIDTH * texelsPerLight, textureRowCount, 1,
+                PixelBufferDescriptor(lp + uniformLightCount,
+                        textureRowCount * CONFIG_LIGHT_TEXTURE_WIDTH * sizeof(LightsUib),
+                        PixelDataFormat::RGBA, PixelDataType::FLOAT));
+    }
 }
 
 // These methods need to exist so clang honors the __restrict__ keyword, which in turn
@@ -76,7 +76,8 @@ public:
     void prepareVisibleRenderables(utils::Range<uint32_t> visibleRenderables) noexcept;
 
     void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena,
-            backend::Handle<backend::HwBufferObject> lightUbh) noexcept;
+            backend::Handle<backend::HwBufferObject> lightUbh,
+            backend::Handle<backend::HwTexture> lightTexture) noexcept;
 
     backend::Handle<backend::HwBufferObject> getRenderableUBO() const noexcept {
         return mRenderableViewUbh;
@@ -171,7 +172,9 @@ public:
         LIGHT_INSTANCE,
         VISIBILITY,
         SCREEN_SPACE_Z_RANGE,
-        SHADOW_INFO
+        SHADOW_INFO,
+        CLIP_SPACE_BOUNDS,
+        VIEW_SPACE_Z_RANGE
     };
 
     using LightSoa = utils::StructureOfArrays<
@@ -182,7 +185,9 @@ public:
             FLightManager::Instance,
             Culler::result_type,
             math::float2,
-            ShadowInfo
+            ShadowInfo,
+            math::float4,   // xy min, xy max, see Froxelizer::computeLightBounds()
+            math::float2    // z far, z near
     >;
 
     LightSoa const& getLightData() const noexcept { return mLightData; }
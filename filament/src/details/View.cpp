@@ -34,6 +34,7 @@
 
 #include <private/filament/UibStructs.h>
 
+#include <utils/Log.h>
 #include <utils/Profiler.h>
 #include <utils/Slice.h>
 #include <utils/Systrace.h>
@@ -43,6 +44,7 @@
 #include <math/scalar.h>
 #include <math/fast.h>
 
+#include <atomic>
 #include <memory>
 
 using namespace utils;
@@ -89,7 +91,7 @@ FView::FView(FEngine& engine)
 #endif
 
     // allocate UBOs
-    mLightUbh = driver.createBufferObject(CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib),
+    mLightUbh = driver.createBufferObject(CONFIG_MAX_LIGHT_UNIFORM_COUNT * sizeof(LightsUib),
             BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
 
     mIsDynamicResolutionSupported = driver.isFrameTimeSupported();
@@ -111,6 +113,9 @@ void FView::terminate(FEngine& engine) {
 
     DriverApi& driver = engine.getDriverApi();
     driver.destroyBufferObject(mLightUbh);
+    if (mLightTexture) {
+        driver.destroyTexture(mLightTexture);
+    }
     driver.destroyBufferObject(mRenderableUbh);
     drainFrameHistory(engine);
     mShadowMapManager.terminate(engine);
@@ -354,9 +359,35 @@ void FView::prepareLighting(FEngine& engine, ArenaScope& arena,
      */
 
     if (hasDynamicLighting()) {
-        scene->prepareDynamicLights(cameraInfo, arena, mLightUbh);
+        size_t const positionalLightCount = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+        if (positionalLightCount > CONFIG_MAX_LIGHT_UNIFORM_COUNT) {
+            // the lights that don't fit in the UBO need the lights texture
+            size_t const rowCount = (positionalLightCount - CONFIG_MAX_LIGHT_UNIFORM_COUNT +
+                    CONFIG_LIGHT_TEXTURE_WIDTH - 1) / CONFIG_LIGHT_TEXTURE_WIDTH;
+            if (rowCount > mLightTextureHeight) {
+                // grow the texture by powers of two, so it's rarely recreated
+                FEngine::DriverApi& driver = engine.getDriverApi();
+                if (mLightTexture) {
+                    driver.destroyTexture(mLightTexture);
+                }
+                uint32_t height = std::max(mLightTextureHeight, 1u);
+                while (height < rowCount) {
+                    height *= 2;
+                }
+                mLightTextureHeight = height;
+                mLightTexture = driver.createTexture(SamplerType::SAMPLER_2D, 1,
+                        TextureFormat::RGBA32F, 1,
+                        CONFIG_LIGHT_TEXTURE_WIDTH * sizeof(LightsUib) / sizeof(float4),
+                        mLightTextureHeight, 1,
+                        TextureUsage::DEFAULT);
+            }
+        }
+        scene->prepareDynamicLights(cameraInfo, arena, mLightUbh, mLightTexture);
     }
 
+    // the lights texture is only used when there are more lights than the UBO can hold
+    mPerViewUniforms.prepareLights(mLightTexture ? mLightTexture : engine.getZeroTexture());
+
     // here the array of visible lights has been shrunk to CONFIG_MAX_LIGHT_COUNT
     SYSTRACE_VALUE32("visibleLights", lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
 
@@ -459,6 +490,13 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
             cameraInfo.worldTransform,
             hasVSM());
 
+    /*
+     * Find the shadow casters that changed since the previous frame, for the cached shadow maps.
+     * This relies on the scene's order of the renderables, so it must happen before culling.
+     */
+    mShadowMapManager.updateShadowCasters(engine, *this, cameraInfo,
+            scene->getRenderableData(), scene->getLightData());
+
     /*
      * Light culling: runs in parallel with Renderable culling (below)
      */
@@ -469,11 +507,11 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
         // create and start the prepareVisibleLights job
         // note: this job updates LightData (non const)
         prepareVisibleLightsJob = js.runAndRetain(js.createJob(nullptr,
-                [&engine, &arena, &viewMatrix = cameraInfo.view, &cullingFrustum,
+                [&engine, &arena, &cameraInfo, &cullingFrustum,
                  &lightData = scene->getLightData()]
                         (JobSystem&, JobSystem::Job*) {
                     FView::prepareVisibleLights(engine.getLightManager(), arena,
-                            viewMatrix, cullingFrustum, lightData);
+                            cameraInfo, cullingFrustum, lightData);
                 }));
     }
 
@@ -520,7 +558,7 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
         // As soon as prepareVisibleLight finishes, we can kick-off the froxelization
         if (hasDynamicLighting()) {
             auto& froxelizer = mFroxelizer;
-            if (froxelizer.prepare(driver, arena, viewport,
+            if (froxelizer.prepare(driver, js, arena, viewport,
                     cameraInfo.projection, cameraInfo.zn, cameraInfo.zf)) {
                 // TODO: might be more consistent to do this in prepareLighting(), but it's not
                 //       strictly necessary
@@ -841,9 +879,10 @@ void FView::cullRenderables(JobSystem&,
 }
 
 void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena,
-        mat4f const& viewMatrix, Frustum const& frustum,
+        CameraInfo const& cameraInfo, Frustum const& frustum,
         FScene::LightSoa& lightData) noexcept {
     SYSTRACE_CALL();
+    SYSTRACE_CONTEXT();
     assert_invariant(lightData.size() > FScene::DIRECTIONAL_LIGHTS_COUNT);
 
     auto const* UTILS_RESTRICT sphereArray     = lightData.data<FScene::POSITION_RADIUS>();
@@ -898,7 +937,7 @@ void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena
 
 
     /*
-     * Some lights might be left out if there are more than the GPU buffer allows (i.e. 256).
+     * Some lights might be left out if there are more than the GPU buffers allow (i.e. 16384).
      *
      * We always sort lights by distance to the camera so that:
      * - we can build light trees later
@@ -910,6 +949,8 @@ void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena
 
     ArenaScope arena(rootArena.getAllocator());
     size_t const size = visibleLightCount;
+    size_t const keptLightCount =
+            std::min(size, CONFIG_MAX_LIGHT_COUNT + FScene::DIRECTIONAL_LIGHTS_COUNT);
     // number of point/spotlights
     size_t const positionalLightCount = size - FScene::DIRECTIONAL_LIGHTS_COUNT;
     if (positionalLightCount) {
@@ -920,16 +961,38 @@ void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena
         // pre-compute the lights' distance to the camera, for sorting below
         // - we don't skip the directional light, because we don't care, it's ignored during sorting
         float4 const* const UTILS_RESTRICT spheres = lightData.data<FScene::POSITION_RADIUS>();
-        computeLightCameraDistances(distances, viewMatrix, spheres, size);
+        computeLightCameraDistances(distances, cameraInfo.view, spheres, size);
 
         // skip directional light
         Zip2Iterator<FScene::LightSoa::iterator, float*> b = { lightData.begin(), distances };
-        std::sort(b + FScene::DIRECTIONAL_LIGHTS_COUNT, b + size,
-                [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; });
+        auto const first = b + FScene::DIRECTIONAL_LIGHTS_COUNT;
+        auto const middle = b + keptLightCount;
+        auto const last = b + size;
+        auto const closer = [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; };
+
+        // With thousands of visible lights, only the ones we keep need to be sorted, so we
+        // first partition them around the farthest light kept, which is linear.
+        if (middle != last) {
+            std::nth_element(first, middle, last, closer);
+        }
+        std::sort(first, middle, closer);
     }
 
     // drop excess lights
-    lightData.resize(std::min(size, CONFIG_MAX_LIGHT_COUNT + FScene::DIRECTIONAL_LIGHTS_COUNT));
+    SYSTRACE_VALUE32("droppedLights", size - keptLightCount);
+    if (UTILS_UNLIKELY(size > keptLightCount)) {
+        static std::atomic_bool sDroppedLightsReported{ false };
+        if (!sDroppedLightsReported.exchange(true, std::memory_order_relaxed)) {
+            slog.w << "More than " << CONFIG_MAX_LIGHT_COUNT << " point and spot lights are "
+                   << "visible, the " << size - keptLightCount << " farthest ones are ignored. "
+                   << "This is only reported once." << io::endl;
+        }
+    }
+    lightData.resize(keptLightCount);
+
+    // the screen-space bounds of the lights we keep limit the froxels visited by froxelization
+    Froxelizer::computeLightBounds(lcm, cameraInfo.view, cameraInfo.projection, cameraInfo.zn,
+            lightData);
 }
 
 // These methods need to exist so clang honors the __restrict__ keyword, which in turn
@@ -333,6 +333,14 @@ public:
         return mSoftShadowOptions;
     }
 
+    void setShadowTexelBudget(uint32_t texels) noexcept {
+        mShadowTexelBudget = texels;
+    }
+
+    uint32_t getShadowTexelBudget() const noexcept {
+        return mShadowTexelBudget;
+    }
+
     AmbientOcclusionOptions const& getAmbientOcclusionOptions() const noexcept {
         return mAmbientOcclusionOptions;
     }
@@ -461,7 +469,7 @@ private:
             Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
 
     static void prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena,
-            math::mat4f const& viewMatrix, Frustum const& frustum,
+            CameraInfo const& cameraInfo, Frustum const& frustum,
             FScene::LightSoa& lightData) noexcept;
 
     static inline void computeLightCameraDistances(float* distances,
@@ -488,6 +496,10 @@ private:
     backend::Handle<backend::HwBufferObject> mLightUbh;
     backend::Handle<backend::HwBufferObject> mRenderableUbh;
 
+    // lights beyond CONFIG_MAX_LIGHT_UNIFORM_COUNT, created on demand
+    backend::Handle<backend::HwTexture> mLightTexture;
+    uint32_t mLightTextureHeight = 0;
+
     FScene* mScene = nullptr;
     // The camera set by the user, used for culling and viewing
     FCamera* /* UTILS_NONNULL */ mCullingCamera = nullptr; // FIXME: should alaways be non-null
@@ -514,6 +526,7 @@ private:
     ShadowType mShadowType = ShadowType::PCF;
     VsmShadowOptions mVsmShadowOptions; // FIXME: this should probably be per-light
     SoftShadowOptions mSoftShadowOptions;
+    uint32_t mShadowTexelBudget = 0;
     BloomOptions mBloomOptions;
     FogOptions mFogOptions;
     DepthOfFieldOptions mDepthOfFieldOptions;
@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -32,6 +36,8 @@
 #include <filament/Material.h>
 #include <filament/Engine.h>
 
+#include <filaflat/ChunkContainer.h>
+
 #include <private/filament/BufferInterfaceBlock.h>
 #include <private/filament/UibStructs.h>
 #include <private/backend/BackendUtils.h>
@@ -40,10 +46,17 @@
 #include "details/Material.h"
 #include "details/Camera.h"
 #include "Froxelizer.h"
+#include "ShadowMapManager.h"
 #include "details/Engine.h"
+#include "details/Scene.h"
+#include "details/Skybox.h"
+#include "details/View.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 #include "UniformBuffer.h"
+#include "UniformBufferPool.h"
+
+#include "generated/resources/materials.h"
 
 using namespace filament;
 using namespace filament::math;
@@ -515,6 +528,112 @@ TEST(FilamentTest, UniformBufferSize2) {
     buffer.invalidate();
 }
 
+TEST(FilamentTest, UniformBufferDirtyRange) {
+    UniformBuffer buffer(64);
+
+    // a new buffer is entirely dirty
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(0, buffer.getDirtyOffset());
+    EXPECT_EQ(64, buffer.getDirtySize());
+
+    buffer.clean();
+    EXPECT_FALSE(buffer.isDirty());
+    EXPECT_EQ(0, buffer.getDirtySize());
+
+    buffer.setUniform(16, 1.0f);
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(16, buffer.getDirtyOffset());
+    EXPECT_EQ(4, buffer.getDirtySize());
+
+    // the range covers all the modified uniforms
+    buffer.setUniform(40, float2(2.0f));
+    buffer.setUniform(8, 3.0f);
+    EXPECT_EQ(8, buffer.getDirtyOffset());
+    EXPECT_EQ(40, buffer.getDirtySize());
+
+    buffer.clean();
+    buffer.invalidate();
+    EXPECT_EQ(0, buffer.getDirtyOffset());
+    EXPECT_EQ(64, buffer.getDirtySize());
+}
+
+TEST(FilamentTest, UniformBufferPool) {
+    using Pool = UniformBufferPool;
+
+    FEngine* engine = downcast(Engine::create());
+    FEngine::DriverApi& driver = engine->getDriverApi();
+
+    Pool disabled(0);
+    EXPECT_FALSE(disabled.allocate(driver, 64));
+
+    Pool pool(4 * Pool::MAX_SLOT_SIZE);
+    EXPECT_FALSE(pool.allocate(driver, Pool::MAX_SLOT_SIZE + 1));
+
+    // slots of the same size class share a buffer object
+    Pool::Slot const a = pool.allocate(driver, 64);
+    Pool::Slot const b = pool.allocate(driver, 64);
+    ASSERT_TRUE(a);
+    ASSERT_TRUE(b);
+    EXPECT_EQ(a.handle, b.handle);
+    EXPECT_NE(a.offset, b.offset);
+    EXPECT_EQ(0, a.offset % Pool::SLOT_ALIGNMENT);
+    EXPECT_EQ(0, b.offset % Pool::SLOT_ALIGNMENT);
+
+    Pool::Slot const c = pool.allocate(driver, Pool::MAX_SLOT_SIZE);
+    ASSERT_TRUE(c);
+    EXPECT_NE(a.handle, c.handle);
+
+    // a freed slot is reused
+    pool.free(driver, b);
+    Pool::Slot const d = pool.allocate(driver, Pool::SLOT_ALIGNMENT);
+    EXPECT_EQ(b.handle, d.handle);
+    EXPECT_EQ(b.offset, d.offset);
+
+    // commit copies the dirty range to the slot and cleans the uniform buffer
+    UniformBuffer ub(64);
+    ub.clean();
+    ub.setUniform(16, 1.0f);
+    pool.commit(a, ub);
+    EXPECT_FALSE(ub.isDirty());
+    Pool::Buffer const& buffer = pool.mBuffers[a.buffer];
+    EXPECT_EQ(a.offset + 16, buffer.dirtyBegin);
+    EXPECT_EQ(a.offset + 20, buffer.dirtyEnd);
+    float value;
+    memcpy(&value, buffer.data.get() + a.offset + 16, sizeof(value));
+    EXPECT_EQ(1.0f, value);
+
+    // the commits to the slots of a buffer object are merged until it's flushed
+    ub.setUniform(0, 2.0f);
+    pool.commit(d, ub);
+    EXPECT_EQ(std::min(a.offset + 16, d.offset), buffer.dirtyBegin);
+    EXPECT_EQ(std::max(a.offset + 20, d.offset + 4), buffer.dirtyEnd);
+    pool.flush(driver, a);
+    EXPECT_GE(buffer.dirtyBegin, buffer.dirtyEnd);
+
+    ub.setUniform(0, 3.0f);
+    pool.commit(a, ub);
+    pool.flush(driver);
+    EXPECT_GE(buffer.dirtyBegin, buffer.dirtyEnd);
+
+    // the buffer object is destroyed once all its slots are free, and its entry is reused
+    pool.free(driver, a);
+    EXPECT_TRUE(pool.mBuffers[a.buffer].handle);
+    pool.free(driver, d);
+    EXPECT_FALSE(pool.mBuffers[a.buffer].handle);
+    Pool::Slot const e = pool.allocate(driver, Pool::MAX_SLOT_SIZE);
+    ASSERT_TRUE(e);
+    EXPECT_EQ(a.buffer, e.buffer);
+
+    pool.free(driver, c);
+    pool.free(driver, e);
+    EXPECT_TRUE(std::none_of(pool.mBuffers.begin(), pool.mBuffers.end(),
+            [](Pool::Buffer const& entry) { return bool(entry.handle); }));
+
+    pool.terminate(driver);
+    disabled.terminate(driver);
+    Engine::destroy((Engine **)&engine);
+}
+
 TEST(FilamentTest, BoxCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -655,7 +774,7 @@ TEST(FilamentTest, FroxelData) {
 
     Froxelizer froxelData(*engine);
     froxelData.setOptions(5, 100);
-    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100);
+    froxelData.prepare(engine->getDriverApi(), engine->getJobSystem(), scope, vp, p, 0.1, 100);
 
     Froxel f = froxelData.getFroxelAt(0,0,0);
 
@@ -702,10 +821,11 @@ TEST(FilamentTest, FroxelData) {
     LightManager::Instance instance = engine->getLightManager().getInstance(e);
 
     FScene::LightSoa lights;
-    lights.push_back({}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
-    lights.push_back(float4{ 0, 0, -5, 1 }, {}, {}, {}, instance, 1, {}, {});
+    lights.push_back({}, {}, {}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
+    lights.push_back(float4{ 0, 0, -5, 1 }, {}, {}, {}, instance, 1, {}, {}, {}, {});
 
     {
+        Froxelizer::computeLightBounds(engine->getLightManager(), {}, p, 0.1, lights);
         froxelData.froxelizeLights(*engine, {}, lights);
         auto const& froxelBuffer = froxelData.getFroxelBufferUser();
         auto const& recordBuffer = froxelData.getRecordBufferUser();
@@ -725,6 +845,7 @@ TEST(FilamentTest, FroxelData) {
         auto pos = lights.elementAt<FScene::POSITION_RADIUS>(1);
         EXPECT_TRUE(pos == float4( 0, 0, -3, 1 ));
 
+        Froxelizer::computeLightBounds(engine->getLightManager(), {}, p, 0.1, lights);
         froxelData.froxelizeLights(*engine, {}, lights);
         auto const& froxelBuffer = froxelData.getFroxelBufferUser();
         auto const& recordBuffer = froxelData.getRecordBufferUser();
@@ -741,6 +862,638 @@ TEST(FilamentTest, FroxelData) {
     Engine::destroy((Engine **)&engine);
 }
 
+TEST(FilamentTest, FroxelDataSkip) {
+    using namespace filament;
+
+    FEngine* engine = downcast(Engine::create());
+    LinearAllocatorArena arena("FRenderer: per-frame allocator", 3 * 1024 * 1024);
+
+    Viewport vp(0, 0, 1280, 640);
+    mat4f p = mat4f::perspective(90, 1.0f, 0.1, 100, mat4f::Fov::HORIZONTAL);
+
+    Froxelizer froxelData(*engine);
+    froxelData.setOptions(5, 100);
+
+    Entity e = engine->getEntityManager().create();
+    LightManager::Builder(LightManager::Type::SPOT)
+            .spotLightCone(0.2f, 0.6f)
+            .build(*engine, e);
+    FLightManager& lcm = engine->getLightManager();
+    LightManager::Instance instance = lcm.getInstance(e);
+
+    FScene::LightSoa lights;
+    lights.push_back({}, {}, {}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
+    lights.push_back(float4{ 0, 0, -5, 2 }, float3{ 0, 0, -1 }, {}, {}, instance, 1,
+            {}, {}, {}, {});
+
+    // runs a frame like FView and FRenderer do, returns whether the froxelization was skipped
+    mat4f view;
+    auto frame = [&]() {
+        utils::ArenaScope<LinearAllocatorArena> scope(arena);
+        froxelData.prepare(engine->getDriverApi(), engine->getJobSystem(), scope, vp, p, 0.1, 100);
+        Froxelizer::computeLightBounds(lcm, view, p, 0.1, lights);
+        froxelData.froxelizeLights(*engine, view, lights);
+        bool const skipped = froxelData.mFroxelDataUnchanged;
+        froxelData.commit(engine->getDriverApi());
+        // the upload is skipped only for this frame
+        EXPECT_FALSE(froxelData.mFroxelDataUnchanged);
+        return skipped;
+    };
+
+    EXPECT_FALSE(frame());
+
+    // static camera and lights
+    EXPECT_TRUE(frame());
+    EXPECT_TRUE(frame());
+
+    // the view matrix changes, however little
+    view = mat4f::translation(float3{ 0, 0, 1e-4f });
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    // every light field the froxels depend on
+    lights.elementAt<FScene::POSITION_RADIUS>(1) = float4{ 0.5f, 0, -5, 2 };
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    lights.elementAt<FScene::POSITION_RADIUS>(1) = float4{ 0.5f, 0, -5, 3 };
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    lights.elementAt<FScene::DIRECTION>(1) = normalize(float3{ 0, 1, -1 });
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    lcm.setSpotLightCone(instance, 0.2f, 0.4f);
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    lights.push_back(float4{ 0, 0, -10, 1 }, float3{ 0, 0, -1 }, {}, {}, instance, 1,
+            {}, {}, {}, {});
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    // the froxels change
+    vp = Viewport(0, 0, 640, 320);
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    froxelData.setOptions(5, 50);
+    EXPECT_FALSE(frame());
+    EXPECT_TRUE(frame());
+
+    froxelData.terminate(engine->getDriverApi());
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, FroxelLightBounds) {
+    using namespace filament;
+
+    FEngine* engine = downcast(Engine::create());
+
+    Entity e = engine->getEntityManager().create();
+    LightManager::Builder(LightManager::Type::POINT).build(*engine, e);
+    LightManager::Instance instance = engine->getLightManager().getInstance(e);
+
+    float const near = 0.1f;
+    mat4f const p = mat4f::perspective(90, 1.0f, near, 100, mat4f::Fov::HORIZONTAL);
+
+    float4 const spheres[] = {
+            { 3.0f, 1.0f, -5.0f, 1.0f },            // in front of the camera
+            { 0.0f, 0.0f, -5.0f, 1.0f },
+            { 2.0f, -1.0f, -0.3f, 0.5f },           // straddles the near plane
+            { 0.05f, 0.02f, -0.12f, 0.05f },
+            { -0.05f, -0.02f, -0.12f, 0.05f },
+            { 0.08f, -0.03f, -0.09f, 0.03f },
+            { -0.03f, 0.06f, -0.11f, 0.06f },
+            { 0.2f, 0.1f, 0.3f, 1.0f },             // contains the camera
+            { 0.5f, 0.2f, -0.5f, 1.0f },
+    };
+
+    FScene::LightSoa lights;
+    lights.push_back({}, {}, {}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
+    for (float4 const& sphere : spheres) {
+        lights.push_back(sphere, {}, {}, {}, instance, 1, {}, {}, {}, {});
+    }
+    Froxelizer::computeLightBounds(engine->getLightManager(), {}, p, near, lights);
+
+    for (size_t l = 0; l < std::size(spheres); l++) {
+        float4 const& s = spheres[l];
+
+        // the bounds of the projection of the sphere's surface in front of the near plane, and of
+        // its intersection with the near plane.
+        float2 lo{ std::numeric_limits<float>::max() };
+        float2 hi{ std::numeric_limits<float>::lowest() };
+        auto add = [&](float3 const& v) {
+            if (v.z <= -near) {
+                float4 const clip = p * float4{ v, 1.0f };
+                lo = min(lo, clip.xy / clip.w);
+                hi = max(hi, clip.xy / clip.w);
+            }
+        };
+        for (size_t i = 0; i <= 256; i++) {
+            for (size_t j = 0; j < 512; j++) {
+                float const theta = float(i) * f::PI / 256.0f;
+                float const phi = float(j) * 2.0f * f::PI / 512.0f;
+                add(s.xyz + s.w * float3{ std::sin(theta) * std::cos(phi),
+                        std::sin(theta) * std::sin(phi), std::cos(theta) });
+            }
+        }
+        float const dz = -near - s.z;
+        if (std::abs(dz) <= s.w) {
+            float const k = std::sqrt(s.w * s.w - dz * dz);
+            for (size_t j = 0; j < 1024; j++) {
+                float const phi = float(j) * 2.0f * f::PI / 1024.0f;
+                add({ s.x + k * std::cos(phi), s.y + k * std::sin(phi), -near });
+            }
+        }
+        lo = clamp(lo, -1.0f, 1.0f);
+        hi = clamp(hi, -1.0f, 1.0f);
+
+        float4 const bounds = lights.elementAt<FScene::CLIP_SPACE_BOUNDS>(l + 1);
+        EXPECT_NEAR(lo.x, bounds.x, 1e-3f) << "light " << l;
+        EXPECT_NEAR(lo.y, bounds.y, 1e-3f) << "light " << l;
+        EXPECT_NEAR(hi.x, bounds.z, 1e-3f) << "light " << l;
+        EXPECT_NEAR(hi.y, bounds.w, 1e-3f) << "light " << l;
+    }
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, FroxelDataManyLights) {
+    using namespace filament;
+
+    FEngine* engine = downcast(Engine::create());
+
+    LinearAllocatorArena arena("FRenderer: per-frame allocator", 3 * 1024 * 1024);
+    utils::ArenaScope<LinearAllocatorArena> scope(arena);
+
+    Viewport vp(0, 0, 1280, 640);
+    mat4f p = mat4f::perspective(90, 1.0f, 0.1, 100, mat4f::Fov::HORIZONTAL);
+
+    Froxelizer froxelData(*engine);
+    froxelData.setOptions(5, 100);
+    froxelData.prepare(engine->getDriverApi(), engine->getJobSystem(), scope, vp, p, 0.1, 100);
+
+    Entity e = engine->getEntityManager().create();
+    LightManager::Builder(LightManager::Type::POINT).build(*engine, e);
+    LightManager::Instance instance = engine->getLightManager().getInstance(e);
+
+    // more lights than 8-bit records can index, sorted by distance like FView does
+    constexpr size_t lightCount = 2048;
+    FScene::LightSoa lights;
+    lights.push_back({}, {}, {}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
+    for (size_t i = 0; i < lightCount; i++) {
+        float const z = -6.0f - float(i) * 0.04f;
+        float const x = (float(i % 16) - 7.5f) * z / 8.0f;
+        float const y = (float((i / 16) % 8) - 3.5f) * z / 8.0f;
+        lights.push_back(float4{ x, y, z, 1 }, {}, {}, {}, instance, 1, {}, {}, {}, {});
+    }
+
+    Froxelizer::computeLightBounds(engine->getLightManager(), {}, p, 0.1, lights);
+    froxelData.froxelizeLights(*engine, {}, lights);
+
+    std::vector<bool> found(lightCount);
+    for (const auto& entry : froxelData.getFroxelBufferUser()) {
+        if (!entry.count()) {
+            continue;
+        }
+        EXPECT_TRUE(entry.hasRecords16());
+        size_t previous = 0;
+        for (size_t i = 0; i < entry.count(); i++) {
+            size_t const lightIndex = froxelData.getLightIndex(entry, i);
+            ASSERT_LT(lightIndex, lightCount);
+            // the lists stay sorted by distance
+            if (i) {
+                EXPECT_LT(previous, lightIndex);
+            }
+            previous = lightIndex;
+            found[lightIndex] = true;
+        }
+    }
+
+    // lights past the first 256 are referenced by the froxels
+    EXPECT_GT(std::count(found.begin() + 256, found.end(), true), 0);
+
+    froxelData.terminate(engine->getDriverApi());
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, LightManagerBulkSetters) {
+    using namespace filament;
+
+    Engine* engine = Engine::create();
+    LightManager& lcm = engine->getLightManager();
+
+    std::array<Entity, 4> entities;
+    engine->getEntityManager().create(entities.size(), entities.data());
+    for (Entity const e : entities) {
+        LightManager::Builder(LightManager::Type::POINT).build(*engine, e);
+    }
+
+    // the instances follow the order of getEntities()
+    Entity const* const lights = lcm.getEntities();
+    LightManager::Instance const first = lcm.getInstance(lights[0]);
+    for (size_t k = 0; k < lcm.getComponentCount(); k++) {
+        EXPECT_EQ(lcm.getInstance(lights[k]), LightManager::Instance(first + k));
+    }
+
+    // update a range of instances
+    std::array<float3, 4> const positions{
+            float3{ 1, 0, 0 }, float3{ 2, 0, 0 }, float3{ 3, 0, 0 }, float3{ 4, 0, 0 }};
+    std::array<float3, 4> const colors{
+            float3{ 1, 0, 0 }, float3{ 0, 1, 0 }, float3{ 0, 0, 1 }, float3{ 1, 1, 1 }};
+    lcm.setPositions(first, positions.data(), positions.size());
+    lcm.setColors(first, colors.data(), colors.size());
+    for (size_t k = 0; k < positions.size(); k++) {
+        EXPECT_EQ(lcm.getPosition(first + k), positions[k]);
+        EXPECT_EQ(lcm.getColor(first + k), colors[k]);
+    }
+
+    // update an array of instances, in any order
+    std::array<LightManager::Instance, 2> const instances{
+            lcm.getInstance(entities[3]), lcm.getInstance(entities[1]) };
+    std::array<float3, 2> const directions{ float3{ 1, 0, 0 }, float3{ 0, 0, 1 }};
+    std::array<float, 2> const intensities{ 100.0f, 200.0f };
+    lcm.setDirections(instances.data(), directions.data(), instances.size());
+    lcm.setIntensities(instances.data(), intensities.data(), instances.size());
+    for (size_t k = 0; k < instances.size(); k++) {
+        EXPECT_EQ(lcm.getDirection(instances[k]), directions[k]);
+        // the intensity of point lights is converted from lumens to candelas
+        EXPECT_FLOAT_EQ(lcm.getIntensity(instances[k]), intensities[k] * f::ONE_OVER_PI * 0.25f);
+    }
+
+    for (Entity const e : entities) {
+        lcm.destroy(e);
+    }
+    engine->getEntityManager().destroy(entities.size(), entities.data());
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ShadowMapCache) {
+    using namespace filament;
+
+    FEngine* engine = downcast(Engine::create());
+    FView* view = downcast(engine->createView());
+    FLightManager& lcm = engine->getLightManager();
+
+    // a directional light whose shadow map is cached
+    Entity const sun = engine->getEntityManager().create();
+    LightManager::ShadowOptions shadowOptions;
+    shadowOptions.cacheShadowMap = true;
+    LightManager::Builder(LightManager::Type::DIRECTIONAL)
+            .castShadows(true)
+            .shadowOptions(shadowOptions)
+            .build(*engine, sun);
+    FLightManager::Instance const light = lcm.getInstance(sun);
+
+    FScene::LightSoa lights;
+    lights.push_back({}, {}, {}, {}, light, {}, {}, {}, {}, {});
+
+    // a single shadow caster, a unit cube at the origin
+    FScene::RenderableSoa renderables;
+    renderables.push_back();
+    auto moveShadowCaster = [&](float3 const& position) {
+        renderables.elementAt<FScene::WORLD_TRANSFORM>(0) = mat4f::translation(position);
+        renderables.elementAt<FScene::WORLD_AABB_CENTER>(0) = position;
+        renderables.elementAt<FScene::WORLD_AABB_EXTENT>(0) = float3{ 0.5f };
+    };
+    moveShadowCaster(float3{ 0 });
+    renderables.elementAt<FScene::LAYERS>(0) = 1;
+    renderables.elementAt<FScene::VISIBILITY_STATE>(0).castShadows = true;
+
+    // the state the shadow map was cached with: the light looks down the -z axis
+    mat4 const projection = mat4::ortho(-4, 4, -4, 4, -4, 4);
+    auto getViewMatrix = [](float3 const& direction) {
+        return inverse(mat4::lookAt(double3{ 0 }, double3(direction), double3{ 0, 1, 0 }));
+    };
+    ShadowMapManager::CachedShadowMap const cached{
+            .projection = projection,
+            .view = getViewMatrix({ 0, 0, -1 }),
+            .viewport = { 1, 1, 254, 254 },
+            .light = light,
+            .type = ShadowMap::ShadowType::DIRECTIONAL,
+            .visibleLayers = 1,
+            .valid = true
+    };
+    Frustum const frustum{ mat4f{ cached.projection * cached.view }};
+
+    ShadowMapManager shadowMapManager(*engine);
+    CameraInfo const cameraInfo{};
+
+    // in the first frame, all the shadow casters are dirty
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_FALSE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    // nothing changed
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_TRUE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    // the light direction changed
+    ShadowMapManager::CachedShadowMap rotated = cached;
+    rotated.view = getViewMatrix(normalize(float3{ 0, -1, -1 }));
+    EXPECT_FALSE(shadowMapManager.canReuseCachedShadowMap(cached, rotated, frustum));
+
+    // the shadow map renders other shadow casters, e.g. because the visible receivers changed
+    FScene::VisibleMaskType const casterMasks[] = { VISIBLE_DIR_SHADOW_RENDERABLE };
+    FScene::VisibleMaskType const culledMasks[] = { 0 };
+    ShadowMapManager::CachedShadowMap culled = cached;
+    culled.shadowCasters = ShadowMapManager::hashShadowCasters(renderables, { 0, 1 },
+            culledMasks, VISIBLE_DIR_SHADOW_RENDERABLE);
+    EXPECT_NE(culled.shadowCasters, ShadowMapManager::hashShadowCasters(renderables, { 0, 1 },
+            casterMasks, VISIBLE_DIR_SHADOW_RENDERABLE));
+    EXPECT_FALSE(shadowMapManager.canReuseCachedShadowMap(cached, culled, frustum));
+
+    // the shadow caster moved within the shadow map
+    moveShadowCaster(float3{ 1, 0, 0 });
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_FALSE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_TRUE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    // the shadow caster moved out of the shadow map, which was showing its shadow
+    moveShadowCaster(float3{ 10, 0, 0 });
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_FALSE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    // the shadow caster moved, but is never in the shadow map
+    moveShadowCaster(float3{ 20, 0, 0 });
+    shadowMapManager.updateShadowCasters(*engine, *view, cameraInfo, renderables, lights);
+    EXPECT_TRUE(shadowMapManager.canReuseCachedShadowMap(cached, cached, frustum));
+
+    // a cascade updated at a reduced rate is reused while it covers the current cascade
+    ShadowMapManager::CachedShadowMap cascade = cached;
+    cascade.shadowData.lightFromWorldMatrix = mat4f::scaling(float3{ 0.5f });
+    cascade.shadowData.scissorNormalized = float4{ 0, 0, 1, 1 };
+    float4 const scissor{ 0.25f, 0.25f, 0.75f, 0.75f };
+    EXPECT_TRUE(shadowMapManager.isCoveredByCachedCascade(cascade,
+            mat4f::scaling(float3{ 0.5f }), scissor));
+    // the current cascade extends past the cached one's scissor...
+    EXPECT_FALSE(shadowMapManager.isCoveredByCachedCascade(cascade,
+            mat4f::scaling(float3{ 0.25f, 0.25f, 0.5f }), scissor));
+    // ...or past its depth range
+    EXPECT_FALSE(shadowMapManager.isCoveredByCachedCascade(cascade,
+            mat4f::scaling(float3{ 0.5f, 0.5f, 0.25f }), scissor));
+
+    shadowMapManager.terminate(*engine);
+    engine->destroy(view);
+    lcm.destroy(sun);
+    engine->getEntityManager().destroy(sun);
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, MaterialInstanceRecycling) {
+    Engine::Config config;
+    config.materialInstanceRecycleCount = 1;
+    FEngine* engine = downcast(Engine::Builder().config(&config).build());
+    FMaterial const* material = FSkybox::createMaterial(*engine);
+    FMaterialInstance const* defaultInstance = material->getDefaultInstance();
+
+    MaterialInstance* mi = material->createInstance(nullptr);
+    mi->setParameter("color", float4{ 1, 0, 0, 1 });
+    mi->setScissor(1, 2, 3, 4);
+    mi->setDepthFunc(MaterialInstance::DepthFunc::A);
+    mi->setDepthWrite(!defaultInstance->isDepthWriteEnabled());
+    engine->destroy(downcast(mi));
+    EXPECT_EQ(1, engine->mRecycledMaterialInstances[material].size());
+
+    // the recycled instance is reset to the state of the default instance
+    FMaterialInstance const* recycled = material->createInstance(nullptr);
+    EXPECT_EQ(mi, recycled);
+    EXPECT_TRUE(engine->mRecycledMaterialInstances[material].empty());
+
+    UniformBuffer const& uniforms = recycled->getUniformBuffer();
+    UniformBuffer const& defaultUniforms = defaultInstance->getUniformBuffer();
+    ASSERT_EQ(defaultUniforms.getSize(), uniforms.getSize());
+    EXPECT_EQ(0, memcmp(defaultUniforms.getBuffer(), uniforms.getBuffer(), uniforms.getSize()));
+    EXPECT_TRUE(uniforms.isDirty());
+
+    EXPECT_FALSE(recycled->hasScissor());
+    EXPECT_EQ(defaultInstance->getScissor().left, recycled->getScissor().left);
+    EXPECT_EQ(defaultInstance->getScissor().bottom, recycled->getScissor().bottom);
+    EXPECT_EQ(defaultInstance->getScissor().width, recycled->getScissor().width);
+    EXPECT_EQ(defaultInstance->getScissor().height, recycled->getScissor().height);
+    EXPECT_EQ(defaultInstance->getDepthFunc(), recycled->getDepthFunc());
+    EXPECT_EQ(defaultInstance->isDepthWriteEnabled(), recycled->isDepthWriteEnabled());
+    EXPECT_STREQ(defaultInstance->getName(), recycled->getName());
+
+    // no more than materialInstanceRecycleCount instances are kept
+    MaterialInstance* other = material->createInstance(nullptr);
+    engine->destroy(recycled);
+    engine->destroy(downcast(other));
+    EXPECT_EQ(1, engine->mRecycledMaterialInstances[material].size());
+
+    engine->destroy(material);
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, MaterialInstanceRecyclingDestroyMaterial) {
+    Engine::Config config;
+    config.materialInstanceRecycleCount = 4;
+    FEngine* engine = downcast(Engine::Builder().config(&config).build());
+    FMaterial const* material = FSkybox::createMaterial(*engine);
+
+    MaterialInstance* instances[4];
+    material->createInstances(instances, 4, nullptr);
+    for (MaterialInstance* mi : instances) {
+        ASSERT_NE(nullptr, mi);
+        engine->destroy(downcast(mi));
+    }
+    EXPECT_EQ(4, engine->mRecycledMaterialInstances[material].size());
+
+    // destroying the material frees its recycled instances
+    engine->destroy(material);
+    EXPECT_EQ(engine->mRecycledMaterialInstances.end(),
+            engine->mRecycledMaterialInstances.find(material));
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, MaterialPackageReleaseCallback) {
+    struct ReleaseCounter {
+        const void* data = nullptr;
+        int count = 0;
+        static void release(const void* data, size_t, void* user) {
+            auto* const counter = static_cast<ReleaseCounter*>(user);
+            counter->data = data;
+            counter->count++;
+        }
+    };
+
+    Engine* engine = Engine::create();
+
+    // the package must be 8-byte aligned to be used in place
+    std::vector<uint64_t> package((MATERIALS_SKYBOX_SIZE + 7) / 8);
+    memcpy(package.data(), MATERIALS_SKYBOX_DATA, MATERIALS_SKYBOX_SIZE);
+
+    // the package is released once per material, when the material is destroyed
+    ReleaseCounter counter;
+    Material* material = Material::Builder()
+            .package(package.data(), MATERIALS_SKYBOX_SIZE, &ReleaseCounter::release, &counter)
+            .build(*engine);
+    ASSERT_NE(nullptr, material);
+    EXPECT_EQ(0, counter.count);
+    engine->destroy(material);
+    EXPECT_EQ(1, counter.count);
+    EXPECT_EQ(package.data(), counter.data);
+
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, VariantUsage) {
+    // copies of the skybox package, optionally with a different cache id or name
+    enum class Change { NONE, CACHE_ID, NAME };
+    auto makePackage = [](Change change) {
+        std::vector<uint8_t> package(MATERIALS_SKYBOX_DATA,
+                MATERIALS_SKYBOX_DATA + MATERIALS_SKYBOX_SIZE);
+        filaflat::ChunkContainer container(package.data(), package.size());
+        EXPECT_TRUE(container.parse());
+        auto [start, end] = container.getChunkRange(change == Change::NAME ?
+                filamat::ChunkType::MaterialName : filamat::ChunkType::MaterialCacheId);
+        if (change != Change::NONE) {
+            EXPECT_NE(start, end);
+            // the last byte of the name is its terminating null
+            package[end - package.data() - 2] ^= 1;
+        }
+        return package;
+    };
+    auto build = [](Engine& engine, std::vector<uint8_t> const& package) {
+        return downcast(Material::Builder()
+                .package(package.data(), package.size())
+                .build(engine));
+    };
+
+    std::vector<uint8_t> const package = makePackage(Change::NONE);
+    Variant const fog{ Variant::FOG };
+
+    // record the variants used by a material in a first session
+    std::vector<uint8_t> list;
+    {
+        Engine* engine = Engine::create();
+        FMaterial* material = build(*engine, package);
+        material->prepareProgram(Variant{});
+        material->prepareProgram(fog);
+        engine->destroy(material);
+
+        list.resize(engine->getVariantUsage(nullptr, 0));
+        EXPECT_EQ(list.size(), engine->getVariantUsage(list.data(), list.size()));
+        Engine::destroy(&engine);
+    }
+
+    // and warm them up in the next one
+    FEngine* engine = downcast(Engine::create());
+    size_t compiledCount = 0;
+    size_t totalCount = 0;
+    ASSERT_TRUE(engine->warmUpVariants(list.data(), list.size(), nullptr,
+            [&](size_t compiled, size_t total) {
+                compiledCount = compiled;
+                totalCount = total;
+            }));
+
+    // only the recorded variants are pending
+    auto const& pending = engine->mVariantUsage.mPending;
+    ASSERT_EQ(1, pending.size());
+    VariantList const& variants = pending.begin()->second;
+    EXPECT_EQ(2, variants.count());
+    EXPECT_TRUE(variants[0]);
+    EXPECT_TRUE(variants[fog.key]);
+
+    // materials with a different cache id or name don't use the list
+    for (Change change : { Change::CACHE_ID, Change::NAME }) {
+        FMaterial* other = build(*engine, makePackage(change));
+        ASSERT_NE(nullptr, other);
+        EXPECT_EQ(1, pending.size());
+        EXPECT_FALSE(other->isCached(Variant{}));
+        engine->destroy(other);
+    }
+
+    // the recorded variants are compiled when the material is created
+    FMaterial* material = build(*engine, package);
+    ASSERT_NE(nullptr, material);
+    EXPECT_TRUE(pending.empty());
+    if (engine->getDriverApi().isParallelShaderCompileSupported()) {
+        for (size_t key = 0; key < VARIANT_COUNT; key++) {
+            EXPECT_EQ(key == 0 || key == fog.key, material->isCached(Variant(key)));
+        }
+    }
+
+    engine->flushAndWait();
+    engine->pumpMessageQueues();
+    EXPECT_EQ(1, compiledCount);
+    EXPECT_EQ(1, totalCount);
+
+    // the warm-up doesn't count as usage
+    EXPECT_FALSE(material->getUsedVariants().any());
+
+    engine->destroy(material);
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, HwProgramCache) {
+    using namespace backend;
+
+    FEngine* engine = downcast(Engine::create(Engine::Backend::NOOP));
+    FEngine::DriverApi& driver = engine->getDriverApi();
+    HwProgramCache& cache = engine->getProgramCache();
+    size_t const programCount = cache.mPrograms.size();
+
+    // identical programs of two materials share a backend program...
+    FMaterial const* a = FSkybox::createMaterial(*engine);
+    FMaterial const* b = FSkybox::createMaterial(*engine);
+    a->prepareProgram(Variant{});
+    b->prepareProgram(Variant{});
+    EXPECT_EQ(a->getProgram(Variant{}), b->getProgram(Variant{}));
+    EXPECT_EQ(programCount + 1, cache.mPrograms.size());
+
+    // ...which is destroyed with the last material that uses it
+    engine->destroy(a);
+    EXPECT_EQ(programCount + 1, cache.mPrograms.size());
+    engine->destroy(b);
+    EXPECT_EQ(programCount, cache.mPrograms.size());
+
+    // programs that only differ by a specialization constant or a binding aren't shared
+    auto makeProgram = [](Program::SpecializationConstant::Type constant, uint32_t binding) {
+        static constexpr char source[] = "void main() {}";
+        Program program;
+        program.shader(ShaderStage::VERTEX, source, sizeof(source));
+        program.shader(ShaderStage::FRAGMENT, source, sizeof(source));
+        Program::Sampler const sampler{ "sampler", binding };
+        program.setSamplerGroup(0, ShaderStageFlags::FRAGMENT, &sampler, 1);
+        auto constants = utils::FixedCapacityVector<Program::SpecializationConstant>::with_capacity(1);
+        constants.push_back({ 0, constant });
+        program.specializationConstants(std::move(constants));
+        return program;
+    };
+
+    ProgramHandle const p0 = cache.create(driver, makeProgram(int32_t(1), 0));
+    ProgramHandle const p1 = cache.create(driver, makeProgram(int32_t(1), 0));
+    ProgramHandle const otherValue = cache.create(driver, makeProgram(int32_t(2), 0));
+    ProgramHandle const otherType = cache.create(driver, makeProgram(1.0f, 0));
+    ProgramHandle const otherBinding = cache.create(driver, makeProgram(int32_t(1), 1));
+    EXPECT_EQ(p0, p1);
+    EXPECT_NE(p0, otherValue);
+    EXPECT_NE(p0, otherType);
+    EXPECT_NE(p0, otherBinding);
+    EXPECT_NE(otherValue, otherType);
+    EXPECT_EQ(programCount + 4, cache.mPrograms.size());
+
+    // a shared program is destroyed when its last user releases it
+    cache.destroy(driver, p0);
+    EXPECT_EQ(1, cache.mKeys.count(p1.getId()));
+    cache.destroy(driver, p1);
+    EXPECT_EQ(0, cache.mKeys.count(p1.getId()));
+
+    cache.destroy(driver, otherValue);
+    cache.destroy(driver, otherType);
+    cache.destroy(driver, otherBinding);
+    EXPECT_EQ(programCount, cache.mPrograms.size());
+
+    Engine::destroy((Engine **)&engine);
+}
+
 TEST(FilamentTest, GoogleLineDirective) {
     {
         char s[512] = "#line 10 \"foobar\"";
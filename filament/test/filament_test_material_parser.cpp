@@ -16,6 +16,9 @@
 
 #include <fstream>
 #include <iostream>
+#include <memory>
+
+#include <string.h>
 
 #include <gtest/gtest.h>
 
@@ -25,6 +28,35 @@
 
 using namespace filament;
 
+namespace {
+
+// the test material, copied at the given offset of an 8-byte aligned buffer
+struct TestPackage {
+    explicit TestPackage(size_t offset = 0)
+            : storage(new uint64_t[(offset + FILAMENT_TEST_RESOURCES_TEST_MATERIAL_SIZE + 7) / 8]),
+              data(reinterpret_cast<char*>(storage.get()) + offset),
+              size(FILAMENT_TEST_RESOURCES_TEST_MATERIAL_SIZE) {
+        memcpy(data, FILAMENT_TEST_RESOURCES_TEST_MATERIAL_DATA, size);
+    }
+    std::unique_ptr<uint64_t[]> storage;
+    char* data;
+    size_t size;
+};
+
+struct ReleaseCounter {
+    const void* data = nullptr;
+    size_t size = 0;
+    int count = 0;
+    static void release(const void* data, size_t size, void* user) {
+        auto* const counter = static_cast<ReleaseCounter*>(user);
+        counter->data = data;
+        counter->size = size;
+        counter->count++;
+    }
+};
+
+} // anonymous namespace
+
 // This test checks that a material compiled with an older version of matc can still be parsed.
 // If this test is failing, it probably means that MATERIAL_VERSION needs to be incremented.
 // After doing so, to fix the test, run filament/test/update_test_material.sh.
@@ -41,6 +73,83 @@ TEST(MaterialParser, Parse) {
             "See instructions in filament_test_material_parser.cpp" << std::endl;
 }
 
+// The shaders decoded on demand by MaterialParser must match the ones decoded up front by
+// DictionaryReader, for the text and the SPIR-V dictionaries.
+TEST(MaterialParser, LazyShadersMatchEagerDictionary) {
+    using namespace filaflat;
+    using filamat::ChunkType;
+
+    TestPackage const package;
+
+    struct {
+        backend::ShaderLanguage language;
+        ChunkType materialTag;
+        ChunkType dictionaryTag;
+    } const languages[] = {
+            { backend::ShaderLanguage::ESSL3, ChunkType::MaterialGlsl, ChunkType::DictionaryText },
+            { backend::ShaderLanguage::MSL, ChunkType::MaterialMetal, ChunkType::DictionaryText },
+            { backend::ShaderLanguage::SPIRV, ChunkType::MaterialSpirv, ChunkType::DictionarySpirv },
+    };
+
+    for (auto const& [language, materialTag, dictionaryTag] : languages) {
+        MaterialParser parser(language, package.data, package.size);
+        ASSERT_EQ(MaterialParser::ParseResult::SUCCESS, parser.parse());
+
+        ChunkContainer container(package.data, package.size);
+        ASSERT_TRUE(container.parse());
+        BlobDictionary dictionary;
+        ASSERT_TRUE(DictionaryReader::unflatten(container,
+                DictionaryReader::getDictionaryTag(container, dictionaryTag), dictionary));
+        MaterialChunk chunk(container);
+        ASSERT_TRUE(chunk.initialize(materialTag));
+
+        size_t shaderCount = 0;
+        chunk.visitShaders([&](backend::ShaderModel model, Variant variant,
+                backend::ShaderStage stage) {
+            ShaderContent expected;
+            ShaderContent lazy;
+            ASSERT_TRUE(chunk.getShader(expected, dictionary, model, variant, stage));
+            ASSERT_TRUE(parser.getShader(lazy, model, variant, stage));
+            ASSERT_EQ(expected.size(), lazy.size());
+            EXPECT_EQ(0, memcmp(expected.data(), lazy.data(), expected.size()));
+            shaderCount++;
+        });
+        EXPECT_GT(shaderCount, 0);
+    }
+}
+
+// With a release callback, an aligned package is used in place and a misaligned one is copied.
+// Either way the callback is called exactly once, when the parser is destroyed.
+TEST(MaterialParser, ReleaseCallback) {
+    for (size_t offset : { 0, 1 }) {
+        TestPackage const package(offset);
+        ReleaseCounter counter;
+        {
+            MaterialParser parser(backend::ShaderLanguage::ESSL3, package.data, package.size,
+                    &ReleaseCounter::release, &counter);
+            ASSERT_EQ(MaterialParser::ParseResult::SUCCESS, parser.parse());
+            EXPECT_EQ(offset == 0, parser.getChunkContainer().getData() == package.data);
+            EXPECT_EQ(0, counter.count);
+        }
+        EXPECT_EQ(1, counter.count);
+        EXPECT_EQ(package.data, counter.data);
+        EXPECT_EQ(package.size, counter.size);
+    }
+}
+
+TEST(MaterialParser, ReleaseCallbackOnFailure) {
+    uint64_t garbage[8] = {};
+    ReleaseCounter counter;
+    {
+        MaterialParser parser(backend::ShaderLanguage::ESSL3, garbage, sizeof(garbage),
+                &ReleaseCounter::release, &counter);
+        EXPECT_NE(MaterialParser::ParseResult::SUCCESS, parser.parse());
+        EXPECT_EQ(0, counter.count);
+    }
+    EXPECT_EQ(1, counter.count);
+    EXPECT_EQ(garbage, counter.data);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -91,7 +91,11 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
     MaterialInterpolation = charTo64bitNum("MAT_INTR"),
 
     DictionaryText = charTo64bitNum("DIC_TEXT"),
+    DictionaryCompressedText = charTo64bitNum("DIC_CTXT"),
     DictionarySpirv = charTo64bitNum("DIC_SPIR"),
+    DictionaryCompressedSpirv = charTo64bitNum("DIC_CSPV"),
+
+    MaterialStatistics = charTo64bitNum("MAT_STAT"),
 };
 
 } // namespace filamat
@@ -71,9 +71,18 @@ enum class ReservedSpecializationConstants : uint8_t {
     CONFIG_STEREO_EYE_COUNT = 8,
 };
 
+// The number of point and spot lights stored in the lights UBO.
 // This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
-// It's also limited by the Froxelizer's record buffer data type (uint8_t).
-constexpr size_t CONFIG_MAX_LIGHT_COUNT = 256;
+// The lights beyond these are stored in the per-view lights texture (see light_punctual.fs).
+constexpr size_t CONFIG_MAX_LIGHT_UNIFORM_COUNT = 256;
+
+// The number of lights stored in each row of the lights texture (4 RGBA32F texels per light).
+constexpr size_t CONFIG_LIGHT_TEXTURE_WIDTH = 256;
+
+// The maximum number of point and spot lights.
+// This value is limited by the Froxelizer's record buffer data type (uint16_t) and by the height
+// of the lights texture (64 rows).
+constexpr size_t CONFIG_MAX_LIGHT_COUNT = 16384;
 constexpr size_t CONFIG_MAX_LIGHT_INDEX = CONFIG_MAX_LIGHT_COUNT - 1;
 
 // The number of specialization constants that Filament reserves for its own use. These are always
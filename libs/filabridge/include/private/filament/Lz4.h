@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_LZ4_H
+#define TNT_FILAMENT_LZ4_H
+
+#include <stddef.h>
+
+/*
+ * A minimal codec for the LZ4 block format, used to compress the dictionaries of material
+ * packages. Decompression is fast enough to be done each time a shader is needed, and the blocks
+ * are independent, so a dictionary entry can be decompressed without the rest of the dictionary.
+ *
+ * The compressor is a simple greedy one, it is only used by the material compiler.
+ */
+namespace filament::lz4 {
+
+// Returns the maximum size of the compressed data for an input of the given size.
+size_t compressBound(size_t size) noexcept;
+
+// Compresses src into dst. Returns the size of the compressed data, or 0 if it doesn't fit in
+// dstCapacity, which is never the case if dstCapacity is at least compressBound(srcSize).
+size_t compress(void const* src, size_t srcSize, void* dst, size_t dstCapacity) noexcept;
+
+// Decompresses src into dst. Returns false if the compressed data is invalid or doesn't
+// decompress to exactly dstSize bytes.
+bool decompress(void const* src, size_t srcSize, void* dst, size_t dstSize) noexcept;
+
+} // namespace filament::lz4
+
+#endif // TNT_FILAMENT_LZ4_H
@@ -286,7 +286,7 @@ struct LightsUib { // NOLINT(cppcoreguidelines-pro-type-member-init)
     }
 };
 static_assert(sizeof(LightsUib) == 64,
-        "the actual UBO is an array of 256 mat4");
+        "the actual UBO is an array of 256 mat4, and the lights texture has 4 texels per light");
 
 // ------------------------------------------------------------------------------------------------
 // MARK: -
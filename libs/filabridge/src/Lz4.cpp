@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/filament/Lz4.h"
+
+#include <utils/debug.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace filament::lz4 {
+
+namespace {
+
+// A block is a sequence of (token, literals, match offset, match length) sequences. The last
+// sequence only has literals. See https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;     // the last 5 bytes of a block are always literals
+constexpr size_t MF_LIMIT = 12;         // the last match starts at least 12 bytes before the end
+constexpr size_t MAX_OFFSET = 65535;
+constexpr uint32_t HASH_BITS = 12;
+
+inline uint32_t read32(uint8_t const* p) noexcept {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash(uint32_t sequence) noexcept {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+uint8_t* writeLength(uint8_t* op, size_t length) noexcept {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = uint8_t(length);
+    return op;
+}
+
+// Writes a sequence. A matchLength of 0 means the sequence only has literals.
+uint8_t* writeSequence(uint8_t* op, uint8_t const* oend, uint8_t const* literals,
+        size_t literalCount, size_t offset, size_t matchLength) noexcept {
+    size_t const worstCase = 1 + (literalCount / 255 + 1) + literalCount + 2 +
+            (matchLength / 255 + 1);
+    if (size_t(oend - op) < worstCase) {
+        return nullptr;
+    }
+
+    uint8_t* const token = op++;
+    uint8_t t;
+    if (literalCount >= 15) {
+        t = 15u << 4u;
+        op = writeLength(op, literalCount - 15);
+    } else {
+        t = uint8_t(literalCount << 4u);
+    }
+    memcpy(op, literals, literalCount);
+    op += literalCount;
+
+    if (matchLength) {
+        assert_invariant(offset && offset <= MAX_OFFSET && matchLength >= MIN_MATCH);
+        *op++ = uint8_t(offset);
+        *op++ = uint8_t(offset >> 8u);
+        size_t const length = matchLength - MIN_MATCH;
+        if (length >= 15) {
+            t |= 15u;
+            op = writeLength(op, length - 15);
+        } else {
+            t |= uint8_t(length);
+        }
+    }
+    *token = t;
+    return op;
+}
+
+bool readLength(uint8_t const*& ip, uint8_t const* iend, size_t& length) noexcept {
+    uint8_t b;
+    do {
+        if (ip == iend) {
+            return false;
+        }
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // anonymous namespace
+
+size_t compressBound(size_t size) noexcept {
+    return size + size / 255 + 16;
+}
+
+size_t compress(void const* src, size_t srcSize, void* dst, size_t dstCapacity) noexcept {
+    assert_invariant(srcSize <= UINT32_MAX);
+    uint8_t const* const in = static_cast<uint8_t const*>(src);
+    uint8_t* const out = static_cast<uint8_t*>(dst);
+    uint8_t const* const oend = out + dstCapacity;
+    uint8_t* op = out;
+
+    size_t anchor = 0;
+    if (srcSize > MF_LIMIT) {
+        // positions of the last occurrence of the 4-byte sequences, by hash
+        std::vector<uint32_t> table(1u << HASH_BITS, 0);
+        size_t const matchStartLimit = srcSize - MF_LIMIT;
+        size_t const matchEndLimit = srcSize - LAST_LITERALS;
+        size_t pos = 0;
+        while (pos < matchStartLimit) {
+            uint32_t const sequence = read32(in + pos);
+            uint32_t const h = hash(sequence);
+            size_t const ref = table[h];
+            table[h] = uint32_t(pos);
+            if (ref < pos && pos - ref <= MAX_OFFSET && read32(in + ref) == sequence) {
+                size_t length = MIN_MATCH;
+                while (pos + length < matchEndLimit && in[ref + length] == in[pos + length]) {
+                    length++;
+                }
+                op = writeSequence(op, oend, in + anchor, pos - anchor, pos - ref, length);
+                if (!op) {
+                    return 0;
+                }
+                pos += length;
+                anchor = pos;
+            } else {
+                pos++;
+            }
+        }
+    }
+
+    op = writeSequence(op, oend, in + anchor, srcSize - anchor, 0, 0);
+    return op ? size_t(op - out) : 0;
+}
+
+bool decompress(void const* src, size_t srcSize, void* dst, size_t dstSize) noexcept {
+    uint8_t const* ip = static_cast<uint8_t const*>(src);
+    uint8_t const* const iend = ip + srcSize;
+    uint8_t* const out = static_cast<uint8_t*>(dst);
+    uint8_t* const oend = out + dstSize;
+    uint8_t* op = out;
+
+    while (ip < iend) {
+        uint8_t const token = *ip++;
+
+        size_t literalCount = token >> 4u;
+        if (literalCount == 15 && !readLength(ip, iend, literalCount)) {
+            return false;
+        }
+        if (literalCount > size_t(iend - ip) || literalCount > size_t(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, literalCount);
+        op += literalCount;
+        ip += literalCount;
+
+        if (ip == iend) {
+            // the last sequence doesn't have a match
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t const offset = size_t(ip[0]) | (size_t(ip[1]) << 8u);
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - out)) {
+            return false;
+        }
+
+        size_t length = token & 0xFu;
+        if (length == 15 && !readLength(ip, iend, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (length > size_t(oend - op)) {
+            return false;
+        }
+
+        uint8_t const* const match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+        } else {
+            // the match overlaps the output, it repeats the last offset bytes
+            for (size_t i = 0; i < length; i++) {
+                op[i] = match[i];
+            }
+        }
+        op += length;
+    }
+    return op == oend;
+}
+
+} // namespace filament::lz4
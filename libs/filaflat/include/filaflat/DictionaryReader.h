@@ -19,12 +19,74 @@
 
 #include <filaflat/ChunkContainer.h>
 
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/FixedCapacityVector.h>
+
+#include <memory>
+#include <string_view>
+
+#include <stddef.h>
+
 namespace filaflat {
 
 struct DictionaryReader {
     static bool unflatten(ChunkContainer const& container,
             ChunkContainer::Type dictionaryTag,
             BlobDictionary& dictionary);
+
+    // Dictionaries are stored either in a DictionaryText or DictionarySpirv chunk, or
+    // LZ4-compressed in a DictionaryCompressedText or DictionaryCompressedSpirv chunk. Returns the
+    // tag of the chunk that holds the dictionary identified by dictionaryTag in the given container.
+    static ChunkContainer::Type getDictionaryTag(ChunkContainer const& container,
+            ChunkContainer::Type dictionaryTag) noexcept;
+};
+
+// A dictionary that references its entries in the package, instead of copying and decoding all of
+// them up front like DictionaryReader. An entry is only decoded when a shader that uses it is
+// requested. The lines of a compressed text dictionary are decompressed one block at a time, the
+// first time one of the lines of the block is requested, and then kept in memory.
+// The package must outlive the dictionary. This class is not thread-safe.
+class LazyDictionary {
+public:
+    // Finds the entries of the given dictionary chunk, without decoding them.
+    bool initialize(ChunkContainer const& container, ChunkContainer::Type dictionaryTag) noexcept;
+
+    size_t size() const noexcept { return mEntries.size(); }
+
+    // For text dictionaries, returns the given entry, without its terminating null.
+    bool getText(size_t index, std::string_view& text) const noexcept {
+        assert_invariant(index < mEntries.size());
+        Entry const& entry = mEntries[index];
+        if (UTILS_UNLIKELY(!entry.data && !decompressBlock(index / mLinesPerBlock))) {
+            return false;
+        }
+        text = { entry.data, entry.size - 1 };
+        return true;
+    }
+
+    // For SPIR-V dictionaries, decompresses the given entry.
+    bool decode(size_t index, ShaderContent& content) const noexcept;
+
+private:
+    bool decompressBlock(size_t blockIndex) const noexcept;
+
+    struct Entry {
+        const char* data;       // null until the block of a compressed text entry is decompressed
+        size_t size;            // including the terminating null for text entries
+        size_t encodedSize;     // size of the smol-v data of a SPIR-V entry, once decompressed
+    };
+    struct Block {
+        const char* data;
+        size_t size;
+        size_t decompressedSize;
+    };
+    mutable utils::FixedCapacityVector<Entry> mEntries;
+
+    // for compressed text dictionaries only
+    utils::FixedCapacityVector<Block> mBlocks;
+    mutable utils::FixedCapacityVector<std::unique_ptr<char[]>> mBlockData;
+    uint32_t mLinesPerBlock = 1;
 };
 
 } // namespace filaflat
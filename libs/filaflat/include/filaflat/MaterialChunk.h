@@ -20,6 +20,7 @@
 #include <filament/MaterialChunkType.h>
 
 #include <filaflat/ChunkContainer.h>
+#include <filaflat/DictionaryReader.h>
 #include <filaflat/Unflattener.h>
 
 #include <private/filament/Variant.h>
@@ -50,6 +51,10 @@ public:
     bool getShader(ShaderContent& shaderContent, BlobDictionary const& dictionary,
             ShaderModel shaderModel, filament::Variant variant, ShaderStage stage);
 
+    // same as above, but only decodes the dictionary entries used by the requested shader
+    bool getShader(ShaderContent& shaderContent, LazyDictionary const& dictionary,
+            ShaderModel shaderModel, filament::Variant variant, ShaderStage stage);
+
     uint32_t getShaderCount() const noexcept;
 
     void visitShaders(utils::Invocable<void(ShaderModel, Variant, ShaderStage)>&& visitor) const;
@@ -70,12 +75,18 @@ private:
     const uint8_t* mBase = nullptr;
     tsl::robin_map<uint32_t, uint32_t> mOffsets;
 
+    template<typename Dictionary>
+    bool getShader(ShaderContent& shaderContent, Dictionary const& dictionary,
+            ShaderModel shaderModel, filament::Variant variant, ShaderStage stage);
+
+    template<typename Dictionary>
     bool getTextShader(Unflattener unflattener,
-            BlobDictionary const& dictionary, ShaderContent& shaderContent,
+            Dictionary const& dictionary, ShaderContent& shaderContent,
             ShaderModel shaderModel, filament::Variant variant, ShaderStage shaderStage);
 
+    template<typename Dictionary>
     bool getSpirvShader(
-            BlobDictionary const& dictionary, ShaderContent& shaderContent,
+            Dictionary const& dictionary, ShaderContent& shaderContent,
             ShaderModel shaderModel, filament::Variant variant, ShaderStage shaderStage);
 };
 
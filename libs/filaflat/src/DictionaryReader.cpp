@@ -19,17 +19,145 @@
 #include <filaflat/ChunkContainer.h>
 #include <filaflat/Unflattener.h>
 
+#include <private/filament/Lz4.h>
+
 #if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
 #include <utils/Log.h>
 #include <smolv.h>
 #endif
 
-#include <assert.h>
+#include <algorithm>
+#include <memory>
+
+#include <string.h>
 
 using namespace filamat;
 
 namespace filaflat {
 
+namespace {
+
+// Compression scheme of DictionarySpirv and DictionaryCompressedSpirv chunks
+constexpr uint32_t SPIRV_SMOLV = 1;
+
+bool isSpirvDictionary(ChunkContainer::Type dictionaryTag) noexcept {
+    return dictionaryTag == ChunkType::DictionarySpirv ||
+            dictionaryTag == ChunkType::DictionaryCompressedSpirv;
+}
+
+// Compressed entries and blocks that didn't compress are stored as is, in which case their size
+// is their decompressed size.
+bool decompress(const char* data, size_t size, char* out, size_t decompressedSize) noexcept {
+    if (size == decompressedSize) {
+        memcpy(out, data, size);
+        return true;
+    }
+    return filament::lz4::decompress(data, size, out, decompressedSize);
+}
+
+bool decodeSpirv(const char* data, size_t size, size_t encodedSize,
+        ShaderContent& content) noexcept {
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+    std::unique_ptr<char[]> encoded;
+    if (size != encodedSize) {
+        encoded.reset(new(std::nothrow) char[encodedSize]);
+        if (!encoded || !decompress(data, size, encoded.get(), encodedSize)) {
+            return false;
+        }
+        data = encoded.get();
+        size = encodedSize;
+    }
+    size_t const spirvSize = smolv::GetDecodedBufferSize(data, size);
+    if (spirvSize == 0) {
+        return false;
+    }
+    content.reserve(spirvSize);
+    content.resize(spirvSize);
+    return smolv::Decode(data, size, content.data(), spirvSize);
+#else
+    return false;
+#endif
+}
+
+// Reads the header of a DictionarySpirv or DictionaryCompressedSpirv chunk.
+bool readSpirvHeader(Unflattener& unflattener, uint32_t* blobCount) noexcept {
+    uint32_t compressionScheme;
+    if (!unflattener.read(&compressionScheme) || compressionScheme != SPIRV_SMOLV) {
+        return false;
+    }
+    return unflattener.read(blobCount);
+}
+
+// Reads the next blob of a DictionarySpirv or DictionaryCompressedSpirv chunk. encodedSize is the
+// size of its smol-v data.
+bool readSpirvBlob(Unflattener& unflattener, bool lz4,
+        const char** data, size_t* size, size_t* encodedSize) noexcept {
+    uint32_t decompressedSize = 0;
+    if (lz4 && !unflattener.read(&decompressedSize)) {
+        return false;
+    }
+    unflattener.skipAlignmentPadding();
+    if (!unflattener.read(data, size)) {
+        return false;
+    }
+    assert_invariant((intptr_t(*data) % 8) == 0);
+    *encodedSize = lz4 ? decompressedSize : *size;
+    return true;
+}
+
+// Reads the header of a DictionaryCompressedText chunk.
+bool readCompressedTextHeader(Unflattener& unflattener,
+        uint32_t* stringCount, uint32_t* linesPerBlock, uint32_t* blockCount) noexcept {
+    if (!unflattener.read(stringCount) || !unflattener.read(linesPerBlock) || !*linesPerBlock) {
+        return false;
+    }
+    *blockCount = (*stringCount + *linesPerBlock - 1) / *linesPerBlock;
+    return true;
+}
+
+// Reads the next block of a DictionaryCompressedText chunk.
+bool readCompressedTextBlock(Unflattener& unflattener,
+        const char** data, size_t* size, size_t* decompressedSize) noexcept {
+    uint32_t s = 0;
+    if (!unflattener.read(&s) || !unflattener.read(data, size)) {
+        return false;
+    }
+    *decompressedSize = s;
+    return true;
+}
+
+// Calls f(line, size) for each of the count null-terminated lines of a decompressed block.
+template<typename F>
+bool splitLines(const char* data, size_t size, size_t count, F f) noexcept {
+    const char* const end = data + size;
+    for (size_t i = 0; i < count; i++) {
+        auto const* const terminator = static_cast<const char*>(memchr(data, 0, end - data));
+        if (!terminator) {
+            return false;
+        }
+        f(data, size_t(terminator - data) + 1);
+        data = terminator + 1;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+ChunkContainer::Type DictionaryReader::getDictionaryTag(ChunkContainer const& container,
+        ChunkContainer::Type dictionaryTag) noexcept {
+    if (dictionaryTag == ChunkType::DictionaryText &&
+            !container.hasChunk(ChunkType::DictionaryText) &&
+            container.hasChunk(ChunkType::DictionaryCompressedText)) {
+        return ChunkType::DictionaryCompressedText;
+    }
+    if (dictionaryTag == ChunkType::DictionarySpirv &&
+            !container.hasChunk(ChunkType::DictionarySpirv) &&
+            container.hasChunk(ChunkType::DictionaryCompressedSpirv)) {
+        return ChunkType::DictionaryCompressedSpirv;
+    }
+    return dictionaryTag;
+}
+
 bool DictionaryReader::unflatten(ChunkContainer const& container,
         ChunkContainer::Type dictionaryTag,
         BlobDictionary& dictionary) {
@@ -37,45 +165,27 @@ bool DictionaryReader::unflatten(ChunkContainer const& container,
     auto [start, end] = container.getChunkRange(dictionaryTag);
     Unflattener unflattener(start, end);
 
-    if (dictionaryTag == ChunkType::DictionarySpirv) {
-        uint32_t compressionScheme;
-        if (!unflattener.read(&compressionScheme)) {
-            return false;
-        }
-        // For now, 1 is the only acceptable compression scheme.
-        assert(compressionScheme == 1);
-
+    if (isSpirvDictionary(dictionaryTag)) {
+        bool const lz4 = dictionaryTag == ChunkType::DictionaryCompressedSpirv;
         uint32_t blobCount;
-        if (!unflattener.read(&blobCount)) {
+        if (!readSpirvHeader(unflattener, &blobCount)) {
             return false;
         }
 
         dictionary.reserve(blobCount);
         for (uint32_t i = 0; i < blobCount; i++) {
-            unflattener.skipAlignmentPadding();
-
             const char* compressed;
             size_t compressedSize;
-            if (!unflattener.read(&compressed, &compressedSize)) {
-                return false;
-            }
-
-            assert_invariant((intptr_t(compressed) % 8) == 0);
-
-#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
-            size_t spirvSize = smolv::GetDecodedBufferSize(compressed, compressedSize);
-            if (spirvSize == 0) {
+            size_t encodedSize;
+            if (!readSpirvBlob(unflattener, lz4,
+                    &compressed, &compressedSize, &encodedSize)) {
                 return false;
             }
-            ShaderContent spirv(spirvSize);
-            if (!smolv::Decode(compressed, compressedSize, spirv.data(), spirvSize)) {
+            ShaderContent spirv;
+            if (!decodeSpirv(compressed, compressedSize, encodedSize, spirv)) {
                 return false;
             }
             dictionary.emplace_back(std::move(spirv));
-#else
-            return false;
-#endif
-
         }
         return true;
     } else if (dictionaryTag == ChunkType::DictionaryText) {
@@ -96,9 +206,137 @@ bool DictionaryReader::unflatten(ChunkContainer const& container,
             memcpy(dictionary.back().data(), str, dictionary.back().size());
         }
         return true;
+    } else if (dictionaryTag == ChunkType::DictionaryCompressedText) {
+        uint32_t stringCount;
+        uint32_t linesPerBlock;
+        uint32_t blockCount;
+        if (!readCompressedTextHeader(unflattener, &stringCount, &linesPerBlock, &blockCount)) {
+            return false;
+        }
+
+        dictionary.reserve(stringCount);
+        std::unique_ptr<char[]> lines;
+        for (uint32_t i = 0; i < blockCount; i++) {
+            const char* compressed;
+            size_t compressedSize;
+            size_t size;
+            if (!readCompressedTextBlock(unflattener, &compressed, &compressedSize, &size)) {
+                return false;
+            }
+            lines.reset(new char[size]);
+            if (!decompress(compressed, compressedSize, lines.get(), size)) {
+                return false;
+            }
+            size_t const count = std::min(linesPerBlock, stringCount - i * linesPerBlock);
+            bool const success = splitLines(lines.get(), size, count,
+                    [&dictionary](const char* line, size_t lineSize) {
+                        dictionary.emplace_back(lineSize);
+                        memcpy(dictionary.back().data(), line, lineSize);
+                    });
+            if (!success) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool LazyDictionary::initialize(ChunkContainer const& container,
+        ChunkContainer::Type dictionaryTag) noexcept {
+    auto [start, end] = container.getChunkRange(dictionaryTag);
+    Unflattener unflattener(start, end);
+
+    if (isSpirvDictionary(dictionaryTag)) {
+        bool const lz4 = dictionaryTag == ChunkType::DictionaryCompressedSpirv;
+        uint32_t blobCount;
+        if (!readSpirvHeader(unflattener, &blobCount)) {
+            return false;
+        }
+
+        mEntries.reserve(blobCount);
+        for (uint32_t i = 0; i < blobCount; i++) {
+            Entry entry{};
+            if (!readSpirvBlob(unflattener, lz4,
+                    &entry.data, &entry.size, &entry.encodedSize)) {
+                return false;
+            }
+            mEntries.push_back(entry);
+        }
+        return true;
+    } else if (dictionaryTag == ChunkType::DictionaryText) {
+        uint32_t stringCount = 0;
+        if (!unflattener.read(&stringCount)) {
+            return false;
+        }
+
+        mEntries.reserve(stringCount);
+        for (uint32_t i = 0; i < stringCount; i++) {
+            const char* str;
+            if (!unflattener.read(&str)) {
+                return false;
+            }
+            size_t const size = strlen(str) + 1;
+            mEntries.push_back({ str, size, size });
+        }
+        return true;
+    } else if (dictionaryTag == ChunkType::DictionaryCompressedText) {
+        uint32_t stringCount;
+        uint32_t blockCount;
+        if (!readCompressedTextHeader(unflattener, &stringCount, &mLinesPerBlock, &blockCount)) {
+            return false;
+        }
+
+        mBlocks.reserve(blockCount);
+        for (uint32_t i = 0; i < blockCount; i++) {
+            Block block{};
+            if (!readCompressedTextBlock(unflattener,
+                    &block.data, &block.size, &block.decompressedSize)) {
+                return false;
+            }
+            mBlocks.push_back(block);
+        }
+
+        // the entries are filled when their block is decompressed
+        mEntries = utils::FixedCapacityVector<Entry>(stringCount, Entry{});
+        mBlockData = utils::FixedCapacityVector<std::unique_ptr<char[]>>(blockCount);
+        return true;
     }
 
     return false;
 }
 
+bool LazyDictionary::decompressBlock(size_t blockIndex) const noexcept {
+    if (blockIndex >= mBlocks.size()) {
+        return false;
+    }
+    Block const& block = mBlocks[blockIndex];
+    std::unique_ptr<char[]> lines(new(std::nothrow) char[block.decompressedSize]);
+    if (!lines || !decompress(block.data, block.size, lines.get(), block.decompressedSize)) {
+        return false;
+    }
+
+    size_t const first = blockIndex * mLinesPerBlock;
+    size_t const count = std::min(size_t(mLinesPerBlock), mEntries.size() - first);
+    size_t index = first;
+    bool const success = splitLines(lines.get(), block.decompressedSize, count,
+            [this, &index](const char* line, size_t lineSize) {
+                mEntries[index++] = { line, lineSize, lineSize };
+            });
+    if (!success) {
+        // don't leave entries pointing to the lines we're about to free
+        std::fill_n(mEntries.begin() + first, count, Entry{});
+        return false;
+    }
+    mBlockData[blockIndex] = std::move(lines);
+    return true;
+}
+
+bool LazyDictionary::decode(size_t index, ShaderContent& content) const noexcept {
+    assert_invariant(index < mEntries.size());
+    Entry const& entry = mEntries[index];
+    return decodeSpirv(entry.data, entry.size, entry.encodedSize, content);
+}
+
 } // namespace filaflat
@@ -21,6 +21,10 @@
 
 #include <utils/Log.h>
 
+#include <string_view>
+
+#include <string.h>
+
 namespace filaflat {
 
 static inline uint32_t makeKey(
@@ -95,8 +99,32 @@ bool MaterialChunk::initialize(filamat::ChunkType materialTag) {
     return true;
 }
 
+// Accessors for the two kinds of dictionaries, so that the shaders are read the same way from both.
+
+static bool getText(BlobDictionary const& dictionary, size_t index,
+        std::string_view& text) noexcept {
+    const auto& content = dictionary[index];
+    text = { (const char*)content.data(), content.size() - 1 };
+    return true;
+}
+
+static bool getText(LazyDictionary const& dictionary, size_t index,
+        std::string_view& text) noexcept {
+    return dictionary.getText(index, text);
+}
+
+static bool getBlob(BlobDictionary const& dictionary, size_t index, ShaderContent& content) {
+    content = dictionary[index];
+    return true;
+}
+
+static bool getBlob(LazyDictionary const& dictionary, size_t index, ShaderContent& content) {
+    return dictionary.decode(index, content);
+}
+
+template<typename Dictionary>
 bool MaterialChunk::getTextShader(Unflattener unflattener,
-        BlobDictionary const& dictionary, ShaderContent& shaderContent,
+        Dictionary const& dictionary, ShaderContent& shaderContent,
         ShaderModel shaderModel, Variant variant, ShaderStage shaderStage) {
     if (mBase == nullptr) {
         return false;
@@ -135,14 +163,18 @@ bool MaterialChunk::getTextShader(Unflattener unflattener,
     // Read all lines.
     for(int32_t i = 0 ; i < lineCount; i++) {
         uint16_t lineIndex;
-        if (!unflattener.read(&lineIndex)) {
+        if (!unflattener.read(&lineIndex) || lineIndex >= dictionary.size()) {
+            return false;
+        }
+        std::string_view content;
+        if (!getText(dictionary, lineIndex, content) ||
+                content.size() + 1 >= shaderSize - cursor) {
             return false;
         }
-        const auto& content = dictionary[lineIndex];
 
         // Replace null with newline.
-        memcpy(&shaderContent[cursor], content.data(), content.size() - 1);
-        cursor += content.size() - 1;
+        memcpy(&shaderContent[cursor], content.data(), content.size());
+        cursor += content.size();
         shaderContent[cursor++] = '\n';
     }
 
@@ -153,7 +185,8 @@ bool MaterialChunk::getTextShader(Unflattener unflattener,
     return true;
 }
 
-bool MaterialChunk::getSpirvShader(BlobDictionary const& dictionary,
+template<typename Dictionary>
+bool MaterialChunk::getSpirvShader(Dictionary const& dictionary,
         ShaderContent& shaderContent, ShaderModel shaderModel, filament::Variant variant, ShaderStage shaderStage) {
 
     if (mBase == nullptr) {
@@ -162,12 +195,11 @@ bool MaterialChunk::getSpirvShader(BlobDictionary const& dictionary,
 
     uint32_t key = makeKey(shaderModel, variant, shaderStage);
     auto pos = mOffsets.find(key);
-    if (pos == mOffsets.end()) {
+    if (pos == mOffsets.end() || pos->second >= dictionary.size()) {
         return false;
     }
 
-    shaderContent = dictionary[pos->second];
-    return true;
+    return getBlob(dictionary, pos->second, shaderContent);
 }
 
 bool MaterialChunk::hasShader(ShaderModel model, Variant variant, ShaderStage stage) const noexcept {
@@ -178,7 +210,8 @@ bool MaterialChunk::hasShader(ShaderModel model, Variant variant, ShaderStage st
     return pos != mOffsets.end();
 }
 
-bool MaterialChunk::getShader(ShaderContent& shaderContent, BlobDictionary const& dictionary,
+template<typename Dictionary>
+bool MaterialChunk::getShader(ShaderContent& shaderContent, Dictionary const& dictionary,
         ShaderModel shaderModel, filament::Variant variant, ShaderStage stage) {
     switch (mMaterialTag) {
         case filamat::ChunkType::MaterialGlsl:
@@ -192,6 +225,16 @@ bool MaterialChunk::getShader(ShaderContent& shaderContent, BlobDictionary const
     }
 }
 
+bool MaterialChunk::getShader(ShaderContent& shaderContent, BlobDictionary const& dictionary,
+        ShaderModel shaderModel, filament::Variant variant, ShaderStage stage) {
+    return getShader<BlobDictionary>(shaderContent, dictionary, shaderModel, variant, stage);
+}
+
+bool MaterialChunk::getShader(ShaderContent& shaderContent, LazyDictionary const& dictionary,
+        ShaderModel shaderModel, filament::Variant variant, ShaderStage stage) {
+    return getShader<LazyDictionary>(shaderContent, dictionary, shaderModel, variant, stage);
+}
+
 uint32_t MaterialChunk::getShaderCount() const noexcept {
     Unflattener unflattener{ mUnflattener }; // make a copy
     uint64_t numShaders;
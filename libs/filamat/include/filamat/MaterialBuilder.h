@@ -570,6 +570,35 @@ public:
     //! If true, will include debugging information in generated SPIRV.
     MaterialBuilder& generateDebugInfo(bool generateDebugInfo) noexcept;
 
+    /**
+     * Specifies a directory where the compiled shaders are cached, keyed by a hash of their
+     * generated code and of the compilation options. When building a material again, only the
+     * variants whose generated code or options changed are compiled, the others are read from
+     * the cache. The directory is created if needed and can be shared by concurrent builds.
+     * Passing nullptr or an empty string disables the cache (the default).
+     *
+     * The oldest entries are deleted when the cache grows past maxSize bytes, 0 means no limit.
+     * Entries produced by a different build of the shader compilers are never used, and are
+     * eventually deleted.
+     */
+    MaterialBuilder& shaderCache(const char* directory,
+            uint64_t maxSize = 256u * 1024u * 1024u) noexcept;
+
+    /**
+     * If true, the shader dictionaries of the package are LZ4-compressed, which makes packages
+     * significantly smaller. Each shader is still decompressed on its own when it is needed, so
+     * this has little impact on the cost of loading a variant. Defaults to false.
+     */
+    MaterialBuilder& compressDictionaries(bool compressDictionaries) noexcept;
+
+    /**
+     * If true, the package includes statistics about its shaders: the size of each variant before
+     * and after optimization and minification, the time it took to compile it, and the size of
+     * the dictionaries. They can be displayed with matinfo, to find the materials whose variants
+     * make packages large and slow to build. Defaults to false.
+     */
+    MaterialBuilder& generateStatistics(bool generateStatistics) noexcept;
+
     //! Specifies a list of variants that should be filtered out during code generation.
     MaterialBuilder& variantFilter(filament::UserVariantFilterMask variantFilter) noexcept;
 
@@ -878,6 +907,13 @@ private:
     filament::UserVariantFilterMask mVariantFilter = {};
 
     bool mNoSamplerValidation = false;
+
+    std::string mShaderCacheDirectory;
+    uint64_t mShaderCacheMaxSize = 0;
+
+    bool mCompressDictionaries = false;
+
+    bool mGenerateStatistics = false;
 };
 
 } // namespace filamat
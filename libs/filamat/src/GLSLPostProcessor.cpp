@@ -39,6 +39,7 @@
 
 #include <utils/Log.h>
 
+#include <mutex>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -85,10 +86,16 @@ GLSLPostProcessor::GLSLPostProcessor(MaterialBuilder::Optimization optimization,
         : mOptimization(optimization),
           mPrintShaders(flags & PRINT_SHADERS),
           mGenerateDebugInfo(flags & GENERATE_DEBUG_INFO) {
-    // SPIRV error handler registration needs to occur only once. To avoid a race we do it up here
-    // in the constructor, which gets invoked before MaterialBuilder kicks off jobs.
-    spv::spirvbin_t::registerErrorHandler([](const std::string& str) {
-        slog.e << str << io::endl;
+}
+
+void GLSLPostProcessor::init() {
+    // The handler is a static std::function, writing it while materials are being built (e.g. by
+    // several threads in matc's batch mode) is a race, so it's only registered once.
+    static std::once_flag sErrorHandlerOnceFlag;
+    std::call_once(sErrorHandlerOnceFlag, []() {
+        spv::spirvbin_t::registerErrorHandler([](const std::string& str) {
+            slog.e << str << io::endl;
+        });
     });
 }
 
@@ -56,6 +56,10 @@ public:
 
     ~GLSLPostProcessor();
 
+    // Registers the SPIR-V remapper's error handler, which is global. This is called by
+    // MaterialBuilder::init(), before any material is built.
+    static void init();
+
     struct Config {
         filament::Variant variant;
         MaterialBuilder::TargetApi targetApi;
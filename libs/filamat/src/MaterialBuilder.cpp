@@ -24,6 +24,7 @@
 #include "shaders/UibGenerator.h"
 
 #include "GLSLPostProcessor.h"
+#include "ShaderCache.h"
 #include "sca/GLSLTools.h"
 
 #include "shaders/MaterialInfo.h"
@@ -34,6 +35,7 @@
 #include "eiff/MaterialInterfaceBlockChunk.h"
 #include "eiff/MaterialTextChunk.h"
 #include "eiff/MaterialSpirvChunk.h"
+#include "eiff/MaterialStatisticsChunk.h"
 #include "eiff/ChunkContainer.h"
 #include "eiff/SimpleFieldChunk.h"
 #include "eiff/DictionaryTextChunk.h"
@@ -52,7 +54,9 @@
 #include <utils/Panic.h>
 #include <utils/Hash.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <utility>
 #include <vector>
 
@@ -179,6 +183,7 @@ MaterialBuilder::~MaterialBuilder() = default;
 void MaterialBuilderBase::init() {
     materialBuilderClients++;
     GLSLTools::init();
+    GLSLPostProcessor::init();
 }
 
 void MaterialBuilderBase::shutdown() {
@@ -528,6 +533,22 @@ MaterialBuilder& MaterialBuilder::generateDebugInfo(bool generateDebugInfo) noex
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::shaderCache(const char* directory, uint64_t maxSize) noexcept {
+    mShaderCacheDirectory = directory ? directory : "";
+    mShaderCacheMaxSize = maxSize;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::compressDictionaries(bool compressDictionaries) noexcept {
+    mCompressDictionaries = compressDictionaries;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::generateStatistics(bool generateStatistics) noexcept {
+    mGenerateStatistics = generateStatistics;
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::variantFilter(UserVariantFilterMask variantFilter) noexcept {
     mVariantFilter = variantFilter;
     return *this;
@@ -795,6 +816,10 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     flags |= mGenerateDebugInfo ? GLSLPostProcessor::GENERATE_DEBUG_INFO : 0;
     GLSLPostProcessor postProcessor(mOptimization, flags);
 
+    // The cache is bypassed when printing shaders, since they're printed by the postprocessor.
+    ShaderCache const shaderCache(mPrintShaders ? std::string{} : mShaderCacheDirectory,
+            mShaderCacheMaxSize);
+
     // Start: must be protected by lock
     Mutex entriesLock;
     std::vector<TextEntry> glslEntries;
@@ -803,6 +828,7 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     std::vector<TextEntry> metalEntries;
     LineDictionary textDictionary;
     BlobDictionary spirvDictionary;
+    std::vector<ShaderStatistics> statistics;
     // End: must be protected by lock
 
     ShaderGenerator sg(mProperties, mVariables, mOutputs, mDefines, mConstants,
@@ -842,6 +868,8 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                     return;
                 }
 
+                auto const start = std::chrono::steady_clock::now();
+
                 // TODO: avoid allocations when not required
                 std::vector<uint32_t> spirv;
                 std::string msl;
@@ -879,6 +907,8 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                             shaderModel, targetApi, targetLanguage, featureLevel, info);
                 }
 
+                size_t const generatedSize = shader.size();
+
                 std::string* pGlsl = nullptr;
                 if (targetApiNeedsGlsl) {
                     pGlsl = &shader;
@@ -902,15 +932,27 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                     config.glsl.subpassInputToColorLocation.emplace_back(0, 0);
                 }
 
-                bool const ok = postProcessor.process(shader, config, pGlsl, pSpirv, pMsl);
-                if (!ok) {
-                    showErrorMessage(mMaterialName.c_str_safe(), v.variant, targetApi, v.stage,
-                                     featureLevel, shader);
-                    cancelJobs = true;
-                    if (mPrintShaders) {
-                        slog.e << shader << io::endl;
+                // The key must be computed before processing, because the GLSL output replaces
+                // the generated shader.
+                std::string cacheKey;
+                bool cached = false;
+                if (shaderCache.isEnabled()) {
+                    cacheKey = ShaderCache::getKey(shader, config, mOptimization, flags);
+                    cached = shaderCache.retrieve(cacheKey, pGlsl, pSpirv, pMsl);
+                }
+
+                if (!cached) {
+                    bool const ok = postProcessor.process(shader, config, pGlsl, pSpirv, pMsl);
+                    if (!ok) {
+                        showErrorMessage(mMaterialName.c_str_safe(), v.variant, targetApi, v.stage,
+                                featureLevel, shader);
+                        cancelJobs = true;
+                        if (mPrintShaders) {
+                            slog.e << shader << io::endl;
+                        }
+                        return;
                     }
-                    return;
+                    shaderCache.insert(cacheKey, pGlsl, pSpirv, pMsl);
                 }
 
                 if (targetApi == TargetApi::OPENGL) {
@@ -920,6 +962,36 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                     }
                 }
 
+                ShaderStatistics shaderStatistics{};
+                if (mGenerateStatistics) {
+                    auto const compileTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start);
+                    using backend::ShaderLanguage;
+                    ShaderLanguage language = ShaderLanguage::SPIRV;
+                    std::string const* text = nullptr;
+                    if (targetApiNeedsMsl) {
+                        language = ShaderLanguage::MSL;
+                        text = &msl;
+                    } else if (targetApiNeedsGlsl) {
+                        language = featureLevel == FeatureLevel::FEATURE_LEVEL_0 ?
+                                ShaderLanguage::ESSL1 : ShaderLanguage::ESSL3;
+                        text = &shader;
+                    }
+                    shaderStatistics = {
+                            .language = language,
+                            .shaderModel = params.shaderModel,
+                            .variant = v.variant,
+                            .stage = v.stage,
+                            .generatedSize = uint32_t(generatedSize),
+                            .outputSize = uint32_t(text ? text->size() :
+                                    spirv.size() * sizeof(uint32_t)),
+                            .lineCount = text ?
+                                    uint32_t(std::count(text->begin(), text->end(), '\n')) : 0,
+                            .compileTime = uint32_t(compileTime.count()),
+                            .cached = cached,
+                    };
+                }
+
                 // NOTE: Everything below touches shared structures protected by a lock
                 // NOTE: do not execute expensive work from here on!
                 std::unique_lock<Mutex> const lock(entriesLock);
@@ -927,6 +999,9 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                 // below we rely on casting ShaderStage to uint8_t
                 static_assert(sizeof(filament::backend::ShaderStage) == 1);
 
+                if (mGenerateStatistics) {
+                    statistics.push_back(shaderStatistics);
+                }
 
                 switch (targetApi) {
                     case TargetApi::ALL:
@@ -971,6 +1046,8 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
         jobSystem.runAndWait(parent);
     }
 
+    shaderCache.trim();
+
     if (cancelJobs.load()) {
         return false;
     }
@@ -987,6 +1064,9 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     std::sort(essl1Entries.begin(), essl1Entries.end(), compare);
     std::sort(spirvEntries.begin(), spirvEntries.end(), compare);
     std::sort(metalEntries.begin(), metalEntries.end(), compare);
+    std::sort(statistics.begin(), statistics.end(), [&compare](auto const& a, auto const& b) {
+        return a.language != b.language ? a.language < b.language : compare(a, b);
+    });
 
     // Generate the dictionaries.
     for (const auto& s : glslEntries) {
@@ -1003,9 +1083,25 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
         textDictionary.addText(s.shader);
     }
 
+    // Emit statistics chunk (MaterialStatisticsChunk), before the dictionaries are moved.
+    if (mGenerateStatistics) {
+        DictionaryStatistics dictionaries{};
+        dictionaries.uniqueLineCount = uint32_t(textDictionary.getLineCount());
+        for (size_t i = 0; i < textDictionary.getLineCount(); i++) {
+            // lines are null-terminated in the dictionary
+            dictionaries.textSize += textDictionary.getString(i).size() + 1;
+        }
+        dictionaries.uniqueSpirvCount = uint32_t(spirvDictionary.getBlobCount());
+        for (size_t i = 0; i < spirvDictionary.getBlobCount(); i++) {
+            dictionaries.spirvSize += spirvDictionary.getBlob(i).size();
+        }
+        container.push<MaterialStatisticsChunk>(dictionaries, std::move(statistics));
+    }
+
     // Emit dictionary chunk (TextDictionaryReader and DictionaryTextChunk)
     const auto& dictionaryChunk = container.push<filamat::DictionaryTextChunk>(
-            std::move(textDictionary), ChunkType::DictionaryText);
+            std::move(textDictionary), mCompressDictionaries ?
+                    ChunkType::DictionaryCompressedText : ChunkType::DictionaryText);
 
     // Emit GLSL chunk (MaterialTextChunk).
     if (!glslEntries.empty()) {
@@ -1022,7 +1118,8 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     // Emit SPIRV chunks (SpirvDictionaryReader and MaterialSpirvChunk).
     if (!spirvEntries.empty()) {
         const bool stripInfo = !mGenerateDebugInfo;
-        container.push<filamat::DictionarySpirvChunk>(std::move(spirvDictionary), stripInfo);
+        container.push<filamat::DictionarySpirvChunk>(std::move(spirvDictionary), stripInfo,
+                mCompressDictionaries);
         container.push<MaterialSpirvChunk>(std::move(spirvEntries));
     }
 
@@ -1261,7 +1358,7 @@ bool MaterialBuilder::checkMaterialLevelFeatures(MaterialInfo const& info) const
             // note: currently SSAO is not used with unlit, but we want to keep that possibility.
             uint32_t textureUsedByFilamentCount = 4;    // shadowMap, structure, ssao, fog texture
             if (info.isLit) {
-                textureUsedByFilamentCount += 3;        // froxels, dfg, specular
+                textureUsedByFilamentCount += 3;        // lights, dfg, specular
             }
             if (info.reflectionMode == ReflectionMode::SCREEN_SPACE ||
                 info.refractionMode == RefractionMode::SCREEN_SPACE) {
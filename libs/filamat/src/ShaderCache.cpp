@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderCache.h"
+
+#include "shaders/MaterialInfo.h"
+
+#include <filament/MaterialEnums.h>
+
+#include <private/filament/SamplerInterfaceBlock.h>
+
+#include <ShaderLang.h>
+#include <spirv-tools/libspirv.h>
+
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Path.h>
+
+#include <algorithm>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace filamat {
+
+using namespace utils;
+
+namespace {
+
+// Bump this when the format of the entries changes. Changes of the compilers are detected by
+// getToolchainId().
+constexpr uint32_t CACHE_VERSION = 2;
+
+constexpr char ENTRY_MAGIC[4] = { 'F', 'S', 'C', 'E' };
+
+struct EntryHeader {
+    char magic[4];
+    uint32_t keySize;
+    uint32_t keyHash;
+    uint32_t outputs;   // bitmask of the outputs stored in this entry
+};
+
+enum Output : uint32_t {
+    GLSL = 0x1,
+    SPIRV = 0x2,
+    MSL = 0x4,
+};
+
+template<typename T>
+void append(std::string& key, T const& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    key.append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void append(std::string& key, char const* string) {
+    // include the terminating null so that consecutive strings can't be confused
+    key.append(string ? string : "", (string ? strlen(string) : 0) + 1);
+}
+
+// FNV-1a, the entries' names must not depend on the platform
+uint64_t hash64(std::string const& data) noexcept {
+    uint64_t h = 0xcbf29ce484222325u;
+    for (char const c : data) {
+        h = (h ^ uint8_t(c)) * 0x100000001b3u;
+    }
+    return h;
+}
+
+uint32_t hash32(std::string const& data) noexcept {
+    return data.empty() ? 0 : hash::murmurSlow((uint8_t const*)data.data(), data.size(), 0);
+}
+
+// 64-bit hash of a file's content, 0 if it can't be read
+uint64_t hashFile(std::string const& path) noexcept {
+    FILE* const file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    std::vector<uint32_t> buffer(16 * 1024);
+    uint32_t h0 = 0;
+    uint32_t h1 = 0x9747B28Cu;
+    uint64_t size = 0;
+    size_t count;
+    while ((count = fread(buffer.data(), 1, buffer.size() * sizeof(uint32_t), file)) > 0) {
+        // the last block is padded with zeros, the file's size tells it apart
+        memset(reinterpret_cast<char*>(buffer.data()) + count, 0,
+                buffer.size() * sizeof(uint32_t) - count);
+        size_t const wordCount = (count + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        h0 = hash::murmur3(buffer.data(), wordCount, h0);
+        h1 = hash::murmur3(buffer.data(), wordCount, h1);
+        size += count;
+    }
+    fclose(file);
+    return ((uint64_t(h0) << 32u) | h1) ^ size;
+}
+
+// Identifies the compilers that produce the entries. The vendored glslang, SPIRV-Tools and
+// SPIRV-Cross don't record the revision they were taken from, so in addition to their versions,
+// this hashes the executable filamat is linked into (e.g. matc), which changes whenever it's
+// built from different sources or with a different compiler.
+std::string const& getToolchainId() {
+    static std::string const id = [] {
+        std::string id;
+        glslang::Version const version = glslang::GetVersion();
+        append(id, version.major);
+        append(id, version.minor);
+        append(id, version.patch);
+        append(id, version.flavor);
+        append(id, spvSoftwareVersionDetailsString());
+        append(id, hashFile(Path::getCurrentExecutable().getPath()));
+        return id;
+    }();
+    return id;
+}
+
+bool write(FILE* file, void const* data, size_t size) noexcept {
+    return !size || fwrite(data, size, 1, file) == 1;
+}
+
+bool read(FILE* file, void* data, size_t size) noexcept {
+    return !size || fread(data, size, 1, file) == 1;
+}
+
+template<typename T>
+bool writeArray(FILE* file, T const& array) noexcept {
+    uint64_t const count = array.size();
+    return write(file, &count, sizeof(count)) &&
+            write(file, array.data(), count * sizeof(array[0]));
+}
+
+template<typename T>
+bool readArray(FILE* file, T& array) {
+    uint64_t count = 0;
+    if (!read(file, &count, sizeof(count)) || count > (uint64_t(1) << 32u)) {
+        return false;
+    }
+    array.resize(size_t(count));
+    return read(file, array.data(), size_t(count) * sizeof(array[0]));
+}
+
+} // anonymous namespace
+
+ShaderCache::ShaderCache(std::string directory, uint64_t maxSize) noexcept
+        : mDirectory(std::move(directory)), mMaxSize(maxSize) {
+    if (isEnabled() && !Path(mDirectory).mkdirRecursive()) {
+        slog.w << "Can't create the shader cache directory " << mDirectory.c_str() << io::endl;
+    }
+}
+
+std::string ShaderCache::getKey(std::string const& shader, GLSLPostProcessor::Config const& config,
+        MaterialBuilder::Optimization optimization, uint32_t flags) {
+    std::string key;
+    key.reserve(shader.size() + 256);
+
+    append(key, CACHE_VERSION);
+    key.append(getToolchainId());
+    append(key, uint32_t(filament::MATERIAL_VERSION));
+    append(key, optimization);
+    append(key, flags);
+
+    append(key, config.variant.key);
+    append(key, config.targetApi);
+    append(key, config.targetLanguage);
+    append(key, config.shaderType);
+    append(key, config.shaderModel);
+    append(key, config.featureLevel);
+    append(key, config.domain);
+    append(key, config.hasFramebufferFetch);
+    append(key, config.usesClipDistance);
+    append(key, uint32_t(config.glsl.subpassInputToColorLocation.size()));
+    for (auto const& [index, location] : config.glsl.subpassInputToColorLocation) {
+        append(key, index);
+        append(key, location);
+    }
+
+    // The material's samplers are only used to generate MSL; everything else the post-processor
+    // needs is in the generated shader itself.
+    if (config.targetApi == MaterialBuilder::TargetApi::METAL && config.materialInfo) {
+        auto const& sib = config.materialInfo->sib;
+        append(key, sib.getName().c_str_safe());
+        append(key, uint32_t(sib.getSamplerInfoList().size()));
+        for (auto const& sampler : sib.getSamplerInfoList()) {
+            append(key, sampler.name.c_str_safe());
+            append(key, sampler.uniformName.c_str_safe());
+            append(key, sampler.offset);
+            append(key, sampler.type);
+            append(key, sampler.format);
+            append(key, sampler.precision);
+            append(key, sampler.multisample);
+        }
+    }
+
+    key.append(shader);
+    return key;
+}
+
+std::string ShaderCache::getPath(std::string const& key) const noexcept {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash64(key));
+    return Path::concat(mDirectory, name).getPath();
+}
+
+bool ShaderCache::retrieve(std::string const& key,
+        std::string* outputGlsl, SpirvBlob* outputSpirv, std::string* outputMsl) const {
+    if (!isEnabled()) {
+        return false;
+    }
+
+    FILE* const file = fopen(getPath(key).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint32_t const requested =
+            (outputGlsl ? GLSL : 0) | (outputSpirv ? SPIRV : 0) | (outputMsl ? MSL : 0);
+
+    // the name of the entry is a 64-bit hash of the key, we also check its size and a second
+    // hash to make collisions practically impossible.
+    EntryHeader header{};
+    bool success = read(file, &header, sizeof(header)) &&
+            !memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) &&
+            header.keySize == key.size() &&
+            header.keyHash == hash32(key) &&
+            (header.outputs & requested) == requested;
+
+    // read into temporaries so that the outputs are untouched if the entry is damaged
+    std::string glsl;
+    SpirvBlob spirv;
+    std::string msl;
+    success = success &&
+            (!(header.outputs & GLSL) || readArray(file, glsl)) &&
+            (!(header.outputs & SPIRV) || readArray(file, spirv)) &&
+            (!(header.outputs & MSL) || readArray(file, msl));
+    fclose(file);
+
+    if (!success) {
+        return false;
+    }
+    if (outputGlsl) {
+        *outputGlsl = std::move(glsl);
+    }
+    if (outputSpirv) {
+        *outputSpirv = std::move(spirv);
+    }
+    if (outputMsl) {
+        *outputMsl = std::move(msl);
+    }
+    return true;
+}
+
+void ShaderCache::insert(std::string const& key, std::string const* glsl, SpirvBlob const* spirv,
+        std::string const* msl) const {
+    if (!isEnabled()) {
+        return;
+    }
+
+    // Other threads or processes could be writing the same entry, so we write to a file with a
+    // unique name and rename it, to never expose a partially written entry.
+    std::string const path = getPath(key);
+    std::string const tmpPath = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    FILE* const file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+
+    EntryHeader header{};
+    memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.keySize = uint32_t(key.size());
+    header.keyHash = hash32(key);
+    header.outputs = (glsl ? GLSL : 0) | (spirv ? SPIRV : 0) | (msl ? MSL : 0);
+
+    bool success = write(file, &header, sizeof(header)) &&
+            (!glsl || writeArray(file, *glsl)) &&
+            (!spirv || writeArray(file, *spirv)) &&
+            (!msl || writeArray(file, *msl));
+    success = fclose(file) == 0 && success;
+
+    // rename() fails on some platforms if the entry exists, in which case we keep the existing
+    // entry, which is identical.
+    if (!success || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+    }
+}
+
+void ShaderCache::trim() const {
+    if (!isEnabled() || !mMaxSize) {
+        return;
+    }
+
+    struct Entry {
+        Path path;
+        uint64_t size;
+        int64_t time;
+    };
+    std::vector<Entry> entries;
+    uint64_t totalSize = 0;
+    for (Path& path : Path(mDirectory).listContents()) {
+        // skip the entries being written
+        if (path.getExtension() != "bin") {
+            continue;
+        }
+        struct stat file{};
+        if (stat(path.c_str(), &file) == 0) {
+            entries.push_back({ std::move(path), uint64_t(file.st_size), int64_t(file.st_mtime) });
+            totalSize += uint64_t(file.st_size);
+        }
+    }
+    if (totalSize <= mMaxSize) {
+        return;
+    }
+
+    // Delete the oldest entries. Another process could be deleting them too, or replacing them
+    // with identical ones, both are harmless.
+    std::sort(entries.begin(), entries.end(), [](Entry const& lhs, Entry const& rhs) {
+        return lhs.time < rhs.time;
+    });
+    for (Entry& entry : entries) {
+        if (totalSize <= mMaxSize) {
+            break;
+        }
+        entry.path.unlinkFile();
+        totalSize -= entry.size;
+    }
+}
+
+} // namespace filamat
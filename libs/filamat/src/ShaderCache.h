@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_SHADERCACHE_H
+#define TNT_FILAMAT_SHADERCACHE_H
+
+#include "GLSLPostProcessor.h"
+
+#include <filamat/MaterialBuilder.h>
+
+#include <string>
+
+#include <stdint.h>
+
+namespace filamat {
+
+/**
+ * A content-addressed cache of the outputs of GLSLPostProcessor, stored in a directory.
+ *
+ * Each entry is a file named after a hash of the generated shader and of all the options that
+ * affect its post-processing, so a material only needs to recompile the variants whose generated
+ * code or options changed since the last build. Entries are written to a temporary file first and
+ * then renamed, which allows several processes to share the same directory. The key includes an
+ * identifier of the compilers, so that entries produced by another version of them are never
+ * used, and trim() keeps the directory under a maximum size.
+ *
+ * All methods are thread-safe.
+ */
+class ShaderCache {
+public:
+    // an empty directory disables the cache, a maxSize of 0 doesn't limit its size
+    ShaderCache(std::string directory, uint64_t maxSize) noexcept;
+
+    bool isEnabled() const noexcept { return !mDirectory.empty(); }
+
+    // Returns the key identifying the output of GLSLPostProcessor::process() for the given
+    // inputs.
+    static std::string getKey(std::string const& shader, GLSLPostProcessor::Config const& config,
+            MaterialBuilder::Optimization optimization, uint32_t flags);
+
+    // Returns true and fills the requested outputs if the cache has an entry for this key, with
+    // all the requested outputs.
+    bool retrieve(std::string const& key,
+            std::string* outputGlsl, SpirvBlob* outputSpirv, std::string* outputMsl) const;
+
+    // Adds an entry to the cache. Failures are silently ignored.
+    void insert(std::string const& key, std::string const* glsl, SpirvBlob const* spirv,
+            std::string const* msl) const;
+
+    // Deletes the oldest entries until the entries fit in the maximum size.
+    void trim() const;
+
+private:
+    std::string getPath(std::string const& key) const noexcept;
+
+    std::string const mDirectory;
+    uint64_t const mMaxSize;
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_SHADERCACHE_H
@@ -16,17 +16,24 @@
 
 #include "DictionarySpirvChunk.h"
 
+#include <private/filament/Lz4.h>
+
 #include <smolv.h>
 
+#include <vector>
+
 namespace filamat {
 
-DictionarySpirvChunk::DictionarySpirvChunk(BlobDictionary&& dictionary, bool stripDebugInfo) :
-        Chunk(ChunkType::DictionarySpirv), mDictionary(std::move(dictionary)), mStripDebugInfo(stripDebugInfo) {
+DictionarySpirvChunk::DictionarySpirvChunk(BlobDictionary&& dictionary, bool stripDebugInfo,
+        bool compress) :
+        Chunk(compress ? ChunkType::DictionaryCompressedSpirv : ChunkType::DictionarySpirv),
+        mDictionary(std::move(dictionary)),
+        mStripDebugInfo(stripDebugInfo), mCompress(compress) {
 }
 
 void DictionarySpirvChunk::flatten(Flattener& f) {
 
-    // For now, 1 is the only acceptable compression scheme.
+    // 1: smol-v, in a DictionaryCompressedSpirv chunk each blob is then LZ4-compressed
     f.writeUint32(1);
 
     uint32_t flags = 0;
@@ -34,6 +41,7 @@ void DictionarySpirvChunk::flatten(Flattener& f) {
         flags |= smolv::kEncodeFlagStripDebugInfo;
     }
 
+    std::vector<char> lz4;
     f.writeUint32(mDictionary.getBlobCount());
     for (size_t i = 0 ; i < mDictionary.getBlobCount() ; i++) {
         std::string_view spirv = mDictionary.getBlob(i);
@@ -42,8 +50,23 @@ void DictionarySpirvChunk::flatten(Flattener& f) {
             utils::slog.e << "Error with SPIRV compression" << utils::io::endl;
         }
 
-        f.writeAlignmentPadding();
-        f.writeBlob((const char*) compressed.data(), compressed.size());
+        if (mCompress) {
+            // Blobs that don't compress are stored as is, which the reader detects because their
+            // size is their decompressed size.
+            lz4.resize(filament::lz4::compressBound(compressed.size()));
+            size_t const size = filament::lz4::compress(compressed.data(), compressed.size(),
+                    lz4.data(), lz4.size());
+            f.writeUint32(uint32_t(compressed.size()));
+            f.writeAlignmentPadding();
+            if (size && size < compressed.size()) {
+                f.writeBlob(lz4.data(), size);
+            } else {
+                f.writeBlob((const char*) compressed.data(), compressed.size());
+            }
+        } else {
+            f.writeAlignmentPadding();
+            f.writeBlob((const char*) compressed.data(), compressed.size());
+        }
     }
 }
 
@@ -28,7 +28,9 @@ namespace filamat {
 
 class DictionarySpirvChunk final : public Chunk {
 public:
-    explicit DictionarySpirvChunk(BlobDictionary&& dictionary, bool stripDebugInfo);
+    // Emits a DictionarySpirv chunk, or a DictionaryCompressedSpirv chunk when compress is true, in
+    // which the smol-v encoded blobs are also LZ4-compressed, each on its own.
+    DictionarySpirvChunk(BlobDictionary&& dictionary, bool stripDebugInfo, bool compress = false);
     ~DictionarySpirvChunk() = default;
 
 private:
@@ -36,6 +38,7 @@ private:
 
     BlobDictionary mDictionary;
     bool mStripDebugInfo;
+    bool mCompress;
 };
 
 } // namespace filamat
@@ -16,13 +16,33 @@
 
 #include "DictionaryTextChunk.h"
 
+#include <private/filament/Lz4.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
 namespace filamat {
 
+namespace {
+
+// Number of lines compressed together in a DictionaryCompressedText chunk. A block is the unit
+// of decompression, so this trades the compression ratio for the amount of text that is
+// decompressed to get a single line.
+constexpr uint32_t LINES_PER_BLOCK = 256;
+
+} // anonymous namespace
+
 DictionaryTextChunk::DictionaryTextChunk(LineDictionary&& dictionary, ChunkType chunkType) :
         Chunk(chunkType), mDictionary(std::move(dictionary)) {
 }
 
 void DictionaryTextChunk::flatten(Flattener& f) {
+    if (getType() == ChunkType::DictionaryCompressedText) {
+        flattenCompressed(f);
+        return;
+    }
+
     // NumStrings
     f.writeUint32(mDictionary.getLineCount());
 
@@ -32,4 +52,36 @@ void DictionaryTextChunk::flatten(Flattener& f) {
     }
 }
 
+void DictionaryTextChunk::flattenCompressed(Flattener& f) {
+    uint32_t const lineCount = uint32_t(mDictionary.getLineCount());
+    f.writeUint32(lineCount);
+    f.writeUint32(LINES_PER_BLOCK);
+
+    // Each block holds the null-terminated strings of LINES_PER_BLOCK consecutive lines, and is
+    // compressed independently of the others. Blocks that don't compress are stored as is, which
+    // the reader detects because their size is their decompressed size.
+    std::string block;
+    std::vector<char> compressed;
+    for (uint32_t first = 0; first < lineCount; first += LINES_PER_BLOCK) {
+        block.clear();
+        uint32_t const last = std::min(first + LINES_PER_BLOCK, lineCount);
+        for (uint32_t i = first; i < last; i++) {
+            std::string_view const line = mDictionary.getString(i);
+            block.append(line.data(), line.size());
+            block.push_back('\0');
+        }
+
+        compressed.resize(filament::lz4::compressBound(block.size()));
+        size_t const size = filament::lz4::compress(block.data(), block.size(),
+                compressed.data(), compressed.size());
+
+        f.writeUint32(uint32_t(block.size()));
+        if (size && size < block.size()) {
+            f.writeBlob(compressed.data(), size);
+        } else {
+            f.writeBlob(block.data(), block.size());
+        }
+    }
+}
+
 } // namespace filamat
@@ -26,6 +26,8 @@
 
 namespace filamat {
 
+// Emits a DictionaryText chunk, or a DictionaryCompressedText chunk, in which the lines are
+// LZ4-compressed in blocks.
 class DictionaryTextChunk final : public Chunk {
 public:
     DictionaryTextChunk(LineDictionary&& dictionary, ChunkType chunkType);
@@ -35,6 +37,7 @@ public:
 
 private:
     void flatten(Flattener& f) override;
+    void flattenCompressed(Flattener& f);
 
     const LineDictionary mDictionary;
 };
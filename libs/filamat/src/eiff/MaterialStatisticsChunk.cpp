@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "MaterialStatisticsChunk.h"
+
+#include <utility>
+
+namespace filamat {
+
+MaterialStatisticsChunk::MaterialStatisticsChunk(DictionaryStatistics const& dictionaries,
+        std::vector<ShaderStatistics>&& shaders)
+        : Chunk(ChunkType::MaterialStatistics),
+          mDictionaries(dictionaries), mShaders(std::move(shaders)) {
+}
+
+void MaterialStatisticsChunk::flatten(Flattener& f) {
+    f.writeUint32(mDictionaries.uniqueLineCount);
+    f.writeUint64(mDictionaries.textSize);
+    f.writeUint32(mDictionaries.uniqueSpirvCount);
+    f.writeUint64(mDictionaries.spirvSize);
+
+    f.writeUint64(mShaders.size());
+    for (ShaderStatistics const& shader : mShaders) {
+        f.writeUint8(uint8_t(shader.language));
+        f.writeUint8(uint8_t(shader.shaderModel));
+        f.writeUint8(shader.variant.key);
+        f.writeUint8(uint8_t(shader.stage));
+        f.writeUint32(shader.generatedSize);
+        f.writeUint32(shader.outputSize);
+        f.writeUint32(shader.lineCount);
+        f.writeUint32(shader.compileTime);
+        f.writeBool(shader.cached);
+    }
+}
+
+} // namespace filamat
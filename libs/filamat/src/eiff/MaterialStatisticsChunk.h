@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_FILAMAT_MATERIAL_STATISTICS_CHUNK_H
+#define TNT_FILAMAT_MATERIAL_STATISTICS_CHUNK_H
+
+#include "Chunk.h"
+
+#include <private/filament/Variant.h>
+
+#include <backend/DriverEnums.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace filamat {
+
+// Statistics about the generation and compilation of one shader of the package.
+struct ShaderStatistics {
+    filament::backend::ShaderLanguage language;
+    filament::backend::ShaderModel shaderModel;
+    filament::Variant variant;
+    filament::backend::ShaderStage stage;
+    uint32_t generatedSize;     // size of the generated GLSL, in bytes
+    uint32_t outputSize;        // size of the shader after optimization and minification, in bytes
+    uint32_t lineCount;         // number of lines of text shaders, 0 for SPIR-V
+    uint32_t compileTime;       // time spent generating and compiling the shader, in microseconds
+    bool cached;                // true if the shader was found in the shader cache
+};
+
+// Statistics about the dictionaries of the package.
+struct DictionaryStatistics {
+    uint32_t uniqueLineCount = 0;
+    uint64_t textSize = 0;      // size of the unique lines of the text dictionary, in bytes
+    uint32_t uniqueSpirvCount = 0;
+    uint64_t spirvSize = 0;     // size of the unique blobs of the SPIR-V dictionary, in bytes
+};
+
+// Optional chunk used by tools, e.g. matinfo, to find out which variants contribute the most to the
+// size of a package and to its compilation time. It is ignored by filament.
+class MaterialStatisticsChunk final : public Chunk {
+public:
+    MaterialStatisticsChunk(DictionaryStatistics const& dictionaries,
+            std::vector<ShaderStatistics>&& shaders);
+    ~MaterialStatisticsChunk() override = default;
+
+private:
+    void flatten(Flattener& f) override;
+
+    const DictionaryStatistics mDictionaries;
+    const std::vector<ShaderStatistics> mShaders;
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_MATERIAL_STATISTICS_CHUNK_H
@@ -49,7 +49,8 @@ SamplerInterfaceBlock const& SibGenerator::getPerViewSib(Variant variant) noexce
                     { "ssao",        Type::SAMPLER_2D_ARRAY, Format::FLOAT,  Precision::MEDIUM },
                     { "ssr",         Type::SAMPLER_2D_ARRAY, Format::FLOAT,  Precision::MEDIUM },
                     { "structure",   Type::SAMPLER_2D,       Format::FLOAT,  Precision::HIGH   },
-                    { "fog",         Type::SAMPLER_CUBEMAP,  Format::FLOAT,  Precision::MEDIUM }}
+                    { "fog",         Type::SAMPLER_CUBEMAP,  Format::FLOAT,  Precision::MEDIUM },
+                    { "lights",      Type::SAMPLER_2D,       Format::FLOAT,  Precision::HIGH   }}
             )
             .build() };
 
@@ -62,7 +63,8 @@ SamplerInterfaceBlock const& SibGenerator::getPerViewSib(Variant variant) noexce
                     { "ssao",        Type::SAMPLER_2D_ARRAY, Format::FLOAT,  Precision::MEDIUM },
                     { "ssr",         Type::SAMPLER_2D_ARRAY, Format::FLOAT,  Precision::MEDIUM },
                     { "structure",   Type::SAMPLER_2D,       Format::FLOAT,  Precision::HIGH   },
-                    { "fog",         Type::SAMPLER_CUBEMAP,  Format::FLOAT,  Precision::MEDIUM }}
+                    { "fog",         Type::SAMPLER_CUBEMAP,  Format::FLOAT,  Precision::MEDIUM },
+                    { "lights",      Type::SAMPLER_2D,       Format::FLOAT,  Precision::HIGH   }}
             )
             .build() };
 
@@ -75,7 +77,8 @@ SamplerInterfaceBlock const& SibGenerator::getPerViewSib(Variant variant) noexce
                     { "ssao",        Type::SAMPLER_2D_ARRAY, Format::FLOAT,  Precision::MEDIUM },
                     { "ssr",         Type::SAMPLER_2D,       Format::FLOAT,  Precision::MEDIUM },
                     { "structure",   Type::SAMPLER_2D,       Format::FLOAT,  Precision::HIGH   },
-                    { "unused5" }}
+                    { "unused5" },
+                    { "unused6" }}
             )
             .build() };
 
@@ -185,7 +185,7 @@ BufferInterfaceBlock const& UibGenerator::getPerRenderableUib() noexcept {
 BufferInterfaceBlock const& UibGenerator::getLightsUib() noexcept {
     static BufferInterfaceBlock const uib = BufferInterfaceBlock::Builder()
             .name(LightsUib::_name)
-            .add({{ "lights", CONFIG_MAX_LIGHT_COUNT,
+            .add({{ "lights", CONFIG_MAX_LIGHT_UNIFORM_COUNT,
                     BufferInterfaceBlock::Type::MAT4, Precision::HIGH }})
             .build();
     return uib;
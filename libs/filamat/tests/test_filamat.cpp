@@ -25,9 +25,23 @@
 #include <filamat/Enums.h>
 #include <filamat/MaterialBuilder.h>
 
+#include <filament/MaterialChunkType.h>
+
+#include <filaflat/ChunkContainer.h>
+#include <filaflat/DictionaryReader.h>
+#include <filaflat/MaterialChunk.h>
+
+#include <private/filament/Lz4.h>
+
 #include <utils/JobSystem.h>
+#include <utils/Path.h>
 
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <string.h>
 
 using namespace utils;
 using namespace ASTHelpers;
@@ -889,6 +903,230 @@ TEST_F(MaterialCompiler, FeatureLevel0Ess3CallFails) {
   EXPECT_FALSE(result.isValid());
 }
 
+TEST_F(MaterialCompiler, ShaderCache) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = texture(materialParams_sampler, vec2(0.0, 0.0));
+        }
+    )");
+
+    Path const cacheDirectory =
+            Path::concat(Path::getTemporaryDirectory(), "filamat_test_shader_cache");
+    for (Path entry : cacheDirectory.listContents()) {
+        entry.unlinkFile();
+    }
+
+    auto build = [&](const char* cacheDirectory, uint64_t maxSize = 256u * 1024u * 1024u) {
+        filamat::MaterialBuilder builder;
+        builder.parameter("sampler", SamplerType::SAMPLER_2D);
+        builder.shading(filament::Shading::UNLIT);
+        builder.targetApi(MaterialBuilder::TargetApi::ALL);
+        builder.material(shaderCode.c_str());
+        builder.shaderCache(cacheDirectory, maxSize);
+        return builder.build(*jobSystem);
+    };
+
+    auto equal = [](filamat::Package const& lhs, filamat::Package const& rhs) {
+        return lhs.getSize() == rhs.getSize() &&
+                !memcmp(lhs.getData(), rhs.getData(), lhs.getSize());
+    };
+
+    // the first build fills the cache
+    filamat::Package const reference = build(nullptr);
+    filamat::Package const first = build(cacheDirectory.c_str());
+    ASSERT_TRUE(first.isValid());
+    size_t const entryCount = cacheDirectory.listContents().size();
+    EXPECT_GT(entryCount, 0u);
+    EXPECT_TRUE(equal(first, reference));
+
+    // the second build only uses the cache, and produces the same package
+    filamat::Package const second = build(cacheDirectory.c_str());
+    ASSERT_TRUE(second.isValid());
+    EXPECT_EQ(cacheDirectory.listContents().size(), entryCount);
+    EXPECT_TRUE(equal(second, reference));
+
+    // the oldest entries are deleted when the cache grows past its maximum size
+    filamat::Package const third = build(cacheDirectory.c_str(), 1);
+    ASSERT_TRUE(third.isValid());
+    EXPECT_TRUE(cacheDirectory.listContents().empty());
+    EXPECT_TRUE(equal(third, reference));
+
+    for (Path entry : cacheDirectory.listContents()) {
+        entry.unlinkFile();
+    }
+}
+
+TEST_F(MaterialCompiler, CompressedDictionaries) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = texture(materialParams_sampler, vec2(0.0, 0.0));
+        }
+    )");
+
+    auto build = [&](bool compress) {
+        filamat::MaterialBuilder builder;
+        builder.parameter("sampler", SamplerType::SAMPLER_2D);
+        builder.targetApi(MaterialBuilder::TargetApi::ALL);
+        builder.material(shaderCode.c_str());
+        builder.compressDictionaries(compress);
+        return builder.build(*jobSystem);
+    };
+
+    filamat::Package const uncompressed = build(false);
+    filamat::Package const compressed = build(true);
+    ASSERT_TRUE(uncompressed.isValid());
+    ASSERT_TRUE(compressed.isValid());
+    EXPECT_LT(compressed.getSize(), uncompressed.getSize());
+
+    filaflat::ChunkContainer uncompressedContainer(uncompressed.getData(), uncompressed.getSize());
+    filaflat::ChunkContainer compressedContainer(compressed.getData(), compressed.getSize());
+    ASSERT_TRUE(uncompressedContainer.parse());
+    ASSERT_TRUE(compressedContainer.parse());
+
+    // the compressed package only has the compressed dictionaries
+    EXPECT_FALSE(compressedContainer.hasChunk(ChunkType::DictionaryText));
+    EXPECT_TRUE(compressedContainer.hasChunk(ChunkType::DictionaryCompressedText));
+    EXPECT_FALSE(compressedContainer.hasChunk(ChunkType::DictionarySpirv));
+    EXPECT_TRUE(compressedContainer.hasChunk(ChunkType::DictionaryCompressedSpirv));
+
+    std::pair<ChunkType, ChunkType> const tags[] = {
+            { ChunkType::MaterialGlsl, ChunkType::DictionaryText },
+            { ChunkType::MaterialEssl1, ChunkType::DictionaryText },
+            { ChunkType::MaterialMetal, ChunkType::DictionaryText },
+#if defined(FILAMENT_DRIVER_SUPPORTS_VULKAN)
+            { ChunkType::MaterialSpirv, ChunkType::DictionarySpirv },
+#endif
+    };
+
+    size_t shaderCount = 0;
+    for (auto const [materialTag, dictionaryTag] : tags) {
+        ASSERT_EQ(uncompressedContainer.hasChunk(materialTag),
+                compressedContainer.hasChunk(materialTag));
+        if (!uncompressedContainer.hasChunk(materialTag)) {
+            continue;
+        }
+
+        // the shaders of the uncompressed package, decoded eagerly
+        filaflat::BlobDictionary expectedDictionary;
+        ASSERT_TRUE(filaflat::DictionaryReader::unflatten(uncompressedContainer,
+                dictionaryTag, expectedDictionary));
+        filaflat::MaterialChunk expectedChunk(uncompressedContainer);
+        ASSERT_TRUE(expectedChunk.initialize(materialTag));
+
+        // the shaders of the compressed package, decoded eagerly and lazily
+        ChunkType const compressedTag =
+                filaflat::DictionaryReader::getDictionaryTag(compressedContainer, dictionaryTag);
+        EXPECT_NE(compressedTag, dictionaryTag);
+        filaflat::BlobDictionary eagerDictionary;
+        ASSERT_TRUE(filaflat::DictionaryReader::unflatten(compressedContainer,
+                compressedTag, eagerDictionary));
+        filaflat::LazyDictionary lazyDictionary;
+        ASSERT_TRUE(lazyDictionary.initialize(compressedContainer, compressedTag));
+        filaflat::MaterialChunk chunk(compressedContainer);
+        ASSERT_TRUE(chunk.initialize(materialTag));
+
+        ASSERT_EQ(expectedChunk.getShaderCount(), chunk.getShaderCount());
+        expectedChunk.visitShaders([&](ShaderModel model, filament::Variant variant,
+                ShaderStage stage) {
+            filaflat::ShaderContent expected;
+            filaflat::ShaderContent eager;
+            filaflat::ShaderContent lazy;
+            ASSERT_TRUE(expectedChunk.getShader(expected, expectedDictionary, model, variant, stage));
+            ASSERT_TRUE(chunk.getShader(eager, eagerDictionary, model, variant, stage));
+            ASSERT_TRUE(chunk.getShader(lazy, lazyDictionary, model, variant, stage));
+            ASSERT_EQ(expected.size(), eager.size());
+            ASSERT_EQ(expected.size(), lazy.size());
+            EXPECT_EQ(0, memcmp(expected.data(), eager.data(), expected.size()));
+            EXPECT_EQ(0, memcmp(expected.data(), lazy.data(), expected.size()));
+            shaderCount++;
+        });
+    }
+    EXPECT_GT(shaderCount, 0);
+}
+
+TEST_F(MaterialCompiler, Statistics) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+        }
+    )");
+
+    auto build = [&](bool generateStatistics) {
+        filamat::MaterialBuilder builder;
+        builder.targetApi(MaterialBuilder::TargetApi::OPENGL);
+        builder.material(shaderCode.c_str());
+        builder.generateStatistics(generateStatistics);
+        return builder.build(*jobSystem);
+    };
+
+    // returns the payload of the given chunk, or nullptr if the package doesn't have it
+    auto findChunk = [](filamat::Package const& package, uint64_t type, uint32_t* size) {
+        uint8_t const* p = package.getData();
+        uint8_t const* const end = p + package.getSize();
+        while (p + sizeof(uint64_t) + sizeof(uint32_t) <= end) {
+            uint64_t chunkType;
+            memcpy(&chunkType, p, sizeof(chunkType));
+            memcpy(size, p + sizeof(chunkType), sizeof(*size));
+            p += sizeof(chunkType) + sizeof(*size);
+            if (chunkType == type) {
+                return p;
+            }
+            p += *size;
+        }
+        return (uint8_t const*)nullptr;
+    };
+
+    uint32_t size = 0;
+    filamat::Package const reference = build(false);
+    ASSERT_TRUE(reference.isValid());
+    EXPECT_EQ(findChunk(reference, filamat::MaterialStatistics, &size), nullptr);
+
+    filamat::Package const package = build(true);
+    ASSERT_TRUE(package.isValid());
+    uint8_t const* const chunk = findChunk(package, filamat::MaterialStatistics, &size);
+    ASSERT_NE(chunk, nullptr);
+
+    // unique lines, text dictionary size, unique SPIR-V blobs, SPIR-V dictionary size
+    uint32_t uniqueLineCount;
+    uint64_t shaderCount;
+    memcpy(&uniqueLineCount, chunk, sizeof(uniqueLineCount));
+    memcpy(&shaderCount, chunk + 24, sizeof(shaderCount));
+    EXPECT_GT(uniqueLineCount, 0u);
+    EXPECT_GT(shaderCount, 0u);
+
+    // language, shader model, variant, stage, generated size, output size...
+    uint32_t generatedSize;
+    uint32_t outputSize;
+    memcpy(&generatedSize, chunk + 32 + 4, sizeof(generatedSize));
+    memcpy(&outputSize, chunk + 32 + 8, sizeof(outputSize));
+    EXPECT_GT(generatedSize, 0u);
+    EXPECT_GT(outputSize, 0u);
+    EXPECT_EQ(size, 32 + shaderCount * 21);
+}
+
+TEST(Lz4, RoundTrip) {
+    std::string input;
+    for (int i = 0; i < 1000; i++) {
+        input += "vec4 color" + std::to_string(i % 37) + " = texture(sampler, uv);\n";
+    }
+
+    std::vector<char> compressed(filament::lz4::compressBound(input.size()));
+    size_t const size = filament::lz4::compress(input.data(), input.size(),
+            compressed.data(), compressed.size());
+    ASSERT_GT(size, 0u);
+    EXPECT_LT(size, input.size() / 4);
+
+    std::string output(input.size(), '\0');
+    EXPECT_TRUE(filament::lz4::decompress(compressed.data(), size, output.data(), output.size()));
+    EXPECT_EQ(output, input);
+
+    // the decompressed size must match exactly
+    EXPECT_FALSE(filament::lz4::decompress(compressed.data(), size,
+            output.data(), output.size() - 1));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
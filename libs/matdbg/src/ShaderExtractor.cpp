@@ -62,6 +62,7 @@ ShaderExtractor::ShaderExtractor(backend::ShaderLanguage target, const void* dat
 
 bool ShaderExtractor::parse() noexcept {
     if (mChunkContainer.parse()) {
+        mDictionaryTag = DictionaryReader::getDictionaryTag(mChunkContainer, mDictionaryTag);
         return mMaterialChunk.initialize(mMaterialTag);
     }
     return false;
@@ -125,11 +125,13 @@ bool ShaderReplacer::replaceShaderSource(ShaderModel shaderModel, Variant varian
     }
 
     filaflat::ChunkContainer const& cc = mOriginalPackage;
+    mDictionaryTag = DictionaryReader::getDictionaryTag(cc, mDictionaryTag);
     if (!cc.hasChunk(mMaterialTag) || !cc.hasChunk(mDictionaryTag)) {
         return false;
     }
 
-    if (mDictionaryTag == ChunkType::DictionarySpirv) {
+    if (mDictionaryTag == ChunkType::DictionarySpirv ||
+            mDictionaryTag == ChunkType::DictionaryCompressedSpirv) {
         return replaceSpirv(shaderModel, variant, stage, sourceString, stringLength);
     }
 
@@ -15,6 +15,7 @@
  */
 
 #include <filaflat/ChunkContainer.h>
+#include <filaflat/Unflattener.h>
 
 #include <filament/MaterialEnums.h>
 
@@ -429,6 +430,129 @@ static bool printShaderInfo(ostream& text, const ChunkContainer& container, Chun
     return true;
 }
 
+static bool printStatistics(ostream& text, const ChunkContainer& container) {
+    if (!container.hasChunk(ChunkType::MaterialStatistics)) {
+        return true;
+    }
+
+    auto [start, end] = container.getChunkRange(ChunkType::MaterialStatistics);
+    Unflattener unflattener(start, end);
+
+    uint32_t uniqueLineCount;
+    uint64_t textSize;
+    uint32_t uniqueSpirvCount;
+    uint64_t spirvSize;
+    uint64_t shaderCount;
+    if (!unflattener.read(&uniqueLineCount) || !unflattener.read(&textSize) ||
+            !unflattener.read(&uniqueSpirvCount) || !unflattener.read(&spirvSize) ||
+            !unflattener.read(&shaderCount)) {
+        return false;
+    }
+
+    MaterialDomain domain = MaterialDomain::SURFACE;
+    read(container, ChunkType::MaterialDomain, reinterpret_cast<uint8_t*>(&domain));
+
+    struct Totals {
+        uint32_t shaderCount = 0;
+        uint64_t generatedSize = 0;
+        uint64_t outputSize = 0;
+        uint64_t lineCount = 0;
+        uint64_t compileTime = 0;
+    };
+    Totals totals[4];
+
+    ostringstream shaders;
+    for (uint64_t i = 0; i < shaderCount; i++) {
+        uint8_t language;
+        uint8_t shaderModel;
+        Variant variant;
+        uint8_t stage;
+        uint32_t generatedSize;
+        uint32_t outputSize;
+        uint32_t lineCount;
+        uint32_t compileTime;
+        bool cached;
+        if (!unflattener.read(&language) || !unflattener.read(&shaderModel) ||
+                !unflattener.read(&variant) || !unflattener.read(&stage) ||
+                !unflattener.read(&generatedSize) || !unflattener.read(&outputSize) ||
+                !unflattener.read(&lineCount) || !unflattener.read(&compileTime) ||
+                !unflattener.read(&cached) || language >= size(totals)) {
+            return false;
+        }
+
+        Totals& t = totals[language];
+        t.shaderCount++;
+        t.generatedSize += generatedSize;
+        t.outputSize += outputSize;
+        t.lineCount += lineCount;
+        t.compileTime += compileTime;
+
+        shaders << "    " << setw(9) << left << shaderLanguageToString(ShaderLanguage(language));
+        shaders << setw(8) << left << toString(ShaderModel(shaderModel));
+        shaders << setw(3) << left << toString(ShaderStage(stage));
+        shaders << "0x" << hex << setfill('0') << setw(2) << right << +variant.key;
+        shaders << setfill(' ') << dec;
+        shaders << setw(10) << right << generatedSize;
+        shaders << setw(10) << right << outputSize;
+        shaders << setw(8) << right << lineCount;
+        shaders << setw(10) << right << fixed << setprecision(1) << compileTime / 1000.0 << " ms";
+        shaders << (cached ? "  (cached) " : "   ");
+        shaders << formatVariantString(variant, domain);
+        shaders << endl;
+    }
+
+    uint64_t textLineCount = 0;
+    uint32_t spirvCount = totals[size_t(ShaderLanguage::SPIRV)].shaderCount;
+    for (Totals const& t : totals) {
+        textLineCount += t.lineCount;
+    }
+
+    text << "Shader statistics:" << endl;
+    text << "    " << setw(alignment) << left << "Text lines: ";
+    text << textLineCount << " (" << uniqueLineCount << " unique)" << endl;
+    text << "    " << setw(alignment) << left << "Text dictionary: ";
+    text << textSize << " bytes" << endl;
+    text << "    " << setw(alignment) << left << "SPIR-V shaders: ";
+    text << spirvCount << " (" << uniqueSpirvCount << " unique)" << endl;
+    text << "    " << setw(alignment) << left << "SPIR-V dictionary: ";
+    text << spirvSize << " bytes" << endl;
+    text << endl;
+
+    text << "    " << setw(9) << left << "Language";
+    text << setw(8) << right << "Shaders";
+    text << setw(12) << right << "Generated";
+    text << setw(10) << right << "Output";
+    text << setw(7) << right << "Ratio";
+    text << setw(15) << right << "Compile time" << endl;
+    for (size_t i = 0; i < size(totals); i++) {
+        Totals const& t = totals[i];
+        if (!t.shaderCount) {
+            continue;
+        }
+        text << "    " << setw(9) << left << shaderLanguageToString(ShaderLanguage(i));
+        text << setw(8) << right << t.shaderCount;
+        text << setw(12) << right << t.generatedSize;
+        text << setw(10) << right << t.outputSize;
+        text << setw(6) << right << fixed << setprecision(0)
+             << (t.generatedSize ? 100.0 * double(t.outputSize) / double(t.generatedSize) : 0.0)
+             << "%";
+        text << setw(12) << right << fixed << setprecision(1) << t.compileTime / 1000.0 << " ms";
+        text << endl;
+    }
+    text << endl;
+
+    text << "    " << setw(9) << left << "Language";
+    text << setw(8) << left << "Model";
+    text << setw(7) << left << "Stage";
+    text << setw(10) << right << "Generated";
+    text << setw(10) << right << "Output";
+    text << setw(8) << right << "Lines";
+    text << setw(13) << right << "Compile time" << endl;
+    text << shaders.str() << endl;
+    text << defaultfloat;
+    return true;
+}
+
 bool TextWriter::writeMaterialInfo(const filaflat::ChunkContainer& container) {
     ostringstream text;
     if (!printMaterial(text, container)) {
@@ -455,6 +579,9 @@ bool TextWriter::writeMaterialInfo(const filaflat::ChunkContainer& container) {
     if (!printShaderInfo(text, container, ChunkType::MaterialMetal)) {
         return false;
     }
+    if (!printStatistics(text, container)) {
+        return false;
+    }
 
     printChunks(text, container);
 
@@ -7,6 +7,11 @@
 #define FROXEL_BUFFER_WIDTH         (1u << FROXEL_BUFFER_WIDTH_SHIFT)
 #define FROXEL_BUFFER_WIDTH_MASK    (FROXEL_BUFFER_WIDTH - 1u)
 
+// Make sure this matches CONFIG_MAX_LIGHT_UNIFORM_COUNT and CONFIG_LIGHT_TEXTURE_WIDTH
+#define LIGHT_UNIFORM_COUNT         256u
+#define LIGHT_TEXTURE_WIDTH_SHIFT   8u
+#define LIGHT_TEXTURE_WIDTH_MASK    ((1u << LIGHT_TEXTURE_WIDTH_SHIFT) - 1u)
+
 #define LIGHT_TYPE_POINT            0u
 #define LIGHT_TYPE_SPOT             1u
 
@@ -14,6 +19,7 @@
 struct FroxelParams {
     uint recordOffset; // offset at which the list of lights for this froxel starts
     uint count;   // number lights in this froxel
+    uint recordShift; // log2 of the size of a record in bits, 3 (8 bits) or 4 (16 bits)
 };
 
 /**
@@ -74,20 +80,23 @@ FroxelParams getFroxelParams(const uint froxelIndex) {
     FroxelParams froxel;
     froxel.recordOffset = f >> 16u;
     froxel.count = f & 0xFFu;
+    froxel.recordShift = 3u + ((f >> 8u) & 0x1u);
     return froxel;
 }
 
 /**
  * Return the light index from the record index
- * A light record is a single uint index into the lights data buffer (lightsUniforms UBO).
+ * A light record is a single uint index into the lights data (see getLight()). Records are
+ * 8 bits, or 16 bits when there are more than 256 lights.
  */
-uint getLightIndex(const uint index) {
-    uint v = index >> 4u;
-    uint c = (index >> 2u) & 0x3u;
-    uint s = (index & 0x3u) * 8u;
+uint getLightIndex(const uint index, const uint recordShift) {
+    uint b = index << recordShift; // offset of the record in bits
+    uint v = b >> 7u;
+    uint c = (b >> 5u) & 0x3u;
+    uint s = b & 0x1Fu;
     // this intermediate is needed to workaround a bug on qualcomm h/w
     highp uvec4 d = froxelRecordUniforms.records[v];
-    return (d[c] >> s) & 0xFFu;
+    return (d[c] >> s) & ((1u << (1u << recordShift)) - 1u);
 }
 
 float getSquareFalloffAttenuation(float distanceSquare, float falloff) {
@@ -120,13 +129,23 @@ float getAngleAttenuation(const highp vec3 lightDir, const highp vec3 l, const h
  * in the w component.
  *
  * The light parameters used to compute the Light structure are fetched from the
- * lightsUniforms uniform buffer.
+ * lightsUniforms uniform buffer, or from the lights texture for the lights that don't fit in it.
  */
 
 Light getLight(const uint lightIndex) {
-    // retrieve the light data from the UBO
-
-    highp mat4 data = lightsUniforms.lights[lightIndex];
+    // retrieve the light data from the UBO, or from the lights texture (4 texels per light)
+
+    highp mat4 data;
+    if (lightIndex < LIGHT_UNIFORM_COUNT) {
+        data = lightsUniforms.lights[lightIndex];
+    } else {
+        highp uint i = lightIndex - LIGHT_UNIFORM_COUNT;
+        ivec2 uv = ivec2((i & LIGHT_TEXTURE_WIDTH_MASK) * 4u, i >> LIGHT_TEXTURE_WIDTH_SHIFT);
+        data[0] = texelFetch(light_lights, uv, 0);
+        data[1] = texelFetch(light_lights, uv + ivec2(1, 0), 0);
+        data[2] = texelFetch(light_lights, uv + ivec2(2, 0), 0);
+        data[3] = texelFetch(light_lights, uv + ivec2(3, 0), 0);
+    }
 
     highp vec4 positionFalloff = data[0];
     highp vec3 direction = data[1].xyz;
@@ -194,7 +213,7 @@ void evaluatePunctualLights(const MaterialInputs material,
 
     // Iterate point lights
     for ( ; index < end; index++) {
-        uint lightIndex = getLightIndex(index);
+        uint lightIndex = getLightIndex(index, froxel.recordShift);
         Light light = getLight(lightIndex);
         if ((light.channels & channels) == 0) {
             continue;
@@ -22,9 +22,11 @@
 
 #include <utils/Path.h>
 
+#include <algorithm>
 #include <istream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using namespace utils;
 
@@ -41,6 +43,7 @@ static void usage(char* name) {
             "\n"
             "Usages:\n"
             "    MATC [options] <input-file>\n"
+            "    MATC --batch [options] -o <output-directory> <input>...\n"
             "\n"
             "Supported input formats:\n"
             "    Filament material definition (.mat)\n"
@@ -51,7 +54,14 @@ static void usage(char* name) {
             "   --license\n"
             "       Print copyright and license information\n\n"
             "   --output, -o\n"
-            "       Specify path to output file\n\n"
+            "       Specify path to output file, or to the output directory in batch mode\n\n"
+            "   --batch, -b\n"
+            "       Compile several materials at once, sharing the compiler's resources and\n"
+            "       scheduling the shader variants of all materials together. Each input is either\n"
+            "       a material file, a directory whose .mat files are compiled, or @<file> to read\n"
+            "       the material files to compile from <file>, one per line. The output files are\n"
+            "       named after the materials: <name>.filamat, or <name>.inc with --output-format\n"
+            "       header. The throughput is printed at the end.\n\n"
             "   --platform, -p\n"
             "       Shader family to generate: desktop, mobile or all (default)\n\n"
             "   --optimize-size, -S\n"
@@ -81,6 +91,15 @@ static void usage(char* name) {
             "           directionalLighting, dynamicLighting, shadowReceiver, skinning, vsm, fog,"
             "           ssr (screen-space reflections), stereo\n"
             "       This variant filter is merged with the filter from the material, if any\n\n"
+            "   --cache <directory>, -c <directory>\n"
+            "       Cache the compiled shaders in the specified directory. Subsequent builds only\n"
+            "       compile the variants whose generated code or compilation options changed.\n"
+            "       The directory can be shared by several instances of MATC running at once.\n\n"
+            "   --compress, -z\n"
+            "       Compress the shader dictionaries with LZ4, to produce smaller packages\n\n"
+            "   --statistics, -s\n"
+            "       Include statistics about the shaders in the package, e.g. the size and compile\n"
+            "       time of each variant. Use matinfo to display them\n\n"
             "   --version, -v\n"
             "       Print the material version number\n\n"
             "Internal use and debugging only:\n"
@@ -143,6 +162,42 @@ static filament::UserVariantFilterMask parseVariantFilter(const std::string& arg
     return variantFilter;
 }
 
+static bool addBatchInputs(const char* arg, std::vector<std::string>& inputs) {
+    if (arg[0] == '@') {
+        std::ifstream list(arg + 1);
+        if (!list) {
+            std::cerr << "Unable to open material list '" << (arg + 1) << "'" << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(list, line)) {
+            line.erase(0, line.find_first_not_of(" \t\r"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#') {
+                inputs.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    Path const path(arg);
+    if (path.isDirectory()) {
+        std::vector<Path> contents = path.listContents();
+        std::sort(contents.begin(), contents.end(), [](Path const& lhs, Path const& rhs) {
+            return lhs.getPath() < rhs.getPath();
+        });
+        for (Path const& entry : contents) {
+            if (entry.isFile() && entry.getExtension() == "mat") {
+                inputs.push_back(entry.getPath());
+            }
+        }
+        return true;
+    }
+
+    inputs.emplace_back(arg);
+    return true;
+}
+
 CommandlineConfig::CommandlineConfig(int argc, char** argv) : Config(), mArgc(argc), mArgv(argv) {
     mIsValid = parse();
 }
@@ -174,7 +229,7 @@ static void parseDefine(std::string defineString, Config::StringReplacementMap&
 }
 
 bool CommandlineConfig::parse() {
-    static constexpr const char* OPTSTR = "hLxo:f:dm:a:l:p:D:T:OSEr:vV:gtwF1";
+    static constexpr const char* OPTSTR = "hLxo:f:dm:a:l:p:D:T:OSEr:vV:gtwF1c:bzs";
     static const struct option OPTIONS[] = {
             { "help",                    no_argument, nullptr, 'h' },
             { "license",                 no_argument, nullptr, 'L' },
@@ -198,11 +253,16 @@ bool CommandlineConfig::parse() {
             { "version",                 no_argument, nullptr, 'v' },
             { "raw",                     no_argument, nullptr, 'w' },
             { "no-sampler-validation",   no_argument, nullptr, 'F' },
+            { "cache",             required_argument, nullptr, 'c' },
+            { "batch",                   no_argument, nullptr, 'b' },
+            { "compress",                no_argument, nullptr, 'z' },
+            { "statistics",              no_argument, nullptr, 's' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
 
     int opt;
     int option_index = 0;
+    std::string outputPath;
 
     while ((opt = getopt_long(mArgc, mArgv, OPTSTR, OPTIONS, &option_index)) >= 0) {
         std::string arg(optarg ? optarg : "");
@@ -217,7 +277,7 @@ bool CommandlineConfig::parse() {
                 exit(0);
                 break;
             case 'o':
-                mOutput = new FilesystemOutput(arg.c_str());
+                outputPath = arg;
                 break;
             case 'f':
                 if (arg == "blob") {
@@ -318,9 +378,35 @@ bool CommandlineConfig::parse() {
             case 'F':
                 mNoSamplerValidation = true;
                 break;
+            case 'c':
+                mShaderCacheDirectory = arg;
+                break;
+            case 'b':
+                mBatch = true;
+                break;
+            case 'z':
+                mCompressDictionaries = true;
+                break;
+            case 's':
+                mGenerateStatistics = true;
+                break;
         }
     }
 
+    if (mBatch) {
+        for (int i = optind; i < mArgc; i++) {
+            if (!addBatchInputs(mArgv[i], mBatchInputs)) {
+                return false;
+            }
+        }
+        mOutputDirectory = outputPath;
+        return true;
+    }
+
+    if (!outputPath.empty()) {
+        mOutput = new FilesystemOutput(outputPath.c_str());
+    }
+
     if (mArgc - optind > 1) {
         std::cerr << "Only one input file should be specified on the command line." << std::endl;
         return false;
@@ -25,6 +25,8 @@
 #include <map>
 #include <memory>
 #include <ostream>
+#include <string>
+#include <vector>
 
 #include <utils/compiler.h>
 
@@ -139,6 +141,32 @@ public:
         return mFeatureLevel;
     }
 
+    const std::string& getShaderCacheDirectory() const noexcept {
+        return mShaderCacheDirectory;
+    }
+
+    bool compressDictionaries() const noexcept {
+        return mCompressDictionaries;
+    }
+
+    bool generateStatistics() const noexcept {
+        return mGenerateStatistics;
+    }
+
+    // In batch mode, the materials to compile replace the input, and the outputs are written to
+    // the output directory.
+    bool isBatch() const noexcept {
+        return mBatch;
+    }
+
+    const std::vector<std::string>& getBatchInputs() const noexcept {
+        return mBatchInputs;
+    }
+
+    const std::string& getOutputDirectory() const noexcept {
+        return mOutputDirectory;
+    }
+
 protected:
     bool mDebug = false;
     bool mIsValid = true;
@@ -155,6 +183,12 @@ protected:
     StringReplacementMap mTemplateMap;
     filament::UserVariantFilterMask mVariantFilter = 0;
     bool mIncludeEssl1 = true;
+    std::string mShaderCacheDirectory;
+    bool mCompressDictionaries = false;
+    bool mGenerateStatistics = false;
+    bool mBatch = false;
+    std::vector<std::string> mBatchInputs;
+    std::string mOutputDirectory;
 };
 
 }
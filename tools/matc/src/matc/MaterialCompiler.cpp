@@ -16,9 +16,13 @@
 
 #include "MaterialCompiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <iostream>
 #include <utility>
+#include <vector>
 
 #include <filamat/MaterialBuilder.h>
 
@@ -287,14 +291,14 @@ bool MaterialCompiler::isValidJsonStart(const char* buffer, size_t size) const n
     return c == 'n' && (end - buffer) > 3 && strncmp(buffer, "null", 5) != 0;
 }
 
-bool MaterialCompiler::run(const Config& config) {
-    Config::Input* input = config.getInput();
-    ssize_t size = input->open();
+bool MaterialCompiler::readInput(const Config& config, Config::Input* input,
+        std::unique_ptr<const char[]>& buffer, ssize_t& size) const noexcept {
+    size = input->open();
     if (size <= 0) {
         std::cerr << "Input file is empty" << std::endl;
         return false;
     }
-    std::unique_ptr<const char[]> buffer = input->read();
+    buffer = input->read();
 
     // Perform template substitutions in two passes: the first pass determines the size of the
     // modified buffer and checks for errors. The second pass rebuilds the buffer.
@@ -356,10 +360,24 @@ bool MaterialCompiler::run(const Config& config) {
         size = modifiedSize;
     }
 
-    utils::Path const materialFilePath = utils::Path(input->getName()).getAbsolutePath();
-    assert(materialFilePath.isFile());
+    return true;
+}
+
+bool MaterialCompiler::run(const Config& config) {
+    if (config.isBatch()) {
+        return runBatch(config);
+    }
+
+    Config::Input* input = config.getInput();
 
     if (config.rawShaderMode()) {
+        std::unique_ptr<const char[]> buffer;
+        ssize_t size = 0;
+        if (!readInput(config, input, buffer, size)) {
+            return false;
+        }
+        utils::Path const materialFilePath = utils::Path(input->getName()).getAbsolutePath();
+        assert(materialFilePath.isFile());
         const std::string extension = materialFilePath.getExtension();
         glslang::InitializeProcess();
         bool const success = compileRawShader(buffer.get(), size, config.isDebug(), config.getOutput(),
@@ -369,6 +387,105 @@ bool MaterialCompiler::run(const Config& config) {
     }
 
     MaterialBuilder::init();
+    JobSystem js;
+    js.adopt();
+
+    bool const success = compileMaterial(config, input, config.getOutput(), js);
+
+    js.emancipate();
+    MaterialBuilder::shutdown();
+    return success;
+}
+
+bool MaterialCompiler::runBatch(const Config& config) {
+    auto const& inputs = config.getBatchInputs();
+
+    // outputs are named after their material, so two materials can't have the same name
+    const char* const extension =
+            config.getOutputFormat() == Config::OutputFormat::BLOB ? ".filamat" : ".inc";
+    std::vector<std::string> outputs;
+    outputs.reserve(inputs.size());
+    std::unordered_map<std::string, std::string const*> names;
+    for (auto const& input : inputs) {
+        std::string const name = utils::Path(input).getNameWithoutExtension();
+        if (auto [pos, inserted] = names.emplace(name, &input); !inserted) {
+            std::cerr << "Materials " << *pos->second << " and " << input
+                    << " would be compiled to the same output file" << std::endl;
+            return false;
+        }
+        outputs.push_back(
+                utils::Path::concat(config.getOutputDirectory(), name + extension).getPath());
+    }
+
+    if (!utils::Path(config.getOutputDirectory()).mkdirRecursive()) {
+        std::cerr << "Unable to create output directory " << config.getOutputDirectory()
+                << std::endl;
+        return false;
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+
+    MaterialBuilder::init();
+    JobSystem js;
+    js.adopt();
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> failureCount{ 0 };
+    auto compileMaterials = [&]() {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            FilesystemInput input(inputs[i].c_str());
+            FilesystemOutput output(outputs[i].c_str());
+            if (!compileMaterial(config, &input, &output, js)) {
+                failureCount++;
+            }
+        }
+    };
+
+    // The first material is compiled on its own, because glslang isn't thread-safe on first use
+    // (see MaterialBuilder::generateShaders).
+    if (!inputs.empty()) {
+        FilesystemInput input(inputs[0].c_str());
+        FilesystemOutput output(outputs[0].c_str());
+        if (!compileMaterial(config, &input, &output, js)) {
+            failureCount++;
+        }
+        next = 1;
+    }
+
+    // The other materials are compiled concurrently, one per thread, so that the shader variants
+    // of all of them are scheduled together on the job system. Each material's build waits for
+    // its variants by running other jobs, which is why there are no more concurrent builds than
+    // threads: this bounds how deeply builds can nest in a thread's stack.
+    size_t const concurrency = std::min(js.getThreadCount() + 1, inputs.size());
+    JobSystem::Job* root = js.createJob();
+    for (size_t i = 0; i < concurrency; i++) {
+        js.run(jobs::createJob(js, root, compileMaterials));
+    }
+    js.runAndWait(root);
+
+    js.emancipate();
+    MaterialBuilder::shutdown();
+
+    std::chrono::duration<double> const duration = std::chrono::steady_clock::now() - start;
+    size_t const successCount = inputs.size() - failureCount;
+    std::cout << "Compiled " << successCount << " of " << inputs.size() << " materials in "
+            << duration.count() << " s (" << double(successCount) / duration.count()
+            << " materials/s)" << std::endl;
+
+    return failureCount == 0;
+}
+
+bool MaterialCompiler::compileMaterial(const Config& config, Config::Input* input,
+        Config::Output* output, JobSystem& js) noexcept {
+    std::unique_ptr<const char[]> buffer;
+    ssize_t size = 0;
+    if (!readInput(config, input, buffer, size)) {
+        return false;
+    }
+
+    utils::Path const materialFilePath = utils::Path(input->getName()).getAbsolutePath();
+    assert(materialFilePath.isFile());
+
     MaterialBuilder builder;
     // Before attempting an expensive lex, let's find out if we were sent pure JSON.
     bool parsed;
@@ -409,29 +526,42 @@ bool MaterialCompiler::run(const Config& config) {
         .optimization(config.getOptimizationLevel())
         .printShaders(config.printShaders())
         .generateDebugInfo(config.isDebug())
+        .shaderCache(config.getShaderCacheDirectory().c_str())
+        .compressDictionaries(config.compressDictionaries())
+        .generateStatistics(config.generateStatistics())
         .variantFilter(config.getVariantFilter() | builder.getVariantFilter());
 
     for (const auto& define : config.getDefines()) {
         builder.shaderDefine(define.first.c_str(), define.second.c_str());
     }
 
-    JobSystem js;
-    js.adopt();
-
     // Write builder.build() to output.
     Package const package = builder.build(js);
 
-    js.emancipate();
-    MaterialBuilder::shutdown();
-
     if (!package.isValid()) {
         std::cerr << "Could not compile material " << input->getName() << std::endl;
         return false;
     }
-    return writePackage(package, config);
+    return writePackage(package, config, output);
 }
 
 bool MaterialCompiler::checkParameters(const Config& config) {
+    if (config.isBatch()) {
+        if (config.getBatchInputs().empty()) {
+            std::cerr << "Missing input materials." << std::endl;
+            return false;
+        }
+        if (config.getOutputDirectory().empty()) {
+            std::cerr << "Missing output directory." << std::endl;
+            return false;
+        }
+        if (config.rawShaderMode() || config.getReflectionTarget() != Config::Metadata::NONE) {
+            std::cerr << "Batch mode only compiles materials." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     // Check for input file.
     if (config.getInput() == nullptr) {
         std::cerr << "Missing input filename." << std::endl;
@@ -17,6 +17,7 @@
 #ifndef TNT_MATERIALCOMPILER_H
 #define TNT_MATERIALCOMPILER_H
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -26,6 +27,9 @@
 namespace filamat {
 class MaterialBuilder;
 }
+namespace utils {
+class JobSystem;
+}
 class TestMaterialCompiler;
 
 namespace matc {
@@ -42,6 +46,16 @@ public:
 private:
     friend class ::TestMaterialCompiler;
 
+    bool runBatch(const Config& config);
+
+    // Reads the input and performs the template substitutions.
+    bool readInput(const Config& config, Config::Input* input,
+            std::unique_ptr<const char[]>& buffer, ssize_t& size) const noexcept;
+
+    // Compiles the material read from input and writes the package to output.
+    bool compileMaterial(const Config& config, Config::Input* input, Config::Output* output,
+            utils::JobSystem& js) noexcept;
+
     bool parseMaterial(const char* buffer, size_t size,
             filamat::MaterialBuilder& builder) const noexcept;
     bool processMaterial(const MaterialLexeme&,
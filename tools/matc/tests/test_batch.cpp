@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <matc/CommandlineConfig.h>
+#include <matc/Config.h>
+#include <matc/MaterialCompiler.h>
+
+#include <utils/Path.h>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace matc;
+
+static std::pair<const char*, const char*> const sMaterials[] = {
+        { "batch_lit", R"(
+material {
+    name : batch_lit,
+    shadingModel : lit,
+    parameters : [
+        { type : float3, name : baseColor },
+        { type : float, name : roughness }
+    ]
+}
+fragment {
+    void material(inout MaterialInputs material) {
+        prepareMaterial(material);
+        material.baseColor.rgb = materialParams.baseColor;
+        material.roughness = materialParams.roughness;
+    }
+}
+)" },
+        { "batch_unlit", R"(
+material {
+    name : batch_unlit,
+    shadingModel : unlit,
+    parameters : [
+        { type : sampler2d, name : texture }
+    ],
+    requires : [ uv0 ]
+}
+fragment {
+    void material(inout MaterialInputs material) {
+        prepareMaterial(material);
+        material.baseColor = texture(materialParams_texture, getUV0());
+    }
+}
+)" },
+        { "batch_transparent", R"(
+material {
+    name : batch_transparent,
+    shadingModel : lit,
+    blending : transparent,
+    parameters : [
+        { type : float4, name : color }
+    ]
+}
+fragment {
+    void material(inout MaterialInputs material) {
+        prepareMaterial(material);
+        material.baseColor = materialParams.color;
+    }
+}
+)" },
+};
+
+// Compiles for a single backend and a few variants, to keep the test short.
+class TestConfig : public Config {
+public:
+    TestConfig() {
+        mPlatform = Platform::MOBILE;
+        mTargetApi = TargetApi::OPENGL;
+        mVariantFilter = filament::UserVariantFilterMask(
+                filament::UserVariantFilterBit::SKINNING |
+                filament::UserVariantFilterBit::FOG |
+                filament::UserVariantFilterBit::VSM |
+                filament::UserVariantFilterBit::SSR |
+                filament::UserVariantFilterBit::STE);
+    }
+
+    void setBatch(std::vector<std::string> inputs, std::string outputDirectory) {
+        mBatch = true;
+        mBatchInputs = std::move(inputs);
+        mOutputDirectory = std::move(outputDirectory);
+    }
+
+    void setFiles(std::string const& input, std::string const& output) {
+        mInput = std::make_unique<FilesystemInput>(input.c_str());
+        mOutput = std::make_unique<FilesystemOutput>(output.c_str());
+    }
+
+    Output* getOutput() const noexcept override { return mOutput.get(); }
+    Input* getInput() const noexcept override { return mInput.get(); }
+    std::string toString() const noexcept override { return ""; }
+
+private:
+    std::unique_ptr<FilesystemInput> mInput;
+    std::unique_ptr<FilesystemOutput> mOutput;
+};
+
+static std::vector<char> readFile(std::string const& path) {
+    std::ifstream in(path, std::ifstream::binary);
+    return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+TEST(TestBatch, BatchMatchesSingleMaterialBuilds) {
+    utils::Path const root = utils::Path::concat(
+            utils::Path::getTemporaryDirectory(), "test_matc_batch");
+    utils::Path const sources = utils::Path::concat(root, "sources");
+    utils::Path const batchOutputs = utils::Path::concat(root, "batch");
+    utils::Path const singleOutputs = utils::Path::concat(root, "single");
+    ASSERT_TRUE(sources.mkdirRecursive());
+    ASSERT_TRUE(singleOutputs.mkdirRecursive());
+
+    std::vector<std::string> inputs;
+    for (auto const& [name, source] : sMaterials) {
+        std::string const path = utils::Path::concat(sources, std::string(name) + ".mat");
+        std::ofstream(path, std::ofstream::binary) << source;
+        inputs.push_back(path);
+    }
+
+    // several materials at once, their variants are compiled concurrently
+    TestConfig batchConfig;
+    batchConfig.setBatch(inputs, batchOutputs);
+    MaterialCompiler batchCompiler;
+    ASSERT_TRUE(batchCompiler.checkParameters(batchConfig));
+    ASSERT_TRUE(batchCompiler.run(batchConfig));
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::string const name = std::string(sMaterials[i].first) + ".filamat";
+        std::string const single = utils::Path::concat(singleOutputs, name);
+
+        TestConfig singleConfig;
+        singleConfig.setFiles(inputs[i], single);
+        MaterialCompiler singleCompiler;
+        ASSERT_TRUE(singleCompiler.checkParameters(singleConfig));
+        ASSERT_TRUE(singleCompiler.run(singleConfig));
+
+        std::vector<char> const expected = readFile(single);
+        std::vector<char> const actual = readFile(utils::Path::concat(batchOutputs, name));
+        EXPECT_FALSE(expected.empty()) << name;
+        EXPECT_TRUE(expected == actual) << name << " differs from its single-material build";
+    }
+
+    for (char const* dir : { "sources", "batch", "single" }) {
+        for (auto& file : utils::Path::concat(root, dir).listContents()) {
+            file.unlinkFile();
+        }
+    }
+}
@@ -332,7 +332,9 @@ value_object<LightManager::ShadowOptions>("LightManager$ShadowOptions")
     .field("stepCount", &LightManager::ShadowOptions::stepCount)
     .field("maxShadowDistance", &LightManager::ShadowOptions::maxShadowDistance)
     .field("shadowBulbRadius", &LightManager::ShadowOptions::shadowBulbRadius)
-    .field("transform", &LightManager::ShadowOptions::transform);
+    .field("transform", &LightManager::ShadowOptions::transform)
+    .field("cacheShadowMap", &LightManager::ShadowOptions::cacheShadowMap)
+    .field("cascadeUpdateInterval", &LightManager::ShadowOptions::cascadeUpdateInterval);
 
 // In JavaScript, a flat contiguous representation is best for matrices (see gl-matrix) so we
 // need to define a small wrapper here.